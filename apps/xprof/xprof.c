@@ -0,0 +1,272 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * xprof - print the per-request counts of a server started with
+ * -reqprofile, as reported by the X-Resource QueryRequestProfile request.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <xcb/xcb.h>
+#include <xcb/xcbext.h>
+#include <xcb/xcb_errors.h>
+#include <X11/Xmd.h>
+#include "xresprivproto.h"
+
+typedef enum { SORT_TIME, SORT_COUNT, SORT_BYTES } SortKey;
+
+typedef struct {
+    int major, minor;
+    unsigned long long count, bytes, time;
+    CARD32 hist[XResRequestProfileBuckets];
+} Profile;
+
+static xcb_extension_t res_id = { "X-Resource", 0 };
+
+static const char *program_name;
+static SortKey sort_key = SORT_TIME;
+
+static void
+usage(void)
+{
+    fprintf(stderr,
+            "usage:  %s [-options ...]\n\n"
+            "where options include:\n"
+            "    -display host:dpy       X server to contact\n"
+            "    -id resource            show the client owning resource\n"
+            "    -sort time|count|bytes  order of the output, default time\n"
+            "    -hist                   print a latency histogram per request\n"
+            "    -reset                  clear the counts once printed\n"
+            "\n", program_name);
+    exit(1);
+}
+
+static unsigned long long
+wide(CARD32 low, CARD32 high)
+{
+    return ((unsigned long long) high << 32) | low;
+}
+
+static unsigned long long
+sort_value(const Profile *p)
+{
+    switch (sort_key) {
+    case SORT_COUNT:
+        return p->count;
+    case SORT_BYTES:
+        return p->bytes;
+    default:
+        return p->time;
+    }
+}
+
+static int
+compare_profiles(const void *a, const void *b)
+{
+    unsigned long long va = sort_value(a), vb = sort_value(b);
+
+    return va < vb ? 1 : va > vb ? -1 : 0;
+}
+
+static void
+request_name(xcb_errors_context_t *ctx, const Profile *p, char *buf,
+             size_t len)
+{
+    const char *major = NULL, *minor = NULL;
+
+    if (ctx) {
+        major = xcb_errors_get_name_for_major_code(ctx, p->major);
+        if (p->major >= 128)
+            minor = xcb_errors_get_name_for_minor_code(ctx, p->major,
+                                                       p->minor);
+    }
+    if (p->major < 128)
+        snprintf(buf, len, "%s", major ? major : "Unknown");
+    else if (major && minor)
+        snprintf(buf, len, "%s.%s", major, minor);
+    else if (major)
+        snprintf(buf, len, "%s.%d", major, p->minor);
+    else
+        snprintf(buf, len, "%d.%d", p->major, p->minor);
+}
+
+static void
+print_histogram(const Profile *p)
+{
+    int i;
+
+    printf("    ");
+    for (i = 0; i < XResRequestProfileBuckets; i++) {
+        if (!p->hist[i])
+            continue;
+        if (i == XResRequestProfileBuckets - 1)
+            printf(" >=%luus:%u", 1UL << (i - 1), (unsigned) p->hist[i]);
+        else
+            printf(" <%luus:%u", 1UL << i, (unsigned) p->hist[i]);
+    }
+    printf("\n");
+}
+
+int
+main(int argc, char **argv)
+{
+    const char *display = NULL;
+    unsigned long xid = 0;
+    int hist = 0, reset = 0;
+    xcb_connection_t *c;
+    const xcb_query_extension_reply_t *ext;
+    xcb_errors_context_t *ctx = NULL;
+    xXResQueryRequestProfileReq req;
+    xXResQueryRequestProfileReply *rep;
+    xXResRequestProfile *wire;
+    xcb_protocol_request_t xcb_req = {
+        .count = 2,
+        .ext = &res_id,
+        .opcode = X_XResQueryRequestProfile,
+        .isvoid = 0
+    };
+    struct iovec parts[4];
+    xcb_generic_error_t *err = NULL;
+    unsigned int seq;
+    Profile *profiles;
+    unsigned long long total_count = 0, total_time = 0;
+    int i, n;
+
+    program_name = argv[0];
+    for (i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-display") || !strcmp(argv[i], "-d")) {
+            if (++i >= argc)
+                usage();
+            display = argv[i];
+        }
+        else if (!strcmp(argv[i], "-id")) {
+            if (++i >= argc)
+                usage();
+            xid = strtoul(argv[i], NULL, 0);
+        }
+        else if (!strcmp(argv[i], "-sort")) {
+            if (++i >= argc)
+                usage();
+            if (!strcmp(argv[i], "time"))
+                sort_key = SORT_TIME;
+            else if (!strcmp(argv[i], "count"))
+                sort_key = SORT_COUNT;
+            else if (!strcmp(argv[i], "bytes"))
+                sort_key = SORT_BYTES;
+            else
+                usage();
+        }
+        else if (!strcmp(argv[i], "-hist"))
+            hist = 1;
+        else if (!strcmp(argv[i], "-reset"))
+            reset = 1;
+        else
+            usage();
+    }
+
+    c = xcb_connect(display, NULL);
+    if (xcb_connection_has_error(c)) {
+        fprintf(stderr, "%s: unable to open display \"%s\"\n",
+                program_name, display ? display : "");
+        return 1;
+    }
+
+    ext = xcb_get_extension_data(c, &res_id);
+    if (!ext || !ext->present) {
+        fprintf(stderr, "%s: X-Resource extension not present\n",
+                program_name);
+        return 1;
+    }
+    if (xcb_errors_context_new(c, &ctx) < 0)
+        ctx = NULL;
+
+    memset(&req, 0, sizeof(req));
+    req.xid = xid;
+    req.reset = reset;
+    parts[2].iov_base = (char *) &req;
+    parts[2].iov_len = sizeof(req);
+    parts[3].iov_base = NULL;
+    parts[3].iov_len = -parts[2].iov_len & 3;
+    seq = xcb_send_request(c, XCB_REQUEST_CHECKED, parts + 2, &xcb_req);
+
+    rep = xcb_wait_for_reply(c, seq, &err);
+    if (!rep) {
+        if (err && err->error_code == XCB_REQUEST)
+            fprintf(stderr, "%s: server does not support request "
+                    "profiling\n", program_name);
+        else if (err && err->error_code == XCB_VALUE)
+            fprintf(stderr, "%s: no client owns resource 0x%lx\n",
+                    program_name, xid);
+        else if (err && err->error_code == XCB_ACCESS)
+            fprintf(stderr, "%s: not allowed to see those counts\n",
+                    program_name);
+        else
+            fprintf(stderr, "%s: QueryRequestProfile failed\n",
+                    program_name);
+        return 1;
+    }
+    if (!rep->enabled)
+        fprintf(stderr, "%s: server not started with -reqprofile\n",
+                program_name);
+
+    n = rep->num_requests;
+    wire = (xXResRequestProfile *) (rep + 1);
+    profiles = calloc(n ? n : 1, sizeof(Profile));
+    if (!profiles)
+        return 1;
+    for (i = 0; i < n; i++) {
+        profiles[i].major = wire[i].major;
+        profiles[i].minor = wire[i].minor;
+        profiles[i].count = wide(wire[i].count, wire[i].count_overflow);
+        profiles[i].bytes = wide(wire[i].bytes, wire[i].bytes_overflow);
+        profiles[i].time = wide(wire[i].time, wire[i].time_overflow);
+        memcpy(profiles[i].hist, wire[i].hist, sizeof(profiles[i].hist));
+        total_count += profiles[i].count;
+        total_time += profiles[i].time;
+    }
+    qsort(profiles, n, sizeof(Profile), compare_profiles);
+
+    printf("%12s %14s %12s %10s %6s  %s\n",
+           "requests", "bytes", "total ms", "mean us", "time%", "request");
+    for (i = 0; i < n; i++) {
+        Profile *p = &profiles[i];
+        char name[128];
+
+        request_name(ctx, p, name, sizeof(name));
+        printf("%12llu %14llu %12.3f %10.2f %6.2f  %s\n",
+               p->count, p->bytes, p->time / 1000.0,
+               (double) p->time / p->count,
+               total_time ? 100.0 * p->time / total_time : 0.0, name);
+        if (hist)
+            print_histogram(p);
+    }
+    printf("%12llu %14s %12.3f\n", total_count, "", total_time / 1000.0);
+
+    free(profiles);
+    free(rep);
+    if (ctx)
+        xcb_errors_context_free(ctx);
+    xcb_disconnect(c);
+
+    return 0;
+}
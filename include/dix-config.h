@@ -551,6 +551,9 @@
 /* Use input thread */
 #undef INPUTTHREAD
 
+/* Have POSIX threads, for the reader and render threads */
+#define HAVE_PTHREAD 1
+
 /* Have poll() */
 #undef HAVE_POLL
 
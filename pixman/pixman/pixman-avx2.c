@@ -0,0 +1,1563 @@
+/*
+ * Copyright © 2008 Rodrigo Kumpera
+ * Copyright © 2008 André Tupinambá
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation, and that the name of Red Hat not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  Red Hat makes no representations about the
+ * suitability of this software for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+ * AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS
+ * SOFTWARE.
+ *
+ * Based on pixman-sse2.c. The arithmetic is the same as there, only
+ * eight pixels wide, so both implementations produce identical results.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <immintrin.h> /* for AVX2 intrinsics */
+#include "pixman-private.h"
+#include "pixman-combine32.h"
+#include "pixman-inlines.h"
+
+/* The unpacked (16 bit per channel) helpers work within each 128 bit
+ * lane, like the AVX2 unpack and pack instructions do, so unpacking
+ * and packing again gives the pixels back in their original order.
+ * The lo half holds pixels 0, 1, 4, 5 and the hi half pixels 2, 3, 6, 7.
+ */
+
+static force_inline __m128i
+unpack_32_1x128 (uint32_t data)
+{
+    return _mm_unpacklo_epi8 (_mm_cvtsi32_si128 (data), _mm_setzero_si128 ());
+}
+
+static force_inline uint32_t
+pack_1x128_32 (__m128i data)
+{
+    return _mm_cvtsi128_si32 (_mm_packus_epi16 (data, _mm_setzero_si128 ()));
+}
+
+static force_inline __m128i
+expand_alpha_1x128 (__m128i data)
+{
+    return _mm_shufflelo_epi16 (data, _MM_SHUFFLE (3, 3, 3, 3));
+}
+
+static force_inline __m128i
+expand_pixel_8_1x128 (uint8_t data)
+{
+    return _mm_shufflelo_epi16 (
+	unpack_32_1x128 ((uint32_t)data), _MM_SHUFFLE (0, 0, 0, 0));
+}
+
+static force_inline __m128i
+pix_multiply_1x128 (__m128i data, __m128i alpha)
+{
+    return _mm_mulhi_epu16 (_mm_adds_epu16 (_mm_mullo_epi16 (data, alpha),
+					    _mm_set1_epi16 (0x0080)),
+			    _mm_set1_epi16 (0x0101));
+}
+
+static force_inline __m128i
+over_1x128 (__m128i src, __m128i alpha, __m128i dst)
+{
+    __m128i ialpha = _mm_xor_si128 (alpha, _mm_set1_epi16 (0x00ff));
+
+    return _mm_adds_epu8 (src, pix_multiply_1x128 (dst, ialpha));
+}
+
+static force_inline __m128i
+in_over_1x128 (__m128i src, __m128i alpha, __m128i mask, __m128i dst)
+{
+    return over_1x128 (pix_multiply_1x128 (src, mask),
+		       pix_multiply_1x128 (alpha, mask),
+		       dst);
+}
+
+static force_inline uint32_t
+core_combine_over_u_pixel_avx2 (uint32_t src, uint32_t dst)
+{
+    uint8_t a = src >> 24;
+
+    if (a == 0xff)
+    {
+	return src;
+    }
+    else if (src)
+    {
+	__m128i ms = unpack_32_1x128 (src);
+
+	return pack_1x128_32 (
+	    over_1x128 (ms, expand_alpha_1x128 (ms), unpack_32_1x128 (dst)));
+    }
+
+    return dst;
+}
+
+static force_inline __m256i
+load_256_aligned (const uint32_t *src)
+{
+    return _mm256_load_si256 ((const __m256i *)src);
+}
+
+static force_inline __m256i
+load_256_unaligned (const void *src)
+{
+    return _mm256_loadu_si256 ((const __m256i *)src);
+}
+
+static force_inline void
+save_256_aligned (void *dst, __m256i data)
+{
+    _mm256_store_si256 ((__m256i *)dst, data);
+}
+
+static force_inline void
+unpack_256_2x256 (__m256i data, __m256i *data_lo, __m256i *data_hi)
+{
+    *data_lo = _mm256_unpacklo_epi8 (data, _mm256_setzero_si256 ());
+    *data_hi = _mm256_unpackhi_epi8 (data, _mm256_setzero_si256 ());
+}
+
+static force_inline __m256i
+pack_2x256_256 (__m256i lo, __m256i hi)
+{
+    return _mm256_packus_epi16 (lo, hi);
+}
+
+static force_inline int
+is_opaque_256 (__m256i x)
+{
+    __m256i ffs = _mm256_cmpeq_epi8 (x, x);
+
+    return ((uint32_t)_mm256_movemask_epi8 (_mm256_cmpeq_epi8 (x, ffs)) &
+	    0x88888888) == 0x88888888;
+}
+
+static force_inline int
+is_zero_256 (__m256i x)
+{
+    return _mm256_testz_si256 (x, x);
+}
+
+static force_inline int
+is_transparent_256 (__m256i x)
+{
+    return _mm256_testz_si256 (x, _mm256_set1_epi32 (0xff000000));
+}
+
+static force_inline void
+expand_alpha_2x256 (__m256i  data_lo,
+		    __m256i  data_hi,
+		    __m256i *alpha_lo,
+		    __m256i *alpha_hi)
+{
+    __m256i lo, hi;
+
+    lo = _mm256_shufflelo_epi16 (data_lo, _MM_SHUFFLE (3, 3, 3, 3));
+    hi = _mm256_shufflelo_epi16 (data_hi, _MM_SHUFFLE (3, 3, 3, 3));
+
+    *alpha_lo = _mm256_shufflehi_epi16 (lo, _MM_SHUFFLE (3, 3, 3, 3));
+    *alpha_hi = _mm256_shufflehi_epi16 (hi, _MM_SHUFFLE (3, 3, 3, 3));
+}
+
+static force_inline void
+expand_alpha_rev_2x256 (__m256i  data_lo,
+			__m256i  data_hi,
+			__m256i *alpha_lo,
+			__m256i *alpha_hi)
+{
+    __m256i lo, hi;
+
+    lo = _mm256_shufflelo_epi16 (data_lo, _MM_SHUFFLE (0, 0, 0, 0));
+    hi = _mm256_shufflelo_epi16 (data_hi, _MM_SHUFFLE (0, 0, 0, 0));
+
+    *alpha_lo = _mm256_shufflehi_epi16 (lo, _MM_SHUFFLE (0, 0, 0, 0));
+    *alpha_hi = _mm256_shufflehi_epi16 (hi, _MM_SHUFFLE (0, 0, 0, 0));
+}
+
+static force_inline void
+pix_multiply_2x256 (__m256i *data_lo,
+		    __m256i *data_hi,
+		    __m256i *alpha_lo,
+		    __m256i *alpha_hi,
+		    __m256i *ret_lo,
+		    __m256i *ret_hi)
+{
+    __m256i lo, hi;
+
+    lo = _mm256_mullo_epi16 (*data_lo, *alpha_lo);
+    hi = _mm256_mullo_epi16 (*data_hi, *alpha_hi);
+    lo = _mm256_adds_epu16 (lo, _mm256_set1_epi16 (0x0080));
+    hi = _mm256_adds_epu16 (hi, _mm256_set1_epi16 (0x0080));
+    *ret_lo = _mm256_mulhi_epu16 (lo, _mm256_set1_epi16 (0x0101));
+    *ret_hi = _mm256_mulhi_epu16 (hi, _mm256_set1_epi16 (0x0101));
+}
+
+static force_inline void
+over_2x256 (__m256i *src_lo,
+	    __m256i *src_hi,
+	    __m256i *alpha_lo,
+	    __m256i *alpha_hi,
+	    __m256i *dst_lo,
+	    __m256i *dst_hi)
+{
+    __m256i t1, t2;
+
+    t1 = _mm256_xor_si256 (*alpha_lo, _mm256_set1_epi16 (0x00ff));
+    t2 = _mm256_xor_si256 (*alpha_hi, _mm256_set1_epi16 (0x00ff));
+
+    pix_multiply_2x256 (dst_lo, dst_hi, &t1, &t2, dst_lo, dst_hi);
+
+    *dst_lo = _mm256_adds_epu8 (*src_lo, *dst_lo);
+    *dst_hi = _mm256_adds_epu8 (*src_hi, *dst_hi);
+}
+
+static force_inline void
+in_over_2x256 (__m256i *src_lo,
+	       __m256i *src_hi,
+	       __m256i *alpha_lo,
+	       __m256i *alpha_hi,
+	       __m256i *mask_lo,
+	       __m256i *mask_hi,
+	       __m256i *dst_lo,
+	       __m256i *dst_hi)
+{
+    __m256i s_lo, s_hi;
+    __m256i a_lo, a_hi;
+
+    pix_multiply_2x256 (src_lo,   src_hi,   mask_lo, mask_hi, &s_lo, &s_hi);
+    pix_multiply_2x256 (alpha_lo, alpha_hi, mask_lo, mask_hi, &a_lo, &a_hi);
+
+    over_2x256 (&s_lo, &s_hi, &a_lo, &a_hi, dst_lo, dst_hi);
+}
+
+/* Returns eight a8 mask values, each in the low byte of its pixel,
+ * ready for unpack_256_2x256 () and expand_alpha_rev_2x256 ().
+ */
+static force_inline __m256i
+load_mask_8_256 (const uint8_t *mask)
+{
+    return _mm256_cvtepu8_epi32 (_mm_loadl_epi64 ((const __m128i *)mask));
+}
+
+/* over the destination with eight source pixels; dst must be aligned */
+static force_inline void
+core_combine_over_8_avx2 (uint32_t *pd, __m256i src)
+{
+    __m256i src_lo, src_hi, dst_lo, dst_hi;
+    __m256i alpha_lo, alpha_hi;
+
+    if (is_zero_256 (src))
+	return;
+
+    if (is_opaque_256 (src))
+    {
+	save_256_aligned (pd, src);
+	return;
+    }
+
+    unpack_256_2x256 (src, &src_lo, &src_hi);
+    unpack_256_2x256 (load_256_aligned (pd), &dst_lo, &dst_hi);
+
+    expand_alpha_2x256 (src_lo, src_hi, &alpha_lo, &alpha_hi);
+    over_2x256 (&src_lo, &src_hi, &alpha_lo, &alpha_hi, &dst_lo, &dst_hi);
+
+    save_256_aligned (pd, pack_2x256_256 (dst_lo, dst_hi));
+}
+
+static force_inline uint32_t
+combine1 (const uint32_t *ps, const uint32_t *pm)
+{
+    uint32_t s;
+    memcpy (&s, ps, sizeof(uint32_t));
+
+    if (pm)
+    {
+	__m128i ms, mm;
+
+	mm = expand_alpha_1x128 (unpack_32_1x128 (*pm));
+	ms = pix_multiply_1x128 (unpack_32_1x128 (s), mm);
+
+	s = pack_1x128_32 (ms);
+    }
+
+    return s;
+}
+
+static force_inline __m256i
+combine8 (const uint32_t *ps, const uint32_t *pm)
+{
+    __m256i src_lo, src_hi;
+    __m256i msk, msk_lo, msk_hi;
+    __m256i s;
+
+    if (pm)
+    {
+	msk = load_256_unaligned (pm);
+
+	if (is_transparent_256 (msk))
+	    return _mm256_setzero_si256 ();
+    }
+
+    s = load_256_unaligned (ps);
+
+    if (pm)
+    {
+	unpack_256_2x256 (s, &src_lo, &src_hi);
+	unpack_256_2x256 (msk, &msk_lo, &msk_hi);
+
+	expand_alpha_2x256 (msk_lo, msk_hi, &msk_lo, &msk_hi);
+
+	pix_multiply_2x256 (&src_lo, &src_hi,
+			    &msk_lo, &msk_hi,
+			    &src_lo, &src_hi);
+
+	s = pack_2x256_256 (src_lo, src_hi);
+    }
+
+    return s;
+}
+
+static void
+avx2_combine_over_u (pixman_implementation_t *imp,
+		     pixman_op_t              op,
+		     uint32_t *               pd,
+		     const uint32_t *         ps,
+		     const uint32_t *         pm,
+		     int                      w)
+{
+    uint32_t s;
+
+    /* Align dst on a 32-byte boundary */
+    while (w && ((uintptr_t)pd & 31))
+    {
+	s = combine1 (ps, pm);
+
+	if (s)
+	    *pd = core_combine_over_u_pixel_avx2 (s, *pd);
+	pd++;
+	ps++;
+	if (pm)
+	    pm++;
+	w--;
+    }
+
+    while (w >= 8)
+    {
+	core_combine_over_8_avx2 (pd, combine8 (ps, pm));
+
+	ps += 8;
+	pd += 8;
+	if (pm)
+	    pm += 8;
+	w -= 8;
+    }
+
+    while (w)
+    {
+	s = combine1 (ps, pm);
+
+	if (s)
+	    *pd = core_combine_over_u_pixel_avx2 (s, *pd);
+	pd++;
+	ps++;
+	if (pm)
+	    pm++;
+	w--;
+    }
+}
+
+static void
+avx2_combine_add_u (pixman_implementation_t *imp,
+		    pixman_op_t              op,
+		    uint32_t *               pd,
+		    const uint32_t *         ps,
+		    const uint32_t *         pm,
+		    int                      w)
+{
+    uint32_t s;
+
+    while (w && ((uintptr_t)pd & 31))
+    {
+	s = combine1 (ps, pm);
+
+	*pd = _mm_cvtsi128_si32 (
+	    _mm_adds_epu8 (_mm_cvtsi32_si128 (s), _mm_cvtsi32_si128 (*pd)));
+	pd++;
+	ps++;
+	if (pm)
+	    pm++;
+	w--;
+    }
+
+    while (w >= 8)
+    {
+	save_256_aligned (
+	    pd, _mm256_adds_epu8 (combine8 (ps, pm), load_256_aligned (pd)));
+
+	pd += 8;
+	ps += 8;
+	if (pm)
+	    pm += 8;
+	w -= 8;
+    }
+
+    while (w)
+    {
+	s = combine1 (ps, pm);
+
+	*pd = _mm_cvtsi128_si32 (
+	    _mm_adds_epu8 (_mm_cvtsi32_si128 (s), _mm_cvtsi32_si128 (*pd)));
+	pd++;
+	ps++;
+	if (pm)
+	    pm++;
+	w--;
+    }
+}
+
+static void
+avx2_composite_over_8888_8888 (pixman_implementation_t *imp,
+			       pixman_composite_info_t *info)
+{
+    PIXMAN_COMPOSITE_ARGS (info);
+    int dst_stride, src_stride;
+    uint32_t    *dst_line;
+    uint32_t    *src_line;
+
+    PIXMAN_IMAGE_GET_LINE (
+	dest_image, dest_x, dest_y, uint32_t, dst_stride, dst_line, 1);
+    PIXMAN_IMAGE_GET_LINE (
+	src_image, src_x, src_y, uint32_t, src_stride, src_line, 1);
+
+    while (height--)
+    {
+	avx2_combine_over_u (imp, op, dst_line, src_line, NULL, width);
+
+	dst_line += dst_stride;
+	src_line += src_stride;
+    }
+}
+
+static void
+avx2_composite_add_8888_8888 (pixman_implementation_t *imp,
+			      pixman_composite_info_t *info)
+{
+    PIXMAN_COMPOSITE_ARGS (info);
+    int dst_stride, src_stride;
+    uint32_t    *dst_line;
+    uint32_t    *src_line;
+
+    PIXMAN_IMAGE_GET_LINE (
+	dest_image, dest_x, dest_y, uint32_t, dst_stride, dst_line, 1);
+    PIXMAN_IMAGE_GET_LINE (
+	src_image, src_x, src_y, uint32_t, src_stride, src_line, 1);
+
+    while (height--)
+    {
+	avx2_combine_add_u (imp, op, dst_line, src_line, NULL, width);
+
+	dst_line += dst_stride;
+	src_line += src_stride;
+    }
+}
+
+static void
+avx2_composite_add_8_8 (pixman_implementation_t *imp,
+			pixman_composite_info_t *info)
+{
+    PIXMAN_COMPOSITE_ARGS (info);
+    uint8_t     *dst_line, *dst;
+    uint8_t     *src_line, *src;
+    int dst_stride, src_stride;
+    int32_t w;
+    uint16_t t;
+
+    PIXMAN_IMAGE_GET_LINE (
+	src_image, src_x, src_y, uint8_t, src_stride, src_line, 1);
+    PIXMAN_IMAGE_GET_LINE (
+	dest_image, dest_x, dest_y, uint8_t, dst_stride, dst_line, 1);
+
+    while (height--)
+    {
+	dst = dst_line;
+	src = src_line;
+
+	dst_line += dst_stride;
+	src_line += src_stride;
+	w = width;
+
+	/* Small head */
+	while (w && (uintptr_t)dst & 3)
+	{
+	    t = (*dst) + (*src++);
+	    *dst++ = t | (0 - (t >> 8));
+	    w--;
+	}
+
+	avx2_combine_add_u (imp, op,
+			    (uint32_t*)dst, (uint32_t*)src, NULL, w >> 2);
+
+	/* Small tail */
+	dst += w & 0xfffc;
+	src += w & 0xfffc;
+
+	w &= 3;
+
+	while (w)
+	{
+	    t = (*dst) + (*src++);
+	    *dst++ = t | (0 - (t >> 8));
+	    w--;
+	}
+    }
+}
+
+static force_inline uint32_t
+add_n_8_8888_pixel (__m128i src, uint8_t m, uint32_t d)
+{
+    uint32_t s = pack_1x128_32 (
+	pix_multiply_1x128 (src, expand_pixel_8_1x128 (m)));
+
+    return _mm_cvtsi128_si32 (
+	_mm_adds_epu8 (_mm_cvtsi32_si128 (s), _mm_cvtsi32_si128 (d)));
+}
+
+static void
+avx2_composite_add_n_8_8888 (pixman_implementation_t *imp,
+			     pixman_composite_info_t *info)
+{
+    PIXMAN_COMPOSITE_ARGS (info);
+    uint32_t     *dst_line, *dst;
+    uint8_t      *mask_line, *mask;
+    int dst_stride, mask_stride;
+    int32_t w;
+    uint32_t src;
+    uint64_t m;
+
+    __m128i xmm_src;
+    __m256i ymm_src;
+
+    src = _pixman_image_get_solid (imp, src_image, dest_image->bits.format);
+    if (src == 0)
+	return;
+
+    xmm_src = unpack_32_1x128 (src);
+    ymm_src = _mm256_unpacklo_epi8 (_mm256_set1_epi32 (src),
+				    _mm256_setzero_si256 ());
+
+    PIXMAN_IMAGE_GET_LINE (
+	dest_image, dest_x, dest_y, uint32_t, dst_stride, dst_line, 1);
+    PIXMAN_IMAGE_GET_LINE (
+	mask_image, mask_x, mask_y, uint8_t, mask_stride, mask_line, 1);
+
+    while (height--)
+    {
+	dst = dst_line;
+	dst_line += dst_stride;
+	mask = mask_line;
+	mask_line += mask_stride;
+	w = width;
+
+	while (w && ((uintptr_t)dst & 31))
+	{
+	    uint8_t a = *mask++;
+
+	    if (a)
+		*dst = add_n_8_8888_pixel (xmm_src, a, *dst);
+	    dst++;
+	    w--;
+	}
+
+	while (w >= 8)
+	{
+	    memcpy (&m, mask, sizeof(uint64_t));
+
+	    if (m)
+	    {
+		__m256i ymm_mask_lo, ymm_mask_hi;
+
+		unpack_256_2x256 (load_mask_8_256 (mask),
+				  &ymm_mask_lo, &ymm_mask_hi);
+		expand_alpha_rev_2x256 (ymm_mask_lo, ymm_mask_hi,
+					&ymm_mask_lo, &ymm_mask_hi);
+
+		pix_multiply_2x256 (&ymm_src, &ymm_src,
+				    &ymm_mask_lo, &ymm_mask_hi,
+				    &ymm_mask_lo, &ymm_mask_hi);
+
+		save_256_aligned (
+		    dst, _mm256_adds_epu8 (
+			pack_2x256_256 (ymm_mask_lo, ymm_mask_hi),
+			load_256_aligned (dst)));
+	    }
+
+	    w -= 8;
+	    dst += 8;
+	    mask += 8;
+	}
+
+	while (w)
+	{
+	    uint8_t a = *mask++;
+
+	    if (a)
+		*dst = add_n_8_8888_pixel (xmm_src, a, *dst);
+	    dst++;
+	    w--;
+	}
+    }
+}
+
+static void
+avx2_composite_over_n_8_8888 (pixman_implementation_t *imp,
+			      pixman_composite_info_t *info)
+{
+    PIXMAN_COMPOSITE_ARGS (info);
+    uint32_t src, srca;
+    uint32_t *dst_line, *dst;
+    uint8_t *mask_line, *mask;
+    int dst_stride, mask_stride;
+    int32_t w;
+    uint64_t m;
+
+    __m128i xmm_src, xmm_alpha;
+    __m256i ymm_def, ymm_src, ymm_alpha;
+    __m256i ymm_dst_lo, ymm_dst_hi;
+    __m256i ymm_mask_lo, ymm_mask_hi;
+
+    src = _pixman_image_get_solid (imp, src_image, dest_image->bits.format);
+
+    srca = src >> 24;
+    if (src == 0)
+	return;
+
+    PIXMAN_IMAGE_GET_LINE (
+	dest_image, dest_x, dest_y, uint32_t, dst_stride, dst_line, 1);
+    PIXMAN_IMAGE_GET_LINE (
+	mask_image, mask_x, mask_y, uint8_t, mask_stride, mask_line, 1);
+
+    xmm_src = unpack_32_1x128 (src);
+    xmm_alpha = expand_alpha_1x128 (xmm_src);
+
+    ymm_def = _mm256_set1_epi32 (src);
+    ymm_src = _mm256_unpacklo_epi8 (ymm_def, _mm256_setzero_si256 ());
+    expand_alpha_2x256 (ymm_src, ymm_src, &ymm_alpha, &ymm_alpha);
+
+    while (height--)
+    {
+	dst = dst_line;
+	dst_line += dst_stride;
+	mask = mask_line;
+	mask_line += mask_stride;
+	w = width;
+
+	while (w && ((uintptr_t)dst & 31))
+	{
+	    uint8_t a = *mask++;
+
+	    if (a)
+	    {
+		*dst = pack_1x128_32 (
+		    in_over_1x128 (xmm_src, xmm_alpha,
+				   expand_pixel_8_1x128 (a),
+				   unpack_32_1x128 (*dst)));
+	    }
+
+	    w--;
+	    dst++;
+	}
+
+	while (w >= 8)
+	{
+	    memcpy (&m, mask, sizeof(uint64_t));
+
+	    if (srca == 0xff && m == ~(uint64_t)0)
+	    {
+		save_256_aligned (dst, ymm_def);
+	    }
+	    else if (m)
+	    {
+		unpack_256_2x256 (load_256_aligned (dst),
+				  &ymm_dst_lo, &ymm_dst_hi);
+		unpack_256_2x256 (load_mask_8_256 (mask),
+				  &ymm_mask_lo, &ymm_mask_hi);
+
+		expand_alpha_rev_2x256 (ymm_mask_lo, ymm_mask_hi,
+					&ymm_mask_lo, &ymm_mask_hi);
+
+		in_over_2x256 (&ymm_src, &ymm_src,
+			       &ymm_alpha, &ymm_alpha,
+			       &ymm_mask_lo, &ymm_mask_hi,
+			       &ymm_dst_lo, &ymm_dst_hi);
+
+		save_256_aligned (dst, pack_2x256_256 (ymm_dst_lo, ymm_dst_hi));
+	    }
+
+	    w -= 8;
+	    dst += 8;
+	    mask += 8;
+	}
+
+	while (w)
+	{
+	    uint8_t a = *mask++;
+
+	    if (a)
+	    {
+		*dst = pack_1x128_32 (
+		    in_over_1x128 (xmm_src, xmm_alpha,
+				   expand_pixel_8_1x128 (a),
+				   unpack_32_1x128 (*dst)));
+	    }
+
+	    w--;
+	    dst++;
+	}
+    }
+}
+
+static force_inline uint32_t
+over_8888_8_8888_pixel (uint32_t s, uint32_t m, uint32_t d)
+{
+    uint32_t sa = s >> 24;
+
+    if (sa == 0xff && m == 0xff)
+	return s;
+
+    return pack_1x128_32 (
+	in_over_1x128 (unpack_32_1x128 (s),
+		       expand_pixel_8_1x128 (sa),
+		       expand_pixel_8_1x128 (m),
+		       unpack_32_1x128 (d)));
+}
+
+static void
+avx2_composite_over_8888_8_8888 (pixman_implementation_t *imp,
+				 pixman_composite_info_t *info)
+{
+    PIXMAN_COMPOSITE_ARGS (info);
+    uint32_t    *src, *src_line;
+    uint32_t    *dst, *dst_line;
+    uint8_t     *mask, *mask_line;
+    int src_stride, mask_stride, dst_stride;
+    int32_t w;
+    uint64_t m;
+
+    __m256i ymm_src, ymm_src_lo, ymm_src_hi, ymm_srca_lo, ymm_srca_hi;
+    __m256i ymm_dst_lo, ymm_dst_hi;
+    __m256i ymm_mask_lo, ymm_mask_hi;
+
+    PIXMAN_IMAGE_GET_LINE (
+	dest_image, dest_x, dest_y, uint32_t, dst_stride, dst_line, 1);
+    PIXMAN_IMAGE_GET_LINE (
+	mask_image, mask_x, mask_y, uint8_t, mask_stride, mask_line, 1);
+    PIXMAN_IMAGE_GET_LINE (
+	src_image, src_x, src_y, uint32_t, src_stride, src_line, 1);
+
+    while (height--)
+    {
+	src = src_line;
+	src_line += src_stride;
+	dst = dst_line;
+	dst_line += dst_stride;
+	mask = mask_line;
+	mask_line += mask_stride;
+
+	w = width;
+
+	while (w && (uintptr_t)dst & 31)
+	{
+	    uint32_t a = *mask++;
+
+	    if (a)
+		*dst = over_8888_8_8888_pixel (*src, a, *dst);
+
+	    src++;
+	    dst++;
+	    w--;
+	}
+
+	while (w >= 8)
+	{
+	    memcpy (&m, mask, sizeof(uint64_t));
+
+	    if (m)
+	    {
+		ymm_src = load_256_unaligned (src);
+
+		if (m == ~(uint64_t)0 && is_opaque_256 (ymm_src))
+		{
+		    save_256_aligned (dst, ymm_src);
+		}
+		else
+		{
+		    unpack_256_2x256 (ymm_src, &ymm_src_lo, &ymm_src_hi);
+		    unpack_256_2x256 (load_mask_8_256 (mask),
+				      &ymm_mask_lo, &ymm_mask_hi);
+		    unpack_256_2x256 (load_256_aligned (dst),
+				      &ymm_dst_lo, &ymm_dst_hi);
+
+		    expand_alpha_2x256 (ymm_src_lo, ymm_src_hi,
+					&ymm_srca_lo, &ymm_srca_hi);
+		    expand_alpha_rev_2x256 (ymm_mask_lo, ymm_mask_hi,
+					    &ymm_mask_lo, &ymm_mask_hi);
+
+		    in_over_2x256 (&ymm_src_lo, &ymm_src_hi,
+				   &ymm_srca_lo, &ymm_srca_hi,
+				   &ymm_mask_lo, &ymm_mask_hi,
+				   &ymm_dst_lo, &ymm_dst_hi);
+
+		    save_256_aligned (
+			dst, pack_2x256_256 (ymm_dst_lo, ymm_dst_hi));
+		}
+	    }
+
+	    src += 8;
+	    dst += 8;
+	    mask += 8;
+	    w -= 8;
+	}
+
+	while (w)
+	{
+	    uint32_t a = *mask++;
+
+	    if (a)
+		*dst = over_8888_8_8888_pixel (*src, a, *dst);
+
+	    src++;
+	    dst++;
+	    w--;
+	}
+    }
+}
+
+static void
+avx2_composite_over_n_8888_8888_ca (pixman_implementation_t *imp,
+				    pixman_composite_info_t *info)
+{
+    PIXMAN_COMPOSITE_ARGS (info);
+    uint32_t src;
+    uint32_t *dst_line, *pd;
+    uint32_t *mask_line;
+    const uint32_t *pm;
+    int dst_stride, mask_stride;
+    int32_t w;
+
+    __m128i xmm_src, xmm_alpha;
+    __m256i ymm_src, ymm_alpha, ymm_mask;
+    __m256i ymm_dst_lo, ymm_dst_hi;
+    __m256i ymm_mask_lo, ymm_mask_hi;
+
+    src = _pixman_image_get_solid (imp, src_image, dest_image->bits.format);
+
+    if (src == 0)
+	return;
+
+    PIXMAN_IMAGE_GET_LINE (
+	dest_image, dest_x, dest_y, uint32_t, dst_stride, dst_line, 1);
+    PIXMAN_IMAGE_GET_LINE (
+	mask_image, mask_x, mask_y, uint32_t, mask_stride, mask_line, 1);
+
+    xmm_src = unpack_32_1x128 (src);
+    xmm_alpha = expand_alpha_1x128 (xmm_src);
+
+    ymm_src = _mm256_unpacklo_epi8 (_mm256_set1_epi32 (src),
+				    _mm256_setzero_si256 ());
+    expand_alpha_2x256 (ymm_src, ymm_src, &ymm_alpha, &ymm_alpha);
+
+    while (height--)
+    {
+	pd = dst_line;
+	pm = mask_line;
+	dst_line += dst_stride;
+	mask_line += mask_stride;
+	w = width;
+
+	while (w && (uintptr_t)pd & 31)
+	{
+	    uint32_t m = *pm++;
+
+	    if (m)
+	    {
+		*pd = pack_1x128_32 (
+		    in_over_1x128 (xmm_src, xmm_alpha,
+				   unpack_32_1x128 (m),
+				   unpack_32_1x128 (*pd)));
+	    }
+
+	    pd++;
+	    w--;
+	}
+
+	while (w >= 8)
+	{
+	    ymm_mask = load_256_unaligned (pm);
+
+	    if (!is_zero_256 (ymm_mask))
+	    {
+		unpack_256_2x256 (ymm_mask, &ymm_mask_lo, &ymm_mask_hi);
+		unpack_256_2x256 (load_256_aligned (pd),
+				  &ymm_dst_lo, &ymm_dst_hi);
+
+		in_over_2x256 (&ymm_src, &ymm_src,
+			       &ymm_alpha, &ymm_alpha,
+			       &ymm_mask_lo, &ymm_mask_hi,
+			       &ymm_dst_lo, &ymm_dst_hi);
+
+		save_256_aligned (pd, pack_2x256_256 (ymm_dst_lo, ymm_dst_hi));
+	    }
+
+	    pd += 8;
+	    pm += 8;
+	    w -= 8;
+	}
+
+	while (w)
+	{
+	    uint32_t m = *pm++;
+
+	    if (m)
+	    {
+		*pd = pack_1x128_32 (
+		    in_over_1x128 (xmm_src, xmm_alpha,
+				   unpack_32_1x128 (m),
+				   unpack_32_1x128 (*pd)));
+	    }
+
+	    pd++;
+	    w--;
+	}
+    }
+}
+
+#if defined(__GNUC__) && !defined(__x86_64__) && !defined(__amd64__)
+__attribute__((__force_align_arg_pointer__))
+#endif
+static pixman_bool_t
+avx2_fill (pixman_implementation_t *imp,
+	   uint32_t *               bits,
+	   int                      stride,
+	   int                      bpp,
+	   int                      x,
+	   int                      y,
+	   int                      width,
+	   int                      height,
+	   uint32_t		    filler)
+{
+    uint32_t byte_width;
+    uint8_t *byte_line;
+
+    __m256i ymm_def;
+
+    if (bpp == 8)
+    {
+	stride = stride * (int) sizeof (uint32_t);
+	byte_line = (uint8_t *)bits + stride * y + x;
+	byte_width = width;
+
+	filler = (filler & 0xff) * 0x01010101;
+    }
+    else if (bpp == 16)
+    {
+	stride = stride * (int) sizeof (uint32_t) / 2;
+	byte_line = (uint8_t *)(((uint16_t *)bits) + stride * y + x);
+	byte_width = 2 * width;
+	stride *= 2;
+
+	filler = (filler & 0xffff) * 0x00010001;
+    }
+    else if (bpp == 32)
+    {
+	stride = stride * (int) sizeof (uint32_t) / 4;
+	byte_line = (uint8_t *)(((uint32_t *)bits) + stride * y + x);
+	byte_width = 4 * width;
+	stride *= 4;
+    }
+    else
+    {
+	return FALSE;
+    }
+
+    ymm_def = _mm256_set1_epi32 (filler);
+
+    while (height--)
+    {
+	int w;
+	uint8_t *d = byte_line;
+	byte_line += stride;
+	w = byte_width;
+
+	if (w >= 1 && ((uintptr_t)d & 1))
+	{
+	    *(uint8_t *)d = filler & 0xff;
+	    w -= 1;
+	    d += 1;
+	}
+
+	while (w >= 2 && ((uintptr_t)d & 3))
+	{
+	    *(uint16_t *)d = filler & 0xffff;
+	    w -= 2;
+	    d += 2;
+	}
+
+	while (w >= 4 && ((uintptr_t)d & 31))
+	{
+	    *(uint32_t *)d = filler;
+
+	    w -= 4;
+	    d += 4;
+	}
+
+	while (w >= 128)
+	{
+	    save_256_aligned (d,      ymm_def);
+	    save_256_aligned (d + 32, ymm_def);
+	    save_256_aligned (d + 64, ymm_def);
+	    save_256_aligned (d + 96, ymm_def);
+
+	    d += 128;
+	    w -= 128;
+	}
+
+	while (w >= 32)
+	{
+	    save_256_aligned (d, ymm_def);
+
+	    d += 32;
+	    w -= 32;
+	}
+
+	while (w >= 4)
+	{
+	    *(uint32_t *)d = filler;
+
+	    w -= 4;
+	    d += 4;
+	}
+
+	if (w >= 2)
+	{
+	    *(uint16_t *)d = filler & 0xffff;
+	    w -= 2;
+	    d += 2;
+	}
+
+	if (w >= 1)
+	{
+	    *(uint8_t *)d = filler & 0xff;
+	    w -= 1;
+	    d += 1;
+	}
+    }
+
+    return TRUE;
+}
+
+static pixman_bool_t
+avx2_blt (pixman_implementation_t *imp,
+	  uint32_t *               src_bits,
+	  uint32_t *               dst_bits,
+	  int                      src_stride,
+	  int                      dst_stride,
+	  int                      src_bpp,
+	  int                      dst_bpp,
+	  int                      src_x,
+	  int                      src_y,
+	  int                      dest_x,
+	  int                      dest_y,
+	  int                      width,
+	  int                      height)
+{
+    uint8_t *   src_bytes;
+    uint8_t *   dst_bytes;
+    int byte_width;
+
+    if (src_bpp != dst_bpp)
+	return FALSE;
+
+    if (src_bpp == 16)
+    {
+	src_stride = src_stride * (int) sizeof (uint32_t) / 2;
+	dst_stride = dst_stride * (int) sizeof (uint32_t) / 2;
+	src_bytes = (uint8_t *)(((uint16_t *)src_bits) + src_stride * (src_y) + (src_x));
+	dst_bytes = (uint8_t *)(((uint16_t *)dst_bits) + dst_stride * (dest_y) + (dest_x));
+	byte_width = 2 * width;
+	src_stride *= 2;
+	dst_stride *= 2;
+    }
+    else if (src_bpp == 32)
+    {
+	src_stride = src_stride * (int) sizeof (uint32_t) / 4;
+	dst_stride = dst_stride * (int) sizeof (uint32_t) / 4;
+	src_bytes = (uint8_t *)(((uint32_t *)src_bits) + src_stride * (src_y) + (src_x));
+	dst_bytes = (uint8_t *)(((uint32_t *)dst_bits) + dst_stride * (dest_y) + (dest_x));
+	byte_width = 4 * width;
+	src_stride *= 4;
+	dst_stride *= 4;
+    }
+    else
+    {
+	return FALSE;
+    }
+
+    while (height--)
+    {
+	int w;
+	uint8_t *s = src_bytes;
+	uint8_t *d = dst_bytes;
+	src_bytes += src_stride;
+	dst_bytes += dst_stride;
+	w = byte_width;
+
+	while (w >= 2 && ((uintptr_t)d & 3))
+	{
+	    memmove (d, s, 2);
+	    w -= 2;
+	    s += 2;
+	    d += 2;
+	}
+
+	while (w >= 4 && ((uintptr_t)d & 31))
+	{
+	    memmove (d, s, 4);
+
+	    w -= 4;
+	    s += 4;
+	    d += 4;
+	}
+
+	while (w >= 128)
+	{
+	    __m256i ymm0, ymm1, ymm2, ymm3;
+
+	    ymm0 = load_256_unaligned (s);
+	    ymm1 = load_256_unaligned (s + 32);
+	    ymm2 = load_256_unaligned (s + 64);
+	    ymm3 = load_256_unaligned (s + 96);
+
+	    save_256_aligned (d,      ymm0);
+	    save_256_aligned (d + 32, ymm1);
+	    save_256_aligned (d + 64, ymm2);
+	    save_256_aligned (d + 96, ymm3);
+
+	    s += 128;
+	    d += 128;
+	    w -= 128;
+	}
+
+	while (w >= 32)
+	{
+	    save_256_aligned (d, load_256_unaligned (s));
+
+	    w -= 32;
+	    d += 32;
+	    s += 32;
+	}
+
+	while (w >= 4)
+	{
+	    memmove (d, s, 4);
+
+	    w -= 4;
+	    s += 4;
+	    d += 4;
+	}
+
+	if (w >= 2)
+	{
+	    memmove (d, s, 2);
+	    w -= 2;
+	    s += 2;
+	    d += 2;
+	}
+    }
+
+    return TRUE;
+}
+
+static void
+avx2_composite_copy_area (pixman_implementation_t *imp,
+			  pixman_composite_info_t *info)
+{
+    PIXMAN_COMPOSITE_ARGS (info);
+    avx2_blt (imp, src_image->bits.bits,
+	      dest_image->bits.bits,
+	      src_image->bits.rowstride,
+	      dest_image->bits.rowstride,
+	      PIXMAN_FORMAT_BPP (src_image->bits.format),
+	      PIXMAN_FORMAT_BPP (dest_image->bits.format),
+	      src_x, src_y, dest_x, dest_y, width, height);
+}
+
+/* Bilinear interpolation, computed exactly like the SSE2 code does:
+ * vertically first with 7 bit weights in 16 bit lanes, then horizontally
+ * with pmaddwd on interleaved left and right values.
+ */
+
+static force_inline uint32_t
+bilinear_interpolate_1_avx2 (const uint32_t *src_top,
+			     const uint32_t *src_bottom,
+			     intptr_t        vx,
+			     int             wt,
+			     int             wb)
+{
+    __m128i zero = _mm_setzero_si128 ();
+    __m128i tltr = _mm_loadl_epi64 ((__m128i *)&src_top[vx >> 16]);
+    __m128i blbr = _mm_loadl_epi64 ((__m128i *)&src_bottom[vx >> 16]);
+    int wr = (vx >> (16 - BILINEAR_INTERPOLATION_BITS)) &
+	(BILINEAR_INTERPOLATION_RANGE - 1);
+    __m128i a;
+
+    /* vertical interpolation */
+    a = _mm_add_epi16 (
+	_mm_mullo_epi16 (_mm_unpacklo_epi8 (tltr, zero), _mm_set1_epi16 (wt)),
+	_mm_mullo_epi16 (_mm_unpacklo_epi8 (blbr, zero), _mm_set1_epi16 (wb)));
+
+    /* horizontal interpolation */
+    a = _mm_madd_epi16 (
+	_mm_unpackhi_epi16 (_mm_unpacklo_epi64 (a, a), a),
+	_mm_set1_epi32 ((wr << 16) | (BILINEAR_INTERPOLATION_RANGE - wr)));
+    a = _mm_srli_epi32 (a, BILINEAR_INTERPOLATION_BITS * 2);
+
+    a = _mm_packs_epi32 (a, a);
+    return _mm_cvtsi128_si32 (_mm_packus_epi16 (a, a));
+}
+
+/* Interpolates four pixels; the result has pixels 0 and 1 in the low
+ * lane and pixels 2 and 3 in the high lane, as 16 bit values.
+ */
+static force_inline __m256i
+bilinear_interpolate_4_avx2 (const uint32_t *src_top,
+			     const uint32_t *src_bottom,
+			     intptr_t        vx,
+			     intptr_t        unit_x,
+			     __m256i         wt,
+			     __m256i         wb,
+			     __m256i         wh_lo,
+			     __m256i         wh_hi)
+{
+    intptr_t x0 = vx >> 16;
+    intptr_t x1 = (vx + unit_x) >> 16;
+    intptr_t x2 = (vx + unit_x * 2) >> 16;
+    intptr_t x3 = (vx + unit_x * 3) >> 16;
+    __m256i top, bot, t_lo, t_hi, b_lo, b_hi;
+
+    /* fetch the 2x2 blocks, one per 64 bits */
+    top = _mm256_inserti128_si256 (
+	_mm256_castsi128_si256 (
+	    _mm_unpacklo_epi64 (_mm_loadl_epi64 ((__m128i *)&src_top[x0]),
+				_mm_loadl_epi64 ((__m128i *)&src_top[x1]))),
+	_mm_unpacklo_epi64 (_mm_loadl_epi64 ((__m128i *)&src_top[x2]),
+			    _mm_loadl_epi64 ((__m128i *)&src_top[x3])), 1);
+    bot = _mm256_inserti128_si256 (
+	_mm256_castsi128_si256 (
+	    _mm_unpacklo_epi64 (_mm_loadl_epi64 ((__m128i *)&src_bottom[x0]),
+				_mm_loadl_epi64 ((__m128i *)&src_bottom[x1]))),
+	_mm_unpacklo_epi64 (_mm_loadl_epi64 ((__m128i *)&src_bottom[x2]),
+			    _mm_loadl_epi64 ((__m128i *)&src_bottom[x3])), 1);
+
+    /* lo has the blocks of pixels 0 and 2, hi those of 1 and 3 */
+    unpack_256_2x256 (top, &t_lo, &t_hi);
+    unpack_256_2x256 (bot, &b_lo, &b_hi);
+
+    /* vertical interpolation */
+    t_lo = _mm256_add_epi16 (_mm256_mullo_epi16 (t_lo, wt),
+			     _mm256_mullo_epi16 (b_lo, wb));
+    t_hi = _mm256_add_epi16 (_mm256_mullo_epi16 (t_hi, wt),
+			     _mm256_mullo_epi16 (b_hi, wb));
+
+    /* horizontal interpolation */
+    t_lo = _mm256_madd_epi16 (
+	_mm256_unpackhi_epi16 (_mm256_unpacklo_epi64 (t_lo, t_lo), t_lo), wh_lo);
+    t_hi = _mm256_madd_epi16 (
+	_mm256_unpackhi_epi16 (_mm256_unpacklo_epi64 (t_hi, t_hi), t_hi), wh_hi);
+
+    t_lo = _mm256_srli_epi32 (t_lo, BILINEAR_INTERPOLATION_BITS * 2);
+    t_hi = _mm256_srli_epi32 (t_hi, BILINEAR_INTERPOLATION_BITS * 2);
+
+    return _mm256_packs_epi32 (t_lo, t_hi);
+}
+
+/* Interpolates eight pixels starting at vx. vxs holds the low bits of
+ * vx + i * unit_x for each pixel i and is advanced past them.
+ */
+static force_inline __m256i
+bilinear_interpolate_8_avx2 (const uint32_t *src_top,
+			     const uint32_t *src_bottom,
+			     intptr_t        vx,
+			     intptr_t        unit_x,
+			     __m256i         wt,
+			     __m256i         wb,
+			     __m256i        *vxs,
+			     __m256i         unit_x8)
+{
+    __m256i wr, wh, p0, p1;
+
+    /* one (1 - w, w) pair of 16 bit horizontal weights per pixel */
+    wr = _mm256_and_si256 (
+	_mm256_srli_epi32 (*vxs, 16 - BILINEAR_INTERPOLATION_BITS),
+	_mm256_set1_epi32 (BILINEAR_INTERPOLATION_RANGE - 1));
+    wh = _mm256_or_si256 (
+	_mm256_slli_epi32 (wr, 16),
+	_mm256_sub_epi32 (_mm256_set1_epi32 (BILINEAR_INTERPOLATION_RANGE), wr));
+    *vxs = _mm256_add_epi32 (*vxs, unit_x8);
+
+    p0 = bilinear_interpolate_4_avx2 (
+	src_top, src_bottom, vx, unit_x, wt, wb,
+	_mm256_permutevar8x32_epi32 (wh, _mm256_setr_epi32 (0, 0, 0, 0, 2, 2, 2, 2)),
+	_mm256_permutevar8x32_epi32 (wh, _mm256_setr_epi32 (1, 1, 1, 1, 3, 3, 3, 3)));
+    p1 = bilinear_interpolate_4_avx2 (
+	src_top, src_bottom, vx + unit_x * 4, unit_x, wt, wb,
+	_mm256_permutevar8x32_epi32 (wh, _mm256_setr_epi32 (4, 4, 4, 4, 6, 6, 6, 6)),
+	_mm256_permutevar8x32_epi32 (wh, _mm256_setr_epi32 (5, 5, 5, 5, 7, 7, 7, 7)));
+
+    /* p0 and p1 pack to 0 1 4 5 | 2 3 6 7 */
+    return _mm256_permute4x64_epi64 (_mm256_packus_epi16 (p0, p1),
+				     _MM_SHUFFLE (3, 1, 2, 0));
+}
+
+#define BILINEAR_DECLARE_VARIABLES_AVX2					\
+    const __m256i ymm_wt = _mm256_set1_epi16 (wt);			\
+    const __m256i ymm_wb = _mm256_set1_epi16 (wb);			\
+    const __m256i ymm_ux8 = _mm256_set1_epi32 ((int32_t)(unit_x * 8));	\
+    __m256i ymm_vxs
+
+#define BILINEAR_START_AVX2()						\
+    ymm_vxs = _mm256_add_epi32 (					\
+	_mm256_set1_epi32 ((int32_t)vx),				\
+	_mm256_mullo_epi32 (_mm256_set1_epi32 ((int32_t)unit_x),	\
+			    _mm256_setr_epi32 (0, 1, 2, 3, 4, 5, 6, 7)))
+
+#define BILINEAR_INTERPOLATE_EIGHT_PIXELS_AVX2(pix)			\
+do {									\
+    pix = bilinear_interpolate_8_avx2 (src_top, src_bottom, vx, unit_x,\
+				       ymm_wt, ymm_wb, &ymm_vxs, ymm_ux8);\
+    vx += unit_x * 8;							\
+} while (0)
+
+static force_inline void
+scaled_bilinear_scanline_avx2_8888_8888_SRC (uint32_t *       dst,
+					     const uint32_t * mask,
+					     const uint32_t * src_top,
+					     const uint32_t * src_bottom,
+					     int32_t          w,
+					     int              wt,
+					     int              wb,
+					     pixman_fixed_t   vx_,
+					     pixman_fixed_t   unit_x_,
+					     pixman_fixed_t   max_vx,
+					     pixman_bool_t    zero_src)
+{
+    intptr_t vx = vx_;
+    intptr_t unit_x = unit_x_;
+    BILINEAR_DECLARE_VARIABLES_AVX2;
+
+    while (w && ((uintptr_t)dst & 31))
+    {
+	*dst++ = bilinear_interpolate_1_avx2 (src_top, src_bottom, vx, wt, wb);
+	vx += unit_x;
+	w--;
+    }
+
+    BILINEAR_START_AVX2 ();
+
+    while (w >= 8)
+    {
+	__m256i ymm_src;
+
+	BILINEAR_INTERPOLATE_EIGHT_PIXELS_AVX2 (ymm_src);
+	save_256_aligned (dst, ymm_src);
+
+	dst += 8;
+	w -= 8;
+    }
+
+    while (w)
+    {
+	*dst++ = bilinear_interpolate_1_avx2 (src_top, src_bottom, vx, wt, wb);
+	vx += unit_x;
+	w--;
+    }
+}
+
+FAST_BILINEAR_MAINLOOP_COMMON (avx2_8888_8888_cover_SRC,
+			       scaled_bilinear_scanline_avx2_8888_8888_SRC,
+			       uint32_t, uint32_t, uint32_t,
+			       COVER, FLAG_NONE)
+FAST_BILINEAR_MAINLOOP_COMMON (avx2_8888_8888_pad_SRC,
+			       scaled_bilinear_scanline_avx2_8888_8888_SRC,
+			       uint32_t, uint32_t, uint32_t,
+			       PAD, FLAG_NONE)
+FAST_BILINEAR_MAINLOOP_COMMON (avx2_8888_8888_none_SRC,
+			       scaled_bilinear_scanline_avx2_8888_8888_SRC,
+			       uint32_t, uint32_t, uint32_t,
+			       NONE, FLAG_NONE)
+FAST_BILINEAR_MAINLOOP_COMMON (avx2_8888_8888_normal_SRC,
+			       scaled_bilinear_scanline_avx2_8888_8888_SRC,
+			       uint32_t, uint32_t, uint32_t,
+			       NORMAL, FLAG_NONE)
+
+static force_inline void
+scaled_bilinear_scanline_avx2_8888_8888_OVER (uint32_t *       dst,
+					      const uint32_t * mask,
+					      const uint32_t * src_top,
+					      const uint32_t * src_bottom,
+					      int32_t          w,
+					      int              wt,
+					      int              wb,
+					      pixman_fixed_t   vx_,
+					      pixman_fixed_t   unit_x_,
+					      pixman_fixed_t   max_vx,
+					      pixman_bool_t    zero_src)
+{
+    intptr_t vx = vx_;
+    intptr_t unit_x = unit_x_;
+    BILINEAR_DECLARE_VARIABLES_AVX2;
+    uint32_t pix;
+
+    while (w && ((uintptr_t)dst & 31))
+    {
+	pix = bilinear_interpolate_1_avx2 (src_top, src_bottom, vx, wt, wb);
+	vx += unit_x;
+
+	if (pix)
+	    *dst = core_combine_over_u_pixel_avx2 (pix, *dst);
+
+	dst++;
+	w--;
+    }
+
+    BILINEAR_START_AVX2 ();
+
+    while (w >= 8)
+    {
+	__m256i ymm_src;
+
+	BILINEAR_INTERPOLATE_EIGHT_PIXELS_AVX2 (ymm_src);
+	core_combine_over_8_avx2 (dst, ymm_src);
+
+	dst += 8;
+	w -= 8;
+    }
+
+    while (w)
+    {
+	pix = bilinear_interpolate_1_avx2 (src_top, src_bottom, vx, wt, wb);
+	vx += unit_x;
+
+	if (pix)
+	    *dst = core_combine_over_u_pixel_avx2 (pix, *dst);
+
+	dst++;
+	w--;
+    }
+}
+
+FAST_BILINEAR_MAINLOOP_COMMON (avx2_8888_8888_cover_OVER,
+			       scaled_bilinear_scanline_avx2_8888_8888_OVER,
+			       uint32_t, uint32_t, uint32_t,
+			       COVER, FLAG_NONE)
+FAST_BILINEAR_MAINLOOP_COMMON (avx2_8888_8888_pad_OVER,
+			       scaled_bilinear_scanline_avx2_8888_8888_OVER,
+			       uint32_t, uint32_t, uint32_t,
+			       PAD, FLAG_NONE)
+FAST_BILINEAR_MAINLOOP_COMMON (avx2_8888_8888_none_OVER,
+			       scaled_bilinear_scanline_avx2_8888_8888_OVER,
+			       uint32_t, uint32_t, uint32_t,
+			       NONE, FLAG_NONE)
+FAST_BILINEAR_MAINLOOP_COMMON (avx2_8888_8888_normal_OVER,
+			       scaled_bilinear_scanline_avx2_8888_8888_OVER,
+			       uint32_t, uint32_t, uint32_t,
+			       NORMAL, FLAG_NONE)
+
+/* Everything not listed here, including the other combiners, falls
+ * through to the SSSE3 and SSE2 implementations.
+ */
+static const pixman_fast_path_t avx2_fast_paths[] =
+{
+    /* PIXMAN_OP_OVER */
+    PIXMAN_STD_FAST_PATH (OVER, a8r8g8b8, null, a8r8g8b8, avx2_composite_over_8888_8888),
+    PIXMAN_STD_FAST_PATH (OVER, a8r8g8b8, null, x8r8g8b8, avx2_composite_over_8888_8888),
+    PIXMAN_STD_FAST_PATH (OVER, a8b8g8r8, null, a8b8g8r8, avx2_composite_over_8888_8888),
+    PIXMAN_STD_FAST_PATH (OVER, a8b8g8r8, null, x8b8g8r8, avx2_composite_over_8888_8888),
+    PIXMAN_STD_FAST_PATH (OVER, solid, a8, a8r8g8b8, avx2_composite_over_n_8_8888),
+    PIXMAN_STD_FAST_PATH (OVER, solid, a8, x8r8g8b8, avx2_composite_over_n_8_8888),
+    PIXMAN_STD_FAST_PATH (OVER, solid, a8, a8b8g8r8, avx2_composite_over_n_8_8888),
+    PIXMAN_STD_FAST_PATH (OVER, solid, a8, x8b8g8r8, avx2_composite_over_n_8_8888),
+    PIXMAN_STD_FAST_PATH (OVER, a8r8g8b8, a8, x8r8g8b8, avx2_composite_over_8888_8_8888),
+    PIXMAN_STD_FAST_PATH (OVER, a8r8g8b8, a8, a8r8g8b8, avx2_composite_over_8888_8_8888),
+    PIXMAN_STD_FAST_PATH (OVER, a8b8g8r8, a8, x8b8g8r8, avx2_composite_over_8888_8_8888),
+    PIXMAN_STD_FAST_PATH (OVER, a8b8g8r8, a8, a8b8g8r8, avx2_composite_over_8888_8_8888),
+    PIXMAN_STD_FAST_PATH_CA (OVER, solid, a8r8g8b8, a8r8g8b8, avx2_composite_over_n_8888_8888_ca),
+    PIXMAN_STD_FAST_PATH_CA (OVER, solid, a8r8g8b8, x8r8g8b8, avx2_composite_over_n_8888_8888_ca),
+    PIXMAN_STD_FAST_PATH_CA (OVER, solid, a8b8g8r8, a8b8g8r8, avx2_composite_over_n_8888_8888_ca),
+    PIXMAN_STD_FAST_PATH_CA (OVER, solid, a8b8g8r8, x8b8g8r8, avx2_composite_over_n_8888_8888_ca),
+    PIXMAN_STD_FAST_PATH (OVER, x8r8g8b8, null, x8r8g8b8, avx2_composite_copy_area),
+    PIXMAN_STD_FAST_PATH (OVER, x8b8g8r8, null, x8b8g8r8, avx2_composite_copy_area),
+
+    /* PIXMAN_OP_ADD */
+    PIXMAN_STD_FAST_PATH (ADD, a8, null, a8, avx2_composite_add_8_8),
+    PIXMAN_STD_FAST_PATH (ADD, a8r8g8b8, null, a8r8g8b8, avx2_composite_add_8888_8888),
+    PIXMAN_STD_FAST_PATH (ADD, a8b8g8r8, null, a8b8g8r8, avx2_composite_add_8888_8888),
+    PIXMAN_STD_FAST_PATH (ADD, solid, a8, x8r8g8b8, avx2_composite_add_n_8_8888),
+    PIXMAN_STD_FAST_PATH (ADD, solid, a8, a8r8g8b8, avx2_composite_add_n_8_8888),
+    PIXMAN_STD_FAST_PATH (ADD, solid, a8, x8b8g8r8, avx2_composite_add_n_8_8888),
+    PIXMAN_STD_FAST_PATH (ADD, solid, a8, a8b8g8r8, avx2_composite_add_n_8_8888),
+
+    /* PIXMAN_OP_SRC */
+    PIXMAN_STD_FAST_PATH (SRC, a8r8g8b8, null, a8r8g8b8, avx2_composite_copy_area),
+    PIXMAN_STD_FAST_PATH (SRC, a8b8g8r8, null, a8b8g8r8, avx2_composite_copy_area),
+    PIXMAN_STD_FAST_PATH (SRC, a8r8g8b8, null, x8r8g8b8, avx2_composite_copy_area),
+    PIXMAN_STD_FAST_PATH (SRC, a8b8g8r8, null, x8b8g8r8, avx2_composite_copy_area),
+    PIXMAN_STD_FAST_PATH (SRC, x8r8g8b8, null, x8r8g8b8, avx2_composite_copy_area),
+    PIXMAN_STD_FAST_PATH (SRC, x8b8g8r8, null, x8b8g8r8, avx2_composite_copy_area),
+    PIXMAN_STD_FAST_PATH (SRC, r5g6b5, null, r5g6b5, avx2_composite_copy_area),
+    PIXMAN_STD_FAST_PATH (SRC, b5g6r5, null, b5g6r5, avx2_composite_copy_area),
+
+    SIMPLE_BILINEAR_FAST_PATH (SRC, a8r8g8b8, a8r8g8b8, avx2_8888_8888),
+    SIMPLE_BILINEAR_FAST_PATH (SRC, a8r8g8b8, x8r8g8b8, avx2_8888_8888),
+    SIMPLE_BILINEAR_FAST_PATH (SRC, x8r8g8b8, x8r8g8b8, avx2_8888_8888),
+    SIMPLE_BILINEAR_FAST_PATH (SRC, a8b8g8r8, a8b8g8r8, avx2_8888_8888),
+    SIMPLE_BILINEAR_FAST_PATH (SRC, a8b8g8r8, x8b8g8r8, avx2_8888_8888),
+    SIMPLE_BILINEAR_FAST_PATH (SRC, x8b8g8r8, x8b8g8r8, avx2_8888_8888),
+
+    SIMPLE_BILINEAR_FAST_PATH (OVER, a8r8g8b8, x8r8g8b8, avx2_8888_8888),
+    SIMPLE_BILINEAR_FAST_PATH (OVER, a8b8g8r8, x8b8g8r8, avx2_8888_8888),
+    SIMPLE_BILINEAR_FAST_PATH (OVER, a8r8g8b8, a8r8g8b8, avx2_8888_8888),
+    SIMPLE_BILINEAR_FAST_PATH (OVER, a8b8g8r8, a8b8g8r8, avx2_8888_8888),
+
+    { PIXMAN_OP_NONE },
+};
+
+pixman_implementation_t *
+_pixman_implementation_create_avx2 (pixman_implementation_t *fallback)
+{
+    pixman_implementation_t *imp =
+	_pixman_implementation_create (fallback, avx2_fast_paths);
+
+    imp->combine_32[PIXMAN_OP_OVER] = avx2_combine_over_u;
+    imp->combine_32[PIXMAN_OP_ADD] = avx2_combine_add_u;
+
+    imp->blt = avx2_blt;
+    imp->fill = avx2_fill;
+
+    return imp;
+}
@@ -18,17 +18,20 @@
 #include "swaprep.h"
 #include "registry.h"
 #include <X11/extensions/XResproto.h>
+#include "xresprivproto.h"
 #include "pixmapstr.h"
 #include "windowstr.h"
 #include "gcstruct.h"
 #include "extinit.h"
 #include "protocol-versions.h"
 #include "client.h"
+#include "reqprofile.h"
 #include "list.h"
 #include "misc.h"
 #include <string.h>
 #include "hashtable.h"
 #include "picturestr.h"
+#include "xace.h"
 
 #ifdef COMPOSITE
 #include "compint.h"
@@ -266,14 +269,6 @@ ProcXResQueryClients(ClientPtr client)
     return Success;
 }
 
-static void
-ResFindAllRes(void *value, XID id, RESTYPE type, void *cdata)
-{
-    int *counts = (int *) cdata;
-
-    if ((type & TypeMask) != RT_NONE) counts[(type & TypeMask) - 1]++;
-}
-
 static CARD32
 resourceTypeAtom(int i)
 {
@@ -311,7 +306,8 @@ ProcXResQueryClientResources(ClientPtr client)
 
     counts = calloc(lastResourceType + 1, sizeof(int));
 
-    FindAllClientResources(clients[clientID], ResFindAllRes, counts);
+    for (i = 0; i < lastResourceType; i++)
+        counts[i] = CountClientResourcesByType(clients[clientID], i + 1);
 
     num_types = 0;
 
@@ -994,6 +990,183 @@ ProcXResQueryResourceBytes (ClientPtr client)
     return rc;
 }
 
+/** @brief Checks whether a client may look at (or clear) the statistics
+    of another client, or the server-wide ones when about is NULL.  Its own
+    are always fine; anything else takes a local client the security
+    extensions would let manage the server, as for the host access list. */
+static int
+XResStatsAccess(ClientPtr client, ClientPtr about, Mask access)
+{
+    int rc;
+
+    if (about == client)
+        return Success;
+
+    rc = XaceHook(XACE_SERVER_ACCESS, client, access);
+    if (rc == Success && about)
+        rc = XaceHook(XACE_CLIENT_ACCESS, client, about, access);
+    if (rc != Success)
+        return rc;
+
+    return client->local ? Success : BadAccess;
+}
+
+static void
+WriteClientSchedule(ClientPtr client, ClientPtr about)
+{
+    SmartScheduleStatsPtr stats = &about->smart_stats;
+    xXResClientSchedule scratch = {
+        .resource_base = about->clientAsMask,
+        .priority = about->priority,
+        .smart_priority = about->smart_priority,
+        .requests = stats->requests,
+        .slices = stats->slices,
+        .preempted = stats->preempted,
+        .run_time = stats->run_time,
+        .run_time_overflow = stats->run_time >> 32,
+        .cost = stats->cost,
+        .wait = stats->wait,
+        .max_wait = stats->max_wait,
+        .burst = stats->burst
+    };
+
+    if (client->swapped)
+        SwapLongs((CARD32 *) &scratch, bytes_to_int32(sizeof(scratch)));
+    WriteToClient(client, sizeof(scratch), &scratch);
+}
+
+/** @brief Reports what the scheduler knows about one or all clients.
+    Any but the caller's own are subject to XResStatsAccess.  Not part of
+    any released XRes version. */
+static int
+ProcXResQueryClientSchedule(ClientPtr client)
+{
+    REQUEST(xXResQueryClientScheduleReq);
+    xXResQueryClientScheduleReply rep;
+    int i, rc, clientID = 0, num_clients = 0;
+
+    REQUEST_SIZE_MATCH(xXResQueryClientScheduleReq);
+
+    if (stuff->xid != None) {
+        clientID = CLIENT_ID(stuff->xid);
+        if ((clientID >= currentMaxClients) || !clients[clientID]) {
+            client->errorValue = stuff->xid;
+            return BadValue;
+        }
+        rc = XResStatsAccess(client, clients[clientID], DixGetAttrAccess);
+        if (rc != Success)
+            return rc;
+        num_clients = 1;
+    }
+    else {
+        rc = XResStatsAccess(client, NULL, DixGetAttrAccess);
+        if (rc != Success)
+            return rc;
+        for (i = 0; i < currentMaxClients; i++)
+            if (clients[i])
+                num_clients++;
+    }
+
+    rep = (xXResQueryClientScheduleReply) {
+        .type = X_Reply,
+        .adaptive = SmartScheduleAdaptive,
+        .sequenceNumber = client->sequence,
+        .length = bytes_to_int32(num_clients * sz_xXResClientSchedule),
+        .num_clients = num_clients
+    };
+    if (client->swapped) {
+        swaps(&rep.sequenceNumber);
+        swapl(&rep.length);
+        swapl(&rep.num_clients);
+    }
+    WriteToClient(client, sizeof(xXResQueryClientScheduleReply), &rep);
+
+    if (stuff->xid != None)
+        WriteClientSchedule(client, clients[clientID]);
+    else {
+        for (i = 0; i < currentMaxClients; i++)
+            if (clients[i])
+                WriteClientSchedule(client, clients[i]);
+    }
+
+    return Success;
+}
+
+static void
+WriteRequestProfile(int major, int minor, RequestProfileEntryPtr entry,
+                    void *closure)
+{
+    ClientPtr client = closure;
+    xXResRequestProfile scratch = {
+        .major = major,
+        .minor = minor,
+        .count = entry->count,
+        .count_overflow = entry->count >> 32,
+        .bytes = entry->bytes,
+        .bytes_overflow = entry->bytes >> 32,
+        .time = entry->time,
+        .time_overflow = entry->time >> 32
+    };
+
+    memcpy(scratch.hist, entry->hist, sizeof(scratch.hist));
+    /* everything after the opcodes is a CARD32 */
+    if (client->swapped)
+        SwapLongs(&scratch.count, bytes_to_int32(sizeof(scratch)) - 1);
+    WriteToClient(client, sizeof(scratch), &scratch);
+}
+
+/** @brief Reports the -reqprofile counts of one client or the whole
+    server, optionally clearing them.  Any but the caller's own are
+    subject to XResStatsAccess, with manage access to clear them.  Not
+    part of any released XRes version. */
+static int
+ProcXResQueryRequestProfile(ClientPtr client)
+{
+    REQUEST(xXResQueryRequestProfileReq);
+    xXResQueryRequestProfileReply rep;
+    ClientPtr about = NULL;
+    int num_requests, rc;
+
+    REQUEST_SIZE_MATCH(xXResQueryRequestProfileReq);
+
+    if (stuff->xid != None) {
+        int clientID = CLIENT_ID(stuff->xid);
+
+        if ((clientID >= currentMaxClients) || !clients[clientID]) {
+            client->errorValue = stuff->xid;
+            return BadValue;
+        }
+        about = clients[clientID];
+    }
+    rc = XResStatsAccess(client, about, stuff->reset ?
+                         DixGetAttrAccess | DixManageAccess :
+                         DixGetAttrAccess);
+    if (rc != Success)
+        return rc;
+
+    num_requests = RequestProfileForEach(about, NULL, NULL);
+
+    rep = (xXResQueryRequestProfileReply) {
+        .type = X_Reply,
+        .enabled = RequestProfiling,
+        .sequenceNumber = client->sequence,
+        .length = bytes_to_int32(num_requests * sz_xXResRequestProfile),
+        .num_requests = num_requests
+    };
+    if (client->swapped) {
+        swaps(&rep.sequenceNumber);
+        swapl(&rep.length);
+        swapl(&rep.num_requests);
+    }
+    WriteToClient(client, sizeof(xXResQueryRequestProfileReply), &rep);
+
+    RequestProfileForEach(about, WriteRequestProfile, client);
+    if (stuff->reset)
+        RequestProfileReset(about);
+
+    return Success;
+}
+
 static int
 ProcResDispatch(ClientPtr client)
 {
@@ -1011,6 +1184,10 @@ ProcResDispatch(ClientPtr client)
         return ProcXResQueryClientIds(client);
     case X_XResQueryResourceBytes:
         return ProcXResQueryResourceBytes(client);
+    case X_XResQueryClientSchedule:
+        return ProcXResQueryClientSchedule(client);
+    case X_XResQueryRequestProfile:
+        return ProcXResQueryRequestProfile(client);
     default: break;
     }
 
@@ -1042,6 +1219,24 @@ SProcXResQueryClientPixmapBytes(ClientPtr client)
     return ProcXResQueryClientPixmapBytes(client);
 }
 
+static int _X_COLD
+SProcXResQueryClientSchedule(ClientPtr client)
+{
+    REQUEST(xXResQueryClientScheduleReq);
+    REQUEST_SIZE_MATCH(xXResQueryClientScheduleReq);
+    swapl(&stuff->xid);
+    return ProcXResQueryClientSchedule(client);
+}
+
+static int _X_COLD
+SProcXResQueryRequestProfile(ClientPtr client)
+{
+    REQUEST(xXResQueryRequestProfileReq);
+    REQUEST_SIZE_MATCH(xXResQueryRequestProfileReq);
+    swapl(&stuff->xid);
+    return ProcXResQueryRequestProfile(client);
+}
+
 static int _X_COLD
 SProcXResQueryClientIds (ClientPtr client)
 {
@@ -1093,6 +1288,10 @@ SProcResDispatch (ClientPtr client)
         return SProcXResQueryClientIds(client);
     case X_XResQueryResourceBytes:
         return SProcXResQueryResourceBytes(client);
+    case X_XResQueryClientSchedule:
+        return SProcXResQueryClientSchedule(client);
+    case X_XResQueryRequestProfile:
+        return SProcXResQueryRequestProfile(client);
     default: break;
     }
 
@@ -2539,6 +2539,8 @@ RecalculateDeviceDeliverableEvents(WindowPtr pWin)
     WindowPtr pChild, tmp;
     int i;
 
+    InvalidateDeliveryPlan(pWin);
+
     pChild = pWin;
     while (1) {
         if ((inputMasks = wOtherInputMasks(pChild)) != 0) {
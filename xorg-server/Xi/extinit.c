@@ -692,7 +692,6 @@ SDeviceChangedEvent(xXIDeviceChangedEvent * from, xXIDeviceChangedEvent * to)
 static void
 SDeviceEvent(xXIDeviceEvent * from, xXIDeviceEvent * to)
 {
-    int i;
     char *ptr;
     char *vmask;
 
@@ -724,14 +723,9 @@ SDeviceEvent(xXIDeviceEvent * from, xXIDeviceEvent * to)
     ptr += from->buttons_len * 4;
     vmask = ptr;                /* valuator mask */
     ptr += from->valuators_len * 4;
-    for (i = 0; i < from->valuators_len * 32; i++) {
-        if (BitIsOn(vmask, i)) {
-            swapl(((uint32_t *) ptr));
-            ptr += 4;
-            swapl(((uint32_t *) ptr));
-            ptr += 4;
-        }
-    }
+    /* one FP3232 per bit set, two longs each */
+    SwapLongs((CARD32 *) ptr,
+              2 * CountBits((uint8_t *) vmask, from->valuators_len * 32));
 }
 
 static void
@@ -772,7 +766,6 @@ SXIPropertyEvent(xXIPropertyEvent * from, xXIPropertyEvent * to)
 static void
 SRawEvent(xXIRawEvent * from, xXIRawEvent * to)
 {
-    int i;
     FP3232 *values;
     unsigned char *mask;
 
@@ -788,21 +781,10 @@ SRawEvent(xXIRawEvent * from, xXIRawEvent * to)
     mask = (unsigned char *) &to[1];
     values = (FP3232 *) (mask + from->valuators_len * 4);
 
-    for (i = 0; i < from->valuators_len * 4 * 8; i++) {
-        if (BitIsOn(mask, i)) {
-            /* for each bit set there are two FP3232 values on the wire, in
-             * the order abcABC for data and data_raw. Here we swap as if
-             * they were in aAbBcC order because it's easier and really
-             * doesn't matter.
-             */
-            swapl(&values->integral);
-            swapl(&values->frac);
-            values++;
-            swapl(&values->integral);
-            swapl(&values->frac);
-            values++;
-        }
-    }
+    /* For each bit set there are two FP3232 values on the wire, in the
+     * order abcABC for data and data_raw, four longs per bit in all. */
+    SwapLongs((CARD32 *) values,
+              4 * CountBits(mask, from->valuators_len * 32));
 
     swaps(&to->valuators_len);
 }
@@ -56,106 +56,205 @@ SOFTWARE.
 #include "resource.h"
 #include "dix.h"
 
-#define InitialTableSize 256
+/*
+ * Atoms are numbered densely from 1.  Each has a record holding its name,
+ * kept in chunks that double in size: chunk k holds ATOM_CHUNK_BASE << k
+ * atoms and is never moved once allocated, so NameForAtom and ValidAtom
+ * need no locking.  Names are found through an open-addressed hash table
+ * of atom numbers.  When that grows, the old table is kept until the
+ * server resets rather than freed, so MakeAtom lookups that don't create
+ * anything are safe from any thread too.  Only the main thread may
+ * create atoms.
+ *
+ * A new atom's record is filled in before lastAtom is advanced past it,
+ * and lastAtom before the atom is put in the hash table, so a reader that
+ * finds an atom number can always find its record.
+ */
 
-typedef struct _Node {
-    struct _Node *left, *right;
-    Atom a;
-    unsigned int fingerPrint;
+#ifdef __GNUC__
+#define ATOMIC_LOAD(p)          __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define ATOMIC_STORE(p, v)      __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#else
+/* MSVC gives volatile accesses acquire and release semantics */
+#define ATOMIC_LOAD(p)          (*(p))
+#define ATOMIC_STORE(p, v)      (*(p) = (v))
+#endif
+
+#define ATOM_CHUNK_BITS 10
+#define ATOM_CHUNK_BASE (1U << ATOM_CHUNK_BITS)
+#define ATOM_CHUNKS     20      /* room for a billion atoms */
+
+#define InitialTableSize 1024
+
+typedef struct _AtomRec {
     const char *string;
-} NodeRec, *NodePtr;
+    unsigned int len;
+    unsigned int hash;
+} AtomRec, *AtomPtr;
+
+typedef struct _AtomTable {
+    struct _AtomTable *retired; /* tables this one replaced */
+    unsigned int mask;
+    volatile Atom *slots;       /* None if empty */
+} AtomTableRec, *AtomTablePtr;
 
-static Atom lastAtom = None;
-static NodePtr atomRoot = NULL;
-static unsigned long tableLength;
-static NodePtr *nodeTable;
+static volatile Atom lastAtom = None;
+static AtomPtr volatile atomChunks[ATOM_CHUNKS];
+static AtomTablePtr volatile atomTable;
+
+static unsigned int
+HashAtomName(const char *string, unsigned len)
+{
+    unsigned int hash = 2166136261U;    /* FNV-1a */
+    unsigned i;
+
+    for (i = 0; i < len; i++)
+        hash = (hash ^ (unsigned char) string[i]) * 16777619U;
+    return hash;
+}
+
+/* chunk k starts at atom (ATOM_CHUNK_BASE << k) - ATOM_CHUNK_BASE */
+static _X_INLINE int
+AtomChunk(Atom atom)
+{
+    unsigned int n = atom + ATOM_CHUNK_BASE;
+    int k = 0;
+
+    while (n >> (ATOM_CHUNK_BITS + k + 1))
+        k++;
+    return k;
+}
+
+static _X_INLINE AtomPtr
+AtomRecord(Atom atom)
+{
+    int k = AtomChunk(atom);
+
+    return &atomChunks[k][atom + ATOM_CHUNK_BASE - (ATOM_CHUNK_BASE << k)];
+}
+
+static AtomTablePtr
+AllocAtomTable(unsigned int size)
+{
+    AtomTablePtr table = malloc(sizeof(AtomTableRec));
+
+    if (!table)
+        return NULL;
+    table->slots = calloc(size, sizeof(Atom));
+    if (!table->slots) {
+        free(table);
+        return NULL;
+    }
+    table->retired = NULL;
+    table->mask = size - 1;
+    return table;
+}
+
+static void
+FreeAtomTables(AtomTablePtr table)
+{
+    AtomTablePtr retired;
+
+    while (table) {
+        retired = table->retired;
+        free((void *) table->slots);
+        free(table);
+        table = retired;
+    }
+}
+
+/*
+ * Replace the hash table with one twice the size, once it is half full.
+ */
+static Bool
+GrowAtomTable(void)
+{
+    AtomTablePtr old = atomTable, table;
+    unsigned int i;
+    Atom a;
+
+    table = AllocAtomTable((old->mask + 1) * 2);
+    if (!table)
+        return FALSE;
+    for (a = 1; a <= lastAtom; a++) {
+        for (i = AtomRecord(a)->hash & table->mask; table->slots[i];
+             i = (i + 1) & table->mask);
+        table->slots[i] = a;
+    }
+    table->retired = old;
+    ATOMIC_STORE(&atomTable, table);
+    return TRUE;
+}
 
 Atom
 MakeAtom(const char *string, unsigned len, Bool makeit)
 {
-    NodePtr *np;
-    unsigned i;
-    int comp;
-    unsigned int fp = 0;
+    AtomTablePtr table = ATOMIC_LOAD(&atomTable);
+    unsigned int hash, i;
+    AtomPtr nd;
+    Atom a;
+    int k;
 
-    np = &atomRoot;
-    for (i = 0; i < (len + 1) / 2; i++) {
-        fp = fp * 27 + string[i];
-        fp = fp * 27 + string[len - 1 - i];
+    len = strnlen(string, len);
+    hash = HashAtomName(string, len);
+    for (i = hash & table->mask; (a = ATOMIC_LOAD(&table->slots[i]));
+         i = (i + 1) & table->mask) {
+        nd = AtomRecord(a);
+        if (nd->hash == hash && nd->len == len &&
+            !memcmp(nd->string, string, len))
+            return a;
     }
-    while (*np != NULL) {
-        if (fp < (*np)->fingerPrint)
-            np = &((*np)->left);
-        else if (fp > (*np)->fingerPrint)
-            np = &((*np)->right);
-        else {                  /* now start testing the strings */
-            comp = strncmp(string, (*np)->string, (int) len);
-            if ((comp < 0) || ((comp == 0) && (len < strlen((*np)->string))))
-                np = &((*np)->left);
-            else if (comp > 0)
-                np = &((*np)->right);
-            else
-                return (*np)->a;
-        }
+    if (!makeit)
+        return None;
+
+    a = lastAtom + 1;
+    if ((a + 1) * 2 > table->mask + 1) {
+        if (!GrowAtomTable())
+            return BAD_RESOURCE;
+        table = atomTable;
+        for (i = hash & table->mask; table->slots[i];
+             i = (i + 1) & table->mask);
     }
-    if (makeit) {
-        NodePtr nd;
 
-        nd = malloc(sizeof(NodeRec));
-        if (!nd)
+    k = AtomChunk(a);
+    if (k >= ATOM_CHUNKS)
+        return BAD_RESOURCE;
+    if (!atomChunks[k]) {
+        AtomPtr chunk = calloc(ATOM_CHUNK_BASE << k, sizeof(AtomRec));
+
+        if (!chunk)
             return BAD_RESOURCE;
-        if (lastAtom < XA_LAST_PREDEFINED) {
-            nd->string = string;
-        }
-        else {
-            nd->string = strndup(string, len);
-            if (!nd->string) {
-                free(nd);
-                return BAD_RESOURCE;
-            }
-        }
-        if ((lastAtom + 1) >= tableLength) {
-            NodePtr *table;
-
-            table = reallocarray(nodeTable, tableLength, 2 * sizeof(NodePtr));
-            if (!table) {
-                if (nd->string != string) {
-                    /* nd->string has been strdup'ed */
-                    free((char *) nd->string);
-                }
-                free(nd);
-                return BAD_RESOURCE;
-            }
-            tableLength <<= 1;
-            nodeTable = table;
-        }
-        *np = nd;
-        nd->left = nd->right = NULL;
-        nd->fingerPrint = fp;
-        nd->a = ++lastAtom;
-        nodeTable[lastAtom] = nd;
-        return nd->a;
+        ATOMIC_STORE(&atomChunks[k], chunk);
     }
-    else
-        return None;
+
+    nd = AtomRecord(a);
+    if (a <= XA_LAST_PREDEFINED) {
+        nd->string = string;
+    }
+    else {
+        nd->string = strndup(string, len);
+        if (!nd->string)
+            return BAD_RESOURCE;
+    }
+    nd->len = len;
+    nd->hash = hash;
+    ATOMIC_STORE(&lastAtom, a);
+    ATOMIC_STORE(&table->slots[i], a);
+    return a;
 }
 
 Bool
 ValidAtom(Atom atom)
 {
-    return (atom != None) && (atom <= lastAtom);
+    return (atom != None) && (atom <= ATOMIC_LOAD(&lastAtom));
 }
 
 const char *
 NameForAtom(Atom atom)
 {
-    NodePtr node;
-
-    if (atom > lastAtom)
-        return 0;
-    if ((node = nodeTable[atom]) == NULL)
+    if (atom == None || atom > ATOMIC_LOAD(&lastAtom))
         return 0;
-    return node->string;
+    return AtomRecord(atom)->string;
 }
 
 void
@@ -164,44 +263,36 @@ AtomError(void)
     FatalError("initializing atoms");
 }
 
-static void
-FreeAtom(NodePtr patom)
-{
-    if (patom->left)
-        FreeAtom(patom->left);
-    if (patom->right)
-        FreeAtom(patom->right);
-    if (patom->a > XA_LAST_PREDEFINED) {
-        /*
-         * All strings above XA_LAST_PREDEFINED are strdup'ed, so it's safe to
-         * cast here
-         */
-        free((char *) patom->string);
-    }
-    free(patom);
-}
-
 void
 FreeAllAtoms(void)
 {
-    if (atomRoot == NULL)
+    Atom a;
+    int k;
+
+    if (atomTable == NULL)
         return;
-    FreeAtom(atomRoot);
-    atomRoot = NULL;
-    free(nodeTable);
-    nodeTable = NULL;
+    /*
+     * All strings above XA_LAST_PREDEFINED are strdup'ed, so it's safe to
+     * cast here
+     */
+    for (a = XA_LAST_PREDEFINED + 1; a <= lastAtom; a++)
+        free((char *) AtomRecord(a)->string);
     lastAtom = None;
+    for (k = 0; k < ATOM_CHUNKS; k++) {
+        free(atomChunks[k]);
+        atomChunks[k] = NULL;
+    }
+    FreeAtomTables(atomTable);
+    atomTable = NULL;
 }
 
 void
 InitAtoms(void)
 {
     FreeAllAtoms();
-    tableLength = InitialTableSize;
-    nodeTable = xallocarray(InitialTableSize, sizeof(NodePtr));
-    if (!nodeTable)
+    atomTable = AllocAtomTable(InitialTableSize);
+    if (!atomTable)
         AtomError();
-    nodeTable[None] = NULL;
     MakePredeclaredAtoms();
     if (lastAtom != XA_LAST_PREDEFINED)
         AtomError();
@@ -132,6 +132,7 @@ int ProcInitialConnection();
 #include "inputstr.h"
 #include "xkbsrv.h"
 #include "client.h"
+#include "reqprofile.h"
 
 #ifdef XSERVER_DTRACE
 #include "registry.h"
@@ -251,6 +252,7 @@ long SmartScheduleInterval = SMART_SCHEDULE_DEFAULT_INTERVAL;
 long SmartScheduleMaxSlice = SMART_SCHEDULE_MAX_SLICE;
 long SmartScheduleTime;
 int SmartScheduleLatencyLimited = 0;
+Bool SmartScheduleAdaptive = FALSE;
 static ClientPtr SmartLastClient;
 static int SmartLastIndex[SMART_MAX_PRIORITY - SMART_MIN_PRIORITY + 1];
 
@@ -282,8 +284,11 @@ clients_are_ready(void)
 void
 mark_client_ready(ClientPtr client)
 {
-    if (xorg_list_is_empty(&client->ready))
+    if (xorg_list_is_empty(&client->ready)) {
+        if (SmartScheduleAdaptive)
+            client->smart_stats.ready_time = GetTimeInMicros();
         xorg_list_append(&client->ready, &ready_clients);
+    }
 }
 
 /*
@@ -292,8 +297,11 @@ mark_client_ready(ClientPtr client)
  */
 void mark_client_saved_ready(ClientPtr client)
 {
-    if (xorg_list_is_empty(&client->ready))
+    if (xorg_list_is_empty(&client->ready)) {
+        if (SmartScheduleAdaptive)
+            client->smart_stats.ready_time = GetTimeInMicros();
         xorg_list_append(&client->ready, &saved_ready_clients);
+    }
 }
 
 /* Client has no requests queued and no data on network */
@@ -327,6 +335,36 @@ mark_client_ungrab(void)
     }
 }
 
+/*
+ * The adaptive scheduler.  Every request and every slice is timed, and
+ * each client keeps running averages of what a request costs, how long
+ * it waits to run and how much of a slice it uses.  Among ready clients
+ * of equal priority it picks the one with the highest response ratio,
+ * (wait + burst) / burst: clients that run in short bursts go first, but
+ * the ratio of a bulk client grows while it waits, so nothing starves.
+ * Clients that have been sent input since they last ran count four times
+ * over.  Slices are measured with the microsecond clock rather than
+ * SmartScheduleTime, so a bulk client is cut off when its slice is up
+ * even between timer ticks.
+ */
+
+#define SMART_EWMA(avg, sample) \
+    ((avg) = (CARD32) ((INT64) (avg) + ((INT64) (sample) - (INT64) (avg)) / 8))
+
+#define SMART_MIN_BURST 100     /* don't trust bursts shorter than this */
+
+static CARD64
+SmartScheduleRatio(ClientPtr client, CARD64 time)
+{
+    SmartScheduleStatsPtr stats = &client->smart_stats;
+    CARD64 burst = max(stats->burst, SMART_MIN_BURST);
+    CARD64 ratio = ((time - stats->ready_time + burst) << 10) / burst;
+
+    if (stats->input_pending)
+        ratio <<= 2;
+    return ratio;
+}
+
 static ClientPtr
 SmartScheduleClient(void)
 {
@@ -335,9 +373,12 @@ SmartScheduleClient(void)
     long now = SmartScheduleTime;
     long idle;
     int nready = 0;
+    CARD64 time = 0, ratio, bestRatio = 0;
 
     bestRobin = 0;
     idle = 2 * SmartScheduleSlice;
+    if (SmartScheduleAdaptive)
+        time = GetTimeInMicros();
 
     xorg_list_for_each_entry(pClient, &ready_clients, ready) {
         nready++;
@@ -348,27 +389,48 @@ SmartScheduleClient(void)
                 pClient->smart_priority++;
         }
 
-        /* check priority to select best client */
-        robin =
-            (pClient->index -
-             SmartLastIndex[pClient->smart_priority -
-                            SMART_MIN_PRIORITY]) & 0xff;
-
-        /* pick the best client */
-        if (!best ||
-            pClient->priority > best->priority ||
-            (pClient->priority == best->priority &&
-             (pClient->smart_priority > best->smart_priority ||
-              (pClient->smart_priority == best->smart_priority && robin > bestRobin))))
-        {
-            best = pClient;
-            bestRobin = robin;
+        if (SmartScheduleAdaptive) {
+            ratio = SmartScheduleRatio(pClient, time);
+            if (!best ||
+                pClient->priority > best->priority ||
+                (pClient->priority == best->priority && ratio > bestRatio)) {
+                best = pClient;
+                bestRatio = ratio;
+            }
+        }
+        else {
+            /* check priority to select best client */
+            robin =
+                (pClient->index -
+                 SmartLastIndex[pClient->smart_priority -
+                                SMART_MIN_PRIORITY]) & 0xff;
+
+            /* pick the best client */
+            if (!best ||
+                pClient->priority > best->priority ||
+                (pClient->priority == best->priority &&
+                 (pClient->smart_priority > best->smart_priority ||
+                  (pClient->smart_priority == best->smart_priority && robin > bestRobin))))
+            {
+                best = pClient;
+                bestRobin = robin;
+            }
         }
 #ifdef SMART_DEBUG
         if ((now - SmartLastPrint) >= 5000)
             fprintf(stderr, " %2d: %3d", pClient->index, pClient->smart_priority);
 #endif
     }
+    best->smart_stats.slices++;
+    if (SmartScheduleAdaptive) {
+        SmartScheduleStatsPtr stats = &best->smart_stats;
+        CARD64 wait = time - stats->ready_time;
+
+        SMART_EWMA(stats->wait, wait);
+        if (wait > stats->max_wait)
+            stats->max_wait = wait;
+        stats->input_pending = FALSE;
+    }
 #ifdef SMART_DEBUG
     if ((now - SmartLastPrint) >= 5000) {
         fprintf(stderr, " use %2d\n", best->index);
@@ -471,12 +533,15 @@ void DispatchQueuedEvents(Bool wait)
         if (!dispatchException && clients_are_ready())
         {
             long start_tick;
+            CARD64 start_time = 0, request_time = 0;
             ClientPtr client;
             client = SmartScheduleClient();
 
             isItTimeToYield = FALSE;
 
             start_tick = SmartScheduleTime;
+            if (SmartScheduleAdaptive)
+                start_time = request_time = GetTimeInMicros();
             while (!isItTimeToYield)
             {
                 int result;
@@ -487,11 +552,14 @@ void DispatchQueuedEvents(Bool wait)
                     ProcessInputEvents();
 
                 FlushIfCriticalOutputPending();
-                if ((SmartScheduleTime - start_tick) >= SmartScheduleSlice)
+                if (SmartScheduleAdaptive ?
+                    (request_time - start_time >= SmartScheduleSlice * 1000) :
+                    ((SmartScheduleTime - start_tick) >= SmartScheduleSlice))
                 {
                     /* Penalize clients which consume ticks */
                     if (client->smart_priority > SMART_MIN_PRIORITY)
                         client->smart_priority--;
+                    client->smart_stats.preempted++;
                     break;
                 }
 
@@ -529,14 +597,35 @@ void DispatchQueuedEvents(Bool wait)
                     result = BadLength;
                 else
                 {
+                    int bytes = result;
+
                     result = XaceHookDispatch(client, client->majorOp);
                     if (result == Success) {
+                        /* leave out the connection setup */
+                        Bool profile = RequestProfiling &&
+                            client->clientState == ClientStateRunning;
+                        int major = client->majorOp, minor = client->minorOp;
+                        CARD64 profile_time = 0;
+
+                        if (profile)
+                            profile_time = GetTimeInMicros();
                         currentClient = client;
                         result =
                             (*client->requestVector[client->majorOp]) (client);
                         currentClient = NULL;
+                        if (profile)
+                            RequestProfileRecord(client, major, minor, bytes,
+                                                 GetTimeInMicros() -
+                                                 profile_time);
                     }
                 }
+                if (SmartScheduleAdaptive) {
+                    CARD64 now = GetTimeInMicros();
+
+                    client->smart_stats.requests++;
+                    SMART_EWMA(client->smart_stats.cost, now - request_time);
+                    request_time = now;
+                }
                 if (!SmartScheduleSignalEnable)
                     SmartScheduleTime = GetTimeInMillis();
 
@@ -577,8 +666,17 @@ void DispatchQueuedEvents(Bool wait)
                 }
             }
             FlushAllOutput();
-            if (client == SmartLastClient)
+            if (client == SmartLastClient) {
                 client->smart_stop_tick = SmartScheduleTime;
+                if (SmartScheduleAdaptive) {
+                    SmartScheduleStatsPtr stats = &client->smart_stats;
+
+                    stats->run_time += request_time - start_time;
+                    SMART_EWMA(stats->burst, request_time - start_time);
+                    /* if it still has requests queued, it is waiting again */
+                    stats->ready_time = request_time;
+                }
+            }
         }
         dispatchException &= ~DE_PRIORITYCHANGE;
     }
@@ -2166,6 +2264,27 @@ ProcPutImage(ClientPtr client)
     return Success;
 }
 
+/*
+ * Send one strip of a GetImage reply.  If the client is already behind
+ * on reading, the strip would only be copied into its output queue, so
+ * hand the buffer over instead and carry on in a fresh one.  Output that
+ * is merely buffered goes out with the strip in one writev, so that case
+ * keeps reusing the one buffer.
+ */
+static char *
+WriteImageStrip(ClientPtr client, int count, char *pBuf, long length)
+{
+    char *pNext;
+
+    if (ClientOutputBackedUp(client) &&
+        (pNext = calloc(1, length))) {
+        WriteToClientNoCopy(client, count, pBuf);
+        return pNext;
+    }
+    WriteToClient(client, count, pBuf);
+    return pBuf;
+}
+
 static int
 DoGetImage(ClientPtr client, int format, Drawable drawable,
            int x, int y, int width, int height,
@@ -2325,7 +2444,8 @@ DoGetImage(ClientPtr client, int format, Drawable drawable,
             ReformatImage(pBuf, (int) (nlines * widthBytesLine),
                           BitsPerPixel(pDraw->depth), ClientOrder(client));
 
-            WriteToClient(client, (int) (nlines * widthBytesLine), pBuf);
+            pBuf = WriteImageStrip(client, (int) (nlines * widthBytesLine),
+                                   pBuf, length);
             linesDone += nlines;
         }
     }
@@ -2353,7 +2473,9 @@ DoGetImage(ClientPtr client, int format, Drawable drawable,
                     ReformatImage(pBuf, (int) (nlines * widthBytesLine),
                                   1, ClientOrder(client));
 
-                    WriteToClient(client, (int)(nlines * widthBytesLine), pBuf);
+                    pBuf = WriteImageStrip(client,
+                                           (int) (nlines * widthBytesLine),
+                                           pBuf, length);
                     linesDone += nlines;
                 }
             }
@@ -3571,6 +3693,7 @@ CloseDownClient(ClientPtr client)
         /* Disable client ID tracking. This must be done after
          * ClientStateCallback. */
         ReleaseClientIds(client);
+        RequestProfileReset(client);
 #ifdef XSERVER_DTRACE
         XSERVER_CLIENT_DISCONNECT(client->index);
 #endif
@@ -3611,6 +3734,8 @@ InitClient(ClientPtr client, int i, void *ospriv)
     QueryMinMaxKeyCodes(&client->minKC, &client->maxKC);
     client->smart_start_tick = SmartScheduleTime;
     client->smart_stop_tick = SmartScheduleTime;
+    memset(&client->smart_stats, 0, sizeof(client->smart_stats));
+    client->req_profile = NULL;
     client->clientIds = NULL;
 }
 
@@ -2081,6 +2081,172 @@ ActivateImplicitGrab(DeviceIntPtr dev, ClientPtr client, WindowPtr win,
     return TRUE;
 }
 
+/*
+ * Delivery plans.  The clients that selected for events on a window are
+ * kept in the OtherClients and InputClients lists; walking those for
+ * every event means chasing a pointer per client and checking grabs and
+ * XACE before finding out whether the client wants the event at all.
+ * The plan is the same lists flattened into an array, core clients
+ * first, with each client's XI2 selections for XIAllDevices and
+ * XIAllMasterDevices folded into a bitmask so that most clients that
+ * don't want an event are passed over with one test.  It is built on
+ * first use and thrown away whenever the window's selections change.
+ * If it can't be allocated, delivery makes up the rows one at a time
+ * from the lists instead.
+ */
+
+typedef struct _DeliveryPlanRow {
+    ClientPtr client;
+    Mask *mask;                 /* core mask, or XI masks by device */
+    XI2Mask *xi2mask;           /* NULL for core clients */
+    CARD32 xi2all;              /* XI2 types selected for all devices */
+    CARD32 xi2master;           /* XI2 types selected for master devices */
+    Bool xi2device;             /* some not covered by the above */
+} DeliveryPlanRowRec, *DeliveryPlanRowPtr;
+
+typedef struct _DeliveryPlan {
+    int ncore;
+    int nxi;
+    DeliveryPlanRowPtr rows;    /* follow the plan in memory */
+} DeliveryPlanRec, *DeliveryPlanPtr;
+
+/* The clients to try on a window, see NextDeliveryRow */
+typedef struct _DeliveryRows {
+    DeliveryPlanRowPtr rows;    /* from the plan */
+    int nrows;
+    OtherClients *others;       /* or from the lists, without a plan */
+    InputClients *iclients;
+    DeliveryPlanRowRec scratch;
+} DeliveryRowsRec, *DeliveryRowsPtr;
+
+static CARD32
+XI2MaskWord(XI2Mask *mask, int deviceid, Bool *more)
+{
+    unsigned char *bytes = mask->masks[deviceid];
+    CARD32 word = 0;
+    int i;
+
+    for (i = 0; i < mask->mask_size; i++) {
+        if (i < sizeof(CARD32))
+            word |= (CARD32) bytes[i] << (i * 8);
+        else if (bytes[i])
+            *more = TRUE;
+    }
+    return word;
+}
+
+static void
+CoreDeliveryPlanRow(DeliveryPlanRowPtr row, OtherClients *others)
+{
+    row->client = rClient(others);
+    row->mask = &others->mask;
+    row->xi2mask = NULL;
+    row->xi2all = row->xi2master = 0;
+    row->xi2device = FALSE;
+}
+
+static void
+XIDeliveryPlanRow(DeliveryPlanRowPtr row, InputClients *iclients)
+{
+    XI2Mask *xi2mask = iclients->xi2mask;
+    int i;
+
+    row->client = rClient(iclients);
+    row->mask = iclients->mask;
+    row->xi2mask = xi2mask;
+    row->xi2device = FALSE;
+    row->xi2all = XI2MaskWord(xi2mask, XIAllDevices, &row->xi2device);
+    row->xi2master = XI2MaskWord(xi2mask, XIAllMasterDevices,
+                                 &row->xi2device);
+    for (i = 0; i < xi2mask->nmasks && !row->xi2device; i++)
+        if (i != XIAllDevices && i != XIAllMasterDevices &&
+            XI2MaskWord(xi2mask, i, &row->xi2device))
+            row->xi2device = TRUE;
+}
+
+static DeliveryPlanPtr
+BuildDeliveryPlan(WindowPtr win)
+{
+    DeliveryPlanPtr plan;
+    DeliveryPlanRowPtr row;
+    OtherClients *others;
+    InputClients *iclients;
+    int ncore = 0, nxi = 0;
+
+    for (others = wOtherClients(win); others; others = others->next)
+        ncore++;
+    if (wOtherInputMasks(win))
+        for (iclients = wOtherInputMasks(win)->inputClients; iclients;
+             iclients = iclients->next)
+            nxi++;
+
+    plan = malloc(sizeof(DeliveryPlanRec) +
+                  (ncore + nxi) * sizeof(DeliveryPlanRowRec));
+    if (!plan)
+        return NULL;
+    plan->ncore = ncore;
+    plan->nxi = nxi;
+    plan->rows = (DeliveryPlanRowPtr) (plan + 1);
+
+    row = plan->rows;
+    for (others = wOtherClients(win); others; others = others->next)
+        CoreDeliveryPlanRow(row++, others);
+    if (wOtherInputMasks(win))
+        for (iclients = wOtherInputMasks(win)->inputClients; iclients;
+             iclients = iclients->next)
+            XIDeliveryPlanRow(row++, iclients);
+
+    return plan;
+}
+
+static DeliveryPlanPtr
+GetDeliveryPlan(WindowPtr win)
+{
+    if (!win->optional)
+        return NULL;
+    if (!win->optional->deliveryPlan)
+        win->optional->deliveryPlan = BuildDeliveryPlan(win);
+    return win->optional->deliveryPlan;
+}
+
+/**
+ * Drop the window's delivery plan, to be rebuilt with the next event.
+ * Must be called whenever a client's selection on the window changes.
+ */
+void
+InvalidateDeliveryPlan(WindowPtr win)
+{
+    if (win->optional) {
+        free(win->optional->deliveryPlan);
+        win->optional->deliveryPlan = NULL;
+    }
+}
+
+/**
+ * The row's equivalent of GetEventMask.  evtype is the XI2 type of the
+ * event, or 0 if it is a core or XI event.
+ */
+static Mask
+DeliveryPlanRowMask(DeliveryPlanRowPtr row, DeviceIntPtr dev, xEvent *event,
+                    int evtype)
+{
+    if (evtype) {
+        CARD32 types = row->xi2all;
+
+        if (IsMaster(dev))
+            types |= row->xi2master;
+        if (evtype < 32 && (types & (1U << evtype)))
+            return event_get_filter_from_xi2type(evtype);
+        if (row->xi2device)
+            return GetXI2MaskByte(row->xi2mask, dev, evtype);
+        return 0;
+    }
+    else if (core_get_type(event) != 0)
+        return row->mask[XIAllDevices];
+    else
+        return row->mask[dev->id];
+}
+
 /**
  * Attempt event delivery to the client owning the window.
  */
@@ -2111,60 +2277,109 @@ DeliverToWindowOwner(DeviceIntPtr dev, WindowPtr win,
 }
 
 /**
- * Get the list of clients that should be tried for event delivery on the
- * given window.
+ * Get the clients that should be tried for event delivery on the given
+ * window, as rows of the window's delivery plan, or straight from its
+ * client lists if there is no plan.
  *
- * @return 1 if the client list should be traversed, zero if the event
+ * @return 1 if the rows should be traversed, zero if the event
  * should be skipped.
  */
 static Bool
 GetClientsForDelivery(DeviceIntPtr dev, WindowPtr win,
-                      xEvent *events, Mask filter, InputClients ** iclients)
+                      xEvent *events, Mask filter, DeliveryRowsPtr rows)
 {
-    int rc = 0;
+    Bool core = core_get_type(events) != 0;
+    DeliveryPlanPtr plan;
 
-    if (core_get_type(events) != 0)
-        *iclients = (InputClients *) wOtherClients(win);
-    else if (xi2_get_type(events) != 0) {
-        OtherInputMasks *inputMasks = wOtherInputMasks(win);
+    memset(rows, 0, sizeof(*rows));
 
+    if (core) {
+        if (!wOtherClients(win))
+            return 1;
+    }
+    else if (xi2_get_type(events) != 0) {
         /* Has any client selected for the event? */
         if (!WindowXI2MaskIsset(dev, win, events))
-            goto out;
-        *iclients = inputMasks->inputClients;
+            return 0;
     }
     else {
         OtherInputMasks *inputMasks = wOtherInputMasks(win);
 
         /* Has any client selected for the event? */
         if (!inputMasks || !(inputMasks->inputEvents[dev->id] & filter))
-            goto out;
+            return 0;
+    }
 
-        *iclients = inputMasks->inputClients;
+    plan = GetDeliveryPlan(win);
+    if (!plan) {
+        if (core)
+            rows->others = wOtherClients(win);
+        else if (wOtherInputMasks(win))
+            rows->iclients = wOtherInputMasks(win)->inputClients;
+    }
+    else if (core) {
+        rows->rows = plan->rows;
+        rows->nrows = plan->ncore;
+    }
+    else {
+        rows->rows = plan->rows + plan->ncore;
+        rows->nrows = plan->nxi;
     }
+    return 1;
+}
 
-    rc = 1;
- out:
-    return rc;
+/**
+ * The next client to try, or NULL once all have been.  Without a plan
+ * the row is made up from the client lists and only valid until the next
+ * call.
+ */
+static DeliveryPlanRowPtr
+NextDeliveryRow(DeliveryRowsPtr rows)
+{
+    DeliveryPlanRowPtr row = &rows->scratch;
+
+    if (rows->nrows > 0) {
+        rows->nrows--;
+        return rows->rows++;
+    }
+    if (rows->others) {
+        CoreDeliveryPlanRow(row, rows->others);
+        rows->others = rows->others->next;
+        return row;
+    }
+    if (rows->iclients) {
+        XIDeliveryPlanRow(row, rows->iclients);
+        rows->iclients = rows->iclients->next;
+        return row;
+    }
+    return NULL;
 }
 
 /**
- * Try delivery on each client in inputclients, provided the event mask
+ * Try delivery on each client in rows, provided the event mask
  * accepts it and there is no interfering core grab..
  */
 static enum EventDeliveryState
-DeliverEventToInputClients(DeviceIntPtr dev, InputClients * inputclients,
+DeliverEventToInputClients(DeviceIntPtr dev, DeliveryRowsPtr rows,
                            WindowPtr win, xEvent *events,
                            int count, Mask filter, GrabPtr grab,
                            ClientPtr *client_return, Mask *mask_return)
 {
     int attempt;
+    int evtype = xi2_get_type(events);
     enum EventDeliveryState rc = EVENT_NOT_DELIVERED;
     Bool have_device_button_grab_class_client = FALSE;
+    DeliveryPlanRowPtr row;
 
-    for (; inputclients; inputclients = inputclients->next) {
+    while ((row = NextDeliveryRow(rows))) {
         Mask mask;
-        ClientPtr client = rClient(inputclients);
+        ClientPtr client = row->client;
+
+        mask = DeliveryPlanRowMask(row, dev, events, evtype);
+
+        /* TryClientEvents would filter it anyway, skip the checks */
+        if (filter != CantBeFiltered && !(mask & filter))
+            continue;
 
         if (IsInterferingGrab(client, dev, events))
             continue;
@@ -2172,8 +2387,6 @@ DeliverEventToInputClients(DeviceIntPtr dev, InputClients * inputclients,
         if (IsWrongPointerBarrierClient(client, dev, events))
             continue;
 
-        mask = GetEventMask(dev, events, inputclients);
-
         if (XaceHook(XACE_RECEIVE_ACCESS, client, win, events, count))
             /* do nothing */ ;
         else if ((attempt = TryClientEvents(client, dev,
@@ -2214,13 +2427,14 @@ DeliverEventToWindowMask(DeviceIntPtr dev, WindowPtr win, xEvent *events,
                          int count, Mask filter, GrabPtr grab,
                          ClientPtr *client_return, Mask *mask_return)
 {
-    InputClients *iclients;
+    DeliveryRowsRec rows;
 
-    if (!GetClientsForDelivery(dev, win, events, filter, &iclients))
+    if (!GetClientsForDelivery(dev, win, events, filter, &rows))
         return EVENT_SKIP;
 
-    return DeliverEventToInputClients(dev, iclients, win, events, count, filter,
-                                      grab, client_return, mask_return);
+    return DeliverEventToInputClients(dev, &rows, win, events, count,
+                                      filter, grab, client_return,
+                                      mask_return);
 
 }
 
@@ -2381,28 +2595,28 @@ DeliverRawEvent(RawDeviceEvent *ev, DeviceIntPtr device)
 
     for (i = 0; i < screenInfo.numScreens; i++) {
         WindowPtr root;
-        InputClients *inputclients;
+        DeliveryRowsRec rows, one;
+        DeliveryPlanRowPtr row;
 
         root = screenInfo.screens[i]->root;
-        if (!GetClientsForDelivery(device, root, xi, filter, &inputclients))
+        if (!GetClientsForDelivery(device, root, xi, filter, &rows))
             continue;
 
-        for (; inputclients; inputclients = inputclients->next) {
+        while ((row = NextDeliveryRow(&rows))) {
             ClientPtr c;        /* unused */
             Mask m;             /* unused */
-            InputClients ic = *inputclients;
 
-            /* Because we run through the list manually, copy the actual
-             * list, shorten the copy to only have one client and then pass
-             * that down to DeliverEventToInputClients. This way we avoid
-             * double events on XI 2.1 clients that have a grab on the
-             * device.
+            /* Pass one client at a time down to
+             * DeliverEventToInputClients. This way we avoid double
+             * events on XI 2.1 clients that have a grab on the device.
              */
-            ic.next = NULL;
-
-            if (!FilterRawEvents(rClient(&ic), grab, root))
-                DeliverEventToInputClients(device, &ic, root, xi, 1,
+            if (!FilterRawEvents(row->client, grab, root)) {
+                memset(&one, 0, sizeof(one));
+                one.rows = row;
+                one.nrows = 1;
+                DeliverEventToInputClients(device, &one, root, xi, 1,
                                            filter, NULL, &c, &m);
+            }
         }
     }
 
@@ -3930,6 +4144,8 @@ CheckPassiveGrabsOnWindow(WindowPtr pWin,
 {
     GrabPtr grab = wPassiveGrabs(pWin);
     GrabPtr tempGrab;
+    GrabIndexIterRec iter;
+    Bool indexed;
 
     if (!grab)
         return NULL;
@@ -3961,7 +4177,10 @@ CheckPassiveGrabsOnWindow(WindowPtr pWin,
     tempGrab->modifiersDetail.pMask = NULL;
     tempGrab->next = NULL;
 
-    for (; grab; grab = grab->next) {
+    indexed = GrabIndexLookup(pWin, tempGrab->detail.exact, &iter);
+    if (indexed)
+        grab = GrabIndexNext(&iter);
+    for (; grab; grab = indexed ? GrabIndexNext(&iter) : grab->next) {
         if (!CheckPassiveGrab(device, grab, event, checkCore, tempGrab))
             continue;
 
@@ -4356,6 +4575,8 @@ RecalculateDeliverableEvents(WindowPtr pWin)
     OtherClients *others;
     WindowPtr pChild;
 
+    InvalidateDeliveryPlan(pWin);
+
     pChild = pWin;
     while (1) {
         if (pChild->optional) {
@@ -5918,6 +6139,16 @@ WriteEventsToClient(ClientPtr pClient, int count, xEvent *events)
     if (!pClient || pClient == serverClient || pClient->clientGone)
         return;
 
+    /* Let the adaptive scheduler favour clients responding to input */
+    if (SmartScheduleAdaptive) {
+        int type = events->u.u.type & 0x7f;
+
+        if ((type >= KeyPress && type <= MotionNotify) ||
+            (type == GenericEvent &&
+             ((xGenericEvent *) events)->extension == IReqCode))
+            pClient->smart_stats.input_pending = TRUE;
+    }
+
     for (i = 0; i < count; i++)
         if ((events[i].u.u.type & 0x7f) != KeymapNotify)
             events[i].u.u.sequenceNumber = pClient->sequence;
@@ -5986,6 +6217,22 @@ WriteEventsToClient(ClientPtr pClient, int count, xEvent *events)
         eventlength += ((xGenericEvent *) events)->length * 4;
     }
 
+    /* Encode straight into the client's output buffer where there is
+     * room, to go out with everything else queued this cycle. */
+    eventTo = ReserveClientOutput(pClient, count * eventlength);
+    if (eventTo) {
+        if (!pClient->swapped) {
+            memcpy(eventTo, events, count * eventlength);
+            return;
+        }
+        for (i = 0; i < count; i++) {
+            (*EventSwapVector[events[i].u.u.type & 0177])
+                (&events[i], eventTo);
+            eventTo = (xEvent *) ((char *) eventTo + eventlength);
+        }
+        return;
+    }
+
     if (pClient->swapped) {
         if (eventlength > swapEventLen) {
             swapEventLen = eventlength;
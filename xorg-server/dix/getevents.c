@@ -1403,6 +1403,7 @@ fill_pointer_events(InternalEvent *events, DeviceIntPtr pDev, int type,
 
         init_raw(pDev, raw, ms, type, buttons);
         set_raw_valuators(raw, &mask, TRUE, raw->valuators.data_raw);
+        raw->relative = !(flags & POINTER_ABSOLUTE);
     }
 
     valuator_mask_drop_unaccelerated(&mask);
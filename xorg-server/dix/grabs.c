@@ -315,6 +315,231 @@ CopyGrab(GrabPtr dst, const GrabPtr src)
     return TRUE;
 }
 
+/*
+ * Windows with many passive grabs, such as a root window holding all the
+ * bindings of a hotkey daemon, index them by detail.  A key or button
+ * press then only looks at the grabs for that key or button and the ones
+ * for AnyKey/AnyButton, instead of every grab on the window.  Each bucket
+ * keeps its grabs oldest first, numbered in the order they were prepended
+ * to the list, so that lookups can merge the two buckets back into list
+ * order.  Modifiers and devices aren't part of the key: which modifier
+ * state a grab is matched against depends on the grab's own modifier
+ * device, and XIAllDevices/XIAllMasterDevices grabs match several devices.
+ */
+#define GRAB_INDEX_MIN_GRABS 32
+#define GRAB_INDEX_BUCKETS 256  /* details are KeyCodes */
+
+typedef struct _GrabIndexEntry {
+    GrabPtr grab;
+    CARD32 seq;
+} GrabIndexEntryRec, *GrabIndexEntryPtr;
+
+typedef struct _GrabIndexBucket {
+    GrabIndexEntryPtr entries;
+    int numEntries;
+    int sizeEntries;
+} GrabIndexBucketRec, *GrabIndexBucketPtr;
+
+typedef struct _GrabIndex {
+    GrabIndexBucketRec buckets[GRAB_INDEX_BUCKETS];
+    CARD32 nextSeq;
+} GrabIndexRec, *GrabIndexPtr;
+
+static GrabIndexPtr
+WindowGrabIndex(WindowPtr pWin)
+{
+    return pWin->optional ? pWin->optional->grabIndex : NULL;
+}
+
+void
+FreeGrabIndex(WindowPtr pWin)
+{
+    GrabIndexPtr index = WindowGrabIndex(pWin);
+    int i;
+
+    if (!index)
+        return;
+    for (i = 0; i < GRAB_INDEX_BUCKETS; i++)
+        free(index->buckets[i].entries);
+    free(index);
+    pWin->optional->grabIndex = NULL;
+}
+
+static GrabIndexBucketPtr
+GrabIndexBucket(GrabIndexPtr index, GrabPtr grab)
+{
+    return &index->buckets[grab->detail.exact % GRAB_INDEX_BUCKETS];
+}
+
+/**
+ * (Re)builds the index of pWin's passive grabs from the list, numbering
+ * them from the end of the list.
+ *
+ * @return FALSE if the index could not be allocated, pWin is left without
+ * one.
+ */
+static Bool
+BuildGrabIndex(WindowPtr pWin)
+{
+    GrabIndexPtr index = WindowGrabIndex(pWin);
+    GrabIndexBucketPtr bucket;
+    GrabPtr grab;
+    CARD32 seq = 0;
+    int i;
+
+    if (!index) {
+        index = calloc(1, sizeof(GrabIndexRec));
+        if (!index)
+            return FALSE;
+        pWin->optional->grabIndex = index;
+    }
+
+    for (i = 0; i < GRAB_INDEX_BUCKETS; i++)
+        index->buckets[i].numEntries = 0;
+    for (grab = wPassiveGrabs(pWin); grab; grab = grab->next) {
+        GrabIndexBucket(index, grab)->numEntries++;
+        seq++;
+    }
+    for (i = 0; i < GRAB_INDEX_BUCKETS; i++) {
+        bucket = &index->buckets[i];
+        if (bucket->numEntries > bucket->sizeEntries) {
+            GrabIndexEntryPtr entries =
+                reallocarray(bucket->entries, bucket->numEntries,
+                             sizeof(GrabIndexEntryRec));
+
+            if (!entries) {
+                FreeGrabIndex(pWin);
+                return FALSE;
+            }
+            bucket->entries = entries;
+            bucket->sizeEntries = bucket->numEntries;
+        }
+    }
+
+    /* the head of the list is the newest grab, fill the buckets from the
+     * back */
+    index->nextSeq = seq + 1;
+    for (grab = wPassiveGrabs(pWin); grab; grab = grab->next) {
+        bucket = GrabIndexBucket(index, grab);
+        bucket->entries[--bucket->numEntries].grab = grab;
+        bucket->entries[bucket->numEntries].seq = seq--;
+    }
+    for (grab = wPassiveGrabs(pWin); grab; grab = grab->next)
+        GrabIndexBucket(index, grab)->numEntries++;
+    return TRUE;
+}
+
+/**
+ * Links a grab into the front of its window's passive grab list, and into
+ * the window's index if it has one or now has enough grabs for one.
+ */
+static void
+PrependPassiveGrab(GrabPtr pGrab)
+{
+    WindowPtr pWin = pGrab->window;
+    GrabIndexPtr index = WindowGrabIndex(pWin);
+    GrabIndexBucketPtr bucket;
+    GrabPtr grab;
+    int num = 0;
+
+    pGrab->next = pWin->optional->passiveGrabs;
+    pWin->optional->passiveGrabs = pGrab;
+
+    if (!index) {
+        for (grab = pGrab; grab && num < GRAB_INDEX_MIN_GRABS;
+             grab = grab->next)
+            num++;
+        if (num == GRAB_INDEX_MIN_GRABS)
+            BuildGrabIndex(pWin);
+        return;
+    }
+    if (index->nextSeq == (CARD32) ~0) {
+        BuildGrabIndex(pWin);
+        return;
+    }
+
+    bucket = GrabIndexBucket(index, pGrab);
+    if (bucket->numEntries == bucket->sizeEntries) {
+        int size = bucket->sizeEntries ? bucket->sizeEntries * 2 : 4;
+        GrabIndexEntryPtr entries = reallocarray(bucket->entries, size,
+                                                 sizeof(GrabIndexEntryRec));
+
+        if (!entries) {
+            /* rebuilt when the next grab is added */
+            FreeGrabIndex(pWin);
+            return;
+        }
+        bucket->entries = entries;
+        bucket->sizeEntries = size;
+    }
+    bucket->entries[bucket->numEntries].grab = pGrab;
+    bucket->entries[bucket->numEntries].seq = index->nextSeq++;
+    bucket->numEntries++;
+}
+
+static void
+GrabIndexRemove(GrabPtr pGrab)
+{
+    GrabIndexPtr index = WindowGrabIndex(pGrab->window);
+    GrabIndexBucketPtr bucket;
+    int i;
+
+    if (!index)
+        return;
+    bucket = GrabIndexBucket(index, pGrab);
+    for (i = bucket->numEntries - 1; i >= 0; i--) {
+        if (bucket->entries[i].grab == pGrab) {
+            memmove(&bucket->entries[i], &bucket->entries[i + 1],
+                    (bucket->numEntries - i - 1) * sizeof(GrabIndexEntryRec));
+            bucket->numEntries--;
+            break;
+        }
+    }
+}
+
+/**
+ * Starts a lookup of the passive grabs on pWin that may match a key or
+ * button press of the given detail, to be read out in list order with
+ * GrabIndexNext().  The grabs still have to be checked one by one, the
+ * index only leaves out the ones for other keys or buttons.
+ *
+ * @return FALSE if pWin has no index or detail is AnyKey, the caller walks
+ * the list itself.
+ */
+Bool
+GrabIndexLookup(WindowPtr pWin, unsigned int detail, GrabIndexIterPtr iter)
+{
+    GrabIndexPtr index = WindowGrabIndex(pWin);
+    GrabIndexBucketPtr bucket;
+
+    if (!index || detail == AnyKey || detail >= GRAB_INDEX_BUCKETS)
+        return FALSE;
+
+    bucket = &index->buckets[detail];
+    iter->exactStart = bucket->entries;
+    iter->exact = bucket->entries + bucket->numEntries;
+    bucket = &index->buckets[AnyKey];
+    iter->anyStart = bucket->entries;
+    iter->any = bucket->entries + bucket->numEntries;
+    return TRUE;
+}
+
+/**
+ * @return the next grab, in list order, that may match the detail given
+ * to GrabIndexLookup(), or NULL.
+ */
+GrabPtr
+GrabIndexNext(GrabIndexIterPtr iter)
+{
+    if (iter->exact > iter->exactStart &&
+        (iter->any == iter->anyStart ||
+         iter->exact[-1].seq > iter->any[-1].seq))
+        return (--iter->exact)->grab;
+    if (iter->any > iter->anyStart)
+        return (--iter->any)->grab;
+    return NULL;
+}
+
 int
 DeletePassiveGrab(void *value, XID id)
 {
@@ -325,10 +550,13 @@ DeletePassiveGrab(void *value, XID id)
     prev = 0;
     for (g = (wPassiveGrabs(pGrab->window)); g; g = g->next) {
         if (pGrab == g) {
+            GrabIndexRemove(g);
             if (prev)
                 prev->next = g->next;
-            else if (!(pGrab->window->optional->passiveGrabs = g->next))
+            else if (!(pGrab->window->optional->passiveGrabs = g->next)) {
+                FreeGrabIndex(pGrab->window);
                 CheckWindowOptionalNeed(pGrab->window);
+            }
             break;
         }
         prev = g;
@@ -529,10 +757,16 @@ int
 AddPassiveGrabToList(ClientPtr client, GrabPtr pGrab)
 {
     GrabPtr grab;
+    GrabIndexIterRec iter;
+    Bool indexed;
     Mask access_mode = DixGrabAccess;
     int rc;
 
-    for (grab = wPassiveGrabs(pGrab->window); grab; grab = grab->next) {
+    /* a grab on a single key or button can only clash with the ones on
+     * the same key or button, or on AnyKey/AnyButton */
+    indexed = GrabIndexLookup(pGrab->window, pGrab->detail.exact, &iter);
+    grab = indexed ? GrabIndexNext(&iter) : wPassiveGrabs(pGrab->window);
+    for (; grab; grab = indexed ? GrabIndexNext(&iter) : grab->next) {
         if (GrabMatchesSecond(pGrab, grab, (pGrab->grabtype == CORE))) {
             if (CLIENT_BITS(pGrab->resource) != CLIENT_BITS(grab->resource)) {
                 FreeGrab(pGrab);
@@ -549,7 +783,9 @@ AddPassiveGrabToList(ClientPtr client, GrabPtr pGrab)
         return rc;
 
     /* Remove all grabs that match the new one exactly */
-    for (grab = wPassiveGrabs(pGrab->window); grab; grab = grab->next) {
+    indexed = GrabIndexLookup(pGrab->window, pGrab->detail.exact, &iter);
+    grab = indexed ? GrabIndexNext(&iter) : wPassiveGrabs(pGrab->window);
+    for (; grab; grab = indexed ? GrabIndexNext(&iter) : grab->next) {
         if (GrabsAreIdentical(pGrab, grab)) {
             DeletePassiveGrabFromList(grab);
             break;
@@ -561,8 +797,7 @@ AddPassiveGrabToList(ClientPtr client, GrabPtr pGrab)
         return BadAlloc;
     }
 
-    pGrab->next = pGrab->window->optional->passiveGrabs;
-    pGrab->window->optional->passiveGrabs = pGrab;
+    PrependPassiveGrab(pGrab);
     if (AddResource(pGrab->resource, RT_PASSIVEGRAB, (void *) pGrab))
         return Success;
     return BadAlloc;
@@ -684,11 +919,8 @@ DeletePassiveGrabFromList(GrabPtr pMinuendGrab)
     else {
         for (i = 0; i < ndels; i++)
             FreeResource(deletes[i]->resource, RT_NONE);
-        for (i = 0; i < nadds; i++) {
-            grab = adds[i];
-            grab->next = grab->window->optional->passiveGrabs;
-            grab->window->optional->passiveGrabs = grab;
-        }
+        for (i = 0; i < nadds; i++)
+            PrependPassiveGrab(adds[i]);
         for (i = 0; i < nups; i++) {
             free(*updates[i]);
             *updates[i] = details[i];
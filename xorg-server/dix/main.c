@@ -321,6 +321,7 @@ dix_main(int argc, char *argv[], char *envp[])
         #endif
 
         InputThreadInit();
+        ReadThreadInit();
 
         Dispatch();
 
@@ -348,6 +349,7 @@ dix_main(int argc, char *argv[], char *envp[])
         CloseInput();
 
         InputThreadFini();
+        ReadThreadFini();
 
         for (i = 0; i < screenInfo.numScreens; i++)
             screenInfo.screens[i]->root = NullWindow;
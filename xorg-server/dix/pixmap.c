@@ -43,6 +43,7 @@ from The Open Group.
 #include "X11/extensions/render.h"
 #include "picturestr.h"
 #include "randrstr.h"
+#include "slab.h"
 /*
  *  Scratch pixmap management and device independent pixmap allocation
  *  function.
@@ -102,7 +103,39 @@ CreateScratchPixmapsForScreen(ScreenPtr pScreen)
 void
 FreeScratchPixmapsForScreen(ScreenPtr pScreen)
 {
+    int i;
+
     FreeScratchPixmapHeader(pScreen->pScratchPixmap);
+
+    for (i = 0; i < ARRAY_SIZE(pScreen->pixmapSlabs); i++) {
+        SlabCacheDestroy(pScreen->pixmapSlabs[i]);
+        pScreen->pixmapSlabs[i] = NULL;
+    }
+}
+
+/*
+ * Pixmaps come from a slab cache for their size class: headers alone
+ * (class 0, the bits live elsewhere), then data up to 128, 256, ...
+ * 4096 bytes.  Anything bigger is left to malloc.
+ */
+static SlabCachePtr
+PixmapSlab(ScreenPtr pScreen, int pixDataSize)
+{
+    static const char *names[] = {
+        "PIXMAP", "PIXMAP 128", "PIXMAP 256", "PIXMAP 512",
+        "PIXMAP 1k", "PIXMAP 2k", "PIXMAP 4k"
+    };
+    int class = 0, classSize = 0;
+
+    while (classSize < pixDataSize) {
+        classSize = classSize ? classSize * 2 : 128;
+        if (++class == ARRAY_SIZE(pScreen->pixmapSlabs))
+            return NULL;
+    }
+    if (!pScreen->pixmapSlabs[class])
+        pScreen->pixmapSlabs[class] =
+            SlabCacheCreate(names[class], pScreen->totalPixmapSize + classSize);
+    return pScreen->pixmapSlabs[class];
 }
 
 /* callable by ddx */
@@ -116,7 +149,8 @@ AllocatePixmap(ScreenPtr pScreen, int pixDataSize)
     if (pScreen->totalPixmapSize > ((size_t) - 1) - pixDataSize)
         return NullPixmap;
 
-    pPixmap = malloc(pScreen->totalPixmapSize + pixDataSize);
+    pPixmap = SlabAlloc(PixmapSlab(pScreen, pixDataSize),
+                        pScreen->totalPixmapSize + pixDataSize);
     if (!pPixmap)
         return NullPixmap;
 
@@ -129,7 +163,7 @@ void
 FreePixmap(PixmapPtr pPixmap)
 {
     dixFiniPrivates(pPixmap, PRIVATE_PIXMAP);
-    free(pPixmap);
+    SlabFree(pPixmap);
 }
 
 void PixmapUnshareSlavePixmap(PixmapPtr slave_pixmap)
@@ -63,6 +63,7 @@ from The Open Group.
 #include "scrnintstr.h"
 #include "extnsionst.h"
 #include "inputstr.h"
+#include "slab.h"
 
 static DevPrivateSetRec global_keys[PRIVATE_LAST];
 
@@ -557,7 +558,10 @@ _dixFreeObjectWithPrivates(void *object, PrivatePtr privates,
                            DevPrivateType type)
 {
     _dixFiniPrivates(privates, type);
-    free(object);
+    if (screen_specific_private[type])
+        SlabFree(object);
+    else
+        free(object);
 }
 
 /*
@@ -671,6 +675,8 @@ dixFreeScreenSpecificPrivates(ScreenPtr pScreen)
         for (key = pScreen->screenSpecificPrivates[t].key; key; key = key->next) {
             key->initialized = FALSE;
         }
+        SlabCacheDestroy(pScreen->screenSpecificPrivates[t].slab);
+        pScreen->screenSpecificPrivates[t].slab = NULL;
     }
 }
 
@@ -720,6 +726,7 @@ _dixAllocateScreenObjectWithPrivates(ScreenPtr pScreen,
     PrivatePtr privates;
     PrivatePtr *devPrivates;
     int privates_size;
+    SlabCachePtr slab = NULL;
 
     assert(type > PRIVATE_SCREEN);
     assert(type < PRIVATE_LAST);
@@ -732,7 +739,17 @@ _dixAllocateScreenObjectWithPrivates(ScreenPtr pScreen,
     /* round up so that pointer is aligned */
     baseSize = (baseSize + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
     totalSize = baseSize + privates_size;
-    object = malloc(totalSize);
+
+    /* the size is fixed from the first object on, see
+     * dixRegisterScreenSpecificPrivateKey */
+    if (pScreen) {
+        DevPrivateSetPtr set = &pScreen->screenSpecificPrivates[type];
+
+        if (!set->slab)
+            set->slab = SlabCacheCreate(key_names[type], totalSize);
+        slab = set->slab;
+    }
+    object = SlabAlloc(slab, totalSize);
     if (!object)
         return NULL;
 
@@ -67,6 +67,197 @@ SOFTWARE.
  *
  *****************************************************************/
 
+/*
+ * Windows with more than PROPERTY_INDEX_MIN properties get a hash index
+ * by name on top of the list, an open-addressed table with linear
+ * probing.  Some windows (the root window, client leaders) carry hundreds
+ * of properties.  The list stays authoritative: the index is built from
+ * it, dropped when it cannot be grown and rebuilt on the next change.
+ *
+ * With security modules properties may be polyinstantiated, so several
+ * can share a name; a slot counts them and points at the first one in
+ * the list, which is what a list walk would have found.
+ */
+
+#define PROPERTY_INDEX_MIN 16
+
+typedef struct _PropertySlot {
+    ATOM name;                  /* None if unused */
+    int count;                  /* properties with this name */
+    PropertyPtr prop;           /* the first of them in userProps */
+} PropertySlotRec, *PropertySlotPtr;
+
+typedef struct _PropertyIndex {
+    int size;                   /* power of two */
+    int bits;                   /* log(2)(size) */
+    int used;
+    PropertySlotPtr slots;
+} PropertyIndexRec, *PropertyIndexPtr;
+
+static _X_INLINE unsigned int
+PropertyHash(ATOM name, int bits)
+{
+    return ((CARD32) name * 0x9e3779b1U) >> (32 - bits);
+}
+
+static PropertySlotPtr
+FindPropertySlot(PropertyIndexPtr index, ATOM name)
+{
+    unsigned int i, mask = index->size - 1;
+
+    for (i = PropertyHash(name, index->bits);; i = (i + 1) & mask) {
+        if (index->slots[i].name == name)
+            return &index->slots[i];
+        if (index->slots[i].name == None)
+            return NULL;
+    }
+}
+
+/*
+ * Add a property to the index; first says whether it is now in front of
+ * any others of the same name.
+ */
+static void
+IndexProperty(PropertyIndexPtr index, PropertyPtr pProp, Bool first)
+{
+    unsigned int i, mask = index->size - 1;
+    PropertySlotPtr slot;
+
+    for (i = PropertyHash(pProp->propertyName, index->bits);;
+         i = (i + 1) & mask) {
+        slot = &index->slots[i];
+        if (slot->name == pProp->propertyName) {
+            slot->count++;
+            if (first)
+                slot->prop = pProp;
+            return;
+        }
+        if (slot->name == None)
+            break;
+    }
+    slot->name = pProp->propertyName;
+    slot->count = 1;
+    slot->prop = pProp;
+    index->used++;
+}
+
+static void
+FreePropertyIndex(WindowPtr pWin)
+{
+    PropertyIndexPtr index = pWin->optional->propIndex;
+
+    if (index) {
+        free(index->slots);
+        free(index);
+        pWin->optional->propIndex = NULL;
+    }
+}
+
+static void
+BuildPropertyIndex(WindowPtr pWin, int count)
+{
+    PropertyIndexPtr index;
+    PropertyPtr pProp;
+    int size = 64;
+
+    FreePropertyIndex(pWin);
+
+    while (size < count * 2)
+        size <<= 1;
+    index = malloc(sizeof(PropertyIndexRec));
+    if (!index)
+        return;
+    index->slots = calloc(size, sizeof(PropertySlotRec));
+    if (!index->slots) {
+        free(index);
+        return;
+    }
+    index->size = size;
+    for (index->bits = 0; (1 << index->bits) < size; index->bits++);
+    index->used = 0;
+
+    for (pProp = pWin->optional->userProps; pProp; pProp = pProp->next)
+        IndexProperty(index, pProp, FALSE);
+    pWin->optional->propIndex = index;
+}
+
+/*
+ * Account for a property just put at the head of the window's list.
+ */
+static void
+PropertyAdded(WindowPtr pWin, PropertyPtr pProp)
+{
+    PropertyIndexPtr index = pWin->optional->propIndex;
+    int count = 0;
+
+    if (index && (index->used + 1) * 4 <= index->size * 3) {
+        IndexProperty(index, pProp, TRUE);
+        return;
+    }
+    for (pProp = pWin->optional->userProps; pProp; pProp = pProp->next)
+        if (++count > PROPERTY_INDEX_MIN && !index)
+            break;
+    if (count > PROPERTY_INDEX_MIN)
+        BuildPropertyIndex(pWin, count);
+}
+
+/*
+ * Unlink a property from the window's list and index.  Its next pointer
+ * is left alone.
+ */
+static void
+RemoveProperty(WindowPtr pWin, PropertyPtr pProp)
+{
+    PropertyIndexPtr index = pWin->optional->propIndex;
+    PropertySlotPtr slot, next;
+    PropertyPtr prevProp;
+    unsigned int i, j, home, mask;
+
+    if (pWin->optional->userProps == pProp)
+        pWin->optional->userProps = pProp->next;
+    else {
+        /* Need to traverse to find the previous element */
+        prevProp = pWin->optional->userProps;
+        while (prevProp->next != pProp)
+            prevProp = prevProp->next;
+        prevProp->next = pProp->next;
+    }
+
+    if (!pWin->optional->userProps) {
+        FreePropertyIndex(pWin);
+        return;
+    }
+    if (!index)
+        return;
+
+    slot = FindPropertySlot(index, pProp->propertyName);
+    if (--slot->count) {
+        if (slot->prop == pProp) {
+            for (prevProp = pProp->next;
+                 prevProp->propertyName != pProp->propertyName;
+                 prevProp = prevProp->next);
+            slot->prop = prevProp;
+        }
+        return;
+    }
+
+    /* shift later slots of the probe chain back over the hole */
+    mask = index->size - 1;
+    i = slot - index->slots;
+    for (j = (i + 1) & mask; index->slots[j].name != None;
+         j = (j + 1) & mask) {
+        next = &index->slots[j];
+        home = PropertyHash(next->name, index->bits);
+        if (i <= j ? (i < home && home <= j) : (i < home || home <= j))
+            continue;
+        index->slots[i] = *next;
+        i = j;
+    }
+    index->slots[i].name = None;
+    index->slots[i].prop = NULL;
+    index->used--;
+}
+
 #ifdef notdef
 static void
 PrintPropertys(WindowPtr pWin)
@@ -95,9 +286,17 @@ dixLookupProperty(PropertyPtr *result, WindowPtr pWin, Atom propertyName,
 
     client->errorValue = propertyName;
 
-    for (pProp = wUserProps(pWin); pProp; pProp = pProp->next)
-        if (pProp->propertyName == propertyName)
-            break;
+    if (pWin->optional && pWin->optional->propIndex) {
+        PropertySlotPtr slot = FindPropertySlot(pWin->optional->propIndex,
+                                                propertyName);
+
+        pProp = slot ? slot->prop : NULL;
+    }
+    else {
+        for (pProp = wUserProps(pWin); pProp; pProp = pProp->next)
+            if (pProp->propertyName == propertyName)
+                break;
+    }
 
     if (pProp)
         rc = XaceHookPropertyAccess(client, pWin, &pProp, access_mode);
@@ -129,14 +328,49 @@ deliverPropertyNotifyEvent(WindowPtr pWin, int state, PropertyPtr pProp)
     DeliverEvents(pWin, &event, 1, (WindowPtr) NULL);
 }
 
+static int
+CompareAtoms(const void *a, const void *b)
+{
+    Atom x = *(const Atom *) a, y = *(const Atom *) b;
+
+    return x < y ? -1 : x > y;
+}
+
+/*
+ * Return the index of the first atom that appears again later in the
+ * list, or n if there is none.  sorted is scratch space for n atoms.
+ */
+static int
+FirstDuplicateAtom(const Atom *atoms, int n, Atom *sorted)
+{
+    Atom *found;
+    int i;
+
+    memcpy(sorted, atoms, n * sizeof(Atom));
+    qsort(sorted, n, sizeof(Atom), CompareAtoms);
+    for (i = 1; i < n; i++)
+        if (sorted[i] == sorted[i - 1])
+            break;
+    if (i == n)
+        return n;
+
+    for (i = 0; i < n; i++) {
+        found = bsearch(&atoms[i], sorted, n, sizeof(Atom), CompareAtoms);
+        if ((found > sorted && found[-1] == atoms[i]) ||
+            (found < sorted + n - 1 && found[1] == atoms[i]))
+            break;
+    }
+    return i;
+}
+
 int
 ProcRotateProperties(ClientPtr client)
 {
-    int i, j, delta, rc;
+    int i, j, delta, rc, dup;
 
     REQUEST(xRotatePropertiesReq);
     WindowPtr pWin;
-    Atom *atoms;
+    Atom *atoms, *sorted;
     PropertyPtr *props;         /* array of pointer */
     PropertyPtr pProp, saved;
 
@@ -149,10 +383,12 @@ ProcRotateProperties(ClientPtr client)
     atoms = (Atom *) &stuff[1];
     props = xallocarray(stuff->nAtoms, sizeof(PropertyPtr));
     saved = xallocarray(stuff->nAtoms, sizeof(PropertyRec));
-    if (!props || !saved) {
+    sorted = xallocarray(stuff->nAtoms, sizeof(Atom));
+    if (!props || !saved || !sorted) {
         rc = BadAlloc;
         goto out;
     }
+    dup = FirstDuplicateAtom(atoms, stuff->nAtoms, sorted);
 
     for (i = 0; i < stuff->nAtoms; i++) {
         if (!ValidAtom(atoms[i])) {
@@ -160,11 +396,10 @@ ProcRotateProperties(ClientPtr client)
             client->errorValue = atoms[i];
             goto out;
         }
-        for (j = i + 1; j < stuff->nAtoms; j++)
-            if (atoms[j] == atoms[i]) {
-                rc = BadMatch;
-                goto out;
-            }
+        if (i == dup) {
+            rc = BadMatch;
+            goto out;
+        }
 
         rc = dixLookupProperty(&pProp, pWin, atoms[i], client,
                                DixReadAccess | DixWriteAccess);
@@ -194,6 +429,7 @@ ProcRotateProperties(ClientPtr client)
         }
     }
  out:
+    free(sorted);
     free(saved);
     free(props);
     return rc;
@@ -295,6 +531,7 @@ dixChangeWindowProperty(ClientPtr pClient, WindowPtr pWin, Atom property,
         }
         pProp->next = pWin->optional->userProps;
         pWin->optional->userProps = pProp;
+        PropertyAdded(pWin, pProp);
     }
     else if (rc == Success) {
         /* To append or prepend to a property the request format and type
@@ -368,7 +605,7 @@ dixChangeWindowProperty(ClientPtr pClient, WindowPtr pWin, Atom property,
 int
 DeleteProperty(ClientPtr client, WindowPtr pWin, Atom propName)
 {
-    PropertyPtr pProp, prevProp;
+    PropertyPtr pProp;
     int rc;
 
     rc = dixLookupProperty(&pProp, pWin, propName, client, DixDestroyAccess);
@@ -376,18 +613,9 @@ DeleteProperty(ClientPtr client, WindowPtr pWin, Atom propName)
         return Success;         /* Succeed if property does not exist */
 
     if (rc == Success) {
-        if (pWin->optional->userProps == pProp) {
-            /* Takes care of head */
-            if (!(pWin->optional->userProps = pProp->next))
-                CheckWindowOptionalNeed(pWin);
-        }
-        else {
-            /* Need to traverse to find the previous element */
-            prevProp = pWin->optional->userProps;
-            while (prevProp->next != pProp)
-                prevProp = prevProp->next;
-            prevProp->next = pProp->next;
-        }
+        RemoveProperty(pWin, pProp);
+        if (!pWin->optional->userProps)
+            CheckWindowOptionalNeed(pWin);
 
         deliverPropertyNotifyEvent(pWin, PropertyDelete, pProp);
         free(pProp->data);
@@ -401,6 +629,9 @@ DeleteAllWindowProperties(WindowPtr pWin)
 {
     PropertyPtr pProp, pNextProp;
 
+    if (pWin->optional)
+        FreePropertyIndex(pWin);
+
     pProp = wUserProps(pWin);
     while (pProp) {
         deliverPropertyNotifyEvent(pWin, PropertyDelete, pProp);
@@ -442,7 +673,7 @@ NullPropertyReply(ClientPtr client, ATOM propertyType, int format)
 int
 ProcGetProperty(ClientPtr client)
 {
-    PropertyPtr pProp, prevProp;
+    PropertyPtr pProp;
     unsigned long n, len, ind;
     int rc;
     WindowPtr pWin;
@@ -543,18 +774,9 @@ ProcGetProperty(ClientPtr client)
 
     if (stuff->delete && (reply.bytesAfter == 0)) {
         /* Delete the Property */
-        if (pWin->optional->userProps == pProp) {
-            /* Takes care of head */
-            if (!(pWin->optional->userProps = pProp->next))
-                CheckWindowOptionalNeed(pWin);
-        }
-        else {
-            /* Need to traverse to find the previous element */
-            prevProp = pWin->optional->userProps;
-            while (prevProp->next != pProp)
-                prevProp = prevProp->next;
-            prevProp->next = pProp->next;
-        }
+        RemoveProperty(pWin, pProp);
+        if (!pWin->optional->userProps)
+            CheckWindowOptionalNeed(pWin);
 
         free(pProp->data);
         dixFreeObjectWithPrivates(pProp, PRIVATE_PROPERTY);
@@ -289,6 +289,41 @@ RegionPrint(RegionPtr rgn)
     ErrorF("[mi] \n");
 }
 
+#ifdef REGION_TRACE
+/* Appends the operation to the file named by $XORG_REGION_TRACE, one line
+ * per call: the operation, then each region as its rectangle count and
+ * rectangles.  test/bench/region-ops replays these. */
+void
+RegionTrace(char op, RegionPtr reg1, RegionPtr reg2)
+{
+    static FILE *trace;
+    static Bool tried;
+    RegionPtr regs[2] = { reg1, reg2 };
+    int i, j;
+
+    if (!tried) {
+        const char *name = getenv("XORG_REGION_TRACE");
+
+        tried = TRUE;
+        if (name)
+            trace = fopen(name, "w");
+    }
+    if (!trace || RegionNar(reg1) || (reg2 && RegionNar(reg2)))
+        return;
+
+    fputc(op, trace);
+    for (i = 0; i < 2 && regs[i]; i++) {
+        BoxPtr rects = RegionRects(regs[i]);
+
+        fprintf(trace, " %d", RegionNumRects(regs[i]));
+        for (j = 0; j < RegionNumRects(regs[i]); j++)
+            fprintf(trace, " %d %d %d %d", rects[j].x1, rects[j].y1,
+                    rects[j].x2, rects[j].y2);
+    }
+    fputc('\n', trace);
+}
+#endif
+
 #ifdef DEBUG
 Bool
 RegionIsValid(RegionPtr reg)
@@ -1041,6 +1076,350 @@ RegionAppend(RegionPtr dstrgn, RegionPtr rgn)
     return TRUE;
 }
 
+/*======================================================================
+ *	    Region/Box Operations
+ *====================================================================*/
+
+/*
+ * Nearly every region the server combines is a single box or a handful
+ * of them: window and GC clips, exposures, damage from one request.
+ * RegionOp sets up and tears down its band machinery for those just as
+ * for a region of thousands, so combining a small region with a box is
+ * done here instead, band by band into a buffer on the stack.  Each band
+ * of the region is split where the box starts and stops; the part
+ * between is combined with the box's span, the rest left alone, and for
+ * a union the box fills the gaps between bands.  The result comes out
+ * y-x banded and coalesced, exactly as RegionOp would leave it.
+ */
+
+#define SMALL_RECTS 16
+
+typedef enum {
+    BoxIntersect,
+    BoxUnion,
+    BoxSubtract
+} BoxOp;
+
+typedef struct {
+    BoxOp op;
+    BoxRec box;
+    BoxRec rects[5 * SMALL_RECTS + 1];  /* 3 per band, 1 more per band and gap */
+    int numRects;
+    int prevBand;
+} BoxOpRec, *BoxOpPtr;
+
+_X_INLINE static void
+BoxOpAdd(BoxOpPtr b, int x1, int x2, int y1, int y2)
+{
+    BoxPtr r = &b->rects[b->numRects++];
+
+    r->x1 = x1;
+    r->y1 = y1;
+    r->x2 = x2;
+    r->y2 = y2;
+}
+
+/* Combines the spans r..rEnd from y1 to y2 with the box, or copies them if
+ * !inBox, and appends the result as a band. */
+_X_INLINE static void
+BoxOpBand(BoxOpPtr b, BoxPtr r, BoxPtr rEnd, int y1, int y2, Bool inBox)
+{
+    int curBand = b->numRects;
+    int bx1 = b->box.x1, bx2 = b->box.x2;
+
+    if (y1 >= y2)
+        return;
+
+    if (!inBox) {
+        if (b->op == BoxIntersect)
+            return;
+        for (; r != rEnd; r++)
+            BoxOpAdd(b, r->x1, r->x2, y1, y2);
+    }
+    else if (b->op == BoxIntersect) {
+        for (; r != rEnd; r++) {
+            int x1 = max(r->x1, bx1), x2 = min(r->x2, bx2);
+
+            if (x1 < x2)
+                BoxOpAdd(b, x1, x2, y1, y2);
+        }
+    }
+    else if (b->op == BoxSubtract) {
+        for (; r != rEnd; r++) {
+            if (r->x2 <= bx1 || r->x1 >= bx2)
+                BoxOpAdd(b, r->x1, r->x2, y1, y2);
+            else {
+                if (r->x1 < bx1)
+                    BoxOpAdd(b, r->x1, bx1, y1, y2);
+                if (r->x2 > bx2)
+                    BoxOpAdd(b, bx2, r->x2, y1, y2);
+            }
+        }
+    }
+    else {
+        /* spans that touch the box merge with it */
+        Bool placed = FALSE;
+
+        for (; r != rEnd; r++) {
+            if (r->x2 < bx1)
+                BoxOpAdd(b, r->x1, r->x2, y1, y2);
+            else if (r->x1 > bx2) {
+                if (!placed)
+                    BoxOpAdd(b, bx1, bx2, y1, y2);
+                placed = TRUE;
+                BoxOpAdd(b, r->x1, r->x2, y1, y2);
+            }
+            else {
+                bx1 = min(bx1, r->x1);
+                bx2 = max(bx2, r->x2);
+            }
+        }
+        if (!placed)
+            BoxOpAdd(b, bx1, bx2, y1, y2);
+    }
+
+    if (b->numRects == curBand)
+        return;
+
+    /* merge with the band above if it touches and has the same spans */
+    if (b->prevBand >= 0 && curBand - b->prevBand == b->numRects - curBand &&
+        b->rects[b->prevBand].y2 == y1) {
+        BoxPtr prev = &b->rects[b->prevBand], cur = &b->rects[curBand];
+        int i, n = curBand - b->prevBand;
+
+        for (i = 0; i < n; i++)
+            if (prev[i].x1 != cur[i].x1 || prev[i].x2 != cur[i].x2)
+                break;
+        if (i == n) {
+            for (i = 0; i < n; i++)
+                prev[i].y2 = y2;
+            b->numRects = curBand;
+            return;
+        }
+    }
+    b->prevBand = curBand;
+}
+
+/* Sets pReg to the rectangles rects..rects+numRects, which are valid
+ * y-x banded.  The rectangles must not be pReg's own. */
+static Bool
+RegionSetBoxes(RegionPtr pReg, BoxPtr rects, int numRects)
+{
+    int i;
+
+    if (!numRects) {
+        xfreeData(pReg);
+        pReg->extents.x2 = pReg->extents.x1;
+        pReg->extents.y2 = pReg->extents.y1;
+        pReg->data = &RegionEmptyData;
+        return TRUE;
+    }
+    if (numRects == 1) {
+        xfreeData(pReg);
+        pReg->extents = rects[0];
+        pReg->data = NULL;
+        return TRUE;
+    }
+
+    if (!pReg->data || pReg->data->size < numRects) {
+        size_t rgnSize = RegionSizeof(numRects);
+
+        xfreeData(pReg);
+        pReg->data = (rgnSize > 0) ? malloc(rgnSize) : NULL;
+        if (!pReg->data)
+            return RegionBreak(pReg);
+        pReg->data->size = numRects;
+    }
+    pReg->data->numRects = numRects;
+    memcpy(RegionBoxptr(pReg), rects, numRects * sizeof(BoxRec));
+
+    pReg->extents.x1 = rects[0].x1;
+    pReg->extents.y1 = rects[0].y1;
+    pReg->extents.x2 = rects[0].x2;
+    pReg->extents.y2 = rects[numRects - 1].y2;
+    for (i = 1; i < numRects; i++) {
+        if (rects[i].x1 < pReg->extents.x1)
+            pReg->extents.x1 = rects[i].x1;
+        if (rects[i].x2 > pReg->extents.x2)
+            pReg->extents.x2 = rects[i].x2;
+    }
+    good(pReg);
+    return TRUE;
+}
+
+/* newReg = reg op box, for any reg, box non-empty.  Returns -1 if reg has
+ * too many rectangles to be done here. */
+static int
+RegionOpBox(RegionPtr newReg, RegionPtr reg, BoxPtr box, BoxOp op)
+{
+    BoxOpRec b;
+    BoxPtr r, rEnd, bandEnd;
+    int gapTop;
+
+    if (reg->data && reg->data->numRects > SMALL_RECTS)
+        return -1;
+
+    b.op = op;
+    b.box = *box;
+    b.numRects = 0;
+    b.prevBand = -1;
+
+    r = RegionRects(reg);
+    rEnd = r + RegionNumRects(reg);
+
+    /* bands wholly above the box come through as they are */
+    bandEnd = r;
+    while (bandEnd != rEnd && bandEnd->y2 <= box->y1)
+        bandEnd++;
+    if (op != BoxIntersect && bandEnd != r) {
+        b.numRects = bandEnd - r;
+        memcpy(b.rects, r, b.numRects * sizeof(BoxRec));
+        b.prevBand = b.numRects - 1;
+        while (b.prevBand && b.rects[b.prevBand - 1].y1 == bandEnd[-1].y1)
+            b.prevBand--;
+    }
+    r = bandEnd;
+
+    gapTop = box->y1;
+    for (; r != rEnd && r->y1 < box->y2; r = bandEnd) {
+        int y1 = r->y1, y2 = r->y2;
+
+        bandEnd = r + 1;
+        while (bandEnd != rEnd && bandEnd->y1 == y1)
+            bandEnd++;
+
+        if (op == BoxUnion)
+            BoxOpBand(&b, NULL, NULL, max(gapTop, box->y1), y1, TRUE);
+        BoxOpBand(&b, r, bandEnd, y1, box->y1, FALSE);
+        BoxOpBand(&b, r, bandEnd, max(y1, box->y1), min(y2, box->y2), TRUE);
+        BoxOpBand(&b, r, bandEnd, box->y2, y2, FALSE);
+        gapTop = y2;
+    }
+    if (op == BoxUnion)
+        BoxOpBand(&b, NULL, NULL, max(gapTop, box->y1), box->y2, TRUE);
+
+    /* and so do those wholly below, once the first has been given the
+     * chance to coalesce */
+    if (op != BoxIntersect && r != rEnd) {
+        bandEnd = r + 1;
+        while (bandEnd != rEnd && bandEnd->y1 == r->y1)
+            bandEnd++;
+        BoxOpBand(&b, r, bandEnd, r->y1, r->y2, FALSE);
+        memcpy(&b.rects[b.numRects], bandEnd, (rEnd - bandEnd) * sizeof(BoxRec));
+        b.numRects += rEnd - bandEnd;
+    }
+
+    return RegionSetBoxes(newReg, b.rects, b.numRects);
+}
+
+#define BOXEMPTY(b) ((b)->x1 >= (b)->x2 || (b)->y1 >= (b)->y2)
+
+/*-
+ *-----------------------------------------------------------------------
+ * RegionIntersectBox, RegionUnionBox, RegionSubtractBox --
+ *	newReg = reg op box.  The box may be the extents of newReg or of
+ *	reg.  The trivial cases are settled from the extents alone, small
+ *	regions go through RegionOpBox and large ones to pixman.
+ *
+ * Results:
+ *	TRUE if successful.
+ *
+ * Side Effects:
+ *	newReg is overwritten.
+ *
+ *-----------------------------------------------------------------------
+ */
+Bool
+RegionIntersectBox(RegionPtr newReg, RegionPtr reg, BoxPtr pBox)
+{
+    BoxRec box = *pBox;
+    RegionRec boxReg;
+    int ret;
+
+    if (RegionNar(reg))
+        return RegionBreak(newReg);
+    if (RegionNil(reg) || BOXEMPTY(&box) || !EXTENTCHECK(&reg->extents, &box)) {
+        RegionEmpty(newReg);
+        return TRUE;
+    }
+    if (SUBSUMES(&box, &reg->extents))
+        return RegionCopy(newReg, reg);
+    if (!reg->data) {
+        box.x1 = max(box.x1, reg->extents.x1);
+        box.y1 = max(box.y1, reg->extents.y1);
+        box.x2 = min(box.x2, reg->extents.x2);
+        box.y2 = min(box.y2, reg->extents.y2);
+        RegionReset(newReg, &box);
+        return TRUE;
+    }
+
+    if ((ret = RegionOpBox(newReg, reg, &box, BoxIntersect)) >= 0)
+        return ret;
+    RegionInit(&boxReg, &box, 1);
+    return pixman_region_intersect(newReg, reg, &boxReg);
+}
+
+Bool
+RegionUnionBox(RegionPtr newReg, RegionPtr reg, BoxPtr pBox)
+{
+    BoxRec box = *pBox;
+    RegionRec boxReg;
+    int ret;
+
+    if (RegionNar(reg))
+        return RegionBreak(newReg);
+    if (BOXEMPTY(&box))
+        return RegionCopy(newReg, reg);
+    if (RegionNil(reg) || SUBSUMES(&box, &reg->extents)) {
+        RegionReset(newReg, &box);
+        return TRUE;
+    }
+    if (!reg->data && SUBSUMES(&reg->extents, &box))
+        return RegionCopy(newReg, reg);
+    if (!reg->data) {
+        BoxPtr r = &reg->extents;
+
+        /* side by side on the same rows, or stacked in the same columns,
+         * and touching: one box */
+        if ((r->y1 == box.y1 && r->y2 == box.y2 &&
+             r->x1 <= box.x2 && box.x1 <= r->x2) ||
+            (r->x1 == box.x1 && r->x2 == box.x2 &&
+             r->y1 <= box.y2 && box.y1 <= r->y2)) {
+            box.x1 = min(box.x1, r->x1);
+            box.y1 = min(box.y1, r->y1);
+            box.x2 = max(box.x2, r->x2);
+            box.y2 = max(box.y2, r->y2);
+            RegionReset(newReg, &box);
+            return TRUE;
+        }
+    }
+
+    if ((ret = RegionOpBox(newReg, reg, &box, BoxUnion)) >= 0)
+        return ret;
+    RegionInit(&boxReg, &box, 1);
+    return pixman_region_union(newReg, reg, &boxReg);
+}
+
+Bool
+RegionSubtractBox(RegionPtr newReg, RegionPtr reg, BoxPtr pBox)
+{
+    BoxRec box = *pBox;
+    RegionRec boxReg;
+    int ret;
+
+    if (RegionNil(reg) || BOXEMPTY(&box) || !EXTENTCHECK(&reg->extents, &box))
+        return RegionCopy(newReg, reg);
+    if (SUBSUMES(&box, &reg->extents)) {
+        RegionEmpty(newReg);
+        return TRUE;
+    }
+
+    if ((ret = RegionOpBox(newReg, reg, &box, BoxSubtract)) >= 0)
+        return ret;
+    RegionInit(&boxReg, &box, 1);
+    return pixman_region_subtract(newReg, reg, &boxReg);
+}
+
 #define ExchangeRects(a, b) \
 {			    \
     BoxRec     t;	    \
@@ -1156,6 +1535,7 @@ RegionValidate(RegionPtr badreg, Bool *pOverlap)
     RegionPtr hreg;             /* ri[j_half].reg                        */
     Bool ret = TRUE;
 
+    RegionTrace('V', badreg, NULL);
     *pOverlap = FALSE;
     if (!badreg->data) {
         good(badreg);
@@ -1180,6 +1560,26 @@ RegionValidate(RegionPtr badreg, Bool *pOverlap)
         return TRUE;
     }
 
+    /* One or two rectangles need no sorting and scattering */
+    if (numRects <= 2) {
+        BoxRec boxes[2];
+        RegionRec first;
+
+        memcpy(boxes, RegionBoxptr(badreg), numRects * sizeof(BoxRec));
+        if (numRects == 2 && !BOXEMPTY(&boxes[0]) && !BOXEMPTY(&boxes[1])) {
+            *pOverlap = EXTENTCHECK(&boxes[0], &boxes[1]);
+            RegionInit(&first, &boxes[0], 1);
+            return RegionUnionBox(badreg, &first, &boxes[1]);
+        }
+        if (numRects == 1) {
+            if (BOXEMPTY(&boxes[0]))
+                RegionEmpty(badreg);
+            else
+                RegionReset(badreg, &boxes[0]);
+            return TRUE;
+        }
+    }
+
     /* Step 1: Sort the rects array into ascending (y1, x1) order */
     QuickSortRects(RegionBoxptr(badreg), numRects);
 
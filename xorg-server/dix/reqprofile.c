@@ -0,0 +1,163 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Request profiling (-reqprofile).  Each profile has one row of entries
+ * per major opcode, allocated the first time that opcode is seen: a
+ * single entry for core requests, one per minor opcode for extensions.
+ * Everything happens on the dispatch thread, so nothing is locked.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <stdlib.h>
+#include <X11/X.h>
+#include "misc.h"
+#include "dixstruct.h"
+#include "reqprofile.h"
+
+#define REQ_PROFILE_MAJORS 256
+#define REQ_PROFILE_MINORS 256
+
+typedef struct _RequestProfile {
+    RequestProfileEntryPtr majors[REQ_PROFILE_MAJORS];
+} RequestProfileRec;
+
+Bool RequestProfiling = FALSE;
+
+static RequestProfilePtr serverProfile;
+
+static int
+MinorsForMajor(int major)
+{
+    return major < EXTENSION_BASE ? 1 : REQ_PROFILE_MINORS;
+}
+
+static int
+HistogramBucket(CARD64 time)
+{
+    int bucket = 0;
+
+    while (time && bucket < REQ_PROFILE_BUCKETS - 1) {
+        time >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+static RequestProfileEntryPtr
+ProfileEntry(RequestProfilePtr *pProfile, int major, int minor)
+{
+    RequestProfilePtr profile = *pProfile;
+    RequestProfileEntryPtr row;
+
+    if (!profile) {
+        profile = *pProfile = calloc(1, sizeof(RequestProfileRec));
+        if (!profile)
+            return NULL;
+    }
+    row = profile->majors[major];
+    if (!row) {
+        row = profile->majors[major] =
+            calloc(MinorsForMajor(major), sizeof(RequestProfileEntryRec));
+        if (!row)
+            return NULL;
+    }
+    return major < EXTENSION_BASE ? row : &row[minor];
+}
+
+static void
+AddToEntry(RequestProfileEntryPtr entry, int bytes, CARD64 time,
+           int bucket)
+{
+    entry->count++;
+    entry->bytes += bytes;
+    entry->time += time;
+    entry->hist[bucket]++;
+}
+
+void
+RequestProfileRecord(ClientPtr client, int major, int minor, int bytes,
+                     CARD64 time)
+{
+    RequestProfileEntryPtr entry;
+    int bucket = HistogramBucket(time);
+
+    entry = ProfileEntry(&serverProfile, major, minor);
+    if (entry)
+        AddToEntry(entry, bytes, time, bucket);
+    entry = ProfileEntry(&client->req_profile, major, minor);
+    if (entry)
+        AddToEntry(entry, bytes, time, bucket);
+}
+
+int
+RequestProfileForEach(ClientPtr client, RequestProfileProcPtr func,
+                      void *closure)
+{
+    RequestProfilePtr profile = client ? client->req_profile : serverProfile;
+    int major, minor, seen = 0;
+
+    if (!profile)
+        return 0;
+
+    for (major = 0; major < REQ_PROFILE_MAJORS; major++) {
+        RequestProfileEntryPtr row = profile->majors[major];
+
+        if (!row)
+            continue;
+        for (minor = 0; minor < MinorsForMajor(major); minor++) {
+            if (!row[minor].count)
+                continue;
+            if (func)
+                (*func) (major, minor, &row[minor], closure);
+            seen++;
+        }
+    }
+    return seen;
+}
+
+static void
+FreeProfile(RequestProfilePtr profile)
+{
+    int major;
+
+    if (!profile)
+        return;
+    for (major = 0; major < REQ_PROFILE_MAJORS; major++)
+        free(profile->majors[major]);
+    free(profile);
+}
+
+void
+RequestProfileReset(ClientPtr client)
+{
+    if (client) {
+        FreeProfile(client->req_profile);
+        client->req_profile = NULL;
+    }
+    else {
+        FreeProfile(serverProfile);
+        serverProfile = NULL;
+    }
+}
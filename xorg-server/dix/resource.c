@@ -149,27 +149,62 @@ Equipment Corporation.
 #define TypeNameString(t) LookupResourceName(t)
 #endif
 
-static void RebuildTable(int    /*client */
-    );
-
 #define SERVER_MINID 32
 
 #define INITBUCKETS 64
 #define INITHASHSIZE 6
-#define MAXHASHSIZE 16
+
+/*
+ * Each client's resources live in one array, and a hash table of buckets
+ * chains them by ID through their next fields; free entries are chained
+ * from freeList the same way.  Entries never move, so freeing a resource
+ * never disturbs any other, even from inside a delete function.  Once
+ * there are as many resources as buckets, the buckets double and the
+ * chains are rebuilt from the array.  HashResourceID keeps runs of
+ * consecutive IDs in consecutive buckets, and clients mostly create
+ * resources in ID order, so adding and rebuilding mostly walk both
+ * arrays in order.
+ *
+ * Resources sharing an ID are chained in no particular order.  Each one
+ * takes the next serial of its client when added, and lookups pick the
+ * newest match, which is the order FreeResource frees them in; some ddx
+ * layers depend on that.
+ */
 
 typedef struct _Resource {
-    struct _Resource *next;
     XID id;
-    RESTYPE type;
+    RESTYPE type;               /* RT_NONE when free */
     void *value;
+    int next;                   /* in the bucket or free list, or -1 */
+    CARD32 serial;
+    int typeIndex;              /* position in the type's list, if any */
 } ResourceRec, *ResourcePtr;
 
+/*
+ * Walks over one type go through a list of the resources of that type,
+ * so they only cost as much as there are resources of the type.  A
+ * type's list is made the first time the type is walked and kept up to
+ * date from then on; freeing a resource moves the last entry of its list
+ * into the hole.  Types nobody walks never get one.
+ */
+typedef struct _ResourceList {
+    int *entries;               /* NULL until the type is walked */
+    int count;
+    int size;
+} ResourceListRec, *ResourceListPtr;
+
 typedef struct _ClientResource {
-    ResourcePtr *resources;
+    ResourcePtr resources;
+    int size;                   /* entries allocated */
+    int used;                   /* entries ever taken */
+    int freeList;
+    int *heads;                 /* first entry of each bucket, or -1 */
     int elements;
     int buckets;
     int hashsize;               /* log(2)(buckets) */
+    CARD32 serial;              /* for the next resource added */
+    ResourceListPtr byType;     /* indexed by type & TypeMask */
+    int numTypes;
     XID fakeID;
     XID endFakeID;
 } ClientResourceRec;
@@ -628,6 +663,263 @@ ResourceClientBits(void)
     return cached;
 }
 
+/*
+ * Chain every resource into 1 << hashsize buckets.  Entries are pushed in
+ * array order, so it doesn't matter that same-ID ones come out in any
+ * order.
+ */
+static Bool
+RebuildTable(ClientResourceRec *rrec, int hashsize)
+{
+    int *heads, i, j;
+    ResourcePtr res;
+
+    heads = xallocarray(1 << hashsize, sizeof(int));
+    if (!heads)
+        return FALSE;
+    memset(heads, 0xff, (1 << hashsize) * sizeof(int));
+    for (i = 0; i < rrec->used; i++) {
+        res = &rrec->resources[i];
+        if (res->type == RT_NONE)
+            continue;
+        j = HashResourceID(res->id, hashsize);
+        res->next = heads[j];
+        heads[j] = i;
+    }
+    free(rrec->heads);
+    rrec->heads = heads;
+    rrec->buckets = 1 << hashsize;
+    rrec->hashsize = hashsize;
+    return TRUE;
+}
+
+/*
+ * Find the newest resource with this ID that is either of the given type
+ * or in one of the given classes.
+ */
+static ResourcePtr
+FindResource(ClientResourceRec *rrec, XID id, RESTYPE type, RESTYPE rclass)
+{
+    ResourcePtr res, found = NULL;
+    int i;
+
+    for (i = rrec->heads[HashResourceID(id, rrec->hashsize)]; i >= 0;
+         i = res->next) {
+        res = &rrec->resources[i];
+        if (res->id == id && (res->type == type || (res->type & rclass)) &&
+            (!found || (int) (res->serial - found->serial) > 0))
+            found = res;
+    }
+    return found;
+}
+
+/*
+ * Take a free entry, growing the array when there is none.  Returns -1
+ * if that fails.
+ */
+static int
+AllocResource(ClientResourceRec *rrec)
+{
+    ResourcePtr resources;
+    int i, size;
+
+    if ((i = rrec->freeList) >= 0) {
+        rrec->freeList = rrec->resources[i].next;
+        return i;
+    }
+    if (rrec->used == rrec->size) {
+        size = rrec->size ? rrec->size * 2 : INITBUCKETS;
+        resources = reallocarray(rrec->resources, size, sizeof(ResourceRec));
+        if (!resources)
+            return -1;
+        rrec->resources = resources;
+        rrec->size = size;
+    }
+    return rrec->used++;
+}
+
+static ResourceListPtr
+TypeList(ClientResourceRec *rrec, RESTYPE type)
+{
+    int index = type & TypeMask;
+
+    if (index >= rrec->numTypes || !rrec->byType[index].entries)
+        return NULL;
+    return &rrec->byType[index];
+}
+
+/*
+ * Make sure the list for this type, if it has one yet, has room for one
+ * more resource.
+ */
+static Bool
+ReserveTypeList(ClientResourceRec *rrec, RESTYPE type)
+{
+    ResourceListPtr list = TypeList(rrec, type);
+    int *entries;
+
+    if (list && list->count == list->size) {
+        entries = reallocarray(list->entries, list->size * 2, sizeof(int));
+        if (!entries)
+            return FALSE;
+        list->entries = entries;
+        list->size *= 2;
+    }
+    return TRUE;
+}
+
+/*
+ * Return the list for this type, making it from the resource array the
+ * first time.  Returns NULL if that fails; walks then go through the
+ * whole array instead.
+ */
+static ResourceListPtr
+ListType(ClientResourceRec *rrec, RESTYPE type)
+{
+    int index = type & TypeMask;
+    ResourceListPtr list;
+    int i, count, size;
+
+    if ((list = TypeList(rrec, type)))
+        return list;
+    if (index >= rrec->numTypes) {
+        int num = lastResourceType + 1;
+
+        if (num <= index)
+            num = index + 1;
+        list = reallocarray(rrec->byType, num, sizeof(ResourceListRec));
+        if (!list)
+            return NULL;
+        memset(list + rrec->numTypes, 0,
+               (num - rrec->numTypes) * sizeof(ResourceListRec));
+        rrec->byType = list;
+        rrec->numTypes = num;
+    }
+    list = &rrec->byType[index];
+
+    count = 0;
+    for (i = 0; i < rrec->used; i++)
+        if ((rrec->resources[i].type & TypeMask) == index)
+            count++;
+    for (size = 8; size <= count; size *= 2)
+        ;
+    list->entries = xallocarray(size, sizeof(int));
+    if (!list->entries)
+        return NULL;
+    list->size = size;
+    list->count = 0;
+    for (i = 0; i < rrec->used; i++) {
+        if ((rrec->resources[i].type & TypeMask) == index) {
+            rrec->resources[i].typeIndex = list->count;
+            list->entries[list->count++] = i;
+        }
+    }
+    return list;
+}
+
+static void
+UnlistResource(ClientResourceRec *rrec, ResourcePtr res)
+{
+    ResourceListPtr list = TypeList(rrec, res->type);
+    int last;
+
+    if (!list)
+        return;
+    last = list->entries[--list->count];
+    list->entries[res->typeIndex] = last;
+    rrec->resources[last].typeIndex = res->typeIndex;
+}
+
+static void
+FreeTypeLists(ClientResourceRec *rrec)
+{
+    int i;
+
+    for (i = 0; i < rrec->numTypes; i++)
+        free(rrec->byType[i].entries);
+    free(rrec->byType);
+    rrec->byType = NULL;
+    rrec->numTypes = 0;
+}
+
+static void
+FreeSlot(ClientResourceRec *rrec, ResourcePtr res)
+{
+    int i = res - rrec->resources;
+    int *prev = &rrec->heads[HashResourceID(res->id, rrec->hashsize)];
+
+    while (*prev != i)
+        prev = &rrec->resources[*prev].next;
+    *prev = res->next;
+    UnlistResource(rrec, res);
+    res->type = RT_NONE;
+    res->value = NULL;
+    res->next = rrec->freeList;
+    rrec->freeList = i;
+    rrec->elements--;
+}
+
+/*
+ * Step through every resource of a client; *pos starts at 0.  Entries
+ * don't move, but adding a resource may move the array, so callers don't
+ * keep the result across anything that can.
+ */
+static ResourcePtr
+NextResource(ClientResourceRec *rrec, int *pos)
+{
+    ResourcePtr res;
+
+    while (*pos < rrec->used) {
+        res = &rrec->resources[(*pos)++];
+        if (res->type != RT_NONE)
+            return res;
+    }
+    return NULL;
+}
+
+/*
+ * Step backwards through the list of type index, starting from *pos =
+ * its count.  Freeing the current entry or any already visited only
+ * moves visited entries around, so nothing is missed; *pos is pulled back
+ * in when func frees several at once.
+ */
+static ResourcePtr
+NextListed(ClientResourceRec *rrec, int index, int *pos)
+{
+    ResourceListPtr list = &rrec->byType[index];
+
+    if (*pos > list->count)
+        *pos = list->count;
+    if (*pos == 0)
+        return NULL;
+    return &rrec->resources[list->entries[--(*pos)]];
+}
+
+/*
+ * Start a walk over one type, or over everything when type is 0.  Returns
+ * the type's list index to pass to NextWalked, or -1 for the whole array.
+ */
+static int
+StartWalk(ClientResourceRec *rrec, RESTYPE type, int *pos)
+{
+    ResourceListPtr list;
+
+    if (type && (list = ListType(rrec, type))) {
+        *pos = list->count;
+        return type & TypeMask;
+    }
+    *pos = 0;
+    return -1;
+}
+
+static ResourcePtr
+NextWalked(ClientResourceRec *rrec, int index, int *pos)
+{
+    if (index < 0)
+        return NextResource(rrec, pos);
+    return NextListed(rrec, index, pos);
+}
+
 /*****************
  * InitClientResources
  *    When a new client is created, call this to allocate space
@@ -637,7 +929,7 @@ ResourceClientBits(void)
 Bool
 InitClientResources(ClientPtr client)
 {
-    int i, j;
+    ClientResourceRec *rrec = &clientTable[client->index];
 
     if (client == serverClient) {
         lastResourceType = RT_LASTPREDEF;
@@ -649,24 +941,18 @@ InitClientResources(ClientPtr client)
             return FALSE;
         memcpy(resourceTypes, predefTypes, sizeof(predefTypes));
     }
-    clientTable[i = client->index].resources =
-        malloc(INITBUCKETS * sizeof(ResourcePtr));
-    if (!clientTable[i].resources)
+    memset(rrec, 0, sizeof(*rrec));
+    rrec->freeList = -1;
+    if (!RebuildTable(rrec, INITHASHSIZE))
         return FALSE;
-    clientTable[i].buckets = INITBUCKETS;
-    clientTable[i].elements = 0;
-    clientTable[i].hashsize = INITHASHSIZE;
     /* Many IDs allocated from the server client are visible to clients,
      * so we don't use the SERVER_BIT for them, but we have to start
      * past the magic value constants used in the protocol.  For normal
      * clients, we can start from zero, with SERVER_BIT set.
      */
-    clientTable[i].fakeID = client->clientAsMask |
+    rrec->fakeID = client->clientAsMask |
         (client->index ? SERVER_BIT : SERVER_MINID);
-    clientTable[i].endFakeID = (clientTable[i].fakeID | RESOURCE_ID_MASK) + 1;
-    for (j = 0; j < INITBUCKETS; j++) {
-        clientTable[i].resources[j] = NULL;
-    }
+    rrec->endFakeID = (rrec->fakeID | RESOURCE_ID_MASK) + 1;
     return TRUE;
 }
 
@@ -686,15 +972,10 @@ HashResourceID(XID id, unsigned int numBits)
 static XID
 AvailableID(int client, XID id, XID maxid, XID goodid)
 {
-    ResourcePtr res;
-
     if ((goodid >= id) && (goodid <= maxid))
         return goodid;
     for (; id <= maxid; id++) {
-        res = clientTable[client].resources[HashResourceID(id, clientTable[client].hashsize)];
-        while (res && (res->id != id))
-            res = res->next;
-        if (!res)
+        if (!FindResource(&clientTable[client], id, RT_NONE, RC_ANY))
             return id;
     }
     return 0;
@@ -703,10 +984,10 @@ AvailableID(int client, XID id, XID maxid, XID goodid)
 void
 GetXIDRange(int client, Bool server, XID *minp, XID *maxp)
 {
+    ClientResourceRec *rrec = &clientTable[client];
     XID id, maxid;
-    ResourcePtr *resp;
     ResourcePtr res;
-    int i;
+    int pos = 0;
     XID goodid;
 
     id = (Mask) client << CLIENTOFFSET;
@@ -714,18 +995,15 @@ GetXIDRange(int client, Bool server, XID *minp, XID *maxp)
         id |= client ? SERVER_BIT : SERVER_MINID;
     maxid = id | RESOURCE_ID_MASK;
     goodid = 0;
-    for (resp = clientTable[client].resources, i = clientTable[client].buckets;
-         --i >= 0;) {
-        for (res = *resp++; res; res = res->next) {
-            if ((res->id < id) || (res->id > maxid))
-                continue;
-            if (((res->id - id) >= (maxid - res->id)) ?
-                (goodid = AvailableID(client, id, res->id - 1, goodid)) :
-                !(goodid = AvailableID(client, res->id + 1, maxid, goodid)))
-                maxid = res->id - 1;
-            else
-                id = res->id + 1;
-        }
+    while ((res = NextResource(rrec, &pos))) {
+        if ((res->id < id) || (res->id > maxid))
+            continue;
+        if (((res->id - id) >= (maxid - res->id)) ?
+            (goodid = AvailableID(client, id, res->id - 1, goodid)) :
+            !(goodid = AvailableID(client, res->id + 1, maxid, goodid)))
+            maxid = res->id - 1;
+        else
+            id = res->id + 1;
     }
     if (id > maxid)
         id = maxid = 0;
@@ -803,7 +1081,9 @@ AddResource(XID id, RESTYPE type, void *value)
 {
     int client;
     ClientResourceRec *rrec;
-    ResourcePtr res, *head;
+    ResourceListPtr list;
+    ResourcePtr res;
+    int i, head;
 
 #ifdef XSERVER_DTRACE
     XSERVER_RESOURCE_ALLOC(id, type, value, TypeNameString(type));
@@ -815,67 +1095,30 @@ AddResource(XID id, RESTYPE type, void *value)
                (unsigned long) id, type, (unsigned long)(uintptr_t) value, client);
         FatalError("client not in use\n");
     }
-    if ((rrec->elements >= 4 * rrec->buckets) && (rrec->hashsize < MAXHASHSIZE))
-        RebuildTable(client);
-    head = &rrec->resources[HashResourceID(id, clientTable[client].hashsize)];
-    res = malloc(sizeof(ResourceRec));
-    if (!res) {
+    /* longer chains will do if the buckets can't grow */
+    if (rrec->elements >= rrec->buckets)
+        RebuildTable(rrec, rrec->hashsize + 1);
+    if (!ReserveTypeList(rrec, type) || (i = AllocResource(rrec)) < 0) {
         (*resourceTypes[type & TypeMask].deleteFunc) (value, id);
         return FALSE;
     }
-    res->next = *head;
+    res = &rrec->resources[i];
     res->id = id;
     res->type = type;
     res->value = value;
-    *head = res;
+    res->serial = rrec->serial++;
+    head = HashResourceID(id, rrec->hashsize);
+    res->next = rrec->heads[head];
+    rrec->heads[head] = i;
+    if ((list = TypeList(rrec, type))) {
+        res->typeIndex = list->count;
+        list->entries[list->count++] = i;
+    }
     rrec->elements++;
     CallResourceStateCallback(ResourceStateAdding, res);
     return TRUE;
 }
 
-static void
-RebuildTable(int client)
-{
-    int j;
-    ResourcePtr res, next;
-    ResourcePtr **tails, *resources;
-    ResourcePtr **tptr, *rptr;
-
-    /*
-     * For now, preserve insertion order, since some ddx layers depend
-     * on resources being free in the opposite order they are added.
-     */
-
-    j = 2 * clientTable[client].buckets;
-    tails =  xallocarray(j, sizeof(ResourcePtr *));
-    if (!tails)
-        return;
-    resources =  xallocarray(j, sizeof(ResourcePtr));
-    if (!resources) {
-        free(tails);
-        return;
-    }
-    for (rptr = resources, tptr = tails; --j >= 0; rptr++, tptr++) {
-        *rptr = NULL;
-        *tptr = rptr;
-    }
-    clientTable[client].hashsize++;
-    for (j = clientTable[client].buckets,
-         rptr = clientTable[client].resources; --j >= 0; rptr++) {
-        for (res = *rptr; res; res = next) {
-            next = res->next;
-            res->next = NULL;
-            tptr = &tails[HashResourceID(res->id, clientTable[client].hashsize)];
-            **tptr = res;
-            *tptr = &res->next;
-        }
-    }
-    free(tails);
-    clientTable[client].buckets *= 2;
-    free(clientTable[client].resources);
-    clientTable[client].resources = resources;
-}
-
 static void
 doFreeResource(ResourcePtr res, Bool skip)
 {
@@ -883,42 +1126,27 @@ doFreeResource(ResourcePtr res, Bool skip)
 
     if (!skip)
         resourceTypes[res->type & TypeMask].deleteFunc(res->value, res->id);
-
-    free(res);
 }
 
 void
 FreeResource(XID id, RESTYPE skipDeleteFuncType)
 {
     int cid;
+    ClientResourceRec *rrec;
     ResourcePtr res;
-    ResourcePtr *prev, *head;
-    int *eltptr;
-    int elements;
+    ResourceRec victim;
 
     if (((cid = CLIENT_ID(id)) < LimitClients) && clientTable[cid].buckets) {
-        head = &clientTable[cid].resources[HashResourceID(id, clientTable[cid].hashsize)];
-        eltptr = &clientTable[cid].elements;
-
-        prev = head;
-        while ((res = *prev)) {
-            if (res->id == id) {
-                RESTYPE rtype = res->type;
-
+        rrec = &clientTable[cid];
+        while ((res = FindResource(rrec, id, RT_NONE, RC_ANY))) {
+            victim = *res;
 #ifdef XSERVER_DTRACE
-                XSERVER_RESOURCE_FREE(res->id, res->type,
-                                      res->value, TypeNameString(res->type));
+            XSERVER_RESOURCE_FREE(victim.id, victim.type,
+                                  victim.value, TypeNameString(victim.type));
 #endif
-                *prev = res->next;
-                elements = --*eltptr;
-
-                doFreeResource(res, rtype == skipDeleteFuncType);
+            FreeSlot(rrec, res);
 
-                if (*eltptr != elements)
-                    prev = head;        /* prev may no longer be valid */
-            }
-            else
-                prev = &res->next;
+            doFreeResource(&victim, victim.type == skipDeleteFuncType);
         }
     }
 }
@@ -927,28 +1155,22 @@ void
 FreeResourceByType(XID id, RESTYPE type, Bool skipFree)
 {
     int cid;
+    ClientResourceRec *rrec;
     ResourcePtr res;
-    ResourcePtr *prev, *head;
+    ResourceRec victim;
 
     if (((cid = CLIENT_ID(id)) < LimitClients) && clientTable[cid].buckets) {
-        head = &clientTable[cid].resources[HashResourceID(id, clientTable[cid].hashsize)];
-
-        prev = head;
-        while ((res = *prev)) {
-            if (res->id == id && res->type == type) {
+        rrec = &clientTable[cid];
+        res = FindResource(rrec, id, type, 0);
+        if (res) {
+            victim = *res;
 #ifdef XSERVER_DTRACE
-                XSERVER_RESOURCE_FREE(res->id, res->type,
-                                      res->value, TypeNameString(res->type));
+            XSERVER_RESOURCE_FREE(victim.id, victim.type,
+                                  victim.value, TypeNameString(victim.type));
 #endif
-                *prev = res->next;
-                clientTable[cid].elements--;
+            FreeSlot(rrec, res);
 
-                doFreeResource(res, skipFree);
-
-                break;
-            }
-            else
-                prev = &res->next;
+            doFreeResource(&victim, skipFree);
         }
     }
 }
@@ -963,53 +1185,65 @@ Bool
 ChangeResourceValue(XID id, RESTYPE rtype, void *value)
 {
     int cid;
+    ClientResourceRec *rrec;
     ResourcePtr res;
 
     if (((cid = CLIENT_ID(id)) < LimitClients) && clientTable[cid].buckets) {
-        res = clientTable[cid].resources[HashResourceID(id, clientTable[cid].hashsize)];
-
-        for (; res; res = res->next)
-            if ((res->id == id) && (res->type == rtype)) {
-                res->value = value;
-                return TRUE;
-            }
+        rrec = &clientTable[cid];
+        res = FindResource(rrec, id, rtype, 0);
+        if (res) {
+            res->value = value;
+            return TRUE;
+        }
     }
     return FALSE;
 }
 
 /* Note: if func adds or deletes resources, then func can get called
  * more than once for some resources.  If func adds new resources,
- * func might or might not get called for them.  func cannot both
- * add and delete an equal number of resources!
+ * func might or might not get called for them.
  */
 
 void
 FindClientResourcesByType(ClientPtr client,
                           RESTYPE type, FindResType func, void *cdata)
 {
-    ResourcePtr *resources;
-    ResourcePtr this, next;
-    int i, elements;
-    int *eltptr;
+    ClientResourceRec *rrec;
+    ResourcePtr this;
+    int index, pos;
 
     if (!client)
         client = serverClient;
 
-    resources = clientTable[client->index].resources;
-    eltptr = &clientTable[client->index].elements;
-    for (i = 0; i < clientTable[client->index].buckets; i++) {
-        for (this = resources[i]; this; this = next) {
-            next = this->next;
-            if (!type || this->type == type) {
-                elements = *eltptr;
-                (*func) (this->value, this->id, cdata);
-                if (*eltptr != elements)
-                    next = resources[i];        /* start over */
-            }
-        }
+    rrec = &clientTable[client->index];
+    index = StartWalk(rrec, type, &pos);
+    while ((this = NextWalked(rrec, index, &pos))) {
+        if (!type || this->type == type)
+            (*func) (this->value, this->id, cdata);
     }
 }
 
+int
+CountClientResourcesByType(ClientPtr client, RESTYPE type)
+{
+    ClientResourceRec *rrec;
+    ResourceListPtr list;
+    ResourcePtr this;
+    int count = 0, pos = 0;
+
+    if (!client)
+        client = serverClient;
+
+    /* counting isn't a walk, so don't make a list for it */
+    rrec = &clientTable[client->index];
+    if ((list = TypeList(rrec, type)))
+        return list->count;
+    while ((this = NextResource(rrec, &pos)))
+        if (this->type == type)
+            count++;
+    return count;
+}
+
 void FindSubResources(void *resource,
                       RESTYPE    type,
                       FindAllRes func,
@@ -1022,25 +1256,16 @@ void FindSubResources(void *resource,
 void
 FindAllClientResources(ClientPtr client, FindAllRes func, void *cdata)
 {
-    ResourcePtr *resources;
-    ResourcePtr this, next;
-    int i, elements;
-    int *eltptr;
+    ClientResourceRec *rrec;
+    ResourcePtr this;
+    int pos = 0;
 
     if (!client)
         client = serverClient;
 
-    resources = clientTable[client->index].resources;
-    eltptr = &clientTable[client->index].elements;
-    for (i = 0; i < clientTable[client->index].buckets; i++) {
-        for (this = resources[i]; this; this = next) {
-            next = this->next;
-            elements = *eltptr;
-            (*func) (this->value, this->id, this->type, cdata);
-            if (*eltptr != elements)
-                next = resources[i];    /* start over */
-        }
-    }
+    rrec = &clientTable[client->index];
+    while ((this = NextResource(rrec, &pos)))
+        (*func) (this->value, this->id, this->type, cdata);
 }
 
 void *
@@ -1048,24 +1273,22 @@ LookupClientResourceComplex(ClientPtr client,
                             RESTYPE type,
                             FindComplexResType func, void *cdata)
 {
-    ResourcePtr *resources;
-    ResourcePtr this, next;
+    ClientResourceRec *rrec;
+    ResourcePtr this;
     void *value;
-    int i;
+    int index, pos;
 
     if (!client)
         client = serverClient;
 
-    resources = clientTable[client->index].resources;
-    for (i = 0; i < clientTable[client->index].buckets; i++) {
-        for (this = resources[i]; this; this = next) {
-            next = this->next;
-            if (!type || this->type == type) {
-                /* workaround func freeing the type as DRI1 does */
-                value = this->value;
-                if ((*func) (value, this->id, cdata))
-                    return value;
-            }
+    rrec = &clientTable[client->index];
+    index = StartWalk(rrec, type, &pos);
+    while ((this = NextWalked(rrec, index, &pos))) {
+        if (!type || this->type == type) {
+            /* workaround func freeing the type as DRI1 does */
+            value = this->value;
+            if ((*func) (value, this->id, cdata))
+                return value;
         }
     }
     return NULL;
@@ -1074,48 +1297,36 @@ LookupClientResourceComplex(ClientPtr client,
 void
 FreeClientNeverRetainResources(ClientPtr client)
 {
-    ResourcePtr *resources;
+    ClientResourceRec *rrec;
     ResourcePtr this;
-    ResourcePtr *prev;
-    int j, elements;
-    int *eltptr;
+    ResourceRec victim;
+    int pos = 0;
 
     if (!client)
         return;
 
-    resources = clientTable[client->index].resources;
-    eltptr = &clientTable[client->index].elements;
-    for (j = 0; j < clientTable[client->index].buckets; j++) {
-        prev = &resources[j];
-        while ((this = *prev)) {
-            RESTYPE rtype = this->type;
-
-            if (rtype & RC_NEVERRETAIN) {
+    rrec = &clientTable[client->index];
+    while ((this = NextResource(rrec, &pos))) {
+        if (!(this->type & RC_NEVERRETAIN))
+            continue;
+        victim = *this;
 #ifdef XSERVER_DTRACE
-                XSERVER_RESOURCE_FREE(this->id, this->type,
-                                      this->value, TypeNameString(this->type));
+        XSERVER_RESOURCE_FREE(victim.id, victim.type,
+                              victim.value, TypeNameString(victim.type));
 #endif
-                *prev = this->next;
-                clientTable[client->index].elements--;
-                elements = *eltptr;
-
-                doFreeResource(this, FALSE);
+        FreeSlot(rrec, this);
 
-                if (*eltptr != elements)
-                    prev = &resources[j];       /* prev may no longer be valid */
-            }
-            else
-                prev = &this->next;
-        }
+        doFreeResource(&victim, FALSE);
     }
 }
 
 void
 FreeClientResources(ClientPtr client)
 {
-    ResourcePtr *resources;
+    ClientResourceRec *rrec;
     ResourcePtr this;
-    int j;
+    ResourceRec victim;
+    int pos = 0;
 
     /* This routine shouldn't be called with a null client, but just in
        case ... */
@@ -1125,35 +1336,33 @@ FreeClientResources(ClientPtr client)
 
     HandleSaveSet(client);
 
-    resources = clientTable[client->index].resources;
-    for (j = 0; j < clientTable[client->index].buckets; j++) {
-        /* It may seem silly to update the head of this resource list as
-           we delete the members, since the entire list will be deleted any way,
-           but there are some resource deletion functions "FreeClientPixels" for
-           one which do a LookupID on another resource id (a Colormap id in this
-           case), so the resource list must be kept valid up to the point that
-           it is deleted, so every time we delete a resource, we must update the
-           head, just like in FreeResource. I hope that this doesn't slow down
-           mass deletion appreciably. PRH */
-
-        ResourcePtr *head;
+    /* Resources are freed one at a time and the table is kept valid
+       throughout, as some delete functions ("FreeClientPixels" for one)
+       look up other resources of the same client. */
 
-        head = &resources[j];
-
-        for (this = *head; this; this = *head) {
+    rrec = &clientTable[client->index];
+    while ((this = NextResource(rrec, &pos))) {
+        /* resources sharing an ID go newest first, as in FreeResource */
+        this = FindResource(rrec, this->id, RT_NONE, RC_ANY);
+        victim = *this;
 #ifdef XSERVER_DTRACE
-            XSERVER_RESOURCE_FREE(this->id, this->type,
-                                  this->value, TypeNameString(this->type));
+        XSERVER_RESOURCE_FREE(victim.id, victim.type,
+                              victim.value, TypeNameString(victim.type));
 #endif
-            *head = this->next;
-            clientTable[client->index].elements--;
+        FreeSlot(rrec, this);
 
-            doFreeResource(this, FALSE);
-        }
+        doFreeResource(&victim, FALSE);
+
+        pos--;                  /* the entry may hold an older one */
     }
-    free(clientTable[client->index].resources);
-    clientTable[client->index].resources = NULL;
-    clientTable[client->index].buckets = 0;
+    free(rrec->resources);
+    rrec->resources = NULL;
+    rrec->size = rrec->used = 0;
+    rrec->freeList = -1;
+    free(rrec->heads);
+    rrec->heads = NULL;
+    rrec->buckets = 0;
+    FreeTypeLists(rrec);
 }
 
 void
@@ -1198,34 +1407,32 @@ dixLookupResourceByType(void **result, XID id, RESTYPE rtype,
 {
     int cid = CLIENT_ID(id);
     ResourcePtr res = NULL;
+    void *value;
 
     *result = NULL;
     if ((rtype & TypeMask) > lastResourceType)
         return BadImplementation;
 
-    if ((cid < LimitClients) && clientTable[cid].buckets) {
-        res = clientTable[cid].resources[HashResourceID(id, clientTable[cid].hashsize)];
-
-        for (; res; res = res->next)
-            if (res->id == id && res->type == rtype)
-                break;
-    }
+    if ((cid < LimitClients) && clientTable[cid].buckets)
+        res = FindResource(&clientTable[cid], id, rtype, 0);
     if (client) {
         client->errorValue = id;
     }
     if (!res)
         return resourceTypes[rtype & TypeMask].errorValue;
 
+    /* the hook may add resources, which can move this one */
+    value = res->value;
     if (client) {
-        cid = XaceHook(XACE_RESOURCE_ACCESS, client, id, res->type,
-                       res->value, RT_NONE, NULL, mode);
+        cid = XaceHook(XACE_RESOURCE_ACCESS, client, id, rtype,
+                       value, RT_NONE, NULL, mode);
         if (cid == BadValue)
             return resourceTypes[rtype & TypeMask].errorValue;
         if (cid != Success)
             return cid;
     }
 
-    *result = res->value;
+    *result = value;
     return Success;
 }
 
@@ -1235,29 +1442,27 @@ dixLookupResourceByClass(void **result, XID id, RESTYPE rclass,
 {
     int cid = CLIENT_ID(id);
     ResourcePtr res = NULL;
+    void *value;
 
     *result = NULL;
 
-    if ((cid < LimitClients) && clientTable[cid].buckets) {
-        res = clientTable[cid].resources[HashResourceID(id, clientTable[cid].hashsize)];
-
-        for (; res; res = res->next)
-            if (res->id == id && (res->type & rclass))
-                break;
-    }
+    if ((cid < LimitClients) && clientTable[cid].buckets)
+        res = FindResource(&clientTable[cid], id, RT_NONE, rclass);
     if (client) {
         client->errorValue = id;
     }
     if (!res)
         return BadValue;
 
+    /* the hook may add resources, which can move this one */
+    value = res->value;
     if (client) {
         cid = XaceHook(XACE_RESOURCE_ACCESS, client, id, res->type,
-                       res->value, RT_NONE, NULL, mode);
+                       value, RT_NONE, NULL, mode);
         if (cid != Success)
             return cid;
     }
 
-    *result = res->value;
+    *result = value;
     return Success;
 }
@@ -0,0 +1,247 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Slab caches.  Every object is preceded by a header naming the slab it
+ * lives in, NULL for objects that came from malloc, so SlabFree needs
+ * nothing but the pointer.  Slabs with room in them are kept on the
+ * cache's partial list, allocations take from the first of them, and a
+ * slab that empties is kept as a spare rather than freed, so that a
+ * client creating and destroying one window over and over does not
+ * malloc and free a whole slab each time.  Free slots are chained
+ * through their headers; slots never used yet are carved off the end.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <stdlib.h>
+#include "misc.h"
+#include "os.h"
+#include "list.h"
+#include "slab.h"
+
+#define SLAB_BYTES      65536
+#define SLAB_MIN_OBJECTS 8
+
+typedef struct _Slab *SlabPtr;
+
+/* two pointers, which keeps the object after it malloc-aligned */
+typedef struct _SlabHeader {
+    SlabPtr slab;
+    struct _SlabHeader *next;   /* while on the free list */
+} SlabHeaderRec, *SlabHeaderPtr;
+
+typedef struct _Slab {
+    struct xorg_list entry;
+    SlabCachePtr cache;
+    SlabHeaderPtr free;
+    unsigned used;
+    unsigned carved;
+} SlabRec;
+
+typedef struct _SlabCache {
+    const char *name;
+    unsigned size;
+    unsigned stride;
+    unsigned slotOffset;
+    struct xorg_list partial;
+    struct xorg_list full;
+    SlabPtr spare;
+    Bool retired;
+    SlabStatsRec stats;
+} SlabCacheRec;
+
+static unsigned
+SlabRound(unsigned size)
+{
+    return (size + sizeof(SlabHeaderRec) - 1) & ~(sizeof(SlabHeaderRec) - 1);
+}
+
+SlabCachePtr
+SlabCacheCreate(const char *name, unsigned size)
+{
+    SlabCachePtr cache;
+    unsigned perSlab;
+
+    if (size > SLAB_BYTES)
+        return NULL;
+    cache = calloc(1, sizeof(SlabCacheRec));
+    if (!cache)
+        return NULL;
+
+    cache->name = name;
+    cache->size = size;
+    cache->stride = sizeof(SlabHeaderRec) + SlabRound(size);
+    cache->slotOffset = SlabRound(sizeof(SlabRec));
+    perSlab = (SLAB_BYTES - cache->slotOffset) / cache->stride;
+    cache->stats.perSlab = max(perSlab, SLAB_MIN_OBJECTS);
+    xorg_list_init(&cache->partial);
+    xorg_list_init(&cache->full);
+    return cache;
+}
+
+static SlabPtr
+SlabCreate(SlabCachePtr cache)
+{
+    SlabPtr slab;
+
+    slab = malloc(cache->slotOffset + cache->stats.perSlab * cache->stride);
+    if (!slab)
+        return NULL;
+    slab->cache = cache;
+    slab->free = NULL;
+    slab->used = 0;
+    slab->carved = 0;
+    if (++cache->stats.slabs > cache->stats.peakSlabs)
+        cache->stats.peakSlabs = cache->stats.slabs;
+    return slab;
+}
+
+static void
+SlabDestroy(SlabPtr slab)
+{
+    slab->cache->stats.slabs--;
+    free(slab);
+}
+
+void *
+SlabAlloc(SlabCachePtr cache, unsigned size)
+{
+    SlabPtr slab;
+    SlabHeaderPtr header;
+
+    if (cache)
+        cache->stats.allocs++;
+
+    if (!cache || size > cache->size) {
+        header = malloc(sizeof(SlabHeaderRec) + size);
+        if (!header)
+            return NULL;
+        header->slab = NULL;
+        return header + 1;
+    }
+
+    if (!xorg_list_is_empty(&cache->partial)) {
+        slab = xorg_list_first_entry(&cache->partial, SlabRec, entry);
+        cache->stats.hits++;
+    }
+    else {
+        if (cache->spare) {
+            slab = cache->spare;
+            cache->spare = NULL;
+            cache->stats.hits++;
+        }
+        else if (!(slab = SlabCreate(cache)))
+            return NULL;
+        xorg_list_add(&slab->entry, &cache->partial);
+    }
+
+    if (slab->free) {
+        header = slab->free;
+        slab->free = header->next;
+    }
+    else
+        header = (SlabHeaderPtr) ((char *) slab + cache->slotOffset +
+                                  slab->carved++ * cache->stride);
+    header->slab = slab;
+
+    if (++slab->used == cache->stats.perSlab) {
+        xorg_list_del(&slab->entry);
+        xorg_list_add(&slab->entry, &cache->full);
+    }
+    if (++cache->stats.inUse > cache->stats.peakInUse)
+        cache->stats.peakInUse = cache->stats.inUse;
+
+    return header + 1;
+}
+
+void
+SlabFree(void *object)
+{
+    SlabHeaderPtr header;
+    SlabPtr slab;
+    SlabCachePtr cache;
+
+    if (!object)
+        return;
+    header = (SlabHeaderPtr) object - 1;
+    slab = header->slab;
+    if (!slab) {
+        free(header);
+        return;
+    }
+    cache = slab->cache;
+
+    header->next = slab->free;
+    slab->free = header;
+    cache->stats.inUse--;
+
+    if (slab->used-- == cache->stats.perSlab) {
+        xorg_list_del(&slab->entry);
+        xorg_list_add(&slab->entry, &cache->partial);
+    }
+    if (slab->used)
+        return;
+
+    xorg_list_del(&slab->entry);
+    if (!cache->retired && !cache->spare)
+        cache->spare = slab;
+    else
+        SlabDestroy(slab);
+    if (cache->retired && !cache->stats.slabs)
+        free(cache);
+}
+
+void
+SlabCacheGetStats(SlabCachePtr cache, SlabStatsPtr stats)
+{
+    *stats = cache->stats;
+}
+
+void
+SlabCacheDestroy(SlabCachePtr cache)
+{
+    SlabStatsPtr stats;
+
+    if (!cache)
+        return;
+    stats = &cache->stats;
+
+    if (stats->allocs)
+        LogMessageVerb(X_INFO, 3,
+                       "[slab] %s (%u bytes): %lu allocations, %.1f%% from "
+                       "slabs already held, peak %lu in %lu slabs "
+                       "(%.1f%% of slots used)\n",
+                       cache->name, cache->size, stats->allocs,
+                       100.0 * stats->hits / stats->allocs,
+                       stats->peakInUse, stats->peakSlabs,
+                       stats->peakSlabs ? 100.0 * stats->peakInUse /
+                       (stats->peakSlabs * stats->perSlab) : 0.0);
+
+    if (cache->spare)
+        SlabDestroy(cache->spare);
+    cache->spare = NULL;
+    cache->retired = TRUE;
+    if (!stats->slabs)
+        free(cache);
+}
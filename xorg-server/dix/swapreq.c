@@ -56,12 +56,130 @@ SOFTWARE.
 #include "extnsionst.h"         /* for SendEvent */
 #include "swapreq.h"
 
+/* SSE2 is part of every x86-64, and of x86 builds that ask for it;
+ * AVX2 is picked at run time, the same way as in fb/fbsimd.c */
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SWAPREQ_USE_SSE2 1
+
+#if defined(_MSC_VER)
+#define SWAPREQ_USE_AVX2 1
+#define SWAPREQ_TARGET_AVX2
+#include <intrin.h>
+#include <immintrin.h>
+#elif defined(__GNUC__) && \
+    (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9) || \
+     defined(__clang__))
+#define SWAPREQ_USE_AVX2 1
+#define SWAPREQ_TARGET_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#endif
+#endif
+
+#ifdef SWAPREQ_USE_AVX2
+static int swapUseAvx2 = -1;
+
+static Bool
+SwapDetectAvx2(void)
+{
+#ifdef _MSC_VER
+    int info[4];
+
+    __cpuid(info, 0);
+    if (info[0] >= 7) {
+        __cpuid(info, 1);
+        /* OSXSAVE and AVX, with the OS saving the YMM registers */
+        if ((info[2] & (1 << 27)) && (info[2] & (1 << 28)) &&
+            (_xgetbv(0) & 6) == 6) {
+            __cpuidex(info, 7, 0);
+            if (info[1] & (1 << 5))
+                return TRUE;
+        }
+    }
+    return FALSE;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+static inline Bool
+SwapAvx2(void)
+{
+    if (swapUseAvx2 < 0)
+        swapUseAvx2 = SwapDetectAvx2();
+    return swapUseAvx2;
+}
+
+/* Byte swap count & ~7 longs, returns how many */
+static SWAPREQ_TARGET_AVX2 unsigned long
+SwapLongsAvx2(CARD32 *list, unsigned long count)
+{
+    const __m256i order = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4,
+                                           11, 10, 9, 8, 15, 14, 13, 12,
+                                           3, 2, 1, 0, 7, 6, 5, 4,
+                                           11, 10, 9, 8, 15, 14, 13, 12);
+    unsigned long n;
+
+    for (n = 0; n + 8 <= count; n += 8) {
+        __m256i v = _mm256_loadu_si256((__m256i *) (list + n));
+
+        _mm256_storeu_si256((__m256i *) (list + n),
+                            _mm256_shuffle_epi8(v, order));
+    }
+    _mm256_zeroupper();
+    return n;
+}
+
+/* Byte swap count & ~15 shorts, returns how many */
+static SWAPREQ_TARGET_AVX2 unsigned long
+SwapShortsAvx2(short *list, unsigned long count)
+{
+    const __m256i order = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6,
+                                           9, 8, 11, 10, 13, 12, 15, 14,
+                                           1, 0, 3, 2, 5, 4, 7, 6,
+                                           9, 8, 11, 10, 13, 12, 15, 14);
+    unsigned long n;
+
+    for (n = 0; n + 16 <= count; n += 16) {
+        __m256i v = _mm256_loadu_si256((__m256i *) (list + n));
+
+        _mm256_storeu_si256((__m256i *) (list + n),
+                            _mm256_shuffle_epi8(v, order));
+    }
+    _mm256_zeroupper();
+    return n;
+}
+#endif
+
 /* Thanks to Jack Palevich for testing and subsequently rewriting all this */
 
 /* Byte swap a list of longs */
 void
 SwapLongs(CARD32 *list, unsigned long count)
 {
+#ifdef SWAPREQ_USE_AVX2
+    if (count >= 8 && SwapAvx2()) {
+        unsigned long done = SwapLongsAvx2(list, count);
+
+        list += done;
+        count -= done;
+    }
+#endif
+#ifdef SWAPREQ_USE_SSE2
+    /* Swap the bytes of each short, then the shorts of each long */
+    while (count >= 4) {
+        __m128i v = _mm_loadu_si128((__m128i *) list);
+
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+        v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+        _mm_storeu_si128((__m128i *) list, v);
+        list += 4;
+        count -= 4;
+    }
+#endif
     while (count >= 8) {
         swapl(list + 0);
         swapl(list + 1);
@@ -86,6 +204,24 @@ SwapLongs(CARD32 *list, unsigned long count)
 void
 SwapShorts(short *list, unsigned long count)
 {
+#ifdef SWAPREQ_USE_AVX2
+    if (count >= 16 && SwapAvx2()) {
+        unsigned long done = SwapShortsAvx2(list, count);
+
+        list += done;
+        count -= done;
+    }
+#endif
+#ifdef SWAPREQ_USE_SSE2
+    while (count >= 8) {
+        __m128i v = _mm_loadu_si128((__m128i *) list);
+
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        _mm_storeu_si128((__m128i *) list, v);
+        list += 8;
+        count -= 8;
+    }
+#endif
     while (count >= 16) {
         swaps(list + 0);
         swaps(list + 1);
@@ -132,6 +132,7 @@ Equipment Corporation.
 #include "privates.h"
 #include "xace.h"
 #include "exevents.h"
+#include "dixgrabs.h"
 
 #include <X11/Xatom.h>          /* must come after server includes */
 
@@ -596,6 +597,10 @@ CreateRootWindow(ScreenPtr pScreen)
     pWin->optional->otherClients = NULL;
     pWin->optional->passiveGrabs = NULL;
     pWin->optional->userProps = NULL;
+    pWin->optional->propIndex = NULL;
+    pWin->optional->childIndex = NULL;
+    pWin->optional->deliveryPlan = NULL;
+    pWin->optional->grabIndex = NULL;
     pWin->optional->backingBitPlanes = ~0L;
     pWin->optional->backingPixel = 0;
     pWin->optional->boundingShape = NULL;
@@ -955,6 +960,297 @@ CreateWindow(Window wid, WindowPtr pParent, int x, int y, unsigned w,
     return pWin;
 }
 
+/*
+ * Hit-testing index over the mapped children of a window, so finding the
+ * child under the pointer doesn't mean walking every sibling.  Children
+ * are bucketed by their border boxes, relative to the parent's origin,
+ * into a grid over the area they cover; children spanning more than a
+ * quarter of the grid are kept on a separate list instead.  Entries are
+ * numbered in stacking order, top first, and every list is kept sorted,
+ * so merging a cell with the large list yields candidates top first.
+ *
+ * The index is only built for windows found to have at least
+ * CHILD_INDEX_MIN children, and is marked dirty whenever a child is
+ * mapped, unmapped, moved, resized, restacked or removed.  It is rebuilt
+ * on the next lookup.
+ */
+
+#define CHILD_INDEX_MIN         32
+#define CHILD_INDEX_MAX_GRID    64
+
+typedef struct _ChildIndexEntry {
+    int x1, y1, x2, y2;
+    WindowPtr pWin;
+} ChildIndexEntryRec, *ChildIndexEntryPtr;
+
+typedef struct _ChildIndex {
+    Bool dirty;
+    int x1, y1, x2, y2;         /* extents of all the entries */
+    int cellWidth, cellHeight;
+    int cols, rows;
+    int numEntries, sizeEntries;
+    ChildIndexEntryPtr entries;
+    int numLarge;
+    int *large;                 /* sizeEntries long */
+    int sizeCells;
+    int *cellStart;             /* sizeCells + 1 long */
+    int sizeItems;
+    int *items;
+} ChildIndexRec, *ChildIndexPtr;
+
+static int
+ChildIndexCol(ChildIndexPtr index, int x)
+{
+    int col = (x - index->x1) / index->cellWidth;
+
+    return min(col, index->cols - 1);
+}
+
+static int
+ChildIndexRow(ChildIndexPtr index, int y)
+{
+    int row = (y - index->y1) / index->cellHeight;
+
+    return min(row, index->rows - 1);
+}
+
+static Bool
+ChildIndexIsLarge(ChildIndexPtr index, ChildIndexEntryPtr entry)
+{
+    int cells = (ChildIndexCol(index, entry->x2 - 1) -
+                 ChildIndexCol(index, entry->x1) + 1) *
+        (ChildIndexRow(index, entry->y2 - 1) -
+         ChildIndexRow(index, entry->y1) + 1);
+
+    return cells > 4 && cells > index->cols * index->rows / 4;
+}
+
+static Bool
+BuildChildIndex(WindowPtr pParent, ChildIndexPtr index)
+{
+    WindowPtr pChild;
+    int numChildren = 0, numEntries = 0, numItems = 0, cells;
+    int i, col, row;
+
+    for (pChild = pParent->firstChild; pChild; pChild = pChild->nextSib) {
+        numChildren++;
+        if (pChild->mapped)
+            numEntries++;
+    }
+    if (numChildren < CHILD_INDEX_MIN)
+        return FALSE;
+
+    if (numEntries > index->sizeEntries) {
+        ChildIndexEntryPtr entries;
+        int *large;
+
+        entries = reallocarray(index->entries, numEntries,
+                               sizeof(ChildIndexEntryRec));
+        if (!entries)
+            return FALSE;
+        index->entries = entries;
+        large = reallocarray(index->large, numEntries, sizeof(int));
+        if (!large)
+            return FALSE;
+        index->large = large;
+        index->sizeEntries = numEntries;
+    }
+
+    index->numEntries = 0;
+    index->x1 = index->y1 = MAXSHORT;
+    index->x2 = index->y2 = MINSHORT;
+    for (pChild = pParent->firstChild; pChild; pChild = pChild->nextSib) {
+        ChildIndexEntryPtr entry;
+        int bw = wBorderWidth(pChild);
+
+        if (!pChild->mapped)
+            continue;
+        entry = &index->entries[index->numEntries++];
+        entry->x1 = pChild->origin.x - bw;
+        entry->y1 = pChild->origin.y - bw;
+        entry->x2 = pChild->origin.x + (int) pChild->drawable.width + bw;
+        entry->y2 = pChild->origin.y + (int) pChild->drawable.height + bw;
+        entry->pWin = pChild;
+        index->x1 = min(index->x1, entry->x1);
+        index->y1 = min(index->y1, entry->y1);
+        index->x2 = max(index->x2, entry->x2);
+        index->y2 = max(index->y2, entry->y2);
+    }
+
+    index->cols = 1;
+    while (index->cols < CHILD_INDEX_MAX_GRID &&
+           index->cols * index->cols < numEntries)
+        index->cols++;
+    index->rows = index->cols;
+    if (numEntries) {
+        index->cellWidth = (index->x2 - index->x1 + index->cols - 1) /
+            index->cols;
+        index->cellHeight = (index->y2 - index->y1 + index->rows - 1) /
+            index->rows;
+    }
+    else
+        index->cellWidth = index->cellHeight = 1;
+
+    cells = index->cols * index->rows;
+    if (cells > index->sizeCells) {
+        int *cellStart = reallocarray(index->cellStart, cells + 1,
+                                      sizeof(int));
+
+        if (!cellStart)
+            return FALSE;
+        index->cellStart = cellStart;
+        index->sizeCells = cells;
+    }
+
+    /* count the entries in each cell, then turn the counts into where
+     * each cell's list ends and fill them in back to front */
+    memset(index->cellStart, 0, (cells + 1) * sizeof(int));
+    index->numLarge = 0;
+    for (i = 0; i < index->numEntries; i++) {
+        ChildIndexEntryPtr entry = &index->entries[i];
+
+        if (ChildIndexIsLarge(index, entry)) {
+            index->large[index->numLarge++] = i;
+            continue;
+        }
+        for (row = ChildIndexRow(index, entry->y1);
+             row <= ChildIndexRow(index, entry->y2 - 1); row++)
+            for (col = ChildIndexCol(index, entry->x1);
+                 col <= ChildIndexCol(index, entry->x2 - 1); col++)
+                index->cellStart[row * index->cols + col]++;
+    }
+    for (i = 0; i < cells; i++) {
+        numItems += index->cellStart[i];
+        index->cellStart[i] = numItems;
+    }
+    index->cellStart[cells] = numItems;
+
+    if (numItems > index->sizeItems) {
+        int *items = reallocarray(index->items, numItems, sizeof(int));
+
+        if (!items)
+            return FALSE;
+        index->items = items;
+        index->sizeItems = numItems;
+    }
+    for (i = index->numEntries - 1; i >= 0; i--) {
+        ChildIndexEntryPtr entry = &index->entries[i];
+
+        if (ChildIndexIsLarge(index, entry))
+            continue;
+        for (row = ChildIndexRow(index, entry->y1);
+             row <= ChildIndexRow(index, entry->y2 - 1); row++)
+            for (col = ChildIndexCol(index, entry->x1);
+                 col <= ChildIndexCol(index, entry->x2 - 1); col++)
+                index->items[--index->cellStart[row * index->cols + col]] = i;
+    }
+
+    index->dirty = FALSE;
+    return TRUE;
+}
+
+static void
+FreeChildIndex(WindowPtr pWin)
+{
+    ChildIndexPtr index = pWin->optional->childIndex;
+
+    if (!index)
+        return;
+    free(index->entries);
+    free(index->large);
+    free(index->cellStart);
+    free(index->items);
+    free(index);
+    pWin->optional->childIndex = NULL;
+}
+
+/**
+ * Marks the hit-testing index of pParent's children out of date, for
+ * callers that change the stacking order or geometry of its children
+ * behind the back of the functions here.
+ */
+void
+InvalidateChildIndex(WindowPtr pParent)
+{
+    if (pParent && pParent->optional && pParent->optional->childIndex)
+        pParent->optional->childIndex->dirty = TRUE;
+}
+
+/**
+ * Starts a lookup of the mapped children of pParent whose border boxes
+ * contain x/y (in screen coordinates), to be read out top first with
+ * ChildIndexNext().  If pParent has no index and build is set, one is
+ * built if it has enough children to be worth it.
+ *
+ * @return FALSE if there is no index, the caller walks the children
+ * itself.
+ */
+Bool
+ChildIndexLookup(WindowPtr pParent, int x, int y, Bool build,
+                 ChildIndexIterPtr iter)
+{
+    ChildIndexPtr index = NULL;
+    int cell;
+
+    if (pParent->optional)
+        index = pParent->optional->childIndex;
+    if (!index) {
+        if (!build || !MakeWindowOptional(pParent))
+            return FALSE;
+        index = calloc(1, sizeof(ChildIndexRec));
+        if (!index)
+            return FALSE;
+        index->dirty = TRUE;
+        pParent->optional->childIndex = index;
+    }
+    if (index->dirty && !BuildChildIndex(pParent, index)) {
+        FreeChildIndex(pParent);
+        return FALSE;
+    }
+
+    x -= pParent->drawable.x;
+    y -= pParent->drawable.y;
+    iter->index = index;
+    iter->x = x;
+    iter->y = y;
+    if (x < index->x1 || x >= index->x2 || y < index->y1 || y >= index->y2) {
+        iter->cell = iter->cellEnd = iter->large = iter->largeEnd = NULL;
+        return TRUE;
+    }
+    cell = ChildIndexRow(index, y) * index->cols + ChildIndexCol(index, x);
+    iter->cell = index->items + index->cellStart[cell];
+    iter->cellEnd = index->items + index->cellStart[cell + 1];
+    iter->large = index->large;
+    iter->largeEnd = index->large + index->numLarge;
+    return TRUE;
+}
+
+/**
+ * @return the next child, in stacking order, whose border box contains
+ * the point given to ChildIndexLookup(), or NullWindow.
+ */
+WindowPtr
+ChildIndexNext(ChildIndexIterPtr iter)
+{
+    ChildIndexPtr index = iter->index;
+
+    for (;;) {
+        ChildIndexEntryPtr entry;
+
+        if (iter->cell < iter->cellEnd &&
+            (iter->large == iter->largeEnd || *iter->cell < *iter->large))
+            entry = &index->entries[*iter->cell++];
+        else if (iter->large < iter->largeEnd)
+            entry = &index->entries[*iter->large++];
+        else
+            return NullWindow;
+
+        if (iter->x >= entry->x1 && iter->x < entry->x2 &&
+            iter->y >= entry->y1 && iter->y < entry->y2)
+            return entry->pWin;
+    }
+}
+
 static void
 DisposeWindowOptional(WindowPtr pWin)
 {
@@ -986,6 +1282,9 @@ DisposeWindowOptional(WindowPtr pWin)
         pWin->optional->deviceCursors = NULL;
     }
 
+    FreeChildIndex(pWin);
+    InvalidateDeliveryPlan(pWin);
+    FreeGrabIndex(pWin);
     free(pWin->optional);
     pWin->optional = NULL;
 }
@@ -1056,6 +1355,7 @@ CrushTree(WindowPtr pWin)
             pChild = pParent;
             pChild->firstChild = NullWindow;
             pChild->lastChild = NullWindow;
+            InvalidateChildIndex(pChild);
             if (pChild == pWin)
                 return;
         }
@@ -1097,6 +1397,7 @@ DeleteWindow(void *value, XID wid)
             pWin->nextSib->prevSib = pWin->prevSib;
         if (pWin->prevSib)
             pWin->prevSib->nextSib = pWin->nextSib;
+        InvalidateChildIndex(pParent);
     }
     else
         pWin->drawable.pScreen->root = NULL;
@@ -1695,6 +1996,7 @@ MoveWindowInStack(WindowPtr pWin, WindowPtr pNextSib)
                     pFirstChange = pFirstChange->nextSib;
             }
         }
+        InvalidateChildIndex(pParent);
         if (pWin->drawable.pScreen->RestackWindow)
             (*pWin->drawable.pScreen->RestackWindow) (pWin, pOldNextSib);
     }
@@ -1716,6 +2018,7 @@ MoveWindowInStack(WindowPtr pWin, WindowPtr pNextSib)
 void
 SetWinSize(WindowPtr pWin)
 {
+    InvalidateChildIndex(pWin->parent);
 #ifdef COMPOSITE
     if (pWin->redirectDraw != RedirectDrawNone) {
         BoxRec box;
@@ -1752,6 +2055,7 @@ SetBorderSize(WindowPtr pWin)
 {
     int bw;
 
+    InvalidateChildIndex(pWin->parent);
     if (HasBorder(pWin)) {
         bw = wBorderWidth(pWin);
 #ifdef COMPOSITE
@@ -2549,6 +2853,7 @@ ReparentWindow(WindowPtr pWin, WindowPtr pParent,
         pWin->nextSib->prevSib = pWin->prevSib;
     if (pWin->prevSib)
         pWin->prevSib->nextSib = pWin->nextSib;
+    InvalidateChildIndex(pPrev);
 
     /* insert at begining of pParent */
     pWin->parent = pParent;
@@ -2678,6 +2983,7 @@ MapWindow(WindowPtr pWin, ClientPtr client)
                 return Success;
 
         pWin->mapped = TRUE;
+        InvalidateChildIndex(pParent);
         if (SubStrSend(pWin, pParent))
             DeliverMapNotify(pWin);
 
@@ -2746,6 +3052,7 @@ MapSubwindows(WindowPtr pParent, ClientPtr client)
                     continue;
 
             pWin->mapped = TRUE;
+            InvalidateChildIndex(pParent);
             if (parentNotify || StrSend(pWin))
                 DeliverMapNotify(pWin);
 
@@ -2862,6 +3169,7 @@ UnmapWindow(WindowPtr pWin, Bool fromConfigure)
         (*pScreen->MarkWindow) (pLayerWin->parent);
     }
     pWin->mapped = FALSE;
+    InvalidateChildIndex(pParent);
     if (wasRealized)
         UnrealizeTree(pWin, fromConfigure);
     if (wasViewable && !fromConfigure) {
@@ -2911,6 +3219,7 @@ UnmapSubwindows(WindowPtr pWin)
                 anyMarked = TRUE;
             }
             pChild->mapped = FALSE;
+            InvalidateChildIndex(pWin);
             if (pChild->realized)
                 UnrealizeTree(pChild, FALSE);
         }
@@ -2970,8 +3279,10 @@ HandleSaveSet(ClientPtr client)
                                pParent->drawable.x,
                                pWin->drawable.y - wBorderWidth(pWin) -
                                pParent->drawable.y, client);
-                if (!pWin->realized && pWin->mapped)
+                if (!pWin->realized && pWin->mapped) {
                     pWin->mapped = FALSE;
+                    InvalidateChildIndex(pParent);
+                }
             }
             if (SaveSetShouldMap(client->saveSet[j]))
                 MapWindow(pWin, client);
@@ -3362,6 +3673,8 @@ CheckWindowOptionalNeed(WindowPtr w)
         return;
     if (optional->inputMasks != NULL)
         return;
+    if (optional->childIndex != NULL)
+        return;
     if (optional->deviceCursors != NULL) {
         DevCursNodePtr pNode = optional->deviceCursors;
 
@@ -3406,6 +3719,10 @@ MakeWindowOptional(WindowPtr pWin)
     optional->otherClients = NULL;
     optional->passiveGrabs = NULL;
     optional->userProps = NULL;
+    optional->propIndex = NULL;
+    optional->childIndex = NULL;
+    optional->deliveryPlan = NULL;
+    optional->grabIndex = NULL;
     optional->backingBitPlanes = ~0L;
     optional->backingPixel = 0;
     optional->boundingShape = NULL;
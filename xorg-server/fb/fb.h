@@ -410,6 +410,15 @@ typedef struct {
 #endif
     DevPrivateKeyRec    gcPrivateKeyRec;
     DevPrivateKeyRec    winPrivateKeyRec;
+#ifndef FB_ACCESS_WRAPPER
+    /* pixman images kept with pictures, see fbpict.c */
+    DevPrivateKeyRec    pictPrivateKeyRec;
+    DestroyPictureProcPtr DestroyPicture;
+    ChangePictureProcPtr ChangePicture;
+    ValidatePictureProcPtr ValidatePicture;
+    ChangePictureTransformProcPtr ChangePictureTransform;
+    ChangePictureFilterProcPtr ChangePictureFilter;
+#endif
 } FbScreenPrivRec, *FbScreenPrivPtr;
 
 #define fbGetScreenPrivate(pScreen) ((FbScreenPrivPtr) \
@@ -1087,6 +1096,33 @@ fbSetSpans(DrawablePtr pDrawable,
            GCPtr pGC,
            char *src, DDXPointPtr ppt, int *pwidth, int nspans, int fSorted);
 
+/*
+ * fbsimd.c
+ */
+
+#define FB_SIMD_NONE	0
+#define FB_SIMD_SSE2	1
+#define FB_SIMD_AVX2	2
+
+extern _X_EXPORT int
+fbSimdLevel(int max);
+
+extern Bool
+fbBltSimd(FbBits * src, FbStride srcStride, int srcX,
+          FbBits * dst, FbStride dstStride, int dstX,
+          int width, int height, int alu, FbBits pm, int bpp,
+          Bool reverse, Bool upsidedown);
+
+extern Bool
+fbBltOneSimd(FbStip * src, FbStride srcStride, int srcX,
+             FbBits * dst, FbStride dstStride, int dstX, int dstBpp,
+             int width, int height,
+             FbBits fgand, FbBits fgxor, FbBits bgand, FbBits bgxor);
+
+extern Bool
+fbAddSimd(CARD8 *dst, int dstStride, const CARD8 *src, int srcStride,
+          int bytes, int height);
+
 /*
  * fbsolid.c
  */
@@ -92,6 +92,10 @@ fbBlt(FbBits * srcLine,
         }
     }
 
+    if (fbBltSimd(srcLine, srcStride, srcX, dstLine, dstStride, dstX,
+                  width, height, alu, pm, bpp, reverse, upsidedown))
+        return;
+
     FbInitializeMergeRop(alu, pm);
     destInvarient = FbDestInvarientMergeRop();
     if (upsidedown) {
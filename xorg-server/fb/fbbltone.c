@@ -187,6 +187,10 @@ fbBltOne(FbStip * src, FbStride srcStride,      /* FbStip units per scanline */
     Bool endNeedsLoad = FALSE;  /* need load for endmask */
     int startbyte, endbyte;
 
+    if (fbBltOneSimd(src, srcStride, srcX, dst, dstStride, dstX, dstBpp,
+                     width, height, fgand, fgxor, bgand, bgxor))
+        return;
+
     /*
      * Do not read past the end of the buffer!
      */
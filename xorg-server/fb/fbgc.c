@@ -38,6 +38,8 @@ const GCFuncs fbGCFuncs = {
     miCopyClip,
 };
 
+static unsigned fbDirectOps(GCPtr pGC);
+
 const GCOps fbGCOps = {
     fbFillSpans,
     fbSetSpans,
@@ -58,9 +60,24 @@ const GCOps fbGCOps = {
     miImageText16,
     fbImageGlyphBlt,
     fbPolyGlyphBlt,
-    fbPushPixels
+    fbPushPixels,
+    fbDirectOps
 };
 
+/*
+ * fb draws all of these itself, except wide lines which mi turns into
+ * spans and rectangles drawn through the GC.
+ */
+static unsigned
+fbDirectOps(GCPtr pGC)
+{
+    unsigned ops = GCOpFillSpans | GCOpPolyPoint | GCOpPolyFillRect;
+
+    if (pGC->lineWidth == 0)
+        ops |= GCOpPolylines | GCOpPolySegment;
+    return ops;
+}
+
 Bool
 fbCreateGC(GCPtr pGC)
 {
@@ -34,6 +34,246 @@
 #include "picturestr.h"
 #include "mipict.h"
 #include "fbpict.h"
+#include "opaque.h"
+
+static pixman_image_t *image_from_pict_internal(PicturePtr pict, Bool has_clip,
+                                                int *xoff, int *yoff,
+                                                Bool is_alpha_map);
+
+#if defined(HAVE_PTHREAD) && !defined(FB_ACCESS_WRAPPER)
+
+#include <pthread.h>
+#include <signal.h>
+
+/*
+ * With -renderthreads n, a composite of more than FB_THREAD_MIN_PIXELS
+ * is split into bands of whole destination rows, about
+ * FB_THREAD_BAND_BYTES each, and the main thread and n workers take
+ * bands in turn.  Each row is composited starting at the same x as the
+ * whole operation would, so pixman steps through it the same way and
+ * the result is the same bit for bit.  pixman validates images on first
+ * use, which writes to them, so the main thread composites the first
+ * band before the workers see the job.  Composites reading the
+ * destination's own bits stay on the main thread, as there the order
+ * the rows are written in matters.
+ */
+#define FB_THREAD_MIN_PIXELS    (256 * 256)
+#define FB_THREAD_BAND_BYTES    (128 * 1024)
+
+typedef struct {
+    CARD8 op;
+    pixman_image_t *src, *mask, *dest;
+    int src_x, src_y, mask_x, mask_y, dst_x, dst_y;
+    int width, height;
+    int bandHeight;
+    int bands;
+    int next;                   /* first band no thread has taken */
+    int done;
+} FbCompositeJobRec, *FbCompositeJobPtr;
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t done;
+    FbCompositeJobPtr job;
+    int threads;                /* -1 when none could be started */
+} fbRenderPool = {
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+    PTHREAD_COND_INITIALIZER, NULL, 0
+};
+
+static void
+fbCompositeBand(FbCompositeJobPtr job, int band)
+{
+    int y = band * job->bandHeight;
+    int height = min(job->bandHeight, job->height - y);
+
+    pixman_image_composite(job->op, job->src, job->mask, job->dest,
+                           job->src_x, job->src_y + y,
+                           job->mask_x, job->mask_y + y,
+                           job->dst_x, job->dst_y + y, job->width, height);
+}
+
+/* Called and returns with the pool locked */
+static void
+fbCompositeBands(void)
+{
+    FbCompositeJobPtr job;
+
+    while ((job = fbRenderPool.job) && job->next < job->bands) {
+        int band = job->next++;
+
+        pthread_mutex_unlock(&fbRenderPool.lock);
+        fbCompositeBand(job, band);
+        pthread_mutex_lock(&fbRenderPool.lock);
+        if (++job->done == job->bands)
+            pthread_cond_signal(&fbRenderPool.done);
+    }
+}
+
+static void *
+fbRenderThread(void *arg)
+{
+#ifdef SIG_BLOCK
+    sigset_t set;
+
+    /* Don't handle any signals on this thread */
+    sigfillset(&set);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+#endif
+
+#if defined(HAVE_PTHREAD_SETNAME_NP_WITH_TID)
+    pthread_setname_np (pthread_self(), "RenderThread");
+#elif defined(HAVE_PTHREAD_SETNAME_NP_WITHOUT_TID)
+    pthread_setname_np ("RenderThread");
+#endif
+
+    pthread_mutex_lock(&fbRenderPool.lock);
+    for (;;) {
+        fbCompositeBands();
+        pthread_cond_wait(&fbRenderPool.work, &fbRenderPool.lock);
+    }
+    return NULL;
+}
+
+static Bool
+fbRenderPoolStart(void)
+{
+    int i;
+
+    if (fbRenderPool.threads)
+        return fbRenderPool.threads > 0;
+
+    for (i = 0; i < RenderThreads; i++) {
+        pthread_t thread;
+
+        if (pthread_create(&thread, NULL, fbRenderThread, NULL) != 0)
+            break;
+        pthread_detach(thread);
+    }
+    if (!i) {
+        LogMessage(X_WARNING, "fb: could not start render threads, "
+                   "compositing on the main thread\n");
+        fbRenderPool.threads = -1;
+        return FALSE;
+    }
+    fbRenderPool.threads = i;
+    return TRUE;
+}
+
+static Bool
+fbCompositeThreaded(CARD8 op,
+                    pixman_image_t *src,
+                    pixman_image_t *mask,
+                    pixman_image_t *dest,
+                    int src_x, int src_y,
+                    int mask_x, int mask_y,
+                    int dst_x, int dst_y, int width, int height)
+{
+    FbCompositeJobRec job;
+    uint32_t *bits = pixman_image_get_data(dest);
+    int rowBytes;
+
+    if (RenderThreads <= 0 || width * height <= FB_THREAD_MIN_PIXELS)
+        return FALSE;
+    if (pixman_image_get_data(src) == bits ||
+        (mask && pixman_image_get_data(mask) == bits))
+        return FALSE;
+    if (!fbRenderPoolStart())
+        return FALSE;
+
+    rowBytes = width * PIXMAN_FORMAT_BPP(pixman_image_get_format(dest)) / 8;
+    job.bandHeight = max(1, FB_THREAD_BAND_BYTES / max(rowBytes, 1));
+    job.bands = (height + job.bandHeight - 1) / job.bandHeight;
+    if (job.bands < 2)
+        return FALSE;
+
+    job.op = op;
+    job.src = src;
+    job.mask = mask;
+    job.dest = dest;
+    job.src_x = src_x;
+    job.src_y = src_y;
+    job.mask_x = mask_x;
+    job.mask_y = mask_y;
+    job.dst_x = dst_x;
+    job.dst_y = dst_y;
+    job.width = width;
+    job.height = height;
+
+    /* validates the images, see above */
+    fbCompositeBand(&job, 0);
+    job.next = job.done = 1;
+
+    pthread_mutex_lock(&fbRenderPool.lock);
+    fbRenderPool.job = &job;
+    pthread_cond_broadcast(&fbRenderPool.work);
+    fbCompositeBands();
+    while (job.done < job.bands)
+        pthread_cond_wait(&fbRenderPool.done, &fbRenderPool.lock);
+    fbRenderPool.job = NULL;
+    pthread_mutex_unlock(&fbRenderPool.lock);
+
+    return TRUE;
+}
+
+/*
+ * miCompositeRects fills Src and Clear rectangles through a scratch GC,
+ * which never reaches the render threads.  Rectangles big enough to
+ * split are composited from a solid picture instead, the way
+ * miCompositeRects draws every other operator, so fbComposite bands
+ * them.  A pixel ends up the same whichever way it is filled, so the
+ * rest are moved to the front of rects and left to miCompositeRects;
+ * returns how many that is.
+ */
+static int
+fbCompositeRectsThreaded(CARD8 op,
+                         PicturePtr pDst,
+                         xRenderColor * color, int nRect, xRectangle *rects)
+{
+    PicturePtr pSrc = NULL;
+    int i, n = 0, error;
+
+    for (i = 0; i < nRect; i++) {
+        xRectangle r = rects[i];
+
+        if ((CARD32) r.width * r.height <= FB_THREAD_MIN_PIXELS) {
+            rects[n++] = r;
+            continue;
+        }
+        if (!pSrc && !(pSrc = CreateSolidPicture(0, color, &error))) {
+            memmove(rects + n, rects + i, (nRect - i) * sizeof(*rects));
+            return n + nRect - i;
+        }
+        CompositePicture(op, pSrc, NULL, pDst, 0, 0, 0, 0,
+                         r.x, r.y, r.width, r.height);
+    }
+    if (pSrc)
+        FreePicture(pSrc, 0);
+    return n;
+}
+
+static void
+fbCompositeRects(CARD8 op,
+                 PicturePtr pDst,
+                 xRenderColor * color, int nRect, xRectangle *rects)
+{
+    if (color->alpha == 0xffff && op == PictOpOver)
+        op = PictOpSrc;
+    if (RenderThreads > 0 && !pDst->alphaMap &&
+        (op == PictOpSrc || op == PictOpClear))
+        nRect = fbCompositeRectsThreaded(op, pDst, color, nRect, rects);
+    if (nRect)
+        miCompositeRects(op, pDst, color, nRect, rects);
+}
+
+#else
+
+#define fbCompositeThreaded(op, src, mask, dest, src_x, src_y, \
+                            mask_x, mask_y, dst_x, dst_y, width, height) FALSE
+#define fbCompositeRects miCompositeRects
+
+#endif
 
 void
 fbComposite(CARD8 op,
@@ -58,7 +298,12 @@ fbComposite(CARD8 op,
     mask = image_from_pict(pMask, FALSE, &msk_xoff, &msk_yoff);
     dest = image_from_pict(pDst, TRUE, &dst_xoff, &dst_yoff);
 
-    if (src && dest && !(pMask && !mask)) {
+    if (src && dest && !(pMask && !mask) &&
+        !fbCompositeThreaded(op, src, mask, dest,
+                             xSrc + src_xoff, ySrc + src_yoff,
+                             xMask + msk_xoff, yMask + msk_yoff,
+                             xDst + dst_xoff, yDst + dst_yoff,
+                             width, height)) {
         pixman_image_composite(op, src, mask, dest,
                                xSrc + src_xoff, ySrc + src_yoff,
                                xMask + msk_xoff, yMask + msk_yoff,
@@ -72,14 +317,465 @@ fbComposite(CARD8 op,
 
 static pixman_glyph_cache_t *glyphCache;
 
+/*
+ * Glyphs drawn through a mask, the way Xft draws text, come from one
+ * shared A8 atlas for A1, A4 and A8 glyph sets and an ARGB one for ARGB
+ * glyphs, instead of each being copied to an image of its own in the
+ * pixman glyph cache.  An atlas is cut into shelves, rows a multiple of
+ * FB_GLYPH_SHELF_ROUND tall, and a glyph goes at the end of a shelf of
+ * its rounded height with room for it.  The atlas starts
+ * FB_GLYPH_ATLAS_ROWS tall and doubles up to FB_GLYPH_ATLAS_MAX_ROWS;
+ * once that is full, a glyph that finds no room empties the least
+ * recently drawn shelf tall enough for it, and only if there is none is
+ * the whole atlas emptied.  Each glyph remembers its slot and the serial
+ * of the shelf contents it was copied into, so a glyph freed or evicted
+ * costs only the slot, and is copied back in when it is drawn again.
+ * Glyphs are added to the mask as soon as they're found, so an eviction
+ * part way through a request loses nothing.
+ *
+ * The atlas is a cache: render/glyph.c still keeps a pixmap and picture
+ * for every glyph on every screen, which is what the atlas copies from
+ * and what other DDXes draw with.
+ */
+#define FB_GLYPH_A8             0
+#define FB_GLYPH_ARGB           1
+#define FB_GLYPH_KINDS          2
+
+#define FB_GLYPH_ATLAS_WIDTH    1024
+#define FB_GLYPH_ATLAS_ROWS     64
+#define FB_GLYPH_ATLAS_MAX_ROWS 2048
+#define FB_GLYPH_SHELF_ROUND    4
+#define FB_GLYPH_MAX_SIZE       128     /* larger glyphs aren't packed */
+
+/*
+ * Without a mask, disjoint Over and Add glyphs still go through one,
+ * unless it would be this many times the area of the glyphs
+ */
+#define FB_GLYPH_MASK_SPARSE    4
+
+typedef struct {
+    CARD16 y;
+    CARD16 height;
+    CARD16 x;                   /* first free column */
+    CARD32 serial;              /* changes whenever the shelf is emptied */
+    CARD32 used;                /* fbGlyphTick when last drawn from */
+} FbGlyphShelfRec, *FbGlyphShelfPtr;
+
+typedef struct {
+    pixman_format_code_t format;
+    pixman_image_t *image;
+    CARD8 *bits;
+    int stride;                 /* bytes */
+    int rows;
+    int top;                    /* rows taken by shelves */
+    int nshelves;
+    FbGlyphShelfRec shelves[FB_GLYPH_ATLAS_MAX_ROWS / FB_GLYPH_SHELF_ROUND];
+} FbGlyphAtlasRec, *FbGlyphAtlasPtr;
+
+typedef struct {
+    CARD16 x, y;                /* slot in the atlas */
+    CARD16 shelf;
+    CARD32 serial;              /* shelf contents the slot belongs to */
+} FbGlyphPrivRec, *FbGlyphPrivPtr;
+
+static FbGlyphAtlasRec fbGlyphAtlas[FB_GLYPH_KINDS] = {
+    { PIXMAN_a8 }, { PIXMAN_a8r8g8b8 }
+};
+static CARD32 fbGlyphSerial;
+static CARD32 fbGlyphTick;      /* counts fbGlyphsAtlas calls */
+
+static DevPrivateKeyRec fbGlyphPrivateKeyRec;
+
+#define fbGetGlyphPrivate(glyph) ((FbGlyphPrivPtr) \
+    dixLookupPrivate(&(glyph)->devPrivates, &fbGlyphPrivateKeyRec))
+
+static void
+fbGlyphAtlasReset(FbGlyphAtlasPtr atlas)
+{
+    atlas->top = 0;
+    atlas->nshelves = 0;
+}
+
+static void
+fbGlyphAtlasFini(FbGlyphAtlasPtr atlas)
+{
+    if (atlas->image)
+        pixman_image_unref(atlas->image);
+    free(atlas->bits);
+    atlas->image = NULL;
+    atlas->bits = NULL;
+    atlas->rows = 0;
+    fbGlyphAtlasReset(atlas);
+}
+
+static Bool
+fbGlyphAtlasGrow(FbGlyphAtlasPtr atlas)
+{
+    int rows = atlas->rows ? atlas->rows * 2 : FB_GLYPH_ATLAS_ROWS;
+    CARD8 *bits;
+
+    if (rows > FB_GLYPH_ATLAS_MAX_ROWS)
+        return FALSE;
+
+    atlas->stride = FB_GLYPH_ATLAS_WIDTH * PIXMAN_FORMAT_BPP(atlas->format) / 8;
+    if (!(bits = realloc(atlas->bits, (size_t) rows * atlas->stride)))
+        return FALSE;
+    atlas->bits = bits;
+
+    if (atlas->image)
+        pixman_image_unref(atlas->image);
+    atlas->image = pixman_image_create_bits(atlas->format,
+                                            FB_GLYPH_ATLAS_WIDTH, rows,
+                                            (uint32_t *) bits, atlas->stride);
+    if (!atlas->image) {
+        fbGlyphAtlasFini(atlas);
+        return FALSE;
+    }
+    if (PIXMAN_FORMAT_RGB(atlas->format))
+        pixman_image_set_component_alpha(atlas->image, TRUE);
+    atlas->rows = rows;
+    return TRUE;
+}
+
+/*
+ * The least recently drawn shelf of this rounded height or, if there is
+ * none, of any height it fits in.  A taller shelf keeps its height, so
+ * only the one glyph that emptied it is shorter than the rest.
+ */
+static FbGlyphShelfPtr
+fbGlyphAtlasVictim(FbGlyphAtlasPtr atlas, int height)
+{
+    FbGlyphShelfPtr shelf, victim = NULL;
+    Bool exact;
+    int i;
+
+    for (i = 0; i < atlas->nshelves; i++) {
+        shelf = &atlas->shelves[i];
+        if (shelf->height < height)
+            continue;
+        exact = shelf->height == height;
+        if (victim &&
+            (exact != (victim->height == height) ? !exact :
+             (CARD32) (fbGlyphTick - shelf->used) <=
+             (CARD32) (fbGlyphTick - victim->used)))
+            continue;
+        victim = shelf;
+    }
+    return victim;
+}
+
+static FbGlyphShelfPtr
+fbGlyphAtlasAlloc(FbGlyphAtlasPtr atlas, int width, int height,
+                  int *x, int *y)
+{
+    FbGlyphShelfPtr shelf;
+    int i;
+
+    /* keep slots word aligned */
+    width = (width + 3) & ~3;
+    height = (height + FB_GLYPH_SHELF_ROUND - 1) & ~(FB_GLYPH_SHELF_ROUND - 1);
+
+    /* the newest shelves are the ones likely to have room */
+    for (i = atlas->nshelves; i--;) {
+        shelf = &atlas->shelves[i];
+        if (shelf->height == height &&
+            shelf->x + width <= FB_GLYPH_ATLAS_WIDTH)
+            goto found;
+    }
+
+    while (atlas->top + height > atlas->rows) {
+        if (atlas->image && fbGlyphAtlasGrow(atlas))
+            continue;
+        /* as big as it gets, or out of memory; make room */
+        if (!(shelf = fbGlyphAtlasVictim(atlas, height)))
+            return NULL;
+        shelf->serial = ++fbGlyphSerial;
+        shelf->x = 0;
+        goto found;
+    }
+
+    shelf = &atlas->shelves[atlas->nshelves++];
+    shelf->y = atlas->top;
+    shelf->height = height;
+    shelf->x = 0;
+    shelf->serial = ++fbGlyphSerial;
+    atlas->top += height;
+
+ found:
+    *x = shelf->x;
+    *y = shelf->y;
+    shelf->x += width;
+    shelf->used = fbGlyphTick;
+    return shelf;
+}
+
+/*
+ * Finds the glyph in the atlas, copying it there if it isn't.  Returns
+ * NULL for glyphs too large to pack and when there's no memory, and
+ * these are drawn from their own picture.
+ */
+static FbGlyphAtlasPtr
+fbGlyphAtlasLookup(int kind, GlyphPtr glyph, PicturePtr pPicture,
+                   int *x, int *y)
+{
+    FbGlyphAtlasPtr atlas = &fbGlyphAtlas[kind];
+    FbGlyphPrivPtr priv = fbGetGlyphPrivate(glyph);
+    int width = glyph->info.width;
+    int height = glyph->info.height;
+    FbGlyphShelfPtr shelf;
+    pixman_image_t *image;
+    int xoff, yoff;
+
+    /* new glyphs have a serial of 0, which no shelf has */
+    if (priv->shelf < atlas->nshelves) {
+        shelf = &atlas->shelves[priv->shelf];
+        if (shelf->serial == priv->serial) {
+            shelf->used = fbGlyphTick;
+            *x = priv->x;
+            *y = priv->y;
+            return atlas;
+        }
+    }
+
+    if (width > FB_GLYPH_MAX_SIZE || height > FB_GLYPH_MAX_SIZE)
+        return NULL;
+
+    if (!atlas->image) {
+        fbGlyphAtlasReset(atlas);
+        if (!fbGlyphAtlasGrow(atlas))
+            return NULL;
+    }
+
+    if (!(shelf = fbGlyphAtlasAlloc(atlas, width, height, x, y))) {
+        /* every shelf is shorter than this glyph */
+        fbGlyphAtlasReset(atlas);
+        if (!(shelf = fbGlyphAtlasAlloc(atlas, width, height, x, y)))
+            return NULL;
+    }
+
+    if (!(image = image_from_pict_internal(pPicture, FALSE, &xoff, &yoff,
+                                           FALSE)))
+        return NULL;
+    pixman_image_composite32(PIXMAN_OP_SRC, image, NULL, atlas->image,
+                             0, 0, 0, 0, *x, *y, width, height);
+    free_pixman_pict(pPicture, image);
+
+    priv->x = *x;
+    priv->y = *y;
+    priv->shelf = shelf - atlas->shelves;
+    priv->serial = shelf->serial;
+    return atlas;
+}
+
+/* pixman's Add, for an atlas and a mask of the same format */
+static void
+fbGlyphAdd(CARD8 *dst, int dstStride, const CARD8 *src, int srcStride,
+           int bytes, int height)
+{
+    if (fbAddSimd(dst, dstStride, src, srcStride, bytes, height))
+        return;
+
+    while (height--) {
+        int i;
+
+        for (i = 0; i < bytes; i++) {
+            int t = dst[i] + src[i];
+
+            dst[i] = t | (0 - (t >> 8));
+        }
+        dst += dstStride;
+        src += srcStride;
+    }
+}
+
+static int
+fbGlyphKind(CARD32 format)
+{
+    if (format == PICT_a8r8g8b8)
+        return FB_GLYPH_ARGB;
+    if (PICT_FORMAT_TYPE(format) == PICT_TYPE_A)
+        return FB_GLYPH_A8;
+    return -1;
+}
+
+/*
+ * Adds the glyphs from the atlas into a mask and composites through
+ * that, giving the same result as pixman_composite_glyphs would.
+ *
+ * Returns FALSE, having drawn nothing, so that the caller hands the
+ * glyphs to pixman, when
+ *  - the glyphs are neither a8r8g8b8 nor alpha-only, the lists mix
+ *    formats, or the atlas private isn't registered;
+ *  - maskFormat is given and can't hold the glyph values exactly:
+ *    a8r8g8b8 glyphs need an a8r8g8b8 mask, alpha glyphs an a8 mask or
+ *    one of their own format;
+ *  - maskFormat is NULL and the glyphs are a8r8g8b8, op is neither Over
+ *    nor Add, the glyphs overlap, or their bounding box is more than
+ *    FB_GLYPH_MASK_SPARSE times their area.
+ * Otherwise returns TRUE, also when there was nothing to draw or an
+ * allocation failed.
+ */
+static Bool
+fbGlyphsAtlas(CARD8 op,
+              PicturePtr pSrc,
+              PicturePtr pDst,
+              PictFormatPtr maskFormat,
+              INT16 xSrc,
+              INT16 ySrc, int nlist, GlyphListPtr list, GlyphPtr *glyphs)
+{
+    ScreenPtr pScreen = pDst->pDrawable->pScreen;
+    CARD32 format = list->format->format;
+    int kind = fbGlyphKind(format);
+    pixman_format_code_t maskCode;
+    pixman_image_t *srcImage, *dstImage, *mask;
+    int srcXoff, srcYoff, dstXoff, dstYoff;
+    int xDst = list->xOff, yDst = list->yOff;
+    int x1 = INT_MAX, y1 = INT_MAX, x2 = INT_MIN, y2 = INT_MIN;
+    int right = INT_MIN, rowBottom = INT_MIN;
+    Bool disjoint = TRUE;
+    CARD64 area = 0;
+    CARD8 *maskBits;
+    int maskStride, bpp;
+    GlyphListPtr l;
+    GlyphPtr *g;
+    int x, y, i, n;
+
+    if (kind < 0 || !dixPrivateKeyRegistered(&fbGlyphPrivateKeyRec))
+        return FALSE;
+    for (i = 1; i < nlist; i++)
+        if (list[i].format->format != format)
+            return FALSE;
+    if (maskFormat) {
+        if (kind == FB_GLYPH_ARGB ? maskFormat->format != PICT_a8r8g8b8 :
+            maskFormat->format != PICT_a8 && maskFormat->format != format)
+            return FALSE;
+    }
+    else if (kind == FB_GLYPH_ARGB || (op != PictOpOver && op != PictOpAdd))
+        return FALSE;
+    fbGlyphTick++;
+
+    /* where the mask goes, and whether the glyphs overlap */
+    x = y = 0;
+    for (l = list, g = glyphs, i = nlist; i--; l++) {
+        x += l->xOff;
+        y += l->yOff;
+        for (n = l->len; n--; g++) {
+            GlyphPtr glyph = *g;
+
+            if (GetGlyphPicture(glyph, pScreen)) {
+                int gx1 = x - glyph->info.x, gy1 = y - glyph->info.y;
+                int gx2 = gx1 + glyph->info.width;
+                int gy2 = gy1 + glyph->info.height;
+
+                /* below everything so far starts a new row */
+                if (gy1 >= y2) {
+                    rowBottom = y2;
+                    right = INT_MIN;
+                }
+                if (gy1 < rowBottom || gx1 < right)
+                    disjoint = FALSE;
+                right = max(right, gx2);
+
+                x1 = min(x1, gx1);
+                y1 = min(y1, gy1);
+                x2 = max(x2, gx2);
+                y2 = max(y2, gy2);
+                area += (CARD64) glyph->info.width * glyph->info.height;
+            }
+            x += glyph->info.xOff;
+            y += glyph->info.yOff;
+        }
+    }
+
+    if (x1 >= x2 || y1 >= y2)
+        return TRUE;
+
+    /*
+     * Over and Add leave the destination alone where the mask is 0, so
+     * glyphs that don't overlap can be drawn through one, unless most of
+     * it would be empty.
+     */
+    if (!maskFormat &&
+        (!disjoint ||
+         (CARD64) (x2 - x1) * (y2 - y1) > FB_GLYPH_MASK_SPARSE * area))
+        return FALSE;
+
+    if (!(srcImage = image_from_pict(pSrc, FALSE, &srcXoff, &srcYoff)))
+        return TRUE;
+    if (!(dstImage = image_from_pict(pDst, TRUE, &dstXoff, &dstYoff)))
+        goto out_free_src;
+
+    maskCode = fbGlyphAtlas[kind].format;
+    if (!(mask = pixman_image_create_bits(maskCode, x2 - x1, y2 - y1,
+                                          NULL, 0)))
+        goto out_free_dst;
+    if (kind == FB_GLYPH_ARGB)
+        pixman_image_set_component_alpha(mask, TRUE);
+    maskBits = (CARD8 *) pixman_image_get_data(mask);
+    maskStride = pixman_image_get_stride(mask);
+    bpp = PIXMAN_FORMAT_BPP(maskCode) / 8;
+
+    x = y = 0;
+    for (l = list, g = glyphs, i = nlist; i--; l++) {
+        x += l->xOff;
+        y += l->yOff;
+        for (n = l->len; n--; g++) {
+            GlyphPtr glyph = *g;
+            PicturePtr pPicture = GetGlyphPicture(glyph, pScreen);
+            int gx = x - glyph->info.x - x1, gy = y - glyph->info.y - y1;
+            int width = glyph->info.width, height = glyph->info.height;
+            FbGlyphAtlasPtr atlas;
+            pixman_image_t *image;
+            int ax, ay, xoff, yoff;
+
+            x += glyph->info.xOff;
+            y += glyph->info.yOff;
+            if (!pPicture)
+                continue;
+
+            if ((atlas = fbGlyphAtlasLookup(kind, glyph, pPicture,
+                                            &ax, &ay))) {
+                fbGlyphAdd(maskBits + gy * maskStride + gx * bpp, maskStride,
+                           atlas->bits + ay * atlas->stride + ax * bpp,
+                           atlas->stride, width * bpp, height);
+            }
+            else if ((image = image_from_pict_internal(pPicture, FALSE,
+                                                       &xoff, &yoff,
+                                                       FALSE))) {
+                pixman_image_composite32(PIXMAN_OP_ADD, image, NULL, mask,
+                                         0, 0, 0, 0, gx, gy, width, height);
+                free_pixman_pict(pPicture, image);
+            }
+        }
+    }
+
+    pixman_image_composite32(op, srcImage, mask, dstImage,
+                             xSrc + srcXoff + x1 - xDst,
+                             ySrc + srcYoff + y1 - yDst,
+                             0, 0, x1 + dstXoff, y1 + dstYoff,
+                             x2 - x1, y2 - y1);
+    pixman_image_unref(mask);
+
+ out_free_dst:
+    free_pixman_pict(pDst, dstImage);
+ out_free_src:
+    free_pixman_pict(pSrc, srcImage);
+    return TRUE;
+}
+
 void
 fbDestroyGlyphCache(void)
 {
+    int i;
+
     if (glyphCache)
     {
 	pixman_glyph_cache_destroy (glyphCache);
 	glyphCache = NULL;
     }
+
+    for (i = 0; i < FB_GLYPH_KINDS; i++)
+        fbGlyphAtlasFini(&fbGlyphAtlas[i]);
 }
 
 static void
@@ -114,6 +810,10 @@ fbGlyphs(CARD8 op,
 
     miCompositeSourceValidate(pSrc);
 
+    if (fbGlyphsAtlas(op, pSrc, pDst, maskFormat, xSrc, ySrc,
+                      nlist, list, glyphs))
+        return;
+
     n_glyphs = 0;
     for (i = 0; i < nlist; ++i)
 	n_glyphs += list[i].len;
@@ -150,7 +850,10 @@ fbGlyphs(CARD8 op,
 		    goto next;
 		}
 
-		if (!(glyphImage = image_from_pict(pPicture, FALSE, &xoff, &yoff)))
+		/* pixman copies it, so don't keep it with the picture */
+		if (!(glyphImage = image_from_pict_internal(pPicture, FALSE,
+							    &xoff, &yoff,
+							    FALSE)))
 		    goto out;
 
 		g = pixman_glyph_cache_insert(glyphCache, glyph, NULL,
@@ -331,10 +1034,6 @@ create_bits_picture(PicturePtr pict, Bool has_clip, int *xoff, int *yoff)
     return image;
 }
 
-static pixman_image_t *image_from_pict_internal(PicturePtr pict, Bool has_clip,
-                                                int *xoff, int *yoff,
-                                                Bool is_alpha_map);
-
 static void image_destroy(pixman_image_t *image, void *data)
 {
     fbFinishAccess((DrawablePtr)data);
@@ -471,9 +1170,154 @@ image_from_pict_internal(PicturePtr pict, Bool has_clip, int *xoff, int *yoff,
     return image;
 }
 
+#ifndef FB_ACCESS_WRAPPER
+/*
+ * A picture on a drawable keeps the pixman images last made for it, one
+ * with its composite clip and one without, so that compositing from and
+ * to the same pictures over and over doesn't set up the transform,
+ * filter, repeat and clip every time.  Any change to the picture drops
+ * them through the screen hooks below; clip changes and window moves
+ * come through ValidatePicture.  The pixmap under the picture can change
+ * without the picture hearing of it, so that is checked on every use.
+ * Pictures with an alpha map aren't kept, as the alpha map can change on
+ * its own.  With FB_ACCESS_WRAPPER nothing is kept, as the image holds
+ * the access to the pixmap for as long as it lives.
+ */
+
+typedef struct {
+    pixman_image_t *image;
+    PixmapPtr pixmap;
+    void *bits;
+    int stride;
+    int width, height;
+    int x, y;                   /* of the drawable within the pixmap */
+    int xoff, yoff;             /* as handed back by image_from_pict */
+} FbPictImageRec, *FbPictImagePtr;
+
+typedef struct {
+    FbPictImageRec image[2];    /* indexed by has_clip */
+} FbPictPrivRec, *FbPictPrivPtr;
+
+#define fbGetPictPrivate(pict) ((FbPictPrivPtr) \
+    dixLookupPrivate(&(pict)->devPrivates, \
+                     &fbGetScreenPrivate((pict)->pDrawable->pScreen)->pictPrivateKeyRec))
+
+static FbPictImagePtr
+fbPictImage(PicturePtr pict, Bool has_clip)
+{
+    if (!pict || !pict->pDrawable || pict->alphaMap)
+        return NULL;
+    /* screens that composite with fb without fbPictureInit */
+    if (!dixPrivateKeyRegistered(&fbGetScreenPrivate(pict->pDrawable->pScreen)->
+                                 pictPrivateKeyRec))
+        return NULL;
+    return &fbGetPictPrivate(pict)->image[has_clip != FALSE];
+}
+
+static void
+fbPictDropImages(PicturePtr pict)
+{
+    FbPictPrivPtr pPriv = fbGetPictPrivate(pict);
+    int i;
+
+    for (i = 0; i < 2; i++) {
+        if (pPriv->image[i].image) {
+            pixman_image_unref(pPriv->image[i].image);
+            pPriv->image[i].image = NULL;
+        }
+    }
+}
+
+static void
+fbDestroyPicture(PicturePtr pPicture)
+{
+    FbScreenPrivPtr pScrPriv = fbGetScreenPrivate(pPicture->pDrawable->pScreen);
+
+    fbPictDropImages(pPicture);
+    (*pScrPriv->DestroyPicture) (pPicture);
+}
+
+static void
+fbChangePicture(PicturePtr pPicture, Mask mask)
+{
+    FbScreenPrivPtr pScrPriv = fbGetScreenPrivate(pPicture->pDrawable->pScreen);
+
+    fbPictDropImages(pPicture);
+    (*pScrPriv->ChangePicture) (pPicture, mask);
+}
+
+static void
+fbValidatePicture(PicturePtr pPicture, Mask mask)
+{
+    FbScreenPrivPtr pScrPriv = fbGetScreenPrivate(pPicture->pDrawable->pScreen);
+
+    fbPictDropImages(pPicture);
+    (*pScrPriv->ValidatePicture) (pPicture, mask);
+}
+
+static int
+fbChangePictureTransform(PicturePtr pPicture, PictTransform * transform)
+{
+    FbScreenPrivPtr pScrPriv = fbGetScreenPrivate(pPicture->pDrawable->pScreen);
+
+    fbPictDropImages(pPicture);
+    return (*pScrPriv->ChangePictureTransform) (pPicture, transform);
+}
+
+static int
+fbChangePictureFilter(PicturePtr pPicture, int filter, xFixed * params,
+                      int nparams)
+{
+    FbScreenPrivPtr pScrPriv = fbGetScreenPrivate(pPicture->pDrawable->pScreen);
+
+    fbPictDropImages(pPicture);
+    return (*pScrPriv->ChangePictureFilter) (pPicture, filter, params,
+                                             nparams);
+}
+#endif
+
 pixman_image_t *
 image_from_pict(PicturePtr pict, Bool has_clip, int *xoff, int *yoff)
 {
+#ifndef FB_ACCESS_WRAPPER
+    FbPictImagePtr cached = fbPictImage(pict, has_clip);
+
+    if (cached) {
+        PixmapPtr pixmap;
+        int x, y;
+
+        fbGetDrawablePixmap(pict->pDrawable, pixmap, x, y);
+        x += pict->pDrawable->x;
+        y += pict->pDrawable->y;
+
+        if (!cached->image ||
+            cached->pixmap != pixmap ||
+            cached->bits != pixmap->devPrivate.ptr ||
+            cached->stride != pixmap->devKind ||
+            cached->width != pixmap->drawable.width ||
+            cached->height != pixmap->drawable.height ||
+            cached->x != x || cached->y != y) {
+            if (cached->image)
+                pixman_image_unref(cached->image);
+            cached->image = image_from_pict_internal(pict, has_clip,
+                                                     &cached->xoff,
+                                                     &cached->yoff, FALSE);
+            if (!cached->image)
+                return NULL;
+            cached->pixmap = pixmap;
+            cached->bits = pixmap->devPrivate.ptr;
+            cached->stride = pixmap->devKind;
+            cached->width = pixmap->drawable.width;
+            cached->height = pixmap->drawable.height;
+            cached->x = x;
+            cached->y = y;
+        }
+
+        *xoff = cached->xoff;
+        *yoff = cached->yoff;
+        return pixman_image_ref(cached->image);
+    }
+#endif
     return image_from_pict_internal(pict, has_clip, xoff, yoff, FALSE);
 }
 
@@ -489,19 +1333,50 @@ fbPictureInit(ScreenPtr pScreen, PictFormatPtr formats, int nformats)
 {
 
     PictureScreenPtr ps;
+#ifndef FB_ACCESS_WRAPPER
+    FbScreenPrivPtr pScrPriv = fbGetScreenPrivate(pScreen);
+
+    if (!dixRegisterScreenSpecificPrivateKey(pScreen,
+                                             &pScrPriv->pictPrivateKeyRec,
+                                             PRIVATE_PICTURE,
+                                             sizeof(FbPictPrivRec)))
+        return FALSE;
+#endif
 
     if (!miPictureInit(pScreen, formats, nformats))
         return FALSE;
+    /*
+     * Glyph privates can't be added once there are glyphs, as there may
+     * be by the time a GPU screen is, and those don't draw glyphs anyway
+     */
+    if (!pScreen->isGPU &&
+        !dixRegisterPrivateKey(&fbGlyphPrivateKeyRec, PRIVATE_GLYPH,
+                               sizeof(FbGlyphPrivRec)))
+        return FALSE;
+
     ps = GetPictureScreen(pScreen);
     ps->Composite = fbComposite;
     ps->Glyphs = fbGlyphs;
     ps->UnrealizeGlyph = fbUnrealizeGlyph;
-    ps->CompositeRects = miCompositeRects;
+    ps->CompositeRects = fbCompositeRects;
     ps->RasterizeTrapezoid = fbRasterizeTrapezoid;
     ps->Trapezoids = fbTrapezoids;
     ps->AddTraps = fbAddTraps;
     ps->AddTriangles = fbAddTriangles;
     ps->Triangles = fbTriangles;
 
+#ifndef FB_ACCESS_WRAPPER
+    pScrPriv->DestroyPicture = ps->DestroyPicture;
+    ps->DestroyPicture = fbDestroyPicture;
+    pScrPriv->ChangePicture = ps->ChangePicture;
+    ps->ChangePicture = fbChangePicture;
+    pScrPriv->ValidatePicture = ps->ValidatePicture;
+    ps->ValidatePicture = fbValidatePicture;
+    pScrPriv->ChangePictureTransform = ps->ChangePictureTransform;
+    ps->ChangePictureTransform = fbChangePictureTransform;
+    pScrPriv->ChangePictureFilter = ps->ChangePictureFilter;
+    ps->ChangePictureFilter = fbChangePictureFilter;
+#endif
+
     return TRUE;
 }
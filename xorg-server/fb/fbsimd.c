@@ -0,0 +1,587 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Vector versions of the common fbBlt and fbBltOne cases.
+ *
+ * fbBlt works a word at a time and spends most of its effort shifting
+ * source words into line with the destination.  Once every coordinate
+ * is a whole number of bytes, which is always the case at 8, 16 and
+ * 32bpp, the shifting turns into unaligned loads, and the merge rop
+ * can be applied to 16 or 32 bytes at a time.  The same goes for
+ * expanding a bitmap to 32bpp: each bit selects a whole pixel, so a
+ * byte of stipple picks between the foreground and background rrops
+ * for eight pixels at once.
+ *
+ * SSE2 is assumed wherever the compiler does; AVX2 is picked at run
+ * time when the CPU and OS support it.  The wrapped-access build
+ * (wfb) goes through READ/WRITE and never uses these.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <string.h>
+#include "fb.h"
+
+#if !defined(FB_ACCESS_WRAPPER) && \
+    IMAGE_BYTE_ORDER == LSBFirst && BITMAP_BIT_ORDER == LSBFirst && \
+    FB_SHIFT == 5 && \
+    (defined(__SSE2__) || defined(_M_X64) || \
+     (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define FB_SIMD_USE_SSE2 1
+#include <emmintrin.h>
+
+#if defined(_MSC_VER)
+#define FB_SIMD_USE_AVX2 1
+#define FB_TARGET_AVX2
+#include <intrin.h>
+#include <immintrin.h>
+#elif defined(__GNUC__) && \
+    (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9) || \
+     defined(__clang__))
+#define FB_SIMD_USE_AVX2 1
+#define FB_TARGET_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#endif
+#endif
+
+static int fbSimd = -1;
+
+static int
+fbSimdDetect(void)
+{
+#ifdef FB_SIMD_USE_AVX2
+#ifdef _MSC_VER
+    int info[4];
+
+    __cpuid(info, 0);
+    if (info[0] >= 7) {
+        __cpuid(info, 1);
+        /* OSXSAVE and AVX, with the OS saving the YMM registers */
+        if ((info[2] & (1 << 27)) && (info[2] & (1 << 28)) &&
+            (_xgetbv(0) & 6) == 6) {
+            __cpuidex(info, 7, 0);
+            if (info[1] & (1 << 5))
+                return FB_SIMD_AVX2;
+        }
+    }
+#else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return FB_SIMD_AVX2;
+#endif
+#endif
+#ifdef FB_SIMD_USE_SSE2
+    return FB_SIMD_SSE2;
+#else
+    return FB_SIMD_NONE;
+#endif
+}
+
+/*
+ * Use the best kernels the CPU supports, but none past max.  Returns
+ * the level picked.  The server never needs to call this; it exists so
+ * that the vector and word-at-a-time code can be compared.
+ */
+int
+fbSimdLevel(int max)
+{
+    int level = fbSimdDetect();
+
+    if (level > max)
+        level = max;
+    fbSimd = level;
+    return level;
+}
+
+#ifdef FB_SIMD_USE_SSE2
+
+static inline int
+fbSimdCurrent(void)
+{
+    if (fbSimd < 0)
+        fbSimd = fbSimdDetect();
+    return fbSimd;
+}
+
+typedef struct {
+    FbBits ca1, cx1, ca2, cx2;
+    Bool destInvarient;
+} FbSimdRopRec, *FbSimdRopPtr;
+
+/*
+ * The rop constants repeat every FbBits, lined up with the destination
+ * words.  Rotated by the offset of dst into its word, they line up with
+ * any run of whole words starting at dst.
+ */
+static inline void
+fbSimdRopAt(FbSimdRopPtr rop, FbSimdRopPtr at, const CARD8 *dst)
+{
+    int shift = ((uintptr_t) dst & (sizeof(FbBits) - 1)) << 3;
+
+#define RotRop(c)   (shift ? ((c) >> shift) | ((c) << (FB_UNIT - shift)) : (c))
+    at->ca1 = RotRop(rop->ca1);
+    at->cx1 = RotRop(rop->cx1);
+    at->ca2 = RotRop(rop->ca2);
+    at->cx2 = RotRop(rop->cx2);
+#undef RotRop
+    at->destInvarient = rop->destInvarient;
+}
+
+static inline void
+fbSimdMergeRopWord(FbSimdRopPtr rop, CARD8 *dst, const CARD8 *src)
+{
+    FbSimdRopRec at;
+    FbBits s, d;
+
+    fbSimdRopAt(rop, &at, dst);
+    memcpy(&s, src, sizeof(s));
+    memcpy(&d, dst, sizeof(d));
+    d = (d & ((s & at.ca1) ^ at.cx1)) ^ ((s & at.ca2) ^ at.cx2);
+    memcpy(dst, &d, sizeof(d));
+}
+
+static inline void
+fbSimdMergeRopByte(FbSimdRopPtr rop, CARD8 *dst, const CARD8 *src)
+{
+    int shift = ((uintptr_t) dst & (sizeof(FbBits) - 1)) << 3;
+    CARD8 ca1 = rop->ca1 >> shift, cx1 = rop->cx1 >> shift;
+    CARD8 ca2 = rop->ca2 >> shift, cx2 = rop->cx2 >> shift;
+
+    *dst = (*dst & ((*src & ca1) ^ cx1)) ^ ((*src & ca2) ^ cx2);
+}
+
+/*
+ * Less than a vector's worth: words, then bytes, in the same direction
+ * as the rest of the scanline.
+ */
+static void
+fbBltRowTail(CARD8 *dst, const CARD8 *src, int n, Bool reverse,
+             FbSimdRopPtr rop)
+{
+    if (!reverse) {
+        for (; n >= 4; n -= 4, dst += 4, src += 4)
+            fbSimdMergeRopWord(rop, dst, src);
+        for (; n; n--)
+            fbSimdMergeRopByte(rop, dst++, src++);
+    }
+    else {
+        for (; n >= 4; n -= 4)
+            fbSimdMergeRopWord(rop, dst + n - 4, src + n - 4);
+        while (n--)
+            fbSimdMergeRopByte(rop, dst + n, src + n);
+    }
+}
+
+/*
+ * One scanline of bytes.  Every chunk is loaded before it is stored,
+ * and chunks are walked in the direction the caller asked for, so
+ * overlapping copies behave just as they do in fbBlt.  The chunks all
+ * sit a whole number of words from the first one and so share its
+ * rotation of the rop.
+ */
+static void
+fbBltRowSse2(CARD8 *dst, const CARD8 *src, int n, Bool reverse,
+             FbSimdRopPtr rop)
+{
+    int chunks = n >> 4, rest = n & 15;
+    FbSimdRopRec at;
+    __m128i ca1, cx1, ca2, cx2;
+    int i;
+
+    if (!chunks) {
+        fbBltRowTail(dst, src, n, reverse, rop);
+        return;
+    }
+
+    if (reverse) {
+        dst += rest;
+        src += rest;
+    }
+    fbSimdRopAt(rop, &at, dst);
+    ca1 = _mm_set1_epi32(at.ca1);
+    cx1 = _mm_set1_epi32(at.cx1);
+    ca2 = _mm_set1_epi32(at.ca2);
+    cx2 = _mm_set1_epi32(at.cx2);
+
+#define MergeRop128(d, s) { \
+    __m128i _s = _mm_loadu_si128((const __m128i *) (s)); \
+    __m128i _v = _mm_xor_si128(_mm_and_si128(_s, ca2), cx2); \
+    if (!at.destInvarient) \
+        _v = _mm_xor_si128(_mm_and_si128(_mm_loadu_si128((__m128i *) (d)), \
+                                         _mm_xor_si128(_mm_and_si128(_s, ca1), \
+                                                       cx1)), _v); \
+    _mm_storeu_si128((__m128i *) (d), _v); \
+}
+
+    if (!reverse) {
+        for (i = 0; i < chunks; i++)
+            MergeRop128(dst + (i << 4), src + (i << 4));
+        fbBltRowTail(dst + (chunks << 4), src + (chunks << 4), rest,
+                     FALSE, rop);
+    }
+    else {
+        for (i = chunks; i--;)
+            MergeRop128(dst + (i << 4), src + (i << 4));
+        fbBltRowTail(dst - rest, src - rest, rest, TRUE, rop);
+    }
+#undef MergeRop128
+}
+
+#ifdef FB_SIMD_USE_AVX2
+
+static FB_TARGET_AVX2 void
+fbBltRowAvx2(CARD8 *dst, const CARD8 *src, int n, Bool reverse,
+             FbSimdRopPtr rop)
+{
+    int chunks = n >> 5, rest = n & 31;
+    FbSimdRopRec at;
+    __m256i ca1, cx1, ca2, cx2;
+    int i;
+
+    if (!chunks) {
+        fbBltRowSse2(dst, src, n, reverse, rop);
+        return;
+    }
+
+    if (reverse) {
+        dst += rest;
+        src += rest;
+    }
+    fbSimdRopAt(rop, &at, dst);
+    ca1 = _mm256_set1_epi32(at.ca1);
+    cx1 = _mm256_set1_epi32(at.cx1);
+    ca2 = _mm256_set1_epi32(at.ca2);
+    cx2 = _mm256_set1_epi32(at.cx2);
+
+#define MergeRop256(d, s) { \
+    __m256i _s = _mm256_loadu_si256((const __m256i *) (s)); \
+    __m256i _v = _mm256_xor_si256(_mm256_and_si256(_s, ca2), cx2); \
+    if (!at.destInvarient) \
+        _v = _mm256_xor_si256( \
+            _mm256_and_si256(_mm256_loadu_si256((__m256i *) (d)), \
+                             _mm256_xor_si256(_mm256_and_si256(_s, ca1), \
+                                              cx1)), _v); \
+    _mm256_storeu_si256((__m256i *) (d), _v); \
+}
+
+    if (!reverse) {
+        for (i = 0; i < chunks; i++)
+            MergeRop256(dst + (i << 5), src + (i << 5));
+        _mm256_zeroupper();
+        fbBltRowSse2(dst + (chunks << 5), src + (chunks << 5), rest,
+                     FALSE, rop);
+    }
+    else {
+        for (i = chunks; i--;)
+            MergeRop256(dst + (i << 5), src + (i << 5));
+        _mm256_zeroupper();
+        fbBltRowSse2(dst - rest, src - rest, rest, TRUE, rop);
+    }
+#undef MergeRop256
+}
+
+#endif
+
+/*
+ * fbBlt when every coordinate falls on a byte boundary.  Returns FALSE,
+ * having done nothing, when the caller's word-at-a-time code has to run.
+ */
+Bool
+fbBltSimd(FbBits * srcLine, FbStride srcStride, int srcX,
+          FbBits * dstLine, FbStride dstStride, int dstX,
+          int width, int height, int alu, FbBits pm, int bpp,
+          Bool reverse, Bool upsidedown)
+{
+    void (*row)(CARD8 *, const CARD8 *, int, Bool, FbSimdRopPtr);
+    FbSimdRopRec rop;
+    CARD8 *src, *dst;
+    FbStride srcByteStride, dstByteStride;
+    int bytes;
+
+    FbDeclareMergeRop();
+
+    if ((srcX | dstX | width) & 7)
+        return FALSE;
+
+    switch (fbSimdCurrent()) {
+#ifdef FB_SIMD_USE_AVX2
+    case FB_SIMD_AVX2:
+        row = fbBltRowAvx2;
+        break;
+#endif
+    case FB_SIMD_SSE2:
+        row = fbBltRowSse2;
+        break;
+    default:
+        return FALSE;
+    }
+
+    FbInitializeMergeRop(alu, pm);
+    rop.ca1 = _ca1;
+    rop.cx1 = _cx1;
+    rop.ca2 = _ca2;
+    rop.cx2 = _cx2;
+    rop.destInvarient = FbDestInvarientMergeRop();
+
+    src = (CARD8 *) srcLine + (srcX >> 3);
+    dst = (CARD8 *) dstLine + (dstX >> 3);
+    srcByteStride = srcStride * (FbStride) sizeof(FbBits);
+    dstByteStride = dstStride * (FbStride) sizeof(FbBits);
+    bytes = width >> 3;
+
+    if (upsidedown) {
+        src += (height - 1) * srcByteStride;
+        dst += (height - 1) * dstByteStride;
+        srcByteStride = -srcByteStride;
+        dstByteStride = -dstByteStride;
+    }
+
+    while (height--) {
+        (*row) (dst, src, bytes, reverse, &rop);
+        src += srcByteStride;
+        dst += dstByteStride;
+    }
+    return TRUE;
+}
+
+/*
+ * The next n (up to 8) stipple bits from bit offset x of a scanline,
+ * without touching bytes past the last bit wanted.
+ */
+static inline CARD32
+fbSimdStippleBits(const CARD8 *src, int x, int n)
+{
+    const CARD8 *s = src + (x >> 3);
+    int shift = x & 7;
+    CARD32 bits = s[0] >> shift;
+
+    if (shift + n > 8)
+        bits |= (CARD32) s[1] << (8 - shift);
+    return bits & ((1 << n) - 1);
+}
+
+static inline void
+fbBltOneTail(CARD32 *dst, CARD32 bits, int n,
+             FbBits fgand, FbBits fgxor, FbBits bgand, FbBits bgxor)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        if (bits & (1 << i))
+            dst[i] = (dst[i] & fgand) ^ fgxor;
+        else
+            dst[i] = (dst[i] & bgand) ^ bgxor;
+    }
+}
+
+static inline __m128i
+fbBltOne4Sse2(__m128i m, __m128i *dst, Bool copy,
+              __m128i fa, __m128i fx, __m128i ba, __m128i bx)
+{
+    __m128i x = _mm_or_si128(_mm_and_si128(m, fx), _mm_andnot_si128(m, bx));
+
+    if (copy)
+        return x;
+    return _mm_xor_si128(
+        _mm_and_si128(_mm_loadu_si128(dst),
+                      _mm_or_si128(_mm_and_si128(m, fa),
+                                   _mm_andnot_si128(m, ba))), x);
+}
+
+static void
+fbBltOneRowSse2(CARD32 *dst, const CARD8 *src, int srcX, int n,
+                Bool copy, FbBits fgand, FbBits fgxor,
+                FbBits bgand, FbBits bgxor)
+{
+    const __m128i lo = _mm_set_epi32(8, 4, 2, 1);
+    const __m128i hi = _mm_set_epi32(128, 64, 32, 16);
+    const __m128i fa = _mm_set1_epi32(fgand), fx = _mm_set1_epi32(fgxor);
+    const __m128i ba = _mm_set1_epi32(bgand), bx = _mm_set1_epi32(bgxor);
+
+    while (n >= 8) {
+        __m128i b = _mm_set1_epi32(fbSimdStippleBits(src, srcX, 8));
+        __m128i *d = (__m128i *) dst;
+
+        _mm_storeu_si128(d, fbBltOne4Sse2(
+                             _mm_cmpeq_epi32(_mm_and_si128(b, lo), lo),
+                             d, copy, fa, fx, ba, bx));
+        _mm_storeu_si128(d + 1, fbBltOne4Sse2(
+                             _mm_cmpeq_epi32(_mm_and_si128(b, hi), hi),
+                             d + 1, copy, fa, fx, ba, bx));
+        dst += 8;
+        srcX += 8;
+        n -= 8;
+    }
+    if (n)
+        fbBltOneTail(dst, fbSimdStippleBits(src, srcX, n), n,
+                     fgand, fgxor, bgand, bgxor);
+}
+
+#ifdef FB_SIMD_USE_AVX2
+
+static FB_TARGET_AVX2 void
+fbBltOneRowAvx2(CARD32 *dst, const CARD8 *src, int srcX, int n,
+                Bool copy, FbBits fgand, FbBits fgxor,
+                FbBits bgand, FbBits bgxor)
+{
+    const __m256i sel = _mm256_set_epi32(128, 64, 32, 16, 8, 4, 2, 1);
+    const __m256i fa = _mm256_set1_epi32(fgand);
+    const __m256i fx = _mm256_set1_epi32(fgxor);
+    const __m256i ba = _mm256_set1_epi32(bgand);
+    const __m256i bx = _mm256_set1_epi32(bgxor);
+
+    while (n >= 8) {
+        __m256i m = _mm256_set1_epi32(fbSimdStippleBits(src, srcX, 8));
+        __m256i x;
+
+        m = _mm256_cmpeq_epi32(_mm256_and_si256(m, sel), sel);
+        x = _mm256_blendv_epi8(bx, fx, m);
+        if (!copy)
+            x = _mm256_xor_si256(
+                _mm256_and_si256(_mm256_loadu_si256((__m256i *) dst),
+                                 _mm256_blendv_epi8(ba, fa, m)), x);
+        _mm256_storeu_si256((__m256i *) dst, x);
+        dst += 8;
+        srcX += 8;
+        n -= 8;
+    }
+    _mm256_zeroupper();
+    if (n)
+        fbBltOneTail(dst, fbSimdStippleBits(src, srcX, n), n,
+                     fgand, fgxor, bgand, bgxor);
+}
+
+#endif
+
+/*
+ * fbBltOne from a bitmap to 32bpp.  Returns FALSE when the caller has
+ * to do the work.
+ */
+Bool
+fbBltOneSimd(FbStip * src, FbStride srcStride, int srcX,
+             FbBits * dst, FbStride dstStride, int dstX, int dstBpp,
+             int width, int height,
+             FbBits fgand, FbBits fgxor, FbBits bgand, FbBits bgxor)
+{
+    void (*row)(CARD32 *, const CARD8 *, int, int, Bool,
+                FbBits, FbBits, FbBits, FbBits);
+    Bool copy = (fgand == 0 && bgand == 0);
+    int n;
+
+    if (dstBpp != 32 || ((dstX | width) & FB_MASK))
+        return FALSE;
+
+    switch (fbSimdCurrent()) {
+#ifdef FB_SIMD_USE_AVX2
+    case FB_SIMD_AVX2:
+        row = fbBltOneRowAvx2;
+        break;
+#endif
+    case FB_SIMD_SSE2:
+        row = fbBltOneRowSse2;
+        break;
+    default:
+        return FALSE;
+    }
+
+    dst += dstX >> FB_SHIFT;
+    n = width >> FB_SHIFT;
+    while (height--) {
+        (*row) ((CARD32 *) dst, (const CARD8 *) src, srcX, n, copy,
+                fgand, fgxor, bgand, bgxor);
+        src += srcStride;
+        dst += dstStride;
+    }
+    return TRUE;
+}
+
+/*
+ * Saturating byte add, which is Render's Add for A8 and ARGB alike, as
+ * used to build glyph masks.  Returns FALSE when the caller has to do
+ * the work.
+ */
+Bool
+fbAddSimd(CARD8 *dst, int dstStride, const CARD8 *src, int srcStride,
+          int bytes, int height)
+{
+    if (fbSimdCurrent() < FB_SIMD_SSE2)
+        return FALSE;
+
+    while (height--) {
+        int i = 0;
+
+        for (; i + 16 <= bytes; i += 16) {
+            __m128i d = _mm_loadu_si128((__m128i *) (dst + i));
+            __m128i s = _mm_loadu_si128((const __m128i *) (src + i));
+
+            _mm_storeu_si128((__m128i *) (dst + i), _mm_adds_epu8(d, s));
+        }
+        for (; i + 4 <= bytes; i += 4) {
+            CARD32 d, s;
+
+            memcpy(&d, dst + i, 4);
+            memcpy(&s, src + i, 4);
+            d = _mm_cvtsi128_si32(_mm_adds_epu8(_mm_cvtsi32_si128(d),
+                                                _mm_cvtsi32_si128(s)));
+            memcpy(dst + i, &d, 4);
+        }
+        for (; i < bytes; i++) {
+            int t = dst[i] + src[i];
+
+            dst[i] = t | (0 - (t >> 8));
+        }
+        dst += dstStride;
+        src += srcStride;
+    }
+    return TRUE;
+}
+
+#else /* FB_SIMD_USE_SSE2 */
+
+Bool
+fbBltSimd(FbBits * srcLine, FbStride srcStride, int srcX,
+          FbBits * dstLine, FbStride dstStride, int dstX,
+          int width, int height, int alu, FbBits pm, int bpp,
+          Bool reverse, Bool upsidedown)
+{
+    return FALSE;
+}
+
+Bool
+fbBltOneSimd(FbStip * src, FbStride srcStride, int srcX,
+             FbBits * dst, FbStride dstStride, int dstX, int dstBpp,
+             int width, int height,
+             FbBits fgand, FbBits fgxor, FbBits bgand, FbBits bgxor)
+{
+    return FALSE;
+}
+
+Bool
+fbAddSimd(CARD8 *dst, int dstStride, const CARD8 *src, int srcStride,
+          int bytes, int height)
+{
+    return FALSE;
+}
+
+#endif /* FB_SIMD_USE_SSE2 */
@@ -1,3 +1,4 @@
+#define fbAddSimd wfbAddSimd
 #define fbAddTraps wfbAddTraps
 #define fbAddTriangles wfbAddTriangles
 #define fbAllocatePrivates wfbAllocatePrivates
@@ -6,7 +7,9 @@
 #define fbArc8 wfbArc8
 #define fbBlt wfbBlt
 #define fbBltOne wfbBltOne
+#define fbBltOneSimd wfbBltOneSimd
 #define fbBltPlane wfbBltPlane
+#define fbBltSimd wfbBltSimd
 #define fbBltStip wfbBltStip
 #define fbBres wfbBres
 #define fbBresDash wfbBresDash
@@ -111,6 +114,7 @@
 #define fbSetupScreen wfbSetupScreen
 #define fbSetVisualTypes wfbSetVisualTypes
 #define fbSetVisualTypesAndMasks wfbSetVisualTypesAndMasks
+#define fbSimdLevel wfbSimdLevel
 #define _fbSetWindowPixmap _wfbSetWindowPixmap
 #define fbSolid wfbSolid
 #define fbSolidBoxClipped wfbSolidBoxClipped
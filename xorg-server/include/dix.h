@@ -456,6 +456,9 @@ FixKeyState(DeviceEvent * /* event */ ,
 extern void
 RecalculateDeliverableEvents(WindowPtr /* pWin */ );
 
+extern void
+InvalidateDeliveryPlan(WindowPtr /* pWin */ );
+
 extern _X_EXPORT int
 OtherClientGone(void *value,
                 XID id);
@@ -28,6 +28,11 @@ OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 
 struct _GrabParameters;
 
+typedef struct _GrabIndexIter {
+    struct _GrabIndexEntry *exact, *exactStart;
+    struct _GrabIndexEntry *any, *anyStart;
+} GrabIndexIterRec, *GrabIndexIterPtr;
+
 extern void PrintDeviceGrabInfo(DeviceIntPtr dev);
 extern void UngrabAllDevices(Bool kill_client);
 
@@ -59,6 +64,11 @@ extern _X_EXPORT int AddPassiveGrabToList(ClientPtr /* client */ ,
 
 extern _X_EXPORT Bool DeletePassiveGrabFromList(GrabPtr /* pMinuendGrab */ );
 
+extern void FreeGrabIndex(WindowPtr pWin);
+extern Bool GrabIndexLookup(WindowPtr pWin, unsigned int detail,
+                            GrabIndexIterPtr iter);
+extern GrabPtr GrabIndexNext(GrabIndexIterPtr iter);
+
 extern Bool GrabIsPointerGrab(GrabPtr grab);
 extern Bool GrabIsKeyboardGrab(GrabPtr grab);
 #endif                          /* DIXGRABS_H */
@@ -73,6 +73,23 @@ typedef struct _saveSet {
 #define SaveSetAssignToRoot(ss,tr)  ((ss).toRoot = (tr))
 #define SaveSetAssignMap(ss,m)      ((ss).map = (m))
 
+/*
+ * What the adaptive scheduler (-schedAdaptive) knows about a client.
+ * Times are in microseconds; averages are exponentially weighted.
+ */
+typedef struct _SmartScheduleStats {
+    CARD64 ready_time;          /* when it last started waiting to run */
+    CARD64 run_time;            /* total time spent in its requests */
+    CARD32 requests;            /* requests dispatched */
+    CARD32 slices;              /* times it was picked to run */
+    CARD32 preempted;           /* slices cut short with requests left */
+    CARD32 cost;                /* average time per request */
+    CARD32 wait;                /* average time from ready to running */
+    CARD32 max_wait;
+    CARD32 burst;               /* average time used per slice */
+    Bool input_pending;         /* input events sent since it last ran */
+} SmartScheduleStatsRec, *SmartScheduleStatsPtr;
+
 typedef struct _Client {
     void *requestBuffer;
     void *osPrivate;             /* for OS layer, including scheduler */
@@ -107,6 +124,8 @@ typedef struct _Client {
 
     int smart_start_tick;
     int smart_stop_tick;
+    SmartScheduleStatsRec smart_stats;
+    struct _RequestProfile *req_profile;        /* for -reqprofile */
 
     DeviceIntPtr clientPtr;
     ClientIdPtr clientIds;
@@ -127,6 +146,7 @@ extern long SmartScheduleTime;
 extern long SmartScheduleInterval;
 extern long SmartScheduleSlice;
 extern long SmartScheduleMaxSlice;
+extern Bool SmartScheduleAdaptive;
 #ifdef HAVE_SETITIMER
 extern Bool SmartScheduleSignalEnable;
 #else
@@ -239,6 +239,7 @@ struct _RawDeviceEvent {
         double data_raw[MAX_VALUATORS];       /**< Valuator data as posted */
     } valuators;
     uint32_t flags;       /**< Flags to be copied into the generated event */
+    Bool relative;        /**< Valuators are deltas, not positions */
 };
 
 struct _BarrierEvent {
@@ -233,8 +233,24 @@ typedef struct _GCOps {
                         int /*h */ ,
                         int /*x */ ,
                         int /*y */ );
+
+    /*
+     * Which of the ops above draw, for this GC as last validated, without
+     * going back through pGC->ops or pGC->funcs.  A layer wrapping the GC
+     * may call those without unwrapping it first.  NULL if none do.
+     * This member is why ABI_VIDEODRV_VERSION is 26: a GCOps built
+     * against an older ABI is one pointer short.
+     */
+    unsigned (*DirectOps) (GCPtr /*pGC */ );
 } GCOps;
 
+/* bits returned by DirectOps */
+#define GCOpFillSpans           (1 << 0)
+#define GCOpPolyPoint           (1 << 1)
+#define GCOpPolylines           (1 << 2)
+#define GCOpPolySegment         (1 << 3)
+#define GCOpPolyFillRect        (1 << 4)
+
 /* there is padding in the bit fields because the Sun compiler doesn't
  * force alignment to 32-bit boundaries.  losers.
  */
@@ -125,6 +125,13 @@ extern _X_EXPORT void SetCriticalOutputPending(void);
 extern _X_EXPORT int WriteToClient(ClientPtr /*who */ , int /*count */ ,
                                    const void * /*buf */ );
 
+extern _X_EXPORT int WriteToClientNoCopy(ClientPtr /*who */ , int /*count */ ,
+                                         void * /*buf */ );
+
+extern _X_EXPORT Bool ClientOutputBackedUp(ClientPtr /*who */ );
+
+extern _X_EXPORT void *ReserveClientOutput(ClientPtr /*who */ , int /*count */ );
+
 extern _X_EXPORT void ResetOsBuffers(void);
 
 extern _X_EXPORT int TransIsListening(char *protocol);
@@ -137,6 +144,10 @@ extern _X_EXPORT void ResetWellKnownSockets(void);
 
 extern _X_EXPORT void CloseWellKnownConnections(void);
 
+extern _X_EXPORT void ReadThreadInit(void);
+
+extern _X_EXPORT void ReadThreadFini(void);
+
 extern _X_EXPORT XID AuthorizationIDOfClient(ClientPtr /*client */ );
 
 extern _X_EXPORT const char *ClientAuthorized(ClientPtr /*client */ ,
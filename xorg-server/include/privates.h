@@ -69,6 +69,7 @@ typedef struct _DevPrivateSetRec {
     unsigned offset;
     int created;
     int allocated;
+    struct _SlabCache *slab;    /* screen-specific objects of this type */
 } DevPrivateSetRec, *DevPrivateSetPtr;
 
 typedef struct _DevScreenPrivateKeyRec {
@@ -225,11 +225,56 @@ RegionCopy(RegionPtr dst, RegionPtr src)
     return pixman_region_copy(dst, src);
 }
 
+#ifdef REGION_TRACE
+extern _X_EXPORT void RegionTrace(char /*op */ ,
+                                  RegionPtr /*reg1 */ ,
+                                  RegionPtr /*reg2 */ );
+#else
+#define RegionTrace(op, reg1, reg2)
+#endif
+
+/* newReg = reg op box, without the general band algorithm for regions of
+ * a few rectangles.  box may be newReg's or reg's extents. */
+extern _X_EXPORT Bool RegionIntersectBox(RegionPtr /*newReg */ ,
+                                         RegionPtr /*reg */ ,
+                                         BoxPtr /*box */ );
+
+extern _X_EXPORT Bool RegionUnionBox(RegionPtr /*newReg */ ,
+                                     RegionPtr /*reg */ ,
+                                     BoxPtr /*box */ );
+
+extern _X_EXPORT Bool RegionSubtractBox(RegionPtr /*newReg */ ,
+                                        RegionPtr /*reg */ ,
+                                        BoxPtr /*box */ );
+
 static inline Bool
 RegionIntersect(RegionPtr newReg,       /* destination Region */
                 RegionPtr reg1, RegionPtr reg2  /* source regions     */
     )
 {
+    RegionTrace('I', reg1, reg2);
+    if (!reg1->data && !reg2->data) {
+        /* two boxes, by far the most common case */
+        BoxRec box;
+
+        box.x1 = reg1->extents.x1 > reg2->extents.x1 ?
+            reg1->extents.x1 : reg2->extents.x1;
+        box.y1 = reg1->extents.y1 > reg2->extents.y1 ?
+            reg1->extents.y1 : reg2->extents.y1;
+        box.x2 = reg1->extents.x2 < reg2->extents.x2 ?
+            reg1->extents.x2 : reg2->extents.x2;
+        box.y2 = reg1->extents.y2 < reg2->extents.y2 ?
+            reg1->extents.y2 : reg2->extents.y2;
+        if (box.x1 < box.x2 && box.y1 < box.y2)
+            RegionReset(newReg, &box);
+        else
+            RegionEmpty(newReg);
+        return TRUE;
+    }
+    if (!reg2->data)
+        return RegionIntersectBox(newReg, reg1, &reg2->extents);
+    if (!reg1->data)
+        return RegionIntersectBox(newReg, reg2, &reg1->extents);
     return pixman_region_intersect(newReg, reg1, reg2);
 }
 
@@ -238,6 +283,11 @@ RegionUnion(RegionPtr newReg,   /* destination Region */
             RegionPtr reg1, RegionPtr reg2      /* source regions     */
     )
 {
+    RegionTrace('U', reg1, reg2);
+    if (!reg2->data)
+        return RegionUnionBox(newReg, reg1, &reg2->extents);
+    if (!reg1->data)
+        return RegionUnionBox(newReg, reg2, &reg1->extents);
     return pixman_region_union(newReg, reg1, reg2);
 }
 
@@ -268,6 +318,9 @@ extern _X_EXPORT RegionPtr RegionFromRects(int /*nrects */ ,
 static inline Bool
 RegionSubtract(RegionPtr regD, RegionPtr regM, RegionPtr regS)
 {
+    RegionTrace('S', regM, regS);
+    if (!regS->data)
+        return RegionSubtractBox(regD, regM, &regS->extents);
     return pixman_region_subtract(regD, regM, regS);
 }
 
@@ -0,0 +1,69 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef REQPROFILE_H
+#define REQPROFILE_H
+
+#include "misc.h"
+#include "dix.h"
+
+/*
+ * Per-opcode request counters kept by Dispatch() when the server runs
+ * with -reqprofile, both for the whole server and for each client.
+ * Times are in microseconds.  hist[0] counts requests that took no
+ * measurable time, hist[n] those that took from 2^(n-1) up to 2^n - 1,
+ * and the last bucket everything longer.
+ */
+
+#define REQ_PROFILE_BUCKETS 24
+
+typedef struct _RequestProfileEntry {
+    CARD64 count;
+    CARD64 bytes;
+    CARD64 time;
+    CARD32 hist[REQ_PROFILE_BUCKETS];
+} RequestProfileEntryRec, *RequestProfileEntryPtr;
+
+typedef struct _RequestProfile *RequestProfilePtr;
+
+typedef void (*RequestProfileProcPtr) (int /* major */ ,
+                                       int /* minor */ ,
+                                       RequestProfileEntryPtr /* entry */ ,
+                                       void * /* closure */ );
+
+extern Bool RequestProfiling;
+
+extern void RequestProfileRecord(ClientPtr /* client */ ,
+                                 int /* major */ ,
+                                 int /* minor */ ,
+                                 int /* bytes */ ,
+                                 CARD64 /* time */ );
+
+/* client may be NULL for the server-wide counters; returns how many
+ * opcodes have been seen */
+extern int RequestProfileForEach(ClientPtr /* client */ ,
+                                 RequestProfileProcPtr /* func */ ,
+                                 void * /* closure */ );
+
+/* client may be NULL to clear the server-wide counters */
+extern void RequestProfileReset(ClientPtr /* client */ );
+
+#endif                          /* REQPROFILE_H */
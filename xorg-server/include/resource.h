@@ -209,6 +209,11 @@ extern _X_EXPORT void FindClientResourcesByType(ClientPtr client,
                                                 FindResType func,
                                                 void *cdata);
 
+/** @brief Number of resources of a type, regardless of class, that a
+           client holds. */
+extern _X_EXPORT int CountClientResourcesByType(ClientPtr client,
+                                                RESTYPE type);
+
 extern _X_EXPORT void FindAllClientResources(ClientPtr client,
                                              FindAllRes func,
                                              void *cdata);
@@ -611,6 +611,8 @@ typedef struct _Screen {
     PixmapPtr pScratchPixmap;   /* scratch pixmap "pool" */
 
     unsigned int totalPixmapSize;
+    /* headers, and pixmaps of up to 4k of data, see AllocatePixmap */
+    struct _SlabCache *pixmapSlabs[7];
 
     MarkWindowProcPtr MarkWindow;
     MarkOverlappedWindowsProcPtr MarkOverlappedWindows;
@@ -0,0 +1,64 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef SLAB_H
+#define SLAB_H
+
+#include "misc.h"
+
+/*
+ * Fixed-size object caches for the structures the server creates and
+ * destroys by the thousand: windows, GCs, pictures and pixmap headers,
+ * privates included.  A cache hands out objects of up to the size it was
+ * created with from slabs of several at a time; anything larger, or
+ * anything asked of a NULL cache, comes straight from malloc.  Either way
+ * the object goes back with SlabFree.
+ */
+
+typedef struct _SlabCache *SlabCachePtr;
+
+typedef struct _SlabStats {
+    unsigned long allocs;       /* objects asked of the cache */
+    unsigned long hits;         /* of those, served from a slab it held */
+    unsigned long inUse;        /* objects out of the cache's slabs */
+    unsigned long peakInUse;
+    unsigned long slabs;        /* slabs held, the spare included */
+    unsigned long peakSlabs;
+    unsigned long perSlab;      /* objects per slab */
+} SlabStatsRec, *SlabStatsPtr;
+
+/* name is not copied */
+extern SlabCachePtr SlabCacheCreate(const char * /* name */ ,
+                                    unsigned /* size */ );
+
+/* Logs the statistics and gives up the cache.  Objects still out may be
+ * freed later; the memory goes once the last of them has. */
+extern void SlabCacheDestroy(SlabCachePtr /* cache */ );
+
+extern void *SlabAlloc(SlabCachePtr /* cache */ ,
+                       unsigned /* size */ );
+
+extern void SlabFree(void * /* object */ );
+
+extern void SlabCacheGetStats(SlabCachePtr /* cache */ ,
+                              SlabStatsPtr /* stats */ );
+
+#endif                          /* SLAB_H */
@@ -210,6 +210,23 @@ extern _X_EXPORT Bool MakeWindowOptional(WindowPtr /*pWin */ );
 extern _X_EXPORT WindowPtr MoveWindowInStack(WindowPtr /*pWin */ ,
                                              WindowPtr /*pNextSib */ );
 
+typedef struct _ChildIndexIter {
+    struct _ChildIndex *index;
+    int x, y;
+    const int *cell, *cellEnd;
+    const int *large, *largeEnd;
+} ChildIndexIterRec, *ChildIndexIterPtr;
+
+extern _X_EXPORT void InvalidateChildIndex(WindowPtr /*pParent */ );
+
+extern _X_EXPORT Bool ChildIndexLookup(WindowPtr /*pParent */ ,
+                                       int /*x */ ,
+                                       int /*y */ ,
+                                       Bool /*build */ ,
+                                       ChildIndexIterPtr /*iter */ );
+
+extern _X_EXPORT WindowPtr ChildIndexNext(ChildIndexIterPtr /*iter */ );
+
 extern _X_EXPORT void SetWinSize(WindowPtr /*pWin */ );
 
 extern _X_EXPORT void SetBorderSize(WindowPtr /*pWin */ );
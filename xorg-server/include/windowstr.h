@@ -86,6 +86,10 @@ typedef struct _WindowOpt {
     struct _OtherClients *otherClients; /* default: NULL */
     struct _GrabRec *passiveGrabs;      /* default: NULL */
     PropertyPtr userProps;      /* default: NULL */
+    struct _PropertyIndex *propIndex;   /* default: NULL */
+    struct _ChildIndex *childIndex;     /* default: NULL */
+    struct _DeliveryPlan *deliveryPlan; /* default: NULL */
+    struct _GrabIndex *grabIndex;       /* default: NULL */
     CARD32 backingBitPlanes;    /* default: ~0L */
     CARD32 backingPixel;        /* default: 0 */
     RegionPtr boundingShape;    /* default: NULL */
@@ -0,0 +1,126 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * X-Resource requests this server adds on top of version 1.2.  They are
+ * not part of any released version of the extension and QueryVersion does
+ * not advertise them; clients have to be prepared for BadRequest.  Kept
+ * out of XResproto.h so that the shared protocol header stays as
+ * released.
+ */
+
+#ifndef _XRESPRIVPROTO_H
+#define _XRESPRIVPROTO_H
+
+#include <X11/extensions/XResproto.h>
+
+#define X_XResQueryClientSchedule     6
+#define X_XResQueryRequestProfile     7
+
+/* XResQueryClientSchedule */
+
+typedef struct _XResQueryClientSchedule {
+   CARD8   reqType;
+   CARD8   XResReqType;
+   CARD16  length;
+   CARD32  xid;                 /* None for all clients */
+} xXResQueryClientScheduleReq;
+#define sz_xXResQueryClientScheduleReq 8
+
+/* times in microseconds, averages exponentially weighted */
+typedef struct {
+   CARD32  resource_base;
+   INT32   priority;
+   INT32   smart_priority;
+   CARD32  requests;
+   CARD32  slices;
+   CARD32  preempted;
+   CARD32  run_time;
+   CARD32  run_time_overflow;
+   CARD32  cost;                /* average per request */
+   CARD32  wait;                /* average from ready to running */
+   CARD32  max_wait;
+   CARD32  burst;               /* average per slice */
+} xXResClientSchedule;
+#define sz_xXResClientSchedule 48
+
+typedef struct {
+   CARD8   type;
+   CARD8   adaptive;            /* whether the server measures times */
+   CARD16  sequenceNumber;
+   CARD32  length;
+   CARD32  num_clients;
+   CARD32  pad2;
+   CARD32  pad3;
+   CARD32  pad4;
+   CARD32  pad5;
+   CARD32  pad6;
+   // followed by num_clients times XResClientSchedule
+} xXResQueryClientScheduleReply;
+#define sz_xXResQueryClientScheduleReply  32
+
+/* XResQueryRequestProfile */
+
+typedef struct _XResQueryRequestProfile {
+   CARD8   reqType;
+   CARD8   XResReqType;
+   CARD16  length;
+   CARD32  xid;                 /* None for the whole server */
+   CARD8   reset;               /* clear the counts once reported */
+   CARD8   pad1;
+   CARD16  pad2;
+} xXResQueryRequestProfileReq;
+#define sz_xXResQueryRequestProfileReq 12
+
+#define XResRequestProfileBuckets 24
+
+/* times in microseconds; hist[0] counts requests that took under one,
+   hist[n] those under 2^n, the last bucket everything longer */
+typedef struct {
+   CARD8   major;
+   CARD8   minor;               /* 0 for core requests */
+   CARD16  pad;
+   CARD32  count;
+   CARD32  count_overflow;
+   CARD32  bytes;
+   CARD32  bytes_overflow;
+   CARD32  time;
+   CARD32  time_overflow;
+   CARD32  hist[XResRequestProfileBuckets];
+} xXResRequestProfile;
+#define sz_xXResRequestProfile 124
+
+typedef struct {
+   CARD8   type;
+   CARD8   enabled;             /* whether the server counts requests */
+   CARD16  sequenceNumber;
+   CARD32  length;
+   CARD32  num_requests;
+   CARD32  pad2;
+   CARD32  pad3;
+   CARD32  pad4;
+   CARD32  pad5;
+   CARD32  pad6;
+   // followed by num_requests times XResRequestProfile
+} xXResQueryRequestProfileReply;
+#define sz_xXResQueryRequestProfileReply  32
+
+#endif /* _XRESPRIVPROTO_H */
@@ -209,6 +209,10 @@ extern _X_EXPORT void mieqProcessDeviceEvent(DeviceIntPtr /* dev */ ,
 extern _X_EXPORT void mieqProcessInputEvents(void
     );
 
+extern void mieqGetCounters(unsigned long * /* dropped */ ,
+                            unsigned long * /* coalesced */
+    );
+
 extern DeviceIntPtr CopyGetMasterEvent(DeviceIntPtr /* sdev */ ,
                                        InternalEvent * /* original */ ,
                                        InternalEvent *  /* copy */
@@ -414,6 +418,10 @@ extern _X_EXPORT int miValidateTree(WindowPtr /*pParent */ ,
                                     VTKind      /*kind */
     );
 
+extern void miValidateTreeGetCounters(unsigned long * /* computed */ ,
+                                      unsigned long * /* kept */
+    );
+
 extern _X_EXPORT void miWideLine(DrawablePtr /*pDrawable */ ,
                                  GCPtr /*pGC */ ,
                                  int /*mode */ ,
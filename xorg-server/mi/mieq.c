@@ -59,13 +59,50 @@ in this Software without prior written authorization from The Open Group.
 #include <X11/extensions/dpmsconst.h>
 #endif
 
-/* Maximum size should be initial size multiplied by a power of 2 */
-#define QUEUE_INITIAL_SIZE                 1024
-#define QUEUE_RESERVED_SIZE                 64
-#define QUEUE_MAXIMUM_SIZE                4096
+/*
+ * The queue is a single-producer, single-consumer ring.  The producer is
+ * whoever calls mieqEnqueue() with input_lock held, normally the input
+ * thread; the consumer is mieqProcessInputEvents() on the main thread,
+ * which takes no lock at all.  Events are handed to the processing code
+ * in the slot they were queued into and the slot is only given back
+ * afterwards, so nothing is copied on the way out.
+ *
+ * head is only written by the consumer and tail only by the producer;
+ * they live on separate cache lines so the two threads don't bounce a
+ * line between them on every event.
+ *
+ * Once QUEUE_COALESCE_THRESHOLD events are waiting, a motion event
+ * replaces the one before it if that was a motion event from the
+ * same device, and a raw motion event is folded into the raw event of
+ * the pair before it.  To do that the producer takes the last slots back
+ * by moving tail down, and then checks claimed to see whether the
+ * consumer already got to them; the consumer sets claimed before it
+ * looks at tail.  One of the two always sees the other's store, so a
+ * slot is never rewritten while it is being processed.
+ */
+
+#define QUEUE_SIZE                        4096  /* must be a power of 2 */
+#define QUEUE_INITIAL_SIZE                1024  /* slots allocated up front */
+#define QUEUE_COALESCE_THRESHOLD           256
+#define QUEUE_CACHELINE                     64
 #define QUEUE_DROP_BACKTRACE_FREQUENCY     100
 #define QUEUE_DROP_BACKTRACE_MAX            10
 
+#define QUEUE_MASK(n) ((n) & (QUEUE_SIZE - 1))
+
+#if INPUTTHREAD
+#define QUEUE_LOAD(p)           __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define QUEUE_STORE(p, v)       __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#define QUEUE_LOAD_SC(p)        __atomic_load_n(p, __ATOMIC_SEQ_CST)
+#define QUEUE_STORE_SC(p, v)    __atomic_store_n(p, v, __ATOMIC_SEQ_CST)
+#else
+/* producer and consumer are the same thread */
+#define QUEUE_LOAD(p)           (*(p))
+#define QUEUE_STORE(p, v)       (*(p) = (v))
+#define QUEUE_LOAD_SC(p)        (*(p))
+#define QUEUE_STORE_SC(p, v)    (*(p) = (v))
+#endif
+
 #define EnqueueScreen(dev) dev->spriteInfo->sprite->pEnqueueScreen
 #define DequeueScreen(dev) dev->spriteInfo->sprite->pDequeueScreen
 
@@ -76,116 +113,221 @@ typedef struct _Event {
 } EventRec, *EventPtr;
 
 typedef struct _EventQueue {
-    HWEventQueueType head, tail;        /* long for SetInputCheck */
+    /* consumer side */
+    HWEventQueueType head;      /* int for SetInputCheck */
+    int claimed;                /* slot being processed, or -1 */
+    unsigned long dropReported; /* value of dropped when last reported */
+    char pad0[QUEUE_CACHELINE];
+
+    /* producer side */
+    HWEventQueueType tail;
     CARD32 lastEventTime;       /* to avoid time running backwards */
     int lastMotion;             /* device ID if last event motion? */
+    int lastRawMotion;          /* device ID if last event raw motion? */
+    int lastPair;               /* device ID if last two raw + motion? */
+    int hiddenMotion;           /* device ID if slot tail holds its motion */
+    unsigned long dropped;      /* total number of dropped events */
+    unsigned long droppedRun;   /* counter for number of consecutive dropped events */
+    unsigned long coalesced;    /* total number of coalesced events */
+    char pad1[QUEUE_CACHELINE];
+
     EventRec *events;           /* our queue as an array */
-    size_t nevents;             /* the number of buckets in our queue */
-    size_t dropped;             /* counter for number of consecutive dropped events */
     mieqHandler handlers[128];  /* custom event handler */
 } EventQueueRec, *EventQueuePtr;
 
 static EventQueueRec miEventQueue;
 
-static size_t
+/* Only meaningful on the producer side */
+static unsigned int
 mieqNumEnqueued(EventQueuePtr eventQueue)
 {
-    size_t n_enqueued = 0;
+    return QUEUE_MASK(eventQueue->tail - QUEUE_LOAD(&eventQueue->head));
+}
 
-    if (eventQueue->nevents) {
-        /* % is not well-defined with negative numbers... sigh */
-        n_enqueued = eventQueue->tail - eventQueue->head + eventQueue->nevents;
-        if (n_enqueued >= eventQueue->nevents)
-            n_enqueued -= eventQueue->nevents;
+Bool
+mieqInit(void)
+{
+    int i;
+
+    memset(&miEventQueue, 0, sizeof(miEventQueue));
+    miEventQueue.lastEventTime = GetTimeInMillis();
+    miEventQueue.claimed = -1;
+
+    miEventQueue.events = calloc(QUEUE_SIZE, sizeof(EventRec));
+    if (!miEventQueue.events)
+        FatalError("Could not allocate event queue.\n");
+    for (i = 0; i < QUEUE_INITIAL_SIZE; i++) {
+        miEventQueue.events[i].events = InitEventList(1);
+        if (!miEventQueue.events[i].events)
+            FatalError("Could not allocate event queue.\n");
     }
-    return n_enqueued;
+
+    SetInputCheck(&miEventQueue.head, &miEventQueue.tail);
+    return TRUE;
 }
 
-/* Pre-condition: Called with input_lock held */
-static Bool
-mieqGrowQueue(EventQueuePtr eventQueue, size_t new_nevents)
+void
+mieqFini(void)
 {
-    size_t i, n_enqueued, first_hunk;
-    EventRec *new_events;
+    int i;
 
-    if (!eventQueue) {
-        ErrorF("[mi] mieqGrowQueue called with a NULL eventQueue\n");
-        return FALSE;
+    if (miEventQueue.coalesced || miEventQueue.dropped)
+        LogMessageVerb(X_INFO, 3, "[mi] EQ coalesced %lu and dropped %lu "
+                       "events.\n", miEventQueue.coalesced,
+                       miEventQueue.dropped);
+
+    for (i = 0; i < QUEUE_SIZE && miEventQueue.events; i++) {
+        if (miEventQueue.events[i].events != NULL) {
+            FreeEventList(miEventQueue.events[i].events, 1);
+            miEventQueue.events[i].events = NULL;
+        }
     }
+    free(miEventQueue.events);
+    miEventQueue.events = NULL;
+}
 
-    if (new_nevents <= eventQueue->nevents)
-        return FALSE;
+void
+mieqGetCounters(unsigned long *dropped, unsigned long *coalesced)
+{
+    *dropped = QUEUE_LOAD(&miEventQueue.dropped);
+    *coalesced = QUEUE_LOAD(&miEventQueue.coalesced);
+}
 
-    new_events = calloc(new_nevents, sizeof(EventRec));
-    if (new_events == NULL) {
-        ErrorF("[mi] mieqGrowQueue memory allocation error.\n");
-        return FALSE;
-    }
+/*
+ * Take the last n published slots back from the consumer.  Fails if the
+ * consumer may already have started on any of them.
+ */
+static Bool
+mieqRetract(EventQueuePtr eventQueue, unsigned int n)
+{
+    unsigned int tail = eventQueue->tail;
+    unsigned int first = QUEUE_MASK(tail - n);
+    int claimed;
 
-    n_enqueued = mieqNumEnqueued(eventQueue);
+    if (mieqNumEnqueued(eventQueue) < n)
+        return FALSE;
 
-    /* First copy the existing events */
-    first_hunk = eventQueue->nevents - eventQueue->head;
-    if (eventQueue->events) {
-        memcpy(new_events,
-               &eventQueue->events[eventQueue->head],
-               first_hunk * sizeof(EventRec));
-        memcpy(&new_events[first_hunk],
-               eventQueue->events, eventQueue->head * sizeof(EventRec));
+    QUEUE_STORE_SC(&eventQueue->tail, first);
+    claimed = QUEUE_LOAD_SC(&eventQueue->claimed);
+    if ((claimed >= 0 && QUEUE_MASK(claimed - first) < n) ||
+        QUEUE_MASK(tail - QUEUE_LOAD(&eventQueue->head)) < n) {
+        QUEUE_STORE(&eventQueue->tail, tail);
+        return FALSE;
     }
+    return TRUE;
+}
 
-    /* Initialize the new portion */
-    for (i = eventQueue->nevents; i < new_nevents; i++) {
-        InternalEvent *evlist = InitEventList(1);
+static Bool
+mieqCanCoalesce(EventPtr slot, DeviceIntPtr pDev, InternalEvent *e)
+{
+    if (slot->pDev != pDev || slot->pScreen != EnqueueScreen(pDev))
+        return FALSE;
+    if (e->any.type == ET_RawMotion)
+        return slot->events->raw_event.flags == e->raw_event.flags &&
+            slot->events->raw_event.relative == e->raw_event.relative;
+    return slot->events->device_event.flags == e->device_event.flags;
+}
 
-        if (!evlist) {
-            size_t j;
+/* Positions are replaced, relative axes add up */
+static void
+mieqMergeRawMotion(RawDeviceEvent *into, const RawDeviceEvent *from)
+{
+    int i;
 
-            for (j = 0; j < i; j++)
-                FreeEventList(new_events[j].events, 1);
-            free(new_events);
-            return FALSE;
+    for (i = 0; i < MAX_VALUATORS; i++) {
+        if (!BitIsOn(from->valuators.mask, i))
+            continue;
+        if (from->relative && BitIsOn(into->valuators.mask, i)) {
+            into->valuators.data[i] += from->valuators.data[i];
+            into->valuators.data_raw[i] += from->valuators.data_raw[i];
+        }
+        else {
+            into->valuators.data[i] = from->valuators.data[i];
+            into->valuators.data_raw[i] = from->valuators.data_raw[i];
+            SetBit(into->valuators.mask, i);
         }
-        new_events[i].events = evlist;
     }
+    into->time = from->time;
+}
 
-    /* And update our record */
-    eventQueue->tail = n_enqueued;
-    eventQueue->head = 0;
-    eventQueue->nevents = new_nevents;
-    free(eventQueue->events);
-    eventQueue->events = new_events;
+/* The new event has the latest position; keep axes only the old one set */
+static void
+mieqMergeMotion(DeviceEvent *into, const DeviceEvent *from)
+{
+    int i;
 
-    return TRUE;
+    for (i = 0; i < MAX_VALUATORS; i++) {
+        if (BitIsOn(from->valuators.mask, i) &&
+            !BitIsOn(into->valuators.mask, i)) {
+            into->valuators.data[i] = from->valuators.data[i];
+            SetBit(into->valuators.mask, i);
+            if (BitIsOn(from->valuators.mode, i))
+                SetBit(into->valuators.mode, i);
+        }
+    }
 }
 
-Bool
-mieqInit(void)
+static void
+mieqFillSlot(EventQueuePtr eventQueue, EventPtr slot, DeviceIntPtr pDev,
+             InternalEvent *e)
 {
-    memset(&miEventQueue, 0, sizeof(miEventQueue));
-    miEventQueue.lastEventTime = GetTimeInMillis();
+    InternalEvent *evt = slot->events;
+    Time time;
 
-    input_lock();
-    if (!mieqGrowQueue(&miEventQueue, QUEUE_INITIAL_SIZE))
-        FatalError("Could not allocate event queue.\n");
-    input_unlock();
+    memcpy(evt, e, e->any.length);
 
-    SetInputCheck(&miEventQueue.head, &miEventQueue.tail);
-    return TRUE;
+    time = e->any.time;
+    /* Make sure that event times don't go backwards - this
+     * is "unnecessary", but very useful. */
+    if (time < eventQueue->lastEventTime &&
+        eventQueue->lastEventTime - time < 10000)
+        e->any.time = eventQueue->lastEventTime;
+
+    eventQueue->lastEventTime = evt->any.time;
+    slot->pScreen = pDev ? EnqueueScreen(pDev) : NULL;
+    slot->pDev = pDev;
 }
 
-void
-mieqFini(void)
+/* Try to fold e into the events at the end of the queue */
+static Bool
+mieqCoalesce(EventQueuePtr eventQueue, DeviceIntPtr pDev, InternalEvent *e,
+             int isMotion, int isRawMotion)
 {
-    int i;
+    EventPtr slot;
+    DeviceEvent old;
 
-    for (i = 0; i < miEventQueue.nevents; i++) {
-        if (miEventQueue.events[i].events != NULL) {
-            FreeEventList(miEventQueue.events[i].events, 1);
-            miEventQueue.events[i].events = NULL;
+    if (isMotion && isMotion == eventQueue->lastMotion) {
+        if (!mieqRetract(eventQueue, 1))
+            return FALSE;
+        slot = &eventQueue->events[eventQueue->tail];
+        if (!mieqCanCoalesce(slot, pDev, e)) {
+            QUEUE_STORE(&eventQueue->tail, QUEUE_MASK(eventQueue->tail + 1));
+            return FALSE;
         }
+        old = slot->events->device_event;
+        mieqFillSlot(eventQueue, slot, pDev, e);
+        mieqMergeMotion(&slot->events->device_event, &old);
+        QUEUE_STORE(&eventQueue->tail, QUEUE_MASK(eventQueue->tail + 1));
+        return TRUE;
     }
-    free(miEventQueue.events);
+
+    if (isRawMotion && isRawMotion == eventQueue->lastPair) {
+        /* raw and motion event of the previous pair */
+        if (!mieqRetract(eventQueue, 2))
+            return FALSE;
+        slot = &eventQueue->events[eventQueue->tail];
+        if (!mieqCanCoalesce(slot, pDev, e)) {
+            QUEUE_STORE(&eventQueue->tail, QUEUE_MASK(eventQueue->tail + 2));
+            return FALSE;
+        }
+        mieqMergeRawMotion(&slot->events->raw_event, &e->raw_event);
+        /* the motion event stays hidden until the next one replaces it */
+        eventQueue->hiddenMotion = isRawMotion;
+        QUEUE_STORE(&eventQueue->tail, QUEUE_MASK(eventQueue->tail + 1));
+        return TRUE;
+    }
+
+    return FALSE;
 }
 
 /*
@@ -196,73 +338,92 @@ mieqFini(void)
 void
 mieqEnqueue(DeviceIntPtr pDev, InternalEvent *e)
 {
-    unsigned int oldtail = miEventQueue.tail;
-    InternalEvent *evt;
-    int isMotion = 0;
-    int evlen;
-    Time time;
-    size_t n_enqueued;
+    EventQueuePtr eventQueue = &miEventQueue;
+    unsigned int tail;
+    EventPtr slot;
+    int isMotion = 0, isRawMotion = 0;
 
     verify_internal_event(e);
 
-    n_enqueued = mieqNumEnqueued(&miEventQueue);
-
     /* avoid merging events from different devices */
-    if (e->any.type == ET_Motion)
+    if (pDev && e->any.type == ET_Motion &&
+        !(e->device_event.flags & TOUCH_POINTER_EMULATED))
         isMotion = pDev->id;
+    else if (pDev && e->any.type == ET_RawMotion)
+        isRawMotion = pDev->id;
 
-    if (isMotion && isMotion == miEventQueue.lastMotion &&
-        oldtail != miEventQueue.head) {
-        oldtail = (oldtail - 1) % miEventQueue.nevents;
-    }
-    else if (n_enqueued + 1 == miEventQueue.nevents) {
-        if (!mieqGrowQueue(&miEventQueue, miEventQueue.nevents << 1)) {
-            /* Toss events which come in late.  Usually this means your server's
-             * stuck in an infinite loop in the main thread.
-             */
-            miEventQueue.dropped++;
-            if (miEventQueue.dropped == 1) {
-                ErrorFSigSafe("[mi] EQ overflowing.  Additional events will be "
-                              "discarded until existing events are processed.\n");
-                xorg_backtrace();
-                ErrorFSigSafe("[mi] These backtraces from mieqEnqueue may point to "
-                              "a culprit higher up the stack.\n");
-                ErrorFSigSafe("[mi] mieq is *NOT* the cause.  It is a victim.\n");
-            }
-            else if (miEventQueue.dropped % QUEUE_DROP_BACKTRACE_FREQUENCY == 0 &&
-                     miEventQueue.dropped / QUEUE_DROP_BACKTRACE_FREQUENCY <=
-                     QUEUE_DROP_BACKTRACE_MAX) {
-                ErrorFSigSafe("[mi] EQ overflow continuing.  %zu events have been "
-                              "dropped.\n", miEventQueue.dropped);
-                if (miEventQueue.dropped / QUEUE_DROP_BACKTRACE_FREQUENCY ==
-                    QUEUE_DROP_BACKTRACE_MAX) {
-                    ErrorFSigSafe("[mi] No further overflow reports will be "
-                                  "reported until the clog is cleared.\n");
-                }
-                xorg_backtrace();
-            }
-            return;
+    if (eventQueue->hiddenMotion) {
+        Bool replaced = FALSE;
+
+        slot = &eventQueue->events[eventQueue->tail];
+        if (isMotion == eventQueue->hiddenMotion &&
+            mieqCanCoalesce(slot, pDev, e)) {
+            DeviceEvent old = slot->events->device_event;
+
+            mieqFillSlot(eventQueue, slot, pDev, e);
+            mieqMergeMotion(&slot->events->device_event, &old);
+            eventQueue->coalesced++;
+            replaced = TRUE;
         }
-        oldtail = miEventQueue.tail;
+
+        /* either way the slot goes out now */
+        QUEUE_STORE(&eventQueue->tail, QUEUE_MASK(eventQueue->tail + 1));
+        eventQueue->lastMotion = eventQueue->hiddenMotion;
+        eventQueue->lastPair = eventQueue->hiddenMotion;
+        eventQueue->lastRawMotion = 0;
+        eventQueue->hiddenMotion = 0;
+        if (replaced)
+            return;
     }
 
-    evlen = e->any.length;
-    evt = miEventQueue.events[oldtail].events;
-    memcpy(evt, e, evlen);
+    if ((isMotion || isRawMotion) &&
+        mieqNumEnqueued(eventQueue) >= QUEUE_COALESCE_THRESHOLD &&
+        mieqCoalesce(eventQueue, pDev, e, isMotion, isRawMotion)) {
+        eventQueue->coalesced++;
+        eventQueue->droppedRun = 0;
+        return;
+    }
 
-    time = e->any.time;
-    /* Make sure that event times don't go backwards - this
-     * is "unnecessary", but very useful. */
-    if (time < miEventQueue.lastEventTime &&
-        miEventQueue.lastEventTime - time < 10000)
-        e->any.time = miEventQueue.lastEventTime;
+    tail = eventQueue->tail;
+    slot = &eventQueue->events[tail];
+    if (QUEUE_MASK(tail + 1) == QUEUE_LOAD(&eventQueue->head) ||
+        (!slot->events && !(slot->events = InitEventList(1)))) {
+        /* Toss events which come in late.  Usually this means your server's
+         * stuck in an infinite loop in the main thread.
+         */
+        eventQueue->dropped++;
+        eventQueue->droppedRun++;
+        if (eventQueue->droppedRun == 1) {
+            ErrorFSigSafe("[mi] EQ overflowing.  Additional events will be "
+                          "discarded until existing events are processed.\n");
+            xorg_backtrace();
+            ErrorFSigSafe("[mi] These backtraces from mieqEnqueue may point to "
+                          "a culprit higher up the stack.\n");
+            ErrorFSigSafe("[mi] mieq is *NOT* the cause.  It is a victim.\n");
+        }
+        else if (eventQueue->droppedRun % QUEUE_DROP_BACKTRACE_FREQUENCY == 0 &&
+                 eventQueue->droppedRun / QUEUE_DROP_BACKTRACE_FREQUENCY <=
+                 QUEUE_DROP_BACKTRACE_MAX) {
+            ErrorFSigSafe("[mi] EQ overflow continuing.  %zu events have been "
+                          "dropped.\n", (size_t) eventQueue->droppedRun);
+            if (eventQueue->droppedRun / QUEUE_DROP_BACKTRACE_FREQUENCY ==
+                QUEUE_DROP_BACKTRACE_MAX) {
+                ErrorFSigSafe("[mi] No further overflow reports will be "
+                              "reported until the clog is cleared.\n");
+            }
+            xorg_backtrace();
+        }
+        return;
+    }
+    eventQueue->droppedRun = 0;
 
-    miEventQueue.lastEventTime = evt->any.time;
-    miEventQueue.events[oldtail].pScreen = pDev ? EnqueueScreen(pDev) : NULL;
-    miEventQueue.events[oldtail].pDev = pDev;
+    mieqFillSlot(eventQueue, slot, pDev, e);
 
-    miEventQueue.lastMotion = isMotion;
-    miEventQueue.tail = (oldtail + 1) % miEventQueue.nevents;
+    eventQueue->lastPair =
+        (isMotion && isMotion == eventQueue->lastRawMotion) ? isMotion : 0;
+    eventQueue->lastMotion = isMotion;
+    eventQueue->lastRawMotion = isRawMotion;
+    QUEUE_STORE(&eventQueue->tail, QUEUE_MASK(tail + 1));
 }
 
 /**
@@ -503,41 +664,46 @@ mieqProcessDeviceEvent(DeviceIntPtr dev, InternalEvent *event, ScreenPtr screen)
 void
 mieqProcessInputEvents(void)
 {
+    EventQueuePtr eventQueue = &miEventQueue;
     EventRec *e = NULL;
     ScreenPtr screen;
-    InternalEvent event;
+    InternalEvent *event;
     DeviceIntPtr dev = NULL, master = NULL;
+    unsigned long dropped;
+    unsigned int head;
     static Bool inProcessInputEvents = FALSE;
 
-    input_lock();
-
     /*
      * report an error if mieqProcessInputEvents() is called recursively;
      * this can happen, e.g., if something in the mieqProcessDeviceEvent()
-     * call chain calls UpdateCurrentTime() instead of UpdateCurrentTimeIf()
+     * call chain calls UpdateCurrentTime() instead of UpdateCurrentTimeIf().
+     * The outer call still owns the slot it is processing, so leave the
+     * rest of the queue to it.
      */
-    BUG_WARN_MSG(inProcessInputEvents, "[mi] mieqProcessInputEvents() called recursively.\n");
+    BUG_RETURN_MSG(inProcessInputEvents, "[mi] mieqProcessInputEvents() called recursively.\n");
     inProcessInputEvents = TRUE;
 
-    if (miEventQueue.dropped) {
+    dropped = QUEUE_LOAD(&eventQueue->dropped);
+    if (dropped != eventQueue->dropReported) {
         ErrorF("[mi] EQ processing has resumed after %lu dropped events.\n",
-               (unsigned long) miEventQueue.dropped);
+               dropped - eventQueue->dropReported);
         ErrorF
             ("[mi] This may be caused by a misbehaving driver monopolizing the server's resources.\n");
-        miEventQueue.dropped = 0;
+        eventQueue->dropReported = dropped;
     }
 
-    while (miEventQueue.head != miEventQueue.tail) {
-        e = &miEventQueue.events[miEventQueue.head];
+    for (;;) {
+        head = eventQueue->head;
+        /* claim the slot before looking at tail, see mieqRetract() */
+        QUEUE_STORE_SC(&eventQueue->claimed, (int) head);
+        if (head == QUEUE_LOAD_SC(&eventQueue->tail))
+            break;
 
-        event = *e->events;
+        e = &eventQueue->events[head];
+        event = e->events;
         dev = e->pDev;
         screen = e->pScreen;
 
-        miEventQueue.head = (miEventQueue.head + 1) % miEventQueue.nevents;
-
-        input_unlock();
-
         master = (dev) ? GetMaster(dev, MASTER_ATTACHED) : NULL;
 
         if (screenIsSaved == SCREEN_SAVER_ON)
@@ -550,20 +716,20 @@ mieqProcessInputEvents(void)
             DPMSSet(serverClient, DPMSModeOn);
 #endif
 
-        mieqProcessDeviceEvent(dev, &event, screen);
+        mieqProcessDeviceEvent(dev, event, screen);
 
         /* Update the sprite now. Next event may be from different device. */
         if (master &&
-            (event.any.type == ET_Motion ||
-             ((event.any.type == ET_TouchBegin ||
-               event.any.type == ET_TouchUpdate) &&
-              event.device_event.flags & TOUCH_POINTER_EMULATED)))
+            (event->any.type == ET_Motion ||
+             ((event->any.type == ET_TouchBegin ||
+               event->any.type == ET_TouchUpdate) &&
+              event->device_event.flags & TOUCH_POINTER_EMULATED)))
             miPointerUpdateSprite(dev);
 
-        input_lock();
+        /* only now may the producer reuse the slot */
+        QUEUE_STORE(&eventQueue->head, QUEUE_MASK(head + 1));
     }
+    QUEUE_STORE(&eventQueue->claimed, -1);
 
     inProcessInputEvents = FALSE;
-
-    input_unlock();
 }
@@ -121,6 +121,14 @@ miModifyPixmapHeader(PixmapPtr pPixmap, int width, int height, int depth,
 static Bool
 miCloseScreen(ScreenPtr pScreen)
 {
+    unsigned long computed, kept;
+
+    miValidateTreeGetCounters(&computed, &kept);
+    if (pScreen->myNum == 0 && kept)
+        LogMessageVerb(X_INFO, 3, "[mi] ValidateTree recomputed the clips "
+                       "of %lu windows and kept those of %lu.\n",
+                       computed, kept);
+
     return ((*pScreen->DestroyPixmap) ((PixmapPtr) pScreen->devPrivate));
 }
 
@@ -177,6 +177,88 @@ miShapedWindowIn(RegionPtr universe, RegionPtr bounding,
 				    HasBorder(w) && \
 				    (w)->backgroundState == ParentRelative)
 
+static unsigned long clipsComputed;
+static unsigned long clipsKept;
+
+void
+miValidateTreeGetCounters(unsigned long *computed, unsigned long *kept)
+{
+    *computed = clipsComputed;
+    *kept = clipsKept;
+}
+
+/*
+ * A window marked only because a changed sibling overlapped it still has
+ * the geometry its clips were computed from.  If its new borderClip is the
+ * old one, and nothing that was marked below it changed either, every clip
+ * in the subtree comes out as it was and can be kept.
+ */
+static Bool
+miClipsUnchanged(WindowPtr pParent, RegionPtr universe)
+{
+    WindowPtr pChild;
+
+    if (!RegionEqual(universe, &pParent->borderClip))
+        return FALSE;
+
+    pChild = pParent;
+    while (1) {
+        ValidatePtr val = pChild->valdata;
+        Bool descend = FALSE;
+
+        if (pChild->viewable) {
+            if (val) {
+                if (val == UnmapValData || !val->before.overlapOnly ||
+                    val->before.borderVisible || val->before.resized)
+                    return FALSE;
+                descend = TRUE;
+            }
+            if (pChild != pParent &&
+                pChild->visibility == VisibilityNotViewable)
+                return FALSE;
+        }
+        else if (val)
+            return FALSE;
+
+        if (descend && pChild->firstChild) {
+            pChild = pChild->firstChild;
+            continue;
+        }
+        while (!pChild->nextSib && (pChild != pParent))
+            pChild = pChild->parent;
+        if (pChild == pParent)
+            break;
+        pChild = pChild->nextSib;
+    }
+    return TRUE;
+}
+
+/*
+ * Leave the clips of a subtree alone, with nothing exposed.
+ */
+static void
+miKeepClips(WindowPtr pParent)
+{
+    WindowPtr pChild = pParent;
+
+    while (1) {
+        if (pChild->viewable && pChild->valdata) {
+            RegionNull(&pChild->valdata->after.borderExposed);
+            RegionNull(&pChild->valdata->after.exposed);
+            clipsKept++;
+            if (pChild->firstChild) {
+                pChild = pChild->firstChild;
+                continue;
+            }
+        }
+        while (!pChild->nextSib && (pChild != pParent))
+            pChild = pChild->parent;
+        if (pChild == pParent)
+            break;
+        pChild = pChild->nextSib;
+    }
+}
+
 /*
  *-----------------------------------------------------------------------
  * miComputeClips --
@@ -281,6 +363,15 @@ miComputeClips(WindowPtr pParent,
     dx = pParent->drawable.x - pParent->valdata->before.oldAbsCorner.x;
     dy = pParent->drawable.y - pParent->valdata->before.oldAbsCorner.y;
 
+    if (!dx && !dy && kind != VTBroken &&
+        pParent->valdata->before.overlapOnly &&
+        oldVis != VisibilityNotViewable &&
+        miClipsUnchanged(pParent, universe)) {
+        miKeepClips(pParent);
+        return;
+    }
+    clipsComputed++;
+
     /*
      * avoid computations when dealing with simple operations
      */
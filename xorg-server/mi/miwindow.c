@@ -59,6 +59,9 @@ SOFTWARE.
 #include "mivalidate.h"
 #include "inputstr.h"
 
+/* siblings tried before miSpriteTrace asks for an index of them */
+#define SPRITE_TRACE_INDEX_MISSES 32
+
 void
 miClearToBackground(WindowPtr pWin,
                     int x, int y, int w, int h, Bool generateExposures)
@@ -122,13 +125,18 @@ miMarkWindow(WindowPtr pWin)
 {
     ValidatePtr val;
 
-    if (pWin->valdata)
+    if (pWin->valdata) {
+        /* marked again for a change of its own */
+        if (pWin->valdata != UnmapValData)
+            pWin->valdata->before.overlapOnly = FALSE;
         return;
+    }
     val = (ValidatePtr) xnfalloc(sizeof(ValidateRec));
     val->before.oldAbsCorner.x = pWin->drawable.x;
     val->before.oldAbsCorner.y = pWin->drawable.y;
     val->before.borderVisible = NullRegion;
     val->before.resized = FALSE;
+    val->before.overlapOnly = FALSE;
     val->after.borderExposed.data= 0; // unitialised member--> causes crash
     pWin->valdata = val;
 }
@@ -182,7 +190,16 @@ miMarkOverlappedWindows(WindowPtr pWin, WindowPtr pFirst, WindowPtr *ppLayerWin)
                 if (RegionBroken(&pChild->borderSize))
                     SetBorderSize(pChild);
                 if (RegionContainsRect(&pChild->borderSize, box)) {
-                    (*MarkWindow) (pChild);
+                    /*
+                     * Siblings below are only uncovered or covered, so
+                     * miComputeClips may find their clips unchanged.
+                     * Leave windows that were already marked as they are.
+                     */
+                    if (!pChild->valdata) {
+                        (*MarkWindow) (pChild);
+                        if (pChild->valdata && pChild->valdata != UnmapValData)
+                            pChild->valdata->before.overlapOnly = TRUE;
+                    }
                     anyMarked = TRUE;
                     if (pChild->firstChild) {
                         pChild = pChild->firstChild;
@@ -746,46 +763,77 @@ miMarkUnrealizedWindow(WindowPtr pChild, WindowPtr pWin, Bool fromConfigure)
     }
 }
 
+static Bool
+miSpriteHitsWindow(WindowPtr pWin, int x, int y)
+{
+    BoxRec box;
+
+    return (pWin->mapped) &&
+        (x >= pWin->drawable.x - wBorderWidth(pWin)) &&
+        (x < pWin->drawable.x + (int) pWin->drawable.width +
+         wBorderWidth(pWin)) &&
+        (y >= pWin->drawable.y - wBorderWidth(pWin)) &&
+        (y < pWin->drawable.y + (int) pWin->drawable.height +
+         wBorderWidth(pWin))
+        /* When a window is shaped, a further check
+         * is made to see if the point is inside
+         * borderSize
+         */
+        && (!wBoundingShape(pWin) || PointInBorderSize(pWin, x, y))
+        && (!wInputShape(pWin) ||
+            RegionContainsPoint(wInputShape(pWin),
+                                x - pWin->drawable.x,
+                                y - pWin->drawable.y, &box))
+        /* In rootless mode windows may be offscreen, even when
+         * they're in X's stack. (E.g. if the native window system
+         * implements some form of virtual desktop system).
+         */
+        && !pWin->unhittable;
+}
+
+/*
+ * The topmost child of pParent at x/y.  Windows with many children get
+ * an index of them after the first few dozen misses, so tracing through
+ * a crowded root window doesn't walk every top-level on each motion.
+ */
+static WindowPtr
+miSpriteTraceChild(WindowPtr pParent, int x, int y)
+{
+    ChildIndexIterRec iter;
+    WindowPtr pWin;
+    int n = 0;
+
+    if (!ChildIndexLookup(pParent, x, y, FALSE, &iter)) {
+        for (pWin = pParent->firstChild; pWin; pWin = pWin->nextSib) {
+            if (miSpriteHitsWindow(pWin, x, y))
+                return pWin;
+            if (++n == SPRITE_TRACE_INDEX_MISSES &&
+                ChildIndexLookup(pParent, x, y, TRUE, &iter))
+                break;
+        }
+        if (!pWin)
+            return NullWindow;
+    }
+    while ((pWin = ChildIndexNext(&iter)))
+        if (miSpriteHitsWindow(pWin, x, y))
+            return pWin;
+    return NullWindow;
+}
+
 WindowPtr
 miSpriteTrace(SpritePtr pSprite, int x, int y)
 {
     WindowPtr pWin;
-    BoxRec box;
 
-    pWin = DeepestSpriteWin(pSprite)->firstChild;
-    while (pWin) {
-        if ((pWin->mapped) &&
-            (x >= pWin->drawable.x - wBorderWidth(pWin)) &&
-            (x < pWin->drawable.x + (int) pWin->drawable.width +
-             wBorderWidth(pWin)) &&
-            (y >= pWin->drawable.y - wBorderWidth(pWin)) &&
-            (y < pWin->drawable.y + (int) pWin->drawable.height +
-             wBorderWidth(pWin))
-            /* When a window is shaped, a further check
-             * is made to see if the point is inside
-             * borderSize
-             */
-            && (!wBoundingShape(pWin) || PointInBorderSize(pWin, x, y))
-            && (!wInputShape(pWin) ||
-                RegionContainsPoint(wInputShape(pWin),
-                                    x - pWin->drawable.x,
-                                    y - pWin->drawable.y, &box))
-            /* In rootless mode windows may be offscreen, even when
-             * they're in X's stack. (E.g. if the native window system
-             * implements some form of virtual desktop system).
-             */
-            && !pWin->unhittable) {
-            if (pSprite->spriteTraceGood >= pSprite->spriteTraceSize) {
-                pSprite->spriteTraceSize += 10;
-                pSprite->spriteTrace = reallocarray(pSprite->spriteTrace,
-                                                    pSprite->spriteTraceSize,
-                                                    sizeof(WindowPtr));
-            }
-            pSprite->spriteTrace[pSprite->spriteTraceGood++] = pWin;
-            pWin = pWin->firstChild;
+    pWin = DeepestSpriteWin(pSprite);
+    while ((pWin = miSpriteTraceChild(pWin, x, y))) {
+        if (pSprite->spriteTraceGood >= pSprite->spriteTraceSize) {
+            pSprite->spriteTraceSize += 10;
+            pSprite->spriteTrace = reallocarray(pSprite->spriteTrace,
+                                                pSprite->spriteTraceSize,
+                                                sizeof(WindowPtr));
         }
-        else
-            pWin = pWin->nextSib;
+        pSprite->spriteTrace[pSprite->spriteTraceGood++] = pWin;
     }
     return DeepestSpriteWin(pSprite);
 }
@@ -339,6 +339,8 @@ static GCFuncs damageGCFuncs = {
 
 static GCOps damageGCOps;
 
+static void damageFlattenGCOps(DamageGCPrivPtr pGCPriv, unsigned direct);
+
 static Bool
 damageCreateGC(GCPtr pGC)
 {
@@ -352,6 +354,8 @@ damageCreateGC(GCPtr pGC)
     if ((ret = (*pScreen->CreateGC) (pGC))) {
         pGCPriv->ops = NULL;
         pGCPriv->funcs = pGC->funcs;
+        pGCPriv->flatOps = damageGCOps;
+        pGCPriv->direct = 0;
         pGC->funcs = &damageGCFuncs;
     }
     wrap(pScrPriv, pScreen, CreateGC, damageCreateGC);
@@ -367,7 +371,7 @@ damageCreateGC(GCPtr pGC)
 
 #define DAMAGE_GC_OP_EPILOGUE(pGC, pDrawable) \
     wrap(pGCPriv, pGC, funcs, oldFuncs); \
-    wrap(pGCPriv, pGC, ops, &damageGCOps)
+    wrap(pGCPriv, pGC, ops, &pGCPriv->flatOps)
 
 #define DAMAGE_GC_FUNC_PROLOGUE(pGC) \
     damageGCPriv(pGC); \
@@ -376,7 +380,7 @@ damageCreateGC(GCPtr pGC)
 
 #define DAMAGE_GC_FUNC_EPILOGUE(pGC) \
     wrap(pGCPriv, pGC, funcs, &damageGCFuncs);  \
-    if (pGCPriv->ops) wrap(pGCPriv, pGC, ops, &damageGCOps)
+    if (pGCPriv->ops) wrap(pGCPriv, pGC, ops, &pGCPriv->flatOps)
 
 static void
 damageValidateGC(GCPtr pGC, unsigned long changes, DrawablePtr pDrawable)
@@ -384,6 +388,8 @@ damageValidateGC(GCPtr pGC, unsigned long changes, DrawablePtr pDrawable)
     DAMAGE_GC_FUNC_PROLOGUE(pGC);
     (*pGC->funcs->ValidateGC) (pGC, changes, pDrawable);
     pGCPriv->ops = pGC->ops; /* just so it's not NULL */
+    damageFlattenGCOps(pGCPriv, pGC->ops->DirectOps ?
+                       (*pGC->ops->DirectOps) (pGC) : 0);
     DAMAGE_GC_FUNC_EPILOGUE(pGC);
 }
 
@@ -458,9 +464,10 @@ damageDestroyClip(GCPtr pGC)
 #define BOX_NOT_EMPTY(box) \
     (((box.x2 - box.x1) > 0) && ((box.y2 - box.y1) > 0))
 
-#define checkGCDamage(d,g)	(getDrawableDamage(d) && \
-				 (!g->pCompositeClip ||\
-				  RegionNotEmpty(g->pCompositeClip)))
+#define checkGCClip(g)		(!g->pCompositeClip || \
+				 RegionNotEmpty(g->pCompositeClip))
+
+#define checkGCDamage(d,g)	(getDrawableDamage(d) && checkGCClip(g))
 
 #define TRIM_PICTURE_BOX(box, pDst) { \
     BoxPtr extents = &pDst->pCompositeClip->extents;\
@@ -632,12 +639,10 @@ damageAddTraps(PicturePtr pPicture,
 /**********************************************************/
 
 static void
-damageFillSpans(DrawablePtr pDrawable,
-                GC * pGC, int npt, DDXPointPtr ppt, int *pwidth, int fSorted)
+damageDamageSpans(DrawablePtr pDrawable,
+                  GC * pGC, int npt, DDXPointPtr ppt, int *pwidth)
 {
-    DAMAGE_GC_OP_PROLOGUE(pGC, pDrawable);
-
-    if (npt && checkGCDamage(pDrawable, pGC)) {
+    if (npt && checkGCClip(pGC)) {
         int nptTmp = npt;
         DDXPointPtr pptTmp = ppt;
         int *pwidthTmp = pwidth;
@@ -670,9 +675,16 @@ damageFillSpans(DrawablePtr pDrawable,
         if (BOX_NOT_EMPTY(box))
             damageDamageBox(pDrawable, &box, pGC->subWindowMode);
     }
+}
 
+static void
+damageFillSpans(DrawablePtr pDrawable,
+                GC * pGC, int npt, DDXPointPtr ppt, int *pwidth, int fSorted)
+{
+    DAMAGE_GC_OP_PROLOGUE(pGC, pDrawable);
+    if (getDrawableDamage(pDrawable))
+        damageDamageSpans(pDrawable, pGC, npt, ppt, pwidth);
     (*pGC->ops->FillSpans) (pDrawable, pGC, npt, ppt, pwidth, fSorted);
-
     damageRegionProcessPending(pDrawable);
     DAMAGE_GC_OP_EPILOGUE(pGC, pDrawable);
 }
@@ -814,12 +826,10 @@ damageCopyPlane(DrawablePtr pSrc,
 }
 
 static void
-damagePolyPoint(DrawablePtr pDrawable,
-                GCPtr pGC, int mode, int npt, xPoint * ppt)
+damageDamagePoints(DrawablePtr pDrawable,
+                   GCPtr pGC, int mode, int npt, xPoint * ppt)
 {
-    DAMAGE_GC_OP_PROLOGUE(pGC, pDrawable);
-
-    if (npt && checkGCDamage(pDrawable, pGC)) {
+    if (npt && checkGCClip(pGC)) {
         BoxRec box;
         int nptTmp = npt;
         xPoint *pptTmp = ppt;
@@ -868,18 +878,25 @@ damagePolyPoint(DrawablePtr pDrawable,
         if (BOX_NOT_EMPTY(box))
             damageDamageBox(pDrawable, &box, pGC->subWindowMode);
     }
+}
+
+static void
+damagePolyPoint(DrawablePtr pDrawable,
+                GCPtr pGC, int mode, int npt, xPoint * ppt)
+{
+    DAMAGE_GC_OP_PROLOGUE(pGC, pDrawable);
+    if (getDrawableDamage(pDrawable))
+        damageDamagePoints(pDrawable, pGC, mode, npt, ppt);
     (*pGC->ops->PolyPoint) (pDrawable, pGC, mode, npt, ppt);
     damageRegionProcessPending(pDrawable);
     DAMAGE_GC_OP_EPILOGUE(pGC, pDrawable);
 }
 
 static void
-damagePolylines(DrawablePtr pDrawable,
-                GCPtr pGC, int mode, int npt, DDXPointPtr ppt)
+damageDamageLines(DrawablePtr pDrawable,
+                  GCPtr pGC, int mode, int npt, DDXPointPtr ppt)
 {
-    DAMAGE_GC_OP_PROLOGUE(pGC, pDrawable);
-
-    if (npt && checkGCDamage(pDrawable, pGC)) {
+    if (npt && checkGCClip(pGC)) {
         int nptTmp = npt;
         DDXPointPtr pptTmp = ppt;
         BoxRec box;
@@ -941,17 +958,25 @@ damagePolylines(DrawablePtr pDrawable,
         if (BOX_NOT_EMPTY(box))
             damageDamageBox(pDrawable, &box, pGC->subWindowMode);
     }
+}
+
+static void
+damagePolylines(DrawablePtr pDrawable,
+                GCPtr pGC, int mode, int npt, DDXPointPtr ppt)
+{
+    DAMAGE_GC_OP_PROLOGUE(pGC, pDrawable);
+    if (getDrawableDamage(pDrawable))
+        damageDamageLines(pDrawable, pGC, mode, npt, ppt);
     (*pGC->ops->Polylines) (pDrawable, pGC, mode, npt, ppt);
     damageRegionProcessPending(pDrawable);
     DAMAGE_GC_OP_EPILOGUE(pGC, pDrawable);
 }
 
 static void
-damagePolySegment(DrawablePtr pDrawable, GCPtr pGC, int nSeg, xSegment * pSeg)
+damageDamageSegments(DrawablePtr pDrawable, GCPtr pGC, int nSeg,
+                     xSegment * pSeg)
 {
-    DAMAGE_GC_OP_PROLOGUE(pGC, pDrawable);
-
-    if (nSeg && checkGCDamage(pDrawable, pGC)) {
+    if (nSeg && checkGCClip(pGC)) {
         BoxRec box;
         int extra = pGC->lineWidth;
         int nsegTmp = nSeg;
@@ -1020,6 +1045,14 @@ damagePolySegment(DrawablePtr pDrawable, GCPtr pGC, int nSeg, xSegment * pSeg)
         if (BOX_NOT_EMPTY(box))
             damageDamageBox(pDrawable, &box, pGC->subWindowMode);
     }
+}
+
+static void
+damagePolySegment(DrawablePtr pDrawable, GCPtr pGC, int nSeg, xSegment * pSeg)
+{
+    DAMAGE_GC_OP_PROLOGUE(pGC, pDrawable);
+    if (getDrawableDamage(pDrawable))
+        damageDamageSegments(pDrawable, pGC, nSeg, pSeg);
     (*pGC->ops->PolySegment) (pDrawable, pGC, nSeg, pSeg);
     damageRegionProcessPending(pDrawable);
     DAMAGE_GC_OP_EPILOGUE(pGC, pDrawable);
@@ -1191,11 +1224,10 @@ damageFillPolygon(DrawablePtr pDrawable,
 }
 
 static void
-damagePolyFillRect(DrawablePtr pDrawable,
-                   GCPtr pGC, int nRects, xRectangle *pRects)
+damageDamageRects(DrawablePtr pDrawable,
+                  GCPtr pGC, int nRects, xRectangle *pRects)
 {
-    DAMAGE_GC_OP_PROLOGUE(pGC, pDrawable);
-    if (nRects && checkGCDamage(pDrawable, pGC)) {
+    if (nRects && checkGCClip(pGC)) {
         BoxRec box;
         xRectangle *pRectsTmp = pRects;
         int nRectsTmp = nRects;
@@ -1221,6 +1253,15 @@ damagePolyFillRect(DrawablePtr pDrawable,
         if (BOX_NOT_EMPTY(box))
             damageDamageBox(pDrawable, &box, pGC->subWindowMode);
     }
+}
+
+static void
+damagePolyFillRect(DrawablePtr pDrawable,
+                   GCPtr pGC, int nRects, xRectangle *pRects)
+{
+    DAMAGE_GC_OP_PROLOGUE(pGC, pDrawable);
+    if (getDrawableDamage(pDrawable))
+        damageDamageRects(pDrawable, pGC, nRects, pRects);
     (*pGC->ops->PolyFillRect) (pDrawable, pGC, nRects, pRects);
     damageRegionProcessPending(pDrawable);
     DAMAGE_GC_OP_EPILOGUE(pGC, pDrawable);
@@ -1592,6 +1633,109 @@ static GCOps damageGCOps = {
     damagePolyGlyphBlt, damagePushPixels,
 };
 
+/*
+ * The ops the layer below draws itself, per its DirectOps, are called
+ * straight from pGCPriv->ops with the GC left wrapped, and drawables
+ * nobody tracks damage on go right through to them.
+ */
+
+static void
+damageFillSpansDirect(DrawablePtr pDrawable,
+                      GC * pGC, int npt, DDXPointPtr ppt, int *pwidth,
+                      int fSorted)
+{
+    damageGCPriv(pGC);
+
+    if (!getDrawableDamage(pDrawable)) {
+        (*pGCPriv->ops->FillSpans) (pDrawable, pGC, npt, ppt, pwidth, fSorted);
+        return;
+    }
+    damageDamageSpans(pDrawable, pGC, npt, ppt, pwidth);
+    (*pGCPriv->ops->FillSpans) (pDrawable, pGC, npt, ppt, pwidth, fSorted);
+    damageRegionProcessPending(pDrawable);
+}
+
+static void
+damagePolyPointDirect(DrawablePtr pDrawable,
+                      GCPtr pGC, int mode, int npt, xPoint * ppt)
+{
+    damageGCPriv(pGC);
+
+    if (!getDrawableDamage(pDrawable)) {
+        (*pGCPriv->ops->PolyPoint) (pDrawable, pGC, mode, npt, ppt);
+        return;
+    }
+    damageDamagePoints(pDrawable, pGC, mode, npt, ppt);
+    (*pGCPriv->ops->PolyPoint) (pDrawable, pGC, mode, npt, ppt);
+    damageRegionProcessPending(pDrawable);
+}
+
+static void
+damagePolylinesDirect(DrawablePtr pDrawable,
+                      GCPtr pGC, int mode, int npt, DDXPointPtr ppt)
+{
+    damageGCPriv(pGC);
+
+    if (!getDrawableDamage(pDrawable)) {
+        (*pGCPriv->ops->Polylines) (pDrawable, pGC, mode, npt, ppt);
+        return;
+    }
+    damageDamageLines(pDrawable, pGC, mode, npt, ppt);
+    (*pGCPriv->ops->Polylines) (pDrawable, pGC, mode, npt, ppt);
+    damageRegionProcessPending(pDrawable);
+}
+
+static void
+damagePolySegmentDirect(DrawablePtr pDrawable, GCPtr pGC, int nSeg,
+                        xSegment * pSeg)
+{
+    damageGCPriv(pGC);
+
+    if (!getDrawableDamage(pDrawable)) {
+        (*pGCPriv->ops->PolySegment) (pDrawable, pGC, nSeg, pSeg);
+        return;
+    }
+    damageDamageSegments(pDrawable, pGC, nSeg, pSeg);
+    (*pGCPriv->ops->PolySegment) (pDrawable, pGC, nSeg, pSeg);
+    damageRegionProcessPending(pDrawable);
+}
+
+static void
+damagePolyFillRectDirect(DrawablePtr pDrawable,
+                         GCPtr pGC, int nRects, xRectangle *pRects)
+{
+    damageGCPriv(pGC);
+
+    if (!getDrawableDamage(pDrawable)) {
+        (*pGCPriv->ops->PolyFillRect) (pDrawable, pGC, nRects, pRects);
+        return;
+    }
+    damageDamageRects(pDrawable, pGC, nRects, pRects);
+    (*pGCPriv->ops->PolyFillRect) (pDrawable, pGC, nRects, pRects);
+    damageRegionProcessPending(pDrawable);
+}
+
+static void
+damageFlattenGCOps(DamageGCPrivPtr pGCPriv, unsigned direct)
+{
+    GCOps *ops = &pGCPriv->flatOps;
+
+    if (direct == pGCPriv->direct)
+        return;
+    pGCPriv->direct = direct;
+
+    ops->FillSpans = (direct & GCOpFillSpans) ?
+        damageFillSpansDirect : damageFillSpans;
+    ops->PolyPoint = (direct & GCOpPolyPoint) ?
+        damagePolyPointDirect : damagePolyPoint;
+    ops->Polylines = (direct & GCOpPolylines) ?
+        damagePolylinesDirect : damagePolylines;
+    ops->PolySegment = (direct & GCOpPolySegment) ?
+        damagePolySegmentDirect : damagePolySegment;
+    ops->PolyFillRect = (direct & GCOpPolyFillRect) ?
+        damagePolyFillRectDirect : damagePolyFillRect;
+}
+
 static void
 damageSetWindowPixmap(WindowPtr pWindow, PixmapPtr pPixmap)
 {
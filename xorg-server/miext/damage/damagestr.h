@@ -77,6 +77,10 @@ typedef struct _damageScrPriv {
 typedef struct _damageGCPriv {
     const GCOps *ops;
     const GCFuncs *funcs;
+    /* damageGCOps, with the ops the layer below draws directly
+     * replaced by ones that call it without unwrapping */
+    GCOps flatOps;
+    unsigned direct;
 } DamageGCPrivRec, *DamageGCPrivPtr;
 
 /* XXX should move these into damage.c, damageScrPrivateIndex is static */
@@ -94,8 +94,15 @@ SOFTWARE.
 #include <X11/extensions/dpmsconst.h>
 #endif
 
+/*
+ * Pending timers are kept in a binary min-heap ordered by expiry time.
+ * Each timer records its own slot in the heap so that it can be
+ * cancelled or re-armed without searching; arming, cancelling and
+ * running a timer are all O(log n) and finding the next expiry is O(1).
+ */
 struct _OsTimerRec {
-    struct xorg_list list;
+    int index;                  /* slot in timer_heap, -1 when idle */
+    CARD32 serial;              /* keeps equal expiry times in FIFO order */
     CARD32 expires;
     CARD32 delta;
     OsTimerCallback callback;
@@ -105,15 +112,104 @@ struct _OsTimerRec {
 static void DoTimer(OsTimerPtr timer, CARD32 now);
 static void DoTimers(CARD32 now);
 static void CheckAllTimers(void);
-static volatile struct xorg_list timers;
+
+static OsTimerPtr *timer_heap;
+static volatile int timer_count;
+static int timer_size;
+static CARD32 timer_serial;
+
+static inline Bool
+timer_before(OsTimerPtr a, OsTimerPtr b)
+{
+    int diff = (int) (a->expires - b->expires);
+
+    if (diff)
+        return diff < 0;
+    return (int) (a->serial - b->serial) < 0;
+}
+
+static inline void
+timer_heap_place(OsTimerPtr timer, int index)
+{
+    timer_heap[index] = timer;
+    timer->index = index;
+}
+
+static void
+timer_heap_up(int index)
+{
+    OsTimerPtr timer = timer_heap[index];
+
+    while (index > 0) {
+        int parent = (index - 1) / 2;
+
+        if (!timer_before(timer, timer_heap[parent]))
+            break;
+        timer_heap_place(timer_heap[parent], index);
+        index = parent;
+    }
+    timer_heap_place(timer, index);
+}
+
+static void
+timer_heap_down(int index)
+{
+    OsTimerPtr timer = timer_heap[index];
+    int count = timer_count;
+
+    for (;;) {
+        int child = 2 * index + 1;
+
+        if (child >= count)
+            break;
+        if (child + 1 < count &&
+            timer_before(timer_heap[child + 1], timer_heap[child]))
+            child++;
+        if (!timer_before(timer_heap[child], timer))
+            break;
+        timer_heap_place(timer_heap[child], index);
+        index = child;
+    }
+    timer_heap_place(timer, index);
+}
+
+static void
+timer_heap_insert(OsTimerPtr timer)
+{
+    if (timer_count == timer_size) {
+        timer_size = timer_size ? timer_size * 2 : 32;
+        timer_heap = xnfreallocarray(timer_heap, timer_size,
+                                     sizeof(OsTimerPtr));
+    }
+    timer->serial = timer_serial++;
+    timer_heap_place(timer, timer_count++);
+    timer_heap_up(timer->index);
+}
+
+static void
+timer_heap_remove(OsTimerPtr timer)
+{
+    int index = timer->index;
+    OsTimerPtr last;
+
+    timer->index = -1;
+    last = timer_heap[--timer_count];
+    if (last == timer)
+        return;
+
+    timer_heap_place(last, index);
+    if (index > 0 && timer_before(last, timer_heap[(index - 1) / 2]))
+        timer_heap_up(index);
+    else
+        timer_heap_down(index);
+}
 
 static inline OsTimerPtr
 first_timer(void)
 {
-    /* inline xorg_list_is_empty which can't handle volatile */
-    if (timers.next == &timers)
+    if (timer_count == 0)
         return NULL;
-    return xorg_list_first_entry(&timers, struct _OsTimerRec, list);
+    return timer_heap[0];
 }
 
 /*
@@ -328,22 +424,24 @@ AdjustWaitForDelay(void *waitTime, int newdelay)
 }
 
 static inline Bool timer_pending(OsTimerPtr timer) {
-    return !xorg_list_is_empty(&timer->list);
+    return timer->index >= 0;
 }
 
 /* If time has rewound, re-run every affected timer.
- * Timers might drop out of the list, so we have to restart every time. */
+ * Timers might move around in the heap, so we have to restart every time. */
 static void
 CheckAllTimers(void)
 {
     OsTimerPtr timer;
     CARD32 now;
+    int i;
 
     input_lock();
  start:
     now = GetTimeInMillis();
 
-    xorg_list_for_each_entry(timer, &timers, list) {
+    for (i = 0; i < timer_count; i++) {
+        timer = timer_heap[i];
         if (timer->expires - now > timer->delta + 250) {
             DoTimer(timer, now);
             goto start;
@@ -357,7 +455,7 @@ DoTimer(OsTimerPtr timer, CARD32 now)
 {
     CARD32 newTime;
 
-    xorg_list_del(&timer->list);
+    timer_heap_remove(timer);
     newTime = (*timer->callback) (timer, now, timer->arg);
     if (newTime)
         TimerSet(timer, 0, newTime, timer->callback, timer->arg);
@@ -381,19 +479,18 @@ OsTimerPtr
 TimerSet(OsTimerPtr timer, int flags, CARD32 millis,
          OsTimerCallback func, void *arg)
 {
-    OsTimerPtr existing;
     CARD32 now = GetTimeInMillis();
 
     if (!timer) {
         timer = calloc(1, sizeof(struct _OsTimerRec));
         if (!timer)
             return NULL;
-        xorg_list_init(&timer->list);
+        timer->index = -1;
     }
     else {
         input_lock();
         if (timer_pending(timer)) {
-            xorg_list_del(&timer->list);
+            timer_heap_remove(timer);
             if (flags & TimerForceOld)
                 (void) (*timer->callback) (timer, now, timer->arg);
         }
@@ -413,12 +510,7 @@ TimerSet(OsTimerPtr timer, int flags, CARD32 millis,
     timer->arg = arg;
     input_lock();
 
-    /* Sort into list */
-    xorg_list_for_each_entry(existing, &timers, list)
-        if ((int) (existing->expires - millis) > 0)
-            break;
-    /* This even works at the end of the list -- existing->list will be timers */
-    xorg_list_append(&timer->list, &existing->list);
+    timer_heap_insert(timer);
 
     /* Check to see if the timer is ready to run now */
     if ((int) (millis - now) <= 0)
@@ -447,7 +539,8 @@ TimerCancel(OsTimerPtr timer)
     if (!timer)
         return;
     input_lock();
-    xorg_list_del(&timer->list);
+    if (timer_pending(timer))
+        timer_heap_remove(timer);
     input_unlock();
 }
 
@@ -469,16 +562,10 @@ TimerCheck(void)
 void
 TimerInit(void)
 {
-    static Bool been_here;
-    OsTimerPtr timer, tmp;
-
-    if (!been_here) {
-        been_here = TRUE;
-        xorg_list_init((struct xorg_list*) &timers);
-    }
+    while (timer_count > 0) {
+        OsTimerPtr timer = timer_heap[--timer_count];
 
-    xorg_list_for_each_entry_safe(timer, tmp, &timers, list) {
-        xorg_list_del(&timer->list);
+        timer->index = -1;
         free(timer);
     }
 }
@@ -657,6 +657,7 @@ AllocNewConnection(XtransConnInfo trans_conn, int fd, CARD32 conn_time)
     oc->auth_id = None;
     oc->conn_time = conn_time;
     oc->flags = 0;
+    oc->reader = NULL;
     if (!(client = NextAvailableClient((void *) oc))) {
         free(oc);
         return NullClient;
@@ -666,6 +667,7 @@ AllocNewConnection(XtransConnInfo trans_conn, int fd, CARD32 conn_time)
                ospoll_trigger_edge,
                ClientReady,
                client);
+    ReadThreadAddClient(client);
     set_poll_client(client);
 
 #ifdef DEBUG
@@ -791,6 +793,7 @@ CloseDownFileDescriptor(OsCommPtr oc)
 #ifdef XDMCP
         XdmcpCloseDisplay(connection);
 #endif
+        ReadThreadRemoveClient(oc);
         ospoll_remove(server_poll, connection);
         _XSERVTransDisconnect(oc->trans_conn);
         _XSERVTransClose(oc->trans_conn);
@@ -1171,7 +1174,8 @@ set_poll_client(ClientPtr client)
     OsCommPtr oc = (OsCommPtr) client->osPrivate;
 
     if (oc->trans_conn) {
-        if (listen_to_client(client))
+        /* a reader thread does the polling for input */
+        if (listen_to_client(client) && !oc->reader)
             ospoll_listen(server_poll, oc->trans_conn->fd, X_NOTIFY_READ);
         else
             ospoll_mute(server_poll, oc->trans_conn->fd, X_NOTIFY_READ);
@@ -89,19 +89,39 @@ typedef struct _connectionInput {
     int lenLastReq;
     int size;
     unsigned int ignoreBytes;   /* bytes to ignore before the next request */
+    int smallReads;             /* reads in a row that fit in BUFSIZE */
 } ConnectionInput;
 
+/*
+ * Output that could not be written straight away and did not fit in
+ * ConnectionOutput.buf is queued as a list of chunks, to be sent with
+ * writev once the client catches up.  A chunk either holds a copy of
+ * the data (and may have room for more), or is a buffer handed over by
+ * WriteToClientNoCopy, which is sent and freed without ever being
+ * copied.  Partially written chunks just advance their start offset.
+ */
+typedef struct _connectionOutputChunk {
+    struct _connectionOutputChunk *next;
+    char *data;
+    int size;                   /* space in data, 0 for handed-over buffers */
+    int start;                  /* bytes already written */
+    int count;                  /* bytes queued */
+} ConnectionOutputChunk, *ConnectionOutputChunkPtr;
+
 typedef struct _connectionOutput {
     struct _connectionOutput *next;
     unsigned char *buf;
     int size;
     int count;
+    ConnectionOutputChunkPtr chunks;    /* queued after buf */
+    ConnectionOutputChunkPtr lastChunk;
 } ConnectionOutput;
 
 static ConnectionInputPtr AllocateInputBuffer(void);
 static ConnectionOutputPtr AllocateOutputBuffer(void);
 
 static Bool CriticalOutputPending;
+static char padBuffer[3];
 static int timesThisConnection = 0;
 static ConnectionInputPtr FreeInputs = (ConnectionInputPtr) NULL;
 static ConnectionOutputPtr FreeOutputs = (ConnectionOutputPtr) NULL;
@@ -118,6 +138,9 @@ static OsCommPtr AvailableInput = (OsCommPtr) NULL;
 
 #define BUFSIZE 16384
 #define BUFWATERMARK 32768
+#define READAHEADSIZE 131072
+#define READAHEADIDLE 8         /* small reads before read-ahead is dropped */
+#define MAXOUTPUTIOV 16
 
 /*
  *   A lot of the code in this file manipulates a ConnectionInputPtr:
@@ -228,8 +251,8 @@ ReadRequestFromClient(ClientPtr client)
 {
     OsCommPtr oc = (OsCommPtr) client->osPrivate;
     ConnectionInputPtr oci = oc->input;
-    unsigned int gotnow, needed;
-    int result;
+    unsigned int gotnow, needed, room;
+    int result, next = 0, nexterr = 0;
     register xReq *request;
     Bool need_header;
     Bool move_header;
@@ -316,24 +339,47 @@ ReadRequestFromClient(ClientPtr client)
             oci->lenLastReq = gotnow;
             return needed;
         }
-        if ((gotnow == 0) || ((oci->bufptr - oci->buffer + needed) > oci->size)) {
+        room = needed;
+        if (oc->reader) {
+            /* reader threads queue whole requests; make room for the next */
+            next = ReadThreadPeek(oc);
+            nexterr = errno;
+            if (next > 0 && gotnow + next > room)
+                room = gotnow + next;
+        }
+        if ((gotnow == 0) || ((oci->bufptr - oci->buffer + room) > oci->size)) {
             /* no data, or the request is too big to fit in the buffer */
 
             if ((gotnow > 0) && (oci->bufptr != oci->buffer))
                 /* save the data we've already read */
                 memmove(oci->buffer, oci->bufptr, gotnow);
-            if (needed > oci->size) {
+            if (room > oci->size) {
                 /* make buffer bigger to accomodate request */
                 char *ibuf;
 
-                ibuf = (char *) realloc(oci->buffer, needed);
+                ibuf = (char *) realloc(oci->buffer, room);
                 if (!ibuf) {
                     YieldControlDeath();
                     return -1;
                 }
-                oci->size = needed;
+                oci->size = room;
                 oci->buffer = ibuf;
             }
+            else if (oci->bufcnt == oci->size && oci->size < READAHEADSIZE) {
+                /* The last read filled the whole buffer, so the client is
+                 * streaming requests at us.  Read further ahead to cut
+                 * down on syscalls; the buffer is shrunk again below once
+                 * the client stops keeping it full.
+                 */
+                char *ibuf;
+                int size = min(oci->size * 2, READAHEADSIZE);
+
+                ibuf = (char *) realloc(oci->buffer, size);
+                if (ibuf) {
+                    oci->size = size;
+                    oci->buffer = ibuf;
+                }
+            }
             oci->bufptr = oci->buffer;
             oci->bufcnt = gotnow;
         }
@@ -349,8 +395,16 @@ ReadRequestFromClient(ClientPtr client)
             YieldControlDeath();
             return -1;
         }
-        result = _XSERVTransRead(oc->trans_conn, oci->buffer + oci->bufcnt,
-                                 oci->size - oci->bufcnt);
+        if (oc->reader) {
+            result = next;
+            if (next > 0)
+                ReadThreadTake(oc, oci->buffer + oci->bufcnt);
+            else
+                errno = nexterr;
+        }
+        else
+            result = _XSERVTransRead(oc->trans_conn, oci->buffer + oci->bufcnt,
+                                     oci->size - oci->bufcnt);
         if (result <= 0) {
             if ((result < 0) && ETEST(errno)) {
                 mark_client_not_ready(client);
@@ -367,9 +421,20 @@ ReadRequestFromClient(ClientPtr client)
         }
         oci->bufcnt += result;
         gotnow += result;
-        /* free up some space after huge requests */
+        if (oci->bufcnt < BUFSIZE && needed < BUFSIZE) {
+            if (oci->smallReads < READAHEADIDLE)
+                oci->smallReads++;
+        }
+        else
+            oci->smallReads = 0;
+        /* free up some space after huge requests, and drop read-ahead
+         * once the client has stopped streaming for a while rather than
+         * after one short read, which would have a client sending at
+         * about BUFSIZE per read grow and shrink the buffer in turn
+         */
         if ((oci->size > BUFWATERMARK) &&
-            (oci->bufcnt < BUFSIZE) && (needed < BUFSIZE)) {
+            (oci->bufcnt < BUFSIZE) && (needed < BUFSIZE) &&
+            (oci->size > READAHEADSIZE || oci->smallReads >= READAHEADIDLE)) {
             char *ibuf;
 
             ibuf = (char *) realloc(oci->buffer, BUFSIZE);
@@ -394,6 +459,14 @@ ReadRequestFromClient(ClientPtr client)
             needed <<= 2;
         }
         if (gotnow < needed) {
+            if (oc->reader && needed > maxBigRequestSize << 2) {
+                /* the reader thread queued just the header and dropped
+                 * the rest; Dispatch() turns it into a BadLength error
+                 */
+                oci->lenLastReq = gotnow;
+                client->requestBuffer = (void *) oci->bufptr;
+                return needed;
+            }
             /* Still don't have enough; punt. */
             YieldControlNoInput(client);
             return 0;
@@ -666,6 +739,63 @@ AbortClient(ClientPtr client)
     }
 }
 
+static Bool
+QueueOutputChunk(ConnectionOutputPtr oco, const char *buf, int count,
+                 Bool owned)
+{
+    ConnectionOutputChunkPtr chunk = oco->lastChunk;
+
+    if (!owned && chunk && chunk->size - chunk->count >= count) {
+        memcpy(chunk->data + chunk->count, buf, count);
+        chunk->count += count;
+        return TRUE;
+    }
+
+    chunk = malloc(sizeof(ConnectionOutputChunk));
+    if (!chunk)
+        return FALSE;
+    if (owned) {
+        chunk->data = (char *) buf;
+        chunk->size = 0;
+    }
+    else {
+        chunk->size = max(count, BUFSIZE);
+        chunk->data = malloc(chunk->size);
+        if (!chunk->data) {
+            free(chunk);
+            return FALSE;
+        }
+        memcpy(chunk->data, buf, count);
+    }
+    chunk->start = 0;
+    chunk->count = count;
+    chunk->next = NULL;
+
+    if (oco->lastChunk)
+        oco->lastChunk->next = chunk;
+    else
+        oco->chunks = chunk;
+    oco->lastChunk = chunk;
+    return TRUE;
+}
+
+static void
+FreeOutputChunks(ConnectionOutputPtr oco)
+{
+    ConnectionOutputChunkPtr chunk, next;
+
+    for (chunk = oco->chunks; chunk; chunk = next) {
+        next = chunk->next;
+        free(chunk->data);
+        free(chunk);
+    }
+    oco->chunks = oco->lastChunk = NULL;
+}
+
+static int FlushClientBuffers(ClientPtr who, OsCommPtr oc,
+                              const char *extraBuf, int extraCount,
+                              Bool owned);
+
 /*****************
  * WriteToClient
  *    Copies buf into ClientPtr.buf if it fits (with padding), else
@@ -675,24 +805,30 @@ AbortClient(ClientPtr client)
  *    that are sending several chunks of data and want to break
  *    out of a loop on error.  Thus, we will leave the type of
  *    this routine as int.
+ *
+ * WriteToClientNoCopy
+ *    The same, but buf must come from malloc and is handed over to
+ *    the OS layer, which frees it once it has been written.  Data
+ *    that can't be written immediately is queued as is rather than
+ *    copied, which is worth it for large replies such as GetImage.
  *****************/
 
-int
-WriteToClient(ClientPtr who, int count, const void *__buf)
+static int
+WriteToClientInternal(ClientPtr who, int count, const void *__buf, Bool owned)
 {
     OsCommPtr oc;
     ConnectionOutputPtr oco;
     int padBytes;
     const char *buf = __buf;
 
-    BUG_RETURN_VAL_MSG(in_input_thread(), 0,
-                       "******** %s called from input thread *********\n", __FUNCTION__);
-
 #ifdef DEBUG_COMMUNICATION
     Bool multicount = FALSE;
 #endif
-    if (!count || !who || who == serverClient || who->clientGone)
+    if (!count || !who || who == serverClient || who->clientGone) {
+        if (owned)
+            free((void *) buf);
         return 0;
+    }
     oc = who->osPrivate;
     oco = oc->output;
 #ifdef DEBUG_COMMUNICATION
@@ -743,6 +879,8 @@ WriteToClient(ClientPtr who, int count, const void *__buf)
         else if (!(oco = AllocateOutputBuffer())) {
             AbortClient(who);
             MarkClientException(who);
+            if (owned)
+                free((void *) buf);
             return -1;
         }
         oc->output = oco;
@@ -790,6 +928,23 @@ WriteToClient(ClientPtr who, int count, const void *__buf)
         }
     }
 #endif
+    if (oco->chunks) {
+        /* Already backed up; keep the data in order behind the queue */
+        if (!QueueOutputChunk(oco, buf, count, owned) ||
+            (padBytes && !QueueOutputChunk(oco, padBuffer, padBytes, FALSE))) {
+            if (owned && oco->lastChunk->data != buf)
+                free((void *) buf);
+            AbortClient(who);
+            MarkClientException(who);
+            FreeOutputChunks(oco);
+            oco->count = 0;
+            return -1;
+        }
+        NewOutputPending = TRUE;
+        output_pending_mark(who);
+        return count;
+    }
+
     if (oco->count == 0 || oco->count + count + padBytes > oco->size) {
         output_pending_clear(who);
         if (!any_output_pending()) {
@@ -797,7 +952,7 @@ WriteToClient(ClientPtr who, int count, const void *__buf)
             NewOutputPending = FALSE;
         }
 
-        return FlushClient(who, oc, buf, count);
+        return FlushClientBuffers(who, oc, buf, count, owned);
     }
 
     NewOutputPending = TRUE;
@@ -808,9 +963,90 @@ WriteToClient(ClientPtr who, int count, const void *__buf)
         memset(oco->buf + oco->count, '\0', padBytes);
         oco->count += padBytes;
     }
+    if (owned)
+        free((void *) buf);
     return count;
 }
 
+int
+WriteToClient(ClientPtr who, int count, const void *buf)
+{
+    BUG_RETURN_VAL_MSG(in_input_thread(), 0,
+                       "******** %s called from input thread *********\n", __FUNCTION__);
+
+    return WriteToClientInternal(who, count, buf, FALSE);
+}
+
+int
+WriteToClientNoCopy(ClientPtr who, int count, void *buf)
+{
+    BUG_RETURN_VAL_MSG(in_input_thread(), 0,
+                       "******** %s called from input thread *********\n", __FUNCTION__);
+
+    return WriteToClientInternal(who, count, buf, TRUE);
+}
+
+/*****************
+ * ClientOutputBackedUp
+ *    TRUE if earlier output to the client could not all be written and
+ *    is queued behind the output buffer, so that anything written now
+ *    will be queued too rather than go out with the next writev.
+ *****************/
+
+Bool
+ClientOutputBackedUp(ClientPtr who)
+{
+    OsCommPtr oc = who->osPrivate;
+
+    return oc && oc->output && oc->output->chunks;
+}
+
+/*****************
+ * ReserveClientOutput
+ *    Returns count bytes at the end of the client's output buffer for
+ *    the caller to fill in place, or NULL if the caller should use
+ *    WriteToClient instead: the buffer is full or backed up, or a reply
+ *    is still being written.  count must be a multiple of 4 and is not
+ *    seen by ReplyCallback, so this is for events only.  The data goes
+ *    out with the next FlushAllOutput rather than straight away.
+ *****************/
+
+void *
+ReserveClientOutput(ClientPtr who, int count)
+{
+    OsCommPtr oc;
+    ConnectionOutputPtr oco;
+    void *space;
+
+    BUG_RETURN_VAL_MSG(in_input_thread(), NULL,
+                       "******** %s called from input thread *********\n", __FUNCTION__);
+
+#ifdef DEBUG_COMMUNICATION
+    return NULL;
+#endif
+    if (count <= 0 || (count & 3) || !who || who == serverClient ||
+        who->clientGone || who->replyBytesRemaining || !who->osPrivate)
+        return NULL;
+    oc = who->osPrivate;
+    oco = oc->output;
+
+    if (!oco) {
+        if ((oco = FreeOutputs))
+            FreeOutputs = oco->next;
+        else if (!(oco = AllocateOutputBuffer()))
+            return NULL;
+        oc->output = oco;
+    }
+    if (oco->chunks || oco->count + count > oco->size)
+        return NULL;
+
+    NewOutputPending = TRUE;
+    output_pending_mark(who);
+    space = oco->buf + oco->count;
+    oco->count += count;
+    return space;
+}
+
  /********************
  * FlushClient()
  *    If the client isn't keeping up with us, then we try to continue
@@ -819,26 +1055,43 @@ WriteToClient(ClientPtr who, int count, const void *__buf)
  *    a permanent error, or we can't allocate any more space, we then
  *    close the connection.
  *
+ *    Everything pending is sent with writev: first ClientPtr.buf, then
+ *    the queued chunks, then extraBuf and its padding.  Whatever is left
+ *    of extraBuf when the client stops accepting data is queued as a
+ *    chunk; if owned, extraBuf itself is queued and later freed.
+ *
  **********************/
 
 int
-FlushClient(ClientPtr who, OsCommPtr oc, const void *__extraBuf, int extraCount)
+FlushClient(ClientPtr who, OsCommPtr oc, const void *extraBuf, int extraCount)
+{
+    return FlushClientBuffers(who, oc, extraBuf, extraCount, FALSE);
+}
+
+static int
+FlushClientBuffers(ClientPtr who, OsCommPtr oc, const char *extraBuf,
+                   int extraCount, Bool owned)
 {
     ConnectionOutputPtr oco = oc->output;
     XtransConnInfo trans_conn = oc->trans_conn;
-    struct iovec iov[3];
-    static char padBuffer[3];
-    const char *extraBuf = __extraBuf;
-    long written;
+    struct iovec iov[MAXOUTPUTIOV];
+    ConnectionOutputChunkPtr chunk;
+    long extraWritten;          /* of extraBuf and its padding */
     long padsize;
     long notWritten;
     long todo;
+    long len;
 
-    if (!oco)
+    if (!oco) {
+        if (owned)
+            free((void *) extraBuf);
 	return 0;
-    written = 0;
+    }
+    extraWritten = 0;
     padsize = padding_for_int32(extraCount);
     notWritten = oco->count + extraCount + padsize;
+    for (chunk = oco->chunks; chunk; chunk = chunk->next)
+        notWritten += chunk->count - chunk->start;
     if (!notWritten)
         return 0;
 
@@ -847,47 +1100,67 @@ FlushClient(ClientPtr who, OsCommPtr oc, const void *__extraBuf, int extraCount)
 
     todo = notWritten;
     while (notWritten) {
-        long before = written;  /* amount of whole thing written */
         long remain = todo;     /* amount to try this time, <= notWritten */
+        Bool all_chunks = TRUE;
         int i = 0;
-        long len;
-
-        /* You could be very general here and have "in" and "out" iovecs
-         * and write a loop without using a macro, but what the heck.  This
-         * translates to:
-         *
-         *     how much of this piece is new?
-         *     if more new then we are trying this time, clamp
-         *     if nothing new
-         *         then bump down amount already written, for next piece
-         *         else put new stuff in iovec, will need all of next piece
-         *
-         * Note that todo had better be at least 1 or else we'll end up
-         * writing 0 iovecs.
+
+        /* Gather up to remain bytes, in order, into the iovec.  extraBuf
+         * may only go out once every queued chunk made it in.  Note that
+         * todo had better be at least 1 or else we'll end up writing 0
+         * iovecs.
          */
 #define InsertIOV(pointer, length) \
-	len = (length) - before; \
-	if (len > remain) \
-	    len = remain; \
-	if (len <= 0) { \
-	    before = (-len); \
-	} else { \
+	if ((length) > 0 && remain > 0) { \
+	    len = min((length), remain); \
+	    iov[i].iov_base = (char *) (pointer); \
 	    iov[i].iov_len = len; \
-	    iov[i].iov_base = (pointer) + before;	\
 	    i++; \
 	    remain -= len; \
-	    before = 0; \
 	}
 
-        InsertIOV((char *) oco->buf, oco->count)
-            InsertIOV((char *) extraBuf, extraCount)
-            InsertIOV(padBuffer, padsize)
+        InsertIOV(oco->buf, oco->count)
+        for (chunk = oco->chunks; chunk; chunk = chunk->next) {
+            if (i == MAXOUTPUTIOV - 2) {
+                all_chunks = FALSE;
+                break;
+            }
+            InsertIOV(chunk->data + chunk->start, chunk->count - chunk->start)
+        }
+        if (all_chunks) {
+            InsertIOV(extraBuf + extraWritten, extraCount - extraWritten)
+            InsertIOV(padBuffer, extraCount + padsize - max(extraWritten, extraCount))
+        }
+#undef InsertIOV
 
-            errno = 0;
+        errno = 0;
         if (trans_conn && (len = _XSERVTransWritev(trans_conn, iov, i)) >= 0) {
-            written += len;
             notWritten -= len;
             todo = notWritten;
+
+            /* Retire whatever went out */
+            if (len >= oco->count) {
+                len -= oco->count;
+                oco->count = 0;
+            }
+            else {
+                oco->count -= len;
+                memmove((char *) oco->buf, (char *) oco->buf + len, oco->count);
+                len = 0;
+            }
+            while ((chunk = oco->chunks) && len > 0) {
+                if (len < chunk->count - chunk->start) {
+                    chunk->start += len;
+                    len = 0;
+                    break;
+                }
+                len -= chunk->count - chunk->start;
+                oco->chunks = chunk->next;
+                if (!oco->chunks)
+                    oco->lastChunk = NULL;
+                free(chunk->data);
+                free(chunk);
+            }
+            extraWritten += len;
         }
         else if (ETEST(errno)
 #ifdef SUNSYSV                  /* check for another brain-damaged OS bug */
@@ -898,46 +1171,34 @@ FlushClient(ClientPtr who, OsCommPtr oc, const void *__extraBuf, int extraCount)
 #endif
             ) {
             /* If we've arrived here, then the client is stuffed to the gills
-               and not ready to accept more.  Make a note of it and buffer
+               and not ready to accept more.  Make a note of it and queue
                the rest. */
+            Bool queued = TRUE;
+
             output_pending_mark(who);
 
-            if (written < oco->count) {
-                if (written > 0) {
-                    oco->count -= written;
-                    memmove((char *) oco->buf,
-                            (char *) oco->buf + written, oco->count);
-                    written = 0;
+            if (extraWritten < extraCount) {
+                if (owned && QueueOutputChunk(oco, extraBuf, extraCount, TRUE)) {
+                    oco->lastChunk->start = extraWritten;
+                    owned = FALSE;
                 }
+                else
+                    queued = QueueOutputChunk(oco, extraBuf + extraWritten,
+                                              extraCount - extraWritten, FALSE);
             }
-            else {
-                written -= oco->count;
+            len = extraCount + padsize - max(extraWritten, extraCount);
+            if (queued && len > 0)
+                queued = QueueOutputChunk(oco, padBuffer, len, FALSE);
+            if (owned)
+                free((void *) extraBuf);
+            if (!queued) {
+                AbortClient(who);
+                MarkClientException(who);
+                FreeOutputChunks(oco);
                 oco->count = 0;
+                return -1;
             }
 
-            if (notWritten > oco->size) {
-                unsigned char *obuf = NULL;
-
-                if (notWritten + BUFSIZE <= INT_MAX) {
-                    obuf = realloc(oco->buf, notWritten + BUFSIZE);
-                }
-                if (!obuf) {
-                    AbortClient(who);
-                    MarkClientException(who);
-                    oco->count = 0;
-                    return -1;
-                }
-                oco->size = notWritten + BUFSIZE;
-                oco->buf = obuf;
-            }
-
-            /* If the amount written extended into the padBuffer, then the
-               difference "extraCount - written" may be less than 0 */
-            if ((len = extraCount - written) > 0)
-                memmove((char *) oco->buf + oco->count,
-                        extraBuf + written, len);
-
-            oco->count = notWritten;    /* this will include the pad */
             ospoll_listen(server_poll, oc->fd, X_NOTIFY_WRITE);
 
             /* return only the amount explicitly requested */
@@ -949,14 +1210,19 @@ FlushClient(ClientPtr who, OsCommPtr oc, const void *__extraBuf, int extraCount)
         }
 #endif
         else {
+            if (owned)
+                free((void *) extraBuf);
             AbortClient(who);
             MarkClientException(who);
+            FreeOutputChunks(oco);
             oco->count = 0;
             return -1;
         }
     }
 
     /* everything was flushed out */
+    if (owned)
+        free((void *) extraBuf);
     oco->count = 0;
     output_pending_clear(who);
 
@@ -990,6 +1256,7 @@ AllocateInputBuffer(void)
     oci->bufcnt = 0;
     oci->lenLastReq = 0;
     oci->ignoreBytes = 0;
+    oci->smallReads = 0;
     return oci;
 }
 
@@ -1008,6 +1275,7 @@ AllocateOutputBuffer(void)
     }
     oco->size = BUFSIZE;
     oco->count = 0;
+    oco->chunks = oco->lastChunk = NULL;
     return oco;
 }
 
@@ -1031,9 +1299,11 @@ FreeOsBuffers(OsCommPtr oc)
             oci->bufcnt = 0;
             oci->lenLastReq = 0;
             oci->ignoreBytes = 0;
+            oci->smallReads = 0;
         }
     }
     if ((oco = oc->output)) {
+        FreeOutputChunks(oco);
         if (FreeOutputs) {
             free(oco->buf);
             free(oco);
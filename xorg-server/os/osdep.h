@@ -111,6 +111,8 @@ typedef void (*OsCloseFunc) (ClientPtr);
 typedef int (*OsFlushFunc) (ClientPtr who, struct _osComm * oc, char *extraBuf,
                             int extraCount);
 
+typedef struct _ReadQueue *ReadQueuePtr;
+
 typedef struct _osComm {
     int fd;
     ConnectionInputPtr input;
@@ -119,6 +121,7 @@ typedef struct _osComm {
     CARD32 conn_time;           /* timestamp if not established, else 0  */
     struct _XtransConnInfo *trans_conn; /* transport connection object */
     int flags;
+    ReadQueuePtr reader;        /* reader thread queue, if any */
 } OsCommRec, *OsCommPtr;
 
 #define OS_COMM_GRAB_IMPERVIOUS 1
@@ -146,6 +149,16 @@ listen_to_client(ClientPtr client);
 
 extern Bool NewOutputPending;
 
+/* in readthread.c */
+#ifdef HAVE_PTHREAD
+#define HAVE_READ_THREADS 1
+#endif
+extern int ReadThreads;
+extern Bool ReadThreadAddClient(ClientPtr client);
+extern void ReadThreadRemoveClient(OsCommPtr oc);
+extern int ReadThreadPeek(OsCommPtr oc);
+extern void ReadThreadTake(OsCommPtr oc, char *buf);
+
 extern WorkQueuePtr workQueue;
 
 /* in access.c */
@@ -0,0 +1,1006 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* readthread.c -- Threaded reading of client requests.
+ *
+ * With -readthreads n, remote client connections are spread over n reader
+ * threads.  Each thread polls its sockets with its own ospoll, cuts what
+ * arrives into whole requests and queues those on a per-client ring;
+ * ReadRequestFromClient() then takes one request at a time out of the
+ * ring instead of going to the socket.  The ring has exactly one producer
+ * (the reader thread) and one consumer (the main thread), so it needs no
+ * lock, only ordered head and tail updates.
+ *
+ * Framing follows the connection: the first thing queued is the setup
+ * message, whose byte order the thread keeps for the request lengths, and
+ * a BIG-REQUESTS enable switches it to reading extended lengths for the
+ * requests after it.  Requests longer than maxBigRequestSize are queued
+ * as their header alone and the rest is dropped on the thread, so the
+ * main thread can fail them with BadLength without reading them.
+ *
+ * Byte swapping stays on the main thread, done in place by the SProc
+ * handlers just before they run the request: which handler applies, and
+ * how much of a request it swaps, depends on extension and client state
+ * that only dispatch has.  Output stays there too.  A reader thread that
+ * fills a ring stops polling that socket until the main thread catches
+ * up, so an ignored or grab-blocked client still gets pushed back on
+ * through TCP.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <X11/X.h>
+#include <X11/Xproto.h>
+#include "os.h"
+#include "osdep.h"
+#include "opaque.h"
+#include "dixstruct.h"
+#include "misc.h"
+
+int ReadThreads = 0;
+
+#ifdef HAVE_READ_THREADS
+
+#ifdef WIN32
+#include <X11/Xwinsock.h>
+#else
+#include <fcntl.h>
+#include <sys/socket.h>
+#endif
+#include <pthread.h>
+#include <signal.h>
+#include <X11/extensions/bigreqsproto.h>
+#include "extnsionst.h"
+
+/* Must be a power of two */
+#define READ_QUEUE_SIZE         (128 * 1024)
+#define READ_QUEUE_EOF          -1
+/* Requests bigger than this are queued as a pointer to a copy */
+#define READ_QUEUE_INLINE       (READ_QUEUE_SIZE / 4)
+#define READ_RECORD_HEAP        0x80000000
+#define READ_RECORD_POINTER     pad_to_int32(sizeof(char *))
+#define READ_STAGE_SIZE         (16 * 1024)
+#define READ_UNIT_BAD           ((unsigned int) -1)
+
+#ifdef __GNUC__
+#define READ_LOAD(p)            __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define READ_STORE(p, v)        __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#define READ_FENCE()            __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#else
+/* MSVC gives volatile loads and stores acquire and release semantics */
+#define READ_LOAD(p)            (*(p))
+#define READ_STORE(p, v)        (*(p) = (v))
+#define READ_FENCE()            MemoryBarrier()
+#endif
+
+#ifdef WIN32
+#define ReadThreadErrno()       WSAGetLastError()
+#define ReadThreadClose(fd)     closesocket(fd)
+#else
+#define ReadThreadErrno()       errno
+#define ReadThreadClose(fd)     close(fd)
+#endif
+
+typedef struct _ReadThread ReadThreadRec, *ReadThreadPtr;
+
+typedef enum _ReadQueueState {
+    read_queue_added,
+    read_queue_running,
+    read_queue_removed,
+    read_queue_gone
+} ReadQueueState;
+
+typedef struct _ReadQueue {
+    struct xorg_list node;      /* on thread->queues */
+    struct xorg_list pending;   /* on thread->pending while signalled */
+    ReadThreadPtr thread;
+    ClientPtr client;
+    int fd;
+    int bigReqOpcode;           /* 0 if BIG-REQUESTS is not there */
+    /* protected by thread->mutex */
+    ReadQueueState state;
+    Bool signalled;
+    Bool resume;
+    /* reader thread only */
+    char *in;                   /* read from the socket, not yet queued */
+    unsigned int inSize;
+    unsigned int inStart;
+    unsigned int inEnd;
+    unsigned int want;          /* size of the partial request at inStart */
+    unsigned int skip;          /* rest of a too-big request to drop */
+    Bool setup;                 /* the setup message has been queued */
+    Bool swapped;
+    Bool bigRequests;
+    /* shared, accessed through READ_LOAD and READ_STORE */
+    volatile int stalled;
+    volatile int status;        /* 0, READ_QUEUE_EOF or an errno value */
+    volatile unsigned int head; /* advanced by the reader thread */
+    volatile unsigned int tail; /* advanced by the main thread */
+    char data[READ_QUEUE_SIZE];
+} ReadQueueRec;
+
+struct _ReadThread {
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    struct ospoll *fds;
+    struct xorg_list queues;
+    struct xorg_list pending;
+    int controlRead;
+    int controlWrite;
+    int notifyRead;
+    int notifyWrite;
+    int nclients;
+    Bool changed;
+    Bool running;
+};
+
+static ReadThreadPtr readThreads;
+static int numReadThreads;
+
+static void
+ReadThreadWake(int fd)
+{
+    int ret;
+    char byte = 0;
+
+    do {
+        ret = send(fd, &byte, 1, 0);
+    } while (ret < 0 && (ETEST(ReadThreadErrno()) ||
+                         ReadThreadErrno() == EINTR));
+}
+
+static int
+ReadThreadDrain(int fd)
+{
+    int ret, err;
+    char array[64];
+
+    ret = recv(fd, array, sizeof(array), 0);
+    if (ret >= 0)
+        return ret;
+
+    err = ReadThreadErrno();
+    if (!ETEST(err) && err != EINTR)
+        FatalError("read-thread: draining wakeup socket (%d)", err);
+
+    return 1;
+}
+
+/**
+ * Connected pair of sockets for waking a thread's ospoll.  Sockets rather
+ * than a pipe, because that is all ospoll can wait on under WIN32.
+ */
+static Bool
+ReadThreadSocketPair(int fds[2])
+{
+#ifdef WIN32
+    struct sockaddr_in addr;
+    int len = sizeof(addr);
+    SOCKET listener, a = INVALID_SOCKET, b = INVALID_SOCKET;
+
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener == INVALID_SOCKET)
+        return FALSE;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    if (bind(listener, (struct sockaddr *) &addr, sizeof(addr)) == 0 &&
+        listen(listener, 1) == 0 &&
+        getsockname(listener, (struct sockaddr *) &addr, &len) == 0 &&
+        (a = socket(AF_INET, SOCK_STREAM, 0)) != INVALID_SOCKET &&
+        connect(a, (struct sockaddr *) &addr, sizeof(addr)) == 0)
+        b = accept(listener, NULL, NULL);
+    closesocket(listener);
+
+    if (b == INVALID_SOCKET) {
+        if (a != INVALID_SOCKET)
+            closesocket(a);
+        return FALSE;
+    }
+    fds[0] = (int) b;
+    fds[1] = (int) a;
+    return TRUE;
+#else
+    return socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0;
+#endif
+}
+
+static void
+ReadThreadSetSocket(int fd, Bool nonblock)
+{
+#ifdef WIN32
+    u_long on = 1;
+
+    if (nonblock)
+        ioctlsocket(fd, FIONBIO, &on);
+#else
+    int flags;
+
+    if (nonblock)
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+    flags = fcntl(fd, F_GETFD);
+    if (flags != -1)
+        fcntl(fd, F_SETFD, flags | FD_CLOEXEC);
+#endif
+}
+
+static void
+ReadQueueCopyIn(ReadQueuePtr queue, unsigned int head,
+                const void *src, unsigned int size)
+{
+    unsigned int offset = head & (READ_QUEUE_SIZE - 1);
+    unsigned int first = min(size, READ_QUEUE_SIZE - offset);
+
+    memcpy(queue->data + offset, src, first);
+    memcpy(queue->data, (const char *) src + first, size - first);
+}
+
+static void
+ReadQueueCopyOut(ReadQueuePtr queue, unsigned int tail,
+                 void *dst, unsigned int size)
+{
+    unsigned int offset = tail & (READ_QUEUE_SIZE - 1);
+    unsigned int first = min(size, READ_QUEUE_SIZE - offset);
+
+    memcpy(dst, queue->data + offset, first);
+    memcpy((char *) dst + first, queue->data, size - first);
+}
+
+static unsigned int
+ReadRecordSize(CARD32 header)
+{
+    if (header & READ_RECORD_HEAP)
+        return sizeof(CARD32) + READ_RECORD_POINTER;
+    return sizeof(CARD32) + header;
+}
+
+/**
+ * Tell the main thread that there is something new in the queue.  The
+ * check of signalled is done under the lock so that it is ordered
+ * against the main thread clearing it before it looks at the ring.
+ * Returns whether the main thread needs waking.
+ */
+static Bool
+ReadQueueSignalLocked(ReadQueuePtr queue)
+{
+    ReadThreadPtr thread = queue->thread;
+    Bool wake = FALSE;
+
+    if (!queue->signalled) {
+        queue->signalled = TRUE;
+        wake = xorg_list_is_empty(&thread->pending);
+        xorg_list_append(&queue->pending, &thread->pending);
+    }
+    return wake;
+}
+
+static void
+ReadQueueSignal(ReadQueuePtr queue)
+{
+    ReadThreadPtr thread = queue->thread;
+    Bool wake;
+
+    pthread_mutex_lock(&thread->mutex);
+    wake = ReadQueueSignalLocked(queue);
+    pthread_mutex_unlock(&thread->mutex);
+
+    if (wake)
+        ReadThreadWake(thread->notifyWrite);
+}
+
+static Bool
+ReadQueuePrefixSwapped(char order)
+{
+    if (X_BYTE_ORDER == X_LITTLE_ENDIAN)
+        return order == 'B' || order == 'R';
+    return order == 'l' || order == 'r';
+}
+
+/**
+ * Size of the setup message or request at the start of count bytes, 0 if
+ * more are needed to tell, or READ_UNIT_BAD for a big request too short
+ * to hold its own header.  A request longer than maxBigRequestSize is
+ * cut down to its header, with *skip set to the length of the rest.
+ */
+static unsigned int
+ReadQueueUnitSize(ReadQueuePtr queue, const char *data, unsigned int count,
+                  unsigned int *skip)
+{
+    const xReq *req = (const xReq *) data;
+    unsigned int header = sizeof(xReq);
+    CARD32 length;
+
+    *skip = 0;
+    if (!queue->setup) {
+        const xConnClientPrefix *prefix = (const xConnClientPrefix *) data;
+        CARD16 proto, string;
+
+        if (count < sz_xConnClientPrefix)
+            return 0;
+        proto = prefix->nbytesAuthProto;
+        string = prefix->nbytesAuthString;
+        if (ReadQueuePrefixSwapped(prefix->byteOrder)) {
+            proto = bswap_16(proto);
+            string = bswap_16(string);
+        }
+        return sz_xConnClientPrefix + pad_to_int32(proto) +
+            pad_to_int32(string);
+    }
+
+    if (count < sizeof(xReq))
+        return 0;
+    length = queue->swapped ? bswap_16(req->length) : req->length;
+    if (!length && queue->bigRequests) {
+        header = sizeof(xBigReq);
+        if (count < sizeof(xBigReq))
+            return 0;
+        length = ((const xBigReq *) req)->length;
+        if (queue->swapped)
+            length = bswap_32(length);
+        if (length < bytes_to_int32(sizeof(xBigReq)))
+            return READ_UNIT_BAD;
+    }
+    else if (!length) {
+        /* Dispatch() fails this with BadLength */
+        return sizeof(xReq);
+    }
+
+    if (length > maxBigRequestSize) {
+        *skip = (length << 2) - header;
+        return header;
+    }
+    return length << 2;
+}
+
+/**
+ * Put one setup message or request on the ring.  Returns 0 if the ring
+ * has no room for it yet and -1 if it could not be copied.
+ */
+static int
+ReadQueuePush(ReadQueuePtr queue, const char *unit, unsigned int size)
+{
+    unsigned int head = queue->head;
+    unsigned int tail, need;
+    CARD32 header = size;
+
+    if (size > READ_QUEUE_INLINE)
+        header |= READ_RECORD_HEAP;
+    need = ReadRecordSize(header);
+
+    tail = READ_LOAD(&queue->tail);
+    if (READ_QUEUE_SIZE - (head - tail) < need) {
+        /* Full.  Re-check after publishing the stall so that a tail
+         * update racing with us is not lost.
+         */
+        READ_STORE(&queue->stalled, TRUE);
+        READ_FENCE();
+        tail = READ_LOAD(&queue->tail);
+        if (READ_QUEUE_SIZE - (head - tail) < need)
+            return 0;
+        READ_STORE(&queue->stalled, FALSE);
+    }
+
+    ReadQueueCopyIn(queue, head, &header, sizeof(header));
+    if (header & READ_RECORD_HEAP) {
+        char *copy = malloc(size);
+
+        if (!copy)
+            return -1;
+        memcpy(copy, unit, size);
+        ReadQueueCopyIn(queue, head + sizeof(header), &copy, sizeof(copy));
+    }
+    else
+        ReadQueueCopyIn(queue, head + sizeof(header), unit, size);
+
+    READ_STORE(&queue->head, head + need);
+    return 1;
+}
+
+/**
+ * Queue every whole request read so far.  Returns FALSE if that stopped
+ * short, because the ring is full or the client has broken the protocol
+ * (with status set); whatever is left stays in the staging buffer.
+ */
+static Bool
+ReadQueueFlush(ReadQueuePtr queue)
+{
+    Bool ok = TRUE;
+
+    while (queue->inStart < queue->inEnd) {
+        const char *unit = queue->in + queue->inStart;
+        unsigned int count = queue->inEnd - queue->inStart;
+        unsigned int size, skip;
+        int pushed;
+
+        if (queue->skip) {
+            size = min(count, queue->skip);
+            queue->skip -= size;
+            queue->inStart += size;
+            continue;
+        }
+
+        size = ReadQueueUnitSize(queue, unit, count, &skip);
+        if (size == READ_UNIT_BAD) {
+            READ_STORE(&queue->status, READ_QUEUE_EOF);
+            ok = FALSE;
+            break;
+        }
+        if (!size || size > count) {
+            queue->want = size;
+            break;
+        }
+
+        pushed = ReadQueuePush(queue, unit, size);
+        if (pushed < 0)
+            READ_STORE(&queue->status, ENOMEM);
+        if (pushed <= 0) {
+            ok = FALSE;
+            break;
+        }
+
+        if (!queue->setup) {
+            queue->setup = TRUE;
+            queue->swapped = ReadQueuePrefixSwapped(unit[0]);
+        }
+        else if (queue->bigReqOpcode &&
+                 ((const xReq *) unit)->reqType == queue->bigReqOpcode &&
+                 ((const xReq *) unit)->data == X_BigReqEnable &&
+                 size == sz_xBigReqEnableReq) {
+            /* ProcBigReqDispatch will turn them on before the request
+             * after this one is read
+             */
+            queue->bigRequests = TRUE;
+        }
+        queue->inStart += size;
+        queue->skip = skip;
+        queue->want = 0;
+    }
+
+    if (queue->inStart == queue->inEnd)
+        queue->inStart = queue->inEnd = 0;
+    return ok;
+}
+
+/**
+ * Make room in the staging buffer for the rest of the request at its
+ * start, and give back what a huge request took once it is gone.
+ */
+static Bool
+ReadQueueRoom(ReadQueuePtr queue)
+{
+    unsigned int count = queue->inEnd - queue->inStart;
+    unsigned int want = max(queue->want, READ_STAGE_SIZE);
+    char *in;
+
+    /* Only part of one request is ever left over, so this is cheap */
+    if (queue->inStart) {
+        memmove(queue->in, queue->in + queue->inStart, count);
+        queue->inStart = 0;
+        queue->inEnd = count;
+    }
+
+    if (want != queue->inSize && count <= want) {
+        in = realloc(queue->in, want);
+        if (!in)
+            return want < queue->inSize;
+        queue->in = in;
+        queue->inSize = want;
+    }
+    return TRUE;
+}
+
+/**
+ * Socket callback, called on the reader thread.  Reads what fits into the
+ * staging buffer and queues the whole requests in it; when the ring is
+ * full the socket is muted until the main thread has drained some of it.
+ */
+static void
+ReadQueueReady(int fd, int xevents, void *data)
+{
+    ReadQueuePtr queue = data;
+    ReadThreadPtr thread = queue->thread;
+    unsigned int head = queue->head;
+    int result, err = 0;
+
+    if (!ReadQueueRoom(queue)) {
+        result = -1;
+        err = ENOMEM;
+    }
+    else {
+        do {
+            result = recv(fd, queue->in + queue->inEnd,
+                          queue->inSize - queue->inEnd, 0);
+            if (result < 0)
+                err = ReadThreadErrno();
+        } while (result < 0 && err == EINTR);
+    }
+
+    if (result > 0) {
+        queue->inEnd += result;
+        if (!ReadQueueFlush(queue))
+            ospoll_mute(thread->fds, fd, X_NOTIFY_READ);
+    }
+    else if (result < 0 && ETEST(err)) {
+        return;
+    }
+    else {
+        /* Leave the socket for the main thread to close; it gets the
+         * error once it has consumed everything read before it.
+         */
+        READ_STORE(&queue->status, result == 0 ? READ_QUEUE_EOF : err);
+        ospoll_mute(thread->fds, fd, X_NOTIFY_READ);
+    }
+
+    if (queue->head != head || queue->status)
+        ReadQueueSignal(queue);
+}
+
+static void
+ReadThreadControlNotify(int fd, int xevents, void *data)
+{
+    ReadThreadPtr thread = data;
+
+    /* Shut down once the main thread closes its end */
+    if (ReadThreadDrain(thread->controlRead) == 0)
+        thread->running = FALSE;
+}
+
+/**
+ * Apply the queue additions, removals and resumes the main thread has
+ * asked for.  Removals are acknowledged through thread->cond; once a
+ * queue is gone this thread will not touch it again.
+ */
+static void
+ReadThreadUpdate(ReadThreadPtr thread)
+{
+    ReadQueuePtr queue, tmp;
+    Bool removed = FALSE;
+    Bool wake = FALSE;
+
+    pthread_mutex_lock(&thread->mutex);
+    thread->changed = FALSE;
+    xorg_list_for_each_entry_safe(queue, tmp, &thread->queues, node) {
+        switch (queue->state) {
+        case read_queue_added:
+            ospoll_add(thread->fds, queue->fd, ospoll_trigger_level,
+                       ReadQueueReady, queue);
+            ospoll_listen(thread->fds, queue->fd, X_NOTIFY_READ);
+            queue->state = read_queue_running;
+            queue->resume = FALSE;
+            break;
+        case read_queue_running:
+            if (queue->resume) {
+                unsigned int head = queue->head;
+
+                /* Requests already read come first; the socket may
+                 * have nothing more to say until it gets replies.
+                 */
+                queue->resume = FALSE;
+                if (!queue->status && ReadQueueFlush(queue))
+                    ospoll_listen(thread->fds, queue->fd, X_NOTIFY_READ);
+                if (queue->head != head || queue->status)
+                    wake |= ReadQueueSignalLocked(queue);
+            }
+            break;
+        case read_queue_removed:
+            ospoll_remove(thread->fds, queue->fd);
+            xorg_list_del(&queue->node);
+            queue->state = read_queue_gone;
+            removed = TRUE;
+            break;
+        case read_queue_gone:
+            break;
+        }
+    }
+    if (removed)
+        pthread_cond_broadcast(&thread->cond);
+    pthread_mutex_unlock(&thread->mutex);
+
+    if (wake)
+        ReadThreadWake(thread->notifyWrite);
+}
+static void *
+ReadThreadDoWork(void *arg)
+{
+    ReadThreadPtr thread = arg;
+    Bool changed;
+#ifdef SIG_BLOCK
+    sigset_t set;
+
+    /* Don't handle any signals on this thread */
+    sigfillset(&set);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+#endif
+
+#if defined(HAVE_PTHREAD_SETNAME_NP_WITH_TID)
+    pthread_setname_np (pthread_self(), "ReadThread");
+#elif defined(HAVE_PTHREAD_SETNAME_NP_WITHOUT_TID)
+    pthread_setname_np ("ReadThread");
+#endif
+
+    ospoll_add(thread->fds, thread->controlRead,
+               ospoll_trigger_level,
+               ReadThreadControlNotify,
+               thread);
+    ospoll_listen(thread->fds, thread->controlRead, X_NOTIFY_READ);
+
+    while (thread->running) {
+        pthread_mutex_lock(&thread->mutex);
+        changed = thread->changed;
+        pthread_mutex_unlock(&thread->mutex);
+        if (changed)
+            ReadThreadUpdate(thread);
+
+        if (ospoll_wait(thread->fds, -1) < 0) {
+            if (errno == EINVAL)
+                FatalError("read-thread: %s (%s)", __FUNCTION__, strerror(errno));
+            else if (errno != EINTR)
+                ErrorF("read-thread: %s (%s)\n", __FUNCTION__, strerror(errno));
+        }
+    }
+
+    ospoll_remove(thread->fds, thread->controlRead);
+
+    return NULL;
+}
+
+/**
+ * Main thread side of ReadQueueSignal: every client whose queue got
+ * data, or an error, since the last call becomes ready for dispatch.
+ */
+static void
+ReadThreadNotify(int fd, int xevents, void *data)
+{
+    ReadThreadPtr thread = data;
+    ReadQueuePtr queue, tmp;
+
+    ReadThreadDrain(thread->notifyRead);
+
+    pthread_mutex_lock(&thread->mutex);
+    xorg_list_for_each_entry_safe(queue, tmp, &thread->pending, pending) {
+        ClientPtr client = queue->client;
+        OsCommPtr oc = (OsCommPtr) client->osPrivate;
+
+        queue->signalled = FALSE;
+        xorg_list_del(&queue->pending);
+
+        if (client->clientGone)
+            continue;
+        if (listen_to_client(client))
+            mark_client_ready(client);
+        else if (!(oc->flags & OS_COMM_IGNORED))
+            mark_client_saved_ready(client);
+    }
+    pthread_mutex_unlock(&thread->mutex);
+}
+
+/**
+ * Start the reader threads asked for with -readthreads.
+ */
+void
+ReadThreadInit(void)
+{
+    int i;
+
+    if (ReadThreads <= 0)
+        return;
+
+    readThreads = calloc(ReadThreads, sizeof(ReadThreadRec));
+    if (!readThreads)
+        FatalError("read-thread: could not allocate memory");
+
+    for (i = 0; i < ReadThreads; i++) {
+        ReadThreadPtr thread = &readThreads[i];
+        int control[2], notify[2];
+
+        if (!ReadThreadSocketPair(control) || !ReadThreadSocketPair(notify))
+            FatalError("read-thread: could not create wakeup sockets");
+
+        pthread_mutex_init(&thread->mutex, NULL);
+        pthread_cond_init(&thread->cond, NULL);
+        xorg_list_init(&thread->queues);
+        xorg_list_init(&thread->pending);
+        thread->fds = ospoll_create();
+        if (!thread->fds)
+            FatalError("read-thread: could not create poll set");
+
+        thread->controlRead = control[0];
+        thread->controlWrite = control[1];
+        thread->notifyRead = notify[0];
+        thread->notifyWrite = notify[1];
+        ReadThreadSetSocket(thread->controlRead, TRUE);
+        ReadThreadSetSocket(thread->controlWrite, FALSE);
+        ReadThreadSetSocket(thread->notifyRead, TRUE);
+        ReadThreadSetSocket(thread->notifyWrite, FALSE);
+        SetNotifyFd(thread->notifyRead, ReadThreadNotify, X_NOTIFY_READ,
+                    thread);
+
+        thread->running = TRUE;
+        if (pthread_create(&thread->thread, NULL, ReadThreadDoWork,
+                           thread) != 0)
+            FatalError("read-thread: could not create thread");
+        numReadThreads++;
+    }
+
+    LogMessageVerb(X_INFO, 1, "Reading remote clients on %d thread%s\n",
+                   numReadThreads, numReadThreads == 1 ? "" : "s");
+}
+
+/**
+ * Free a queue the reader thread has let go of, along with the copies of
+ * big requests still on it.
+ */
+static void
+ReadQueueFree(ReadQueuePtr queue)
+{
+    unsigned int tail = queue->tail;
+    CARD32 header;
+    char *copy;
+
+    while (tail != queue->head) {
+        ReadQueueCopyOut(queue, tail, &header, sizeof(header));
+        if (header & READ_RECORD_HEAP) {
+            ReadQueueCopyOut(queue, tail + sizeof(header),
+                             &copy, sizeof(copy));
+            free(copy);
+        }
+        tail += ReadRecordSize(header);
+    }
+    free(queue->in);
+    free(queue);
+}
+
+/**
+ * Stop the reader threads.  Called at server reset, after all clients
+ * have been closed down.
+ */
+void
+ReadThreadFini(void)
+{
+    int i;
+
+    for (i = 0; i < numReadThreads; i++) {
+        ReadThreadPtr thread = &readThreads[i];
+        ReadQueuePtr queue, tmp;
+
+        ReadThreadClose(thread->controlWrite);
+        pthread_join(thread->thread, NULL);
+
+        xorg_list_for_each_entry_safe(queue, tmp, &thread->queues, node) {
+            OsCommPtr oc = (OsCommPtr) queue->client->osPrivate;
+
+            if (queue->state != read_queue_added)
+                ospoll_remove(thread->fds, queue->fd);
+            if (oc)
+                oc->reader = NULL;
+            xorg_list_del(&queue->node);
+            ReadQueueFree(queue);
+        }
+        ospoll_destroy(thread->fds);
+
+        RemoveNotifyFd(thread->notifyRead);
+        ReadThreadClose(thread->controlRead);
+        ReadThreadClose(thread->notifyRead);
+        ReadThreadClose(thread->notifyWrite);
+        pthread_cond_destroy(&thread->cond);
+        pthread_mutex_destroy(&thread->mutex);
+    }
+
+    free(readThreads);
+    readThreads = NULL;
+    numReadThreads = 0;
+}
+
+/**
+ * Hand a new connection to the least loaded reader thread.  Local
+ * clients stay on the main thread: they may pass file descriptors,
+ * which xtrans collects from the socket as part of reading requests.
+ */
+Bool
+ReadThreadAddClient(ClientPtr client)
+{
+    OsCommPtr oc = (OsCommPtr) client->osPrivate;
+    ExtensionEntry *bigreq;
+    ReadThreadPtr thread;
+    ReadQueuePtr queue;
+    int i;
+
+    if (!numReadThreads || client->local || oc->fd < 0)
+        return FALSE;
+
+    thread = &readThreads[0];
+    for (i = 1; i < numReadThreads; i++)
+        if (readThreads[i].nclients < thread->nclients)
+            thread = &readThreads[i];
+
+    queue = calloc(1, sizeof(ReadQueueRec));
+    if (!queue)
+        return FALSE;
+
+    queue->thread = thread;
+    queue->client = client;
+    queue->fd = oc->fd;
+    bigreq = CheckExtension(XBigReqExtensionName);
+    if (bigreq)
+        queue->bigReqOpcode = bigreq->base;
+    queue->state = read_queue_added;
+    xorg_list_init(&queue->pending);
+
+    pthread_mutex_lock(&thread->mutex);
+    xorg_list_append(&queue->node, &thread->queues);
+    thread->changed = TRUE;
+    pthread_mutex_unlock(&thread->mutex);
+    ReadThreadWake(thread->controlWrite);
+
+    thread->nclients++;
+    oc->reader = queue;
+    return TRUE;
+}
+
+/**
+ * Take a connection back from its reader thread before the socket is
+ * closed.  Waits for the thread to drop the socket from its poll set.
+ */
+void
+ReadThreadRemoveClient(OsCommPtr oc)
+{
+    ReadQueuePtr queue = oc->reader;
+    ReadThreadPtr thread;
+
+    if (!queue)
+        return;
+    thread = queue->thread;
+
+    pthread_mutex_lock(&thread->mutex);
+    queue->state = read_queue_removed;
+    thread->changed = TRUE;
+    pthread_mutex_unlock(&thread->mutex);
+    ReadThreadWake(thread->controlWrite);
+
+    pthread_mutex_lock(&thread->mutex);
+    while (queue->state != read_queue_gone)
+        pthread_cond_wait(&thread->cond, &thread->mutex);
+    if (queue->signalled)
+        xorg_list_del(&queue->pending);
+    pthread_mutex_unlock(&thread->mutex);
+
+    thread->nclients--;
+    oc->reader = NULL;
+    ReadQueueFree(queue);
+}
+
+/**
+ * Size of the next setup message or request the reader thread has
+ * queued for this connection.  Returns -1 with errno set to EAGAIN if
+ * there is none yet, and the socket's own EOF or error, as read() would,
+ * once everything before it has been taken.
+ */
+int
+ReadThreadPeek(OsCommPtr oc)
+{
+    ReadQueuePtr queue = oc->reader;
+    unsigned int head;
+    CARD32 header;
+    int status;
+
+    status = READ_LOAD(&queue->status);
+    head = READ_LOAD(&queue->head);
+
+    if (head == queue->tail) {
+        if (status == 0)
+            errno = EAGAIN;
+        else if (status == READ_QUEUE_EOF)
+            return 0;
+        else
+            errno = status;
+        return -1;
+    }
+
+    ReadQueueCopyOut(queue, queue->tail, &header, sizeof(header));
+    return header & ~READ_RECORD_HEAP;
+}
+
+/**
+ * Copy out the request ReadThreadPeek returned the size of, and let the
+ * reader thread go on if it was waiting for room.
+ */
+void
+ReadThreadTake(OsCommPtr oc, char *buf)
+{
+    ReadQueuePtr queue = oc->reader;
+    unsigned int tail = queue->tail;
+    CARD32 header, size;
+    char *copy;
+
+    ReadQueueCopyOut(queue, tail, &header, sizeof(header));
+    size = header & ~READ_RECORD_HEAP;
+    if (header & READ_RECORD_HEAP) {
+        ReadQueueCopyOut(queue, tail + sizeof(header), &copy, sizeof(copy));
+        memcpy(buf, copy, size);
+        free(copy);
+    }
+    else
+        ReadQueueCopyOut(queue, tail + sizeof(header), buf, size);
+
+    READ_STORE(&queue->tail, tail + ReadRecordSize(header));
+    READ_FENCE();
+    if (READ_LOAD(&queue->stalled)) {
+        ReadThreadPtr thread = queue->thread;
+
+        READ_STORE(&queue->stalled, FALSE);
+        pthread_mutex_lock(&thread->mutex);
+        queue->resume = TRUE;
+        thread->changed = TRUE;
+        pthread_mutex_unlock(&thread->mutex);
+        ReadThreadWake(thread->controlWrite);
+    }
+}
+
+#else                           /* HAVE_READ_THREADS */
+
+void
+ReadThreadInit(void)
+{
+    if (ReadThreads > 0)
+        LogMessageVerb(X_WARNING, 1,
+                       "Reader threads are not supported on this platform\n");
+}
+
+void
+ReadThreadFini(void)
+{
+}
+
+Bool
+ReadThreadAddClient(ClientPtr client)
+{
+    return FALSE;
+}
+
+void
+ReadThreadRemoveClient(OsCommPtr oc)
+{
+}
+
+int
+ReadThreadPeek(OsCommPtr oc)
+{
+    errno = EAGAIN;
+    return -1;
+}
+
+void
+ReadThreadTake(OsCommPtr oc, char *buf)
+{
+}
+
+#endif                          /* HAVE_READ_THREADS */
@@ -108,6 +108,7 @@ __stdcall unsigned long GetTickCount(void);
 #include "opaque.h"
 
 #include "dixstruct.h"
+#include "reqprofile.h"
 
 #include "xkbsrv.h"
 
@@ -188,6 +189,8 @@ Bool CoreDump;
 
 Bool enableIndirectGLX = TRUE;
 
+int RenderThreads = 0;
+
 #ifdef PANORAMIX
 Bool PanoramiXExtensionDisabledHack = FALSE;
 #endif
@@ -579,7 +582,14 @@ UseMsg(void)
     ErrorF("-nopn                  reject failure to listen on all ports\n");
     ErrorF("-r                     turns off auto-repeat\n");
     ErrorF("r                      turns on auto-repeat \n");
+#ifdef HAVE_READ_THREADS
+    ErrorF("-readthreads n         read remote clients on n threads\n");
+#endif
+    ErrorF("-reqprofile            count and time requests by opcode\n");
     ErrorF("-render [default|mono|gray|color] set render color alloc policy\n");
+#ifdef HAVE_PTHREAD
+    ErrorF("-renderthreads n       composite large areas on n more threads\n");
+#endif
     ErrorF("-retro                 start with classic stipple\n");
     ErrorF("-seat string           seat to run on\n");
     ErrorF("-t #                   default pointer threshold (pixels/t)\n");
@@ -593,6 +603,7 @@ UseMsg(void)
     ErrorF
         ("-dumbSched             Disable smart scheduling and threaded input, enable old behavior\n");
     ErrorF("-schedInterval int     Set scheduler interval in msec\n");
+    ErrorF("-schedAdaptive         Schedule clients by measured request cost and wait\n");
     ErrorF("+extension name        Enable extension\n");
     ErrorF("-extension name        Disable extension\n");
 #ifdef XDMCP
@@ -1008,6 +1019,9 @@ ProcessCommandLine(int argc, char *argv[])
             else
                 UseMsg();
         }
+        else if (strcmp(argv[i], "-schedAdaptive") == 0) {
+            SmartScheduleAdaptive = TRUE;
+        }
         else if (strcmp(argv[i], "-schedMax") == 0) {
             if (++i < argc) {
                 SmartScheduleMaxSlice = atoi(argv[i]);
@@ -1015,6 +1029,27 @@ ProcessCommandLine(int argc, char *argv[])
             else
                 UseMsg();
         }
+        else if (strcmp(argv[i], "-readthreads") == 0) {
+            if (++i < argc)
+                ReadThreads = atoi(argv[i]);
+            else
+                UseMsg();
+        }
+        else if (strcmp(argv[i], "-reqprofile") == 0) {
+            RequestProfiling = TRUE;
+        }
+        else if (strcmp(argv[i], "-renderthreads") == 0) {
+            if (++i < argc) {
+#ifdef HAVE_PTHREAD
+                RenderThreads = atoi(argv[i]);
+#else
+                LogMessageVerb(X_WARNING, 1, "Render threads are not "
+                               "supported on this platform\n");
+#endif
+            }
+            else
+                UseMsg();
+        }
         else if (strcmp(argv[i], "-render") == 0) {
             if (++i < argc) {
                 int policy = PictureParseCmapPolicy(argv[i]);
@@ -868,7 +868,7 @@ CreateSolidPicture(Picture pid, xRenderColor * color, int *error)
     pPicture->pSourcePict = (SourcePictPtr) malloc(sizeof(PictSolidFill));
     if (!pPicture->pSourcePict) {
         *error = BadAlloc;
-        free(pPicture);
+        dixFreeObjectWithPrivates(pPicture, PRIVATE_PICTURE);
         return 0;
     }
     pPicture->pSourcePict->type = SourcePictTypeSolidFill;
@@ -899,7 +899,7 @@ CreateLinearGradientPicture(Picture pid, xPointFixed * p1, xPointFixed * p2,
     pPicture->pSourcePict = (SourcePictPtr) malloc(sizeof(PictLinearGradient));
     if (!pPicture->pSourcePict) {
         *error = BadAlloc;
-        free(pPicture);
+        dixFreeObjectWithPrivates(pPicture, PRIVATE_PICTURE);
         return 0;
     }
 
@@ -909,7 +909,7 @@ CreateLinearGradientPicture(Picture pid, xPointFixed * p1, xPointFixed * p2,
 
     initGradient(pPicture->pSourcePict, nStops, stops, colors, error);
     if (*error) {
-        free(pPicture);
+        dixFreeObjectWithPrivates(pPicture, PRIVATE_PICTURE);
         return 0;
     }
     return pPicture;
@@ -939,7 +939,7 @@ CreateRadialGradientPicture(Picture pid, xPointFixed * inner,
     pPicture->pSourcePict = (SourcePictPtr) malloc(sizeof(PictRadialGradient));
     if (!pPicture->pSourcePict) {
         *error = BadAlloc;
-        free(pPicture);
+        dixFreeObjectWithPrivates(pPicture, PRIVATE_PICTURE);
         return 0;
     }
     radial = &pPicture->pSourcePict->radial;
@@ -954,7 +954,7 @@ CreateRadialGradientPicture(Picture pid, xPointFixed * inner,
 
     initGradient(pPicture->pSourcePict, nStops, stops, colors, error);
     if (*error) {
-        free(pPicture);
+        dixFreeObjectWithPrivates(pPicture, PRIVATE_PICTURE);
         return 0;
     }
     return pPicture;
@@ -982,7 +982,7 @@ CreateConicalGradientPicture(Picture pid, xPointFixed * center, xFixed angle,
     pPicture->pSourcePict = (SourcePictPtr) malloc(sizeof(PictConicalGradient));
     if (!pPicture->pSourcePict) {
         *error = BadAlloc;
-        free(pPicture);
+        dixFreeObjectWithPrivates(pPicture, PRIVATE_PICTURE);
         return 0;
     }
 
@@ -992,7 +992,7 @@ CreateConicalGradientPicture(Picture pid, xPointFixed * center, xFixed angle,
 
     initGradient(pPicture->pSourcePict, nStops, stops, colors, error);
     if (*error) {
-        free(pPicture);
+        dixFreeObjectWithPrivates(pPicture, PRIVATE_PICTURE);
         return 0;
     }
     return pPicture;
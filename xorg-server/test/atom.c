@@ -0,0 +1,132 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Tests for the atom table, plus a rough benchmark interning and looking
+ * up a few hundred thousand atoms.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <X11/Xatom.h>
+#include "misc.h"
+#include "dix.h"
+
+#include "tests-common.h"
+
+#define NUM_BENCH_ATOMS 200000
+
+static void
+atom_predefined(void)
+{
+    InitAtoms();
+
+    assert(!ValidAtom(None));
+    assert(ValidAtom(XA_PRIMARY));
+    assert(ValidAtom(XA_LAST_PREDEFINED));
+    assert(!ValidAtom(XA_LAST_PREDEFINED + 1));
+
+    assert(NameForAtom(None) == NULL);
+    assert(strcmp(NameForAtom(XA_PRIMARY), "PRIMARY") == 0);
+    assert(strcmp(NameForAtom(XA_WM_TRANSIENT_FOR), "WM_TRANSIENT_FOR") == 0);
+    assert(NameForAtom(XA_LAST_PREDEFINED + 1) == NULL);
+
+    assert(MakeAtom("PRIMARY", 7, FALSE) == XA_PRIMARY);
+    assert(MakeAtom("PRIMARY", 7, TRUE) == XA_PRIMARY);
+    /* only the first len bytes count */
+    assert(MakeAtom("PRIMARYX", 7, FALSE) == XA_PRIMARY);
+    assert(MakeAtom("PRIMAR", 6, FALSE) == None);
+    assert(MakeAtom("", 0, FALSE) == None);
+}
+
+static void
+atom_intern(void)
+{
+    Atom a, b, empty;
+
+    a = MakeAtom("_TEST_ATOM", 10, TRUE);
+    assert(a == XA_LAST_PREDEFINED + 1);
+    assert(ValidAtom(a));
+    assert(strcmp(NameForAtom(a), "_TEST_ATOM") == 0);
+    assert(MakeAtom("_TEST_ATOM", 10, TRUE) == a);
+
+    b = MakeAtom("_TEST_ATOM_2", 12, TRUE);
+    assert(b == a + 1);
+    assert(MakeAtom("_TEST_ATOM_2", 10, FALSE) == a);
+
+    empty = MakeAtom("", 0, TRUE);
+    assert(empty == b + 1);
+    assert(strcmp(NameForAtom(empty), "") == 0);
+    assert(MakeAtom("", 0, FALSE) == empty);
+
+    /* a reset starts over with only the predefined atoms */
+    FreeAllAtoms();
+    InitAtoms();
+    assert(!ValidAtom(a));
+    assert(MakeAtom("_TEST_ATOM", 10, FALSE) == None);
+}
+
+static void
+atom_bench(void)
+{
+    static char names[NUM_BENCH_ATOMS][24];
+    CARD64 start, interned, looked_up;
+    Atom first;
+    int i;
+
+    for (i = 0; i < NUM_BENCH_ATOMS; i++)
+        snprintf(names[i], sizeof(names[i]), "_BENCH_ATOM_%d", i);
+
+    start = GetTimeInMicros();
+    first = MakeAtom(names[0], strlen(names[0]), TRUE);
+    for (i = 1; i < NUM_BENCH_ATOMS; i++)
+        assert(MakeAtom(names[i], strlen(names[i]), TRUE) == first + i);
+    interned = GetTimeInMicros();
+    for (i = 0; i < NUM_BENCH_ATOMS; i++) {
+        Atom a = MakeAtom(names[i], strlen(names[i]), FALSE);
+
+        assert(a == first + i);
+        assert(strcmp(NameForAtom(a), names[i]) == 0);
+    }
+    looked_up = GetTimeInMicros();
+
+    printf("%d atoms: interned in %llu us, looked up in %llu us\n",
+           NUM_BENCH_ATOMS,
+           (unsigned long long) (interned - start),
+           (unsigned long long) (looked_up - interned));
+
+    FreeAllAtoms();
+}
+
+int
+atom_test(void)
+{
+    atom_predefined();
+    atom_intern();
+    atom_bench();
+
+    return 0;
+}
@@ -0,0 +1,167 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Times small PolyFillRectangle and PolySegment requests, one shape per
+ * request, into a window and into a pixmap, with thin and wide lines.
+ * These are the requests where going through the GC wrappers costs the
+ * most next to the drawing itself.  The last rectangle drawn is read
+ * back, so a server that drops the drawing fails the run.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <xcb/xcb.h>
+
+#define NUM_REQUESTS    500000
+#define SIZE            256
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double
+run(xcb_connection_t *c, xcb_drawable_t d, xcb_gcontext_t gc, int segments)
+{
+    double start = now();
+    int i;
+
+    for (i = 0; i < NUM_REQUESTS; i++) {
+        int x = i % (SIZE - 8), y = (i / 13) % (SIZE - 8);
+
+        if (segments) {
+            xcb_segment_t seg = { x, y, x + 6, y + (i & 7) };
+
+            xcb_poly_segment(c, d, gc, 1, &seg);
+        }
+        else {
+            xcb_rectangle_t rect = { x, y, 4, 4 };
+
+            xcb_poly_fill_rectangle(c, d, gc, 1, &rect);
+        }
+    }
+    free(xcb_get_input_focus_reply(c, xcb_get_input_focus(c), NULL));
+    return now() - start;
+}
+
+static int
+check(xcb_connection_t *c, xcb_drawable_t d, xcb_gcontext_t gc,
+      uint32_t pixel)
+{
+    xcb_rectangle_t rect = { 10, 10, 4, 4 };
+    xcb_get_image_reply_t *image;
+    uint32_t got;
+
+    xcb_change_gc(c, gc, XCB_GC_FOREGROUND, &pixel);
+    xcb_poly_fill_rectangle(c, d, gc, 1, &rect);
+    image = xcb_get_image_reply(c, xcb_get_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP,
+                                                 d, 11, 11, 1, 1, ~0), NULL);
+    if (!image || xcb_get_image_data_length(image) < 4) {
+        free(image);
+        return 0;
+    }
+    memcpy(&got, xcb_get_image_data(image), 4);
+    free(image);
+    return (got & 0xffffff) == pixel;
+}
+
+int main(int argc, char **argv)
+{
+    static const char *names[] = { "window", "pixmap" };
+    xcb_connection_t *c = xcb_connect(NULL, NULL);
+    xcb_screen_t *screen;
+    xcb_drawable_t targets[2];
+    xcb_gcontext_t gc;
+    xcb_generic_event_t *ev;
+    uint32_t values[2];
+    int t;
+
+    if (xcb_connection_has_error(c))
+        return 1;
+
+    screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+    if (screen->root_depth != 24) {
+        fprintf(stderr, "needs a depth 24 root window\n");
+        return 1;
+    }
+
+    targets[0] = xcb_generate_id(c);
+    values[0] = screen->black_pixel;
+    values[1] = 1;
+    xcb_create_window(c, XCB_COPY_FROM_PARENT, targets[0], screen->root,
+                      0, 0, SIZE, SIZE, 0, XCB_WINDOW_CLASS_INPUT_OUTPUT,
+                      XCB_COPY_FROM_PARENT,
+                      XCB_CW_BACK_PIXEL | XCB_CW_OVERRIDE_REDIRECT, values);
+    xcb_map_window(c, targets[0]);
+    targets[1] = xcb_generate_id(c);
+    xcb_create_pixmap(c, screen->root_depth, targets[1], screen->root,
+                      SIZE, SIZE);
+
+    gc = xcb_generate_id(c);
+    values[0] = screen->white_pixel;
+    xcb_create_gc(c, gc, screen->root, XCB_GC_FOREGROUND, values);
+
+    for (t = 0; t < 2; t++) {
+        double rects, thin, wide;
+
+        values[0] = 0;
+        xcb_change_gc(c, gc, XCB_GC_LINE_WIDTH, values);
+        rects = run(c, targets[t], gc, 0);
+        thin = run(c, targets[t], gc, 1);
+        values[0] = 3;
+        xcb_change_gc(c, gc, XCB_GC_LINE_WIDTH, values);
+        wide = run(c, targets[t], gc, 1);
+
+        printf("%s: %.0f rectangles/s, %.0f thin segments/s, "
+               "%.0f wide segments/s\n", names[t],
+               NUM_REQUESTS / rects, NUM_REQUESTS / thin,
+               NUM_REQUESTS / wide);
+
+        if (!check(c, targets[t], gc, 0x123456 + t)) {
+            fprintf(stderr, "%s: rectangle not drawn\n", names[t]);
+            return 1;
+        }
+    }
+
+    while ((ev = xcb_poll_for_event(c))) {
+        if (ev->response_type == 0) {
+            xcb_generic_error_t *err = (xcb_generic_error_t *) ev;
+
+            fprintf(stderr, "X error %d on request %d\n",
+                    err->error_code, err->major_code);
+            return 1;
+        }
+        free(ev);
+    }
+
+    xcb_free_gc(c, gc);
+    xcb_free_pixmap(c, targets[1]);
+    xcb_disconnect(c);
+
+    return 0;
+}
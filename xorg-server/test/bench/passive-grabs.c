@@ -0,0 +1,238 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Puts a key grab on the root window for every keycode with each of
+ * NUM_MODIFIER_SETS modifier combinations, the way a hotkey daemon does,
+ * and presses keys through XTEST as fast as the server takes them.  With
+ * no modifiers held none of those grabs match, so every press makes the
+ * server look through the root's grabs for nothing.  One key also has a
+ * grab without modifiers, and presses of that key must activate it; after
+ * that grab is removed they must not.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <xcb/xcb.h>
+#include <xcb/xcbext.h>
+
+#define MIN_KEYCODE         8
+#define MAX_KEYCODE         255
+#define NUM_MODIFIER_SETS   41  /* 248 keycodes * 41 = 10168 grabs */
+#define HOT_KEYCODE         38
+#define NUM_ROUNDS          20
+#define PRESSES_PER_ROUND   2000
+
+#define XTEST_FAKE_INPUT    2
+
+typedef struct {
+    uint8_t major, minor;
+    uint16_t length;
+    uint8_t type, detail;
+    uint16_t pad0;
+    uint32_t time;
+    uint32_t root;
+    uint32_t pad1[2];
+    int16_t root_x, root_y;
+    uint8_t pad2[7];
+    uint8_t deviceid;
+} FakeInputReq;
+
+static xcb_extension_t xtest_id = { "XTEST", 0 };
+
+/* modifier keys aren't pressed, Caps Lock and Num Lock would stay on */
+static int is_modifier[MAX_KEYCODE + 1];
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+fake_key(xcb_connection_t *c, uint8_t type, uint8_t keycode)
+{
+    FakeInputReq fi;
+    xcb_protocol_request_t req = { 2, &xtest_id, XTEST_FAKE_INPUT, 1 };
+    struct iovec parts[4];
+
+    memset(&fi, 0, sizeof(fi));
+    fi.type = type;
+    fi.detail = keycode;
+    parts[2].iov_base = &fi;
+    parts[2].iov_len = sizeof(fi);
+    parts[3].iov_base = NULL;
+    parts[3].iov_len = 0;
+    xcb_send_request(c, 0, parts + 2, &req);
+}
+
+static void
+press(xcb_connection_t *c, uint8_t keycode)
+{
+    fake_key(c, XCB_KEY_PRESS, keycode);
+    fake_key(c, XCB_KEY_RELEASE, keycode);
+}
+
+/* @return the number of key events that came in, or -1 on an X error */
+static long
+drain(xcb_connection_t *c)
+{
+    xcb_generic_event_t *ev;
+    long n = 0;
+
+    /* everything sent before the reply has been read once it's here */
+    free(xcb_get_input_focus_reply(c, xcb_get_input_focus(c), NULL));
+    while ((ev = xcb_poll_for_event(c))) {
+        uint8_t type = ev->response_type & 0x7f;
+
+        free(ev);
+        if (type == 0)
+            return -1;
+        if (type == XCB_KEY_PRESS || type == XCB_KEY_RELEASE)
+            n++;
+    }
+    return n;
+}
+
+static int
+find_modifiers(xcb_connection_t *c)
+{
+    xcb_get_modifier_mapping_reply_t *rep;
+    xcb_keycode_t *keycodes;
+    int i;
+
+    rep = xcb_get_modifier_mapping_reply(c, xcb_get_modifier_mapping(c),
+                                         NULL);
+    if (!rep)
+        return 0;
+    keycodes = xcb_get_modifier_mapping_keycodes(rep);
+    for (i = 0; i < xcb_get_modifier_mapping_keycodes_length(rep); i++)
+        is_modifier[keycodes[i]] = 1;
+    free(rep);
+    return 1;
+}
+
+static int
+run_round(xcb_connection_t *c, int round, long *hot)
+{
+    int i, n = 0;
+
+    *hot = 0;
+    for (i = 0; i < PRESSES_PER_ROUND; i++) {
+        uint8_t keycode = MIN_KEYCODE +
+            (round + i) % (MAX_KEYCODE - MIN_KEYCODE + 1);
+
+        if (is_modifier[keycode])
+            continue;
+        press(c, keycode);
+        if (keycode == HOT_KEYCODE)
+            (*hot)++;
+        n++;
+    }
+    return n;
+}
+
+int main(int argc, char **argv)
+{
+    xcb_connection_t *c = xcb_connect(NULL, NULL);
+    const xcb_query_extension_reply_t *ext;
+    xcb_screen_t *screen;
+    xcb_generic_error_t *err;
+    unsigned long npresses = 0;
+    double start, elapsed;
+    long hot, got;
+    int keycode, mods, round, ngrabs = 0;
+
+    if (xcb_connection_has_error(c))
+        return 1;
+
+    screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+    ext = xcb_get_extension_data(c, &xtest_id);
+    if (!ext || !ext->present) {
+        fprintf(stderr, "XTEST not present\n");
+        return 1;
+    }
+    if (!find_modifiers(c) || is_modifier[HOT_KEYCODE]) {
+        fprintf(stderr, "can't use keycode %d\n", HOT_KEYCODE);
+        return 1;
+    }
+
+    start = now();
+    for (keycode = MIN_KEYCODE; keycode <= MAX_KEYCODE; keycode++) {
+        for (mods = 1; mods <= NUM_MODIFIER_SETS; mods++) {
+            xcb_grab_key(c, 1, screen->root, mods, keycode,
+                         XCB_GRAB_MODE_ASYNC, XCB_GRAB_MODE_ASYNC);
+            ngrabs++;
+        }
+    }
+    err = xcb_request_check(c, xcb_grab_key_checked(c, 1, screen->root, 0,
+                                                    HOT_KEYCODE,
+                                                    XCB_GRAB_MODE_ASYNC,
+                                                    XCB_GRAB_MODE_ASYNC));
+    if (err) {
+        fprintf(stderr, "GrabKey failed: %d\n", err->error_code);
+        return 1;
+    }
+    ngrabs++;
+    printf("%d passive grabs on the root in %.3f s\n", ngrabs, now() - start);
+
+    elapsed = 0;
+    for (round = 0; round < NUM_ROUNDS; round++) {
+        start = now();
+        npresses += run_round(c, round, &hot);
+        free(xcb_get_input_focus_reply(c, xcb_get_input_focus(c), NULL));
+        elapsed += now() - start;
+
+        /* the hot key's press and release each come through its grab */
+        got = drain(c);
+        if (got != 2 * hot) {
+            fprintf(stderr, "round %d: %ld key events, expected %ld\n",
+                    round, got, 2 * hot);
+            return 1;
+        }
+    }
+
+    err = xcb_request_check(c, xcb_ungrab_key_checked(c, HOT_KEYCODE,
+                                                      screen->root, 0));
+    if (err) {
+        fprintf(stderr, "UngrabKey failed: %d\n", err->error_code);
+        return 1;
+    }
+    run_round(c, 0, &hot);
+    got = drain(c);
+    if (got != 0) {
+        fprintf(stderr, "%ld key events after the ungrab\n", got);
+        return 1;
+    }
+
+    printf("%lu key presses with %d root grabs in %.3f s: "
+           "%.0f presses/s\n", npresses, ngrabs, elapsed,
+           npresses / elapsed);
+
+    xcb_disconnect(c);
+
+    return 0;
+}
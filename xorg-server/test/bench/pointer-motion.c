@@ -0,0 +1,181 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Maps NUM_WINDOWS overlapping top-level windows and warps the pointer
+ * around them as fast as the server takes it, so every warp makes the
+ * server find the window under the pointer again.  Some windows are
+ * raised and moved between rounds.  After each round the child reported
+ * by QueryPointer is checked against the topmost window at the pointer,
+ * as worked out here.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <xcb/xcb.h>
+
+#define NUM_WINDOWS     1000
+#define NUM_ROUNDS      100
+#define WARPS_PER_ROUND 2000
+
+typedef struct {
+    xcb_window_t id;
+    int x, y, width, height, border;
+} TopLevel;
+
+/* top of the stack first */
+static TopLevel stack[NUM_WINDOWS];
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+place(TopLevel *w, int screen_width, int screen_height)
+{
+    w->width = 20 + rand() % 200;
+    w->height = 20 + rand() % 200;
+    w->border = rand() % 3;
+    w->x = rand() % screen_width - w->width / 2;
+    w->y = rand() % screen_height - w->height / 2;
+}
+
+static xcb_window_t
+window_at(int x, int y)
+{
+    int i;
+
+    for (i = 0; i < NUM_WINDOWS; i++) {
+        TopLevel *w = &stack[i];
+
+        if (x >= w->x && x < w->x + w->width + 2 * w->border &&
+            y >= w->y && y < w->y + w->height + 2 * w->border)
+            return w->id;
+    }
+    return XCB_NONE;
+}
+
+static void
+raise_window(xcb_connection_t *c, int i)
+{
+    TopLevel w = stack[i];
+    uint32_t mode = XCB_STACK_MODE_ABOVE;
+
+    memmove(&stack[1], &stack[0], i * sizeof(TopLevel));
+    stack[0] = w;
+    xcb_configure_window(c, w.id, XCB_CONFIG_WINDOW_STACK_MODE, &mode);
+}
+
+int main(int argc, char **argv)
+{
+    xcb_connection_t *c = xcb_connect(NULL, NULL);
+    xcb_screen_t *screen;
+    xcb_generic_event_t *ev;
+    unsigned long nwarps = 0;
+    double start, elapsed = 0;
+    int round, i;
+
+    if (xcb_connection_has_error(c))
+        return 1;
+
+    screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+    srand(3);
+
+    /* each new window goes on top */
+    for (i = NUM_WINDOWS - 1; i >= 0; i--) {
+        TopLevel *w = &stack[i];
+        uint32_t override = 1;
+
+        place(w, screen->width_in_pixels, screen->height_in_pixels);
+        w->id = xcb_generate_id(c);
+        xcb_create_window(c, XCB_COPY_FROM_PARENT, w->id, screen->root,
+                          w->x, w->y, w->width, w->height, w->border,
+                          XCB_WINDOW_CLASS_INPUT_OUTPUT,
+                          XCB_COPY_FROM_PARENT,
+                          XCB_CW_OVERRIDE_REDIRECT, &override);
+        xcb_map_window(c, w->id);
+    }
+
+    for (round = 0; round < NUM_ROUNDS; round++) {
+        xcb_query_pointer_reply_t *reply;
+        int x = 0, y = 0;
+
+        for (i = 0; i < 10; i++)
+            raise_window(c, rand() % NUM_WINDOWS);
+        for (i = 0; i < 10; i++) {
+            TopLevel *w = &stack[rand() % NUM_WINDOWS];
+            uint32_t values[2];
+
+            w->x = rand() % screen->width_in_pixels - w->width / 2;
+            w->y = rand() % screen->height_in_pixels - w->height / 2;
+            values[0] = w->x;
+            values[1] = w->y;
+            xcb_configure_window(c, w->id,
+                                 XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y,
+                                 values);
+        }
+        free(xcb_get_input_focus_reply(c, xcb_get_input_focus(c), NULL));
+
+        start = now();
+        for (i = 0; i < WARPS_PER_ROUND; i++) {
+            x = rand() % screen->width_in_pixels;
+            y = rand() % screen->height_in_pixels;
+            xcb_warp_pointer(c, XCB_NONE, screen->root, 0, 0, 0, 0, x, y);
+            nwarps++;
+        }
+        reply = xcb_query_pointer_reply(c, xcb_query_pointer(c, screen->root),
+                                        NULL);
+        elapsed += now() - start;
+
+        if (!reply || reply->root_x != x || reply->root_y != y ||
+            reply->child != window_at(x, y)) {
+            fprintf(stderr, "wrong window under the pointer at %d,%d\n",
+                    x, y);
+            return 1;
+        }
+        free(reply);
+    }
+
+    while ((ev = xcb_poll_for_event(c))) {
+        if (ev->response_type == 0) {
+            xcb_generic_error_t *err = (xcb_generic_error_t *) ev;
+
+            fprintf(stderr, "X error %d on request %d\n",
+                    err->error_code, err->major_code);
+            return 1;
+        }
+        free(ev);
+    }
+
+    printf("%lu warps over %d windows in %.3f s: %.0f warps/s\n",
+           nwarps, NUM_WINDOWS, elapsed, nwarps / elapsed);
+
+    xcb_disconnect(c);
+
+    return 0;
+}
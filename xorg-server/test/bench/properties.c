@@ -0,0 +1,169 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Puts NUM_PROPS properties on the root window and times ChangeProperty,
+ * GetProperty and RotateProperties against it.  Every GetProperty reply
+ * is checked against what was last written, so this also checks that
+ * lookups find the right property after rotations and deletions.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <xcb/xcb.h>
+
+#define NUM_PROPS       1000
+#define NUM_OPS         20000
+#define ROTATE_ATOMS    100
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int
+check_errors(xcb_connection_t *c)
+{
+    xcb_generic_event_t *ev;
+
+    while ((ev = xcb_poll_for_event(c))) {
+        if (ev->response_type == 0) {
+            xcb_generic_error_t *err = (xcb_generic_error_t *) ev;
+
+            fprintf(stderr, "X error %d on request %d\n",
+                    err->error_code, err->major_code);
+            return 1;
+        }
+        free(ev);
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    xcb_connection_t *c = xcb_connect(NULL, NULL);
+    xcb_window_t root;
+    xcb_atom_t atoms[NUM_PROPS];
+    xcb_intern_atom_cookie_t cookies[NUM_PROPS];
+    uint32_t values[NUM_PROPS];
+    double start, change, get, rotate;
+    char name[32];
+    int i, n;
+
+    if (xcb_connection_has_error(c))
+        return 1;
+
+    root = xcb_setup_roots_iterator(xcb_get_setup(c)).data->root;
+    srand(1);
+
+    for (i = 0; i < NUM_PROPS; i++) {
+        snprintf(name, sizeof(name), "_BENCH_PROPERTY_%d", i);
+        cookies[i] = xcb_intern_atom(c, 0, strlen(name), name);
+    }
+    for (i = 0; i < NUM_PROPS; i++) {
+        xcb_intern_atom_reply_t *reply =
+            xcb_intern_atom_reply(c, cookies[i], NULL);
+
+        if (!reply)
+            return 1;
+        atoms[i] = reply->atom;
+        free(reply);
+
+        values[i] = i;
+        xcb_change_property(c, XCB_PROP_MODE_REPLACE, root, atoms[i],
+                            XCB_ATOM_CARDINAL, 32, 1, &values[i]);
+    }
+
+    start = now();
+    for (n = 0; n < NUM_OPS; n++) {
+        i = rand() % NUM_PROPS;
+        values[i] = n;
+        xcb_change_property(c, XCB_PROP_MODE_REPLACE, root, atoms[i],
+                            XCB_ATOM_CARDINAL, 32, 1, &values[i]);
+    }
+    free(xcb_get_input_focus_reply(c, xcb_get_input_focus(c), NULL));
+    change = now();
+
+    for (n = 0; n < NUM_OPS; n++) {
+        xcb_get_property_reply_t *reply;
+
+        i = rand() % NUM_PROPS;
+        reply = xcb_get_property_reply(c,
+                                       xcb_get_property(c, 0, root, atoms[i],
+                                                        XCB_ATOM_CARDINAL,
+                                                        0, 1),
+                                       NULL);
+        if (!reply || reply->value_len != 1 ||
+            *(uint32_t *) xcb_get_property_value(reply) != values[i]) {
+            fprintf(stderr, "wrong value for property %d\n", i);
+            return 1;
+        }
+        free(reply);
+    }
+    get = now();
+
+    for (n = 0; n < NUM_OPS / 10; n++) {
+        int first = rand() % (NUM_PROPS - ROTATE_ATOMS);
+        uint32_t tmp[ROTATE_ATOMS];
+
+        xcb_rotate_properties(c, root, ROTATE_ATOMS, 1, &atoms[first]);
+        /* property first + j now holds what first + j - 1 did */
+        memcpy(tmp, &values[first], sizeof(tmp));
+        for (i = 0; i < ROTATE_ATOMS; i++)
+            values[first + (i + 1) % ROTATE_ATOMS] = tmp[i];
+    }
+    free(xcb_get_input_focus_reply(c, xcb_get_input_focus(c), NULL));
+    rotate = now();
+
+    for (i = 0; i < NUM_PROPS; i++) {
+        xcb_get_property_reply_t *reply =
+            xcb_get_property_reply(c,
+                                   xcb_get_property(c, 1, root, atoms[i],
+                                                    XCB_ATOM_CARDINAL, 0, 1),
+                                   NULL);
+
+        if (!reply || reply->value_len != 1 ||
+            *(uint32_t *) xcb_get_property_value(reply) != values[i]) {
+            fprintf(stderr, "wrong value for property %d\n", i);
+            return 1;
+        }
+        free(reply);
+    }
+
+    if (check_errors(c))
+        return 1;
+
+    printf("%d properties on the root window:\n", NUM_PROPS);
+    printf("  ChangeProperty:   %.0f requests/s\n", NUM_OPS / (change - start));
+    printf("  GetProperty:      %.0f round trips/s\n", NUM_OPS / (get - change));
+    printf("  RotateProperties: %.0f requests/s (%d atoms each)\n",
+           NUM_OPS / 10 / (rotate - get), ROTATE_ATOMS);
+
+    xcb_disconnect(c);
+
+    return 0;
+}
@@ -0,0 +1,345 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Replays a trace of region operations through the server's Region
+ * calls and through pixman's general ones, checks that every result
+ * agrees, and times both.  A trace comes from a server built with
+ * -DREGION_TRACE and run with XORG_REGION_TRACE set to a file name; pass
+ * it as the only argument.  Without one, a synthetic trace shaped like a
+ * desktop session is replayed instead: window clips cut by GC clips,
+ * damage collected from small drawing requests, exposures of moved
+ * windows and the odd validated rectangle list.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "misc.h"
+#include "regionstr.h"
+
+#define NUM_SYNTHETIC   2000
+#define NUM_ROUNDS      500
+
+typedef struct {
+    char op;                    /* I, U, S or V as written by RegionTrace */
+    RegionRec a, b;             /* for V, a holds the unvalidated rects */
+    BoxPtr rects;
+    int nrects;
+} TraceOp;
+
+static TraceOp *ops;
+static int nops, sizeops;
+
+/* region.c only needs this for RegionPrint */
+void
+ErrorF(const char *f, ...)
+{
+    va_list args;
+
+    va_start(args, f);
+    vfprintf(stderr, f, args);
+    va_end(args);
+}
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static TraceOp *
+new_op(char op)
+{
+    if (nops == sizeops) {
+        sizeops = sizeops ? 2 * sizeops : 1024;
+        ops = realloc(ops, sizeops * sizeof(TraceOp));
+        if (!ops)
+            abort();
+    }
+    memset(&ops[nops], 0, sizeof(TraceOp));
+    ops[nops].op = op;
+    return &ops[nops++];
+}
+
+static void
+set_op_region(TraceOp *t, RegionPtr reg, BoxPtr rects, int n)
+{
+    if (t->op == 'V') {
+        t->rects = malloc(n * sizeof(BoxRec));
+        memcpy(t->rects, rects, n * sizeof(BoxRec));
+        t->nrects = n;
+    }
+    else
+        pixman_region_init_rects(reg, rects, n);
+}
+
+static int
+read_region(FILE *f, TraceOp *t, RegionPtr reg)
+{
+    BoxRec *rects;
+    int n, i;
+
+    if (fscanf(f, "%d", &n) != 1 || n < 0)
+        return 0;
+    rects = calloc(n + 1, sizeof(BoxRec));
+    for (i = 0; i < n; i++) {
+        int x1, y1, x2, y2;
+
+        if (fscanf(f, "%d %d %d %d", &x1, &y1, &x2, &y2) != 4) {
+            free(rects);
+            return 0;
+        }
+        rects[i].x1 = x1;
+        rects[i].y1 = y1;
+        rects[i].x2 = x2;
+        rects[i].y2 = y2;
+    }
+    set_op_region(t, reg, rects, n);
+    free(rects);
+    return 1;
+}
+
+static int
+read_trace(const char *name)
+{
+    FILE *f = fopen(name, "r");
+    char op;
+
+    if (!f)
+        return 0;
+    while (fscanf(f, " %c", &op) == 1) {
+        TraceOp *t = new_op(op);
+
+        if (!read_region(f, t, &t->a) ||
+            (op != 'V' && !read_region(f, t, &t->b))) {
+            fclose(f);
+            return 0;
+        }
+    }
+    fclose(f);
+    return 1;
+}
+
+static void
+random_box(BoxPtr box, int maxw, int maxh)
+{
+    box->x1 = rand() % 1280;
+    box->y1 = rand() % 1024;
+    box->x2 = box->x1 + 1 + rand() % maxw;
+    box->y2 = box->y1 + 1 + rand() % maxh;
+}
+
+/* a window clip: its box less a few windows above it */
+static void
+random_clip(BoxPtr boxes, int *n)
+{
+    RegionRec clip, above;
+    int i;
+
+    random_box(&boxes[0], 800, 600);
+    RegionInit(&clip, &boxes[0], 1);
+    for (i = rand() % 3; i > 0; i--) {
+        BoxRec box;
+
+        random_box(&box, 400, 300);
+        RegionInit(&above, &box, 1);
+        pixman_region_subtract(&clip, &clip, &above);
+    }
+    /* fully covered windows have no clip to speak of, keep the box */
+    *n = RegionNumRects(&clip);
+    if (*n)
+        memcpy(boxes, RegionRects(&clip), *n * sizeof(BoxRec));
+    else
+        *n = 1;
+    RegionUninit(&clip);
+}
+
+static void
+synthesize_trace(void)
+{
+    int i;
+
+    srand(7);
+    for (i = 0; i < NUM_SYNTHETIC; i++) {
+        int kind = rand() % 20;
+        BoxRec boxes[16], box;
+        int n;
+        TraceOp *t;
+
+        if (kind < 8) {
+            /* window clip against a GC clip or a drawing's extents */
+            t = new_op('I');
+            random_clip(boxes, &n);
+            set_op_region(t, &t->a, boxes, n);
+            random_box(&box, 200, 200);
+            set_op_region(t, &t->b, &box, 1);
+        }
+        else if (kind < 13) {
+            /* damage from a small drawing request */
+            t = new_op('U');
+            random_clip(boxes, &n);
+            n = 1 + rand() % n;
+            set_op_region(t, &t->a, boxes, n);
+            random_box(&box, 40, 20);
+            set_op_region(t, &t->b, &box, 1);
+        }
+        else if (kind < 17) {
+            /* what a moved window used to cover */
+            t = new_op('S');
+            random_box(&boxes[0], 400, 300);
+            set_op_region(t, &t->a, boxes, 1);
+            box = boxes[0];
+            box.x1 += rand() % 41 - 20;
+            box.x2 += rand() % 41 - 20;
+            box.y1 += rand() % 41 - 20;
+            box.y2 += rand() % 41 - 20;
+            box.x2 = max(box.x2, box.x1 + 1);
+            box.y2 = max(box.y2, box.y1 + 1);
+            set_op_region(t, &t->b, &box, 1);
+        }
+        else {
+            /* a pair of rectangles from a request */
+            t = new_op('V');
+            random_box(&boxes[0], 100, 100);
+            random_box(&boxes[1], 100, 100);
+            set_op_region(t, NULL, boxes, 2);
+        }
+    }
+}
+
+static void
+run_op(TraceOp *t, RegionPtr dst, Bool general)
+{
+    Bool overlap;
+
+    switch (t->op) {
+    case 'I':
+        if (general)
+            pixman_region_intersect(dst, &t->a, &t->b);
+        else
+            RegionIntersect(dst, &t->a, &t->b);
+        break;
+    case 'U':
+        if (general)
+            pixman_region_union(dst, &t->a, &t->b);
+        else
+            RegionUnion(dst, &t->a, &t->b);
+        break;
+    case 'S':
+        if (general)
+            pixman_region_subtract(dst, &t->a, &t->b);
+        else
+            RegionSubtract(dst, &t->a, &t->b);
+        break;
+    case 'V':
+        RegionUninit(dst);
+        if (general)
+            pixman_region_init_rects(dst, t->rects, t->nrects);
+        else {
+            RegionInit(dst, NullBox, t->nrects > 1 ? t->nrects : 2);
+            memcpy(RegionBoxptr(dst), t->rects, t->nrects * sizeof(BoxRec));
+            dst->data->numRects = t->nrects;
+            dst->extents.x1 = dst->extents.x2 = 0;
+            RegionValidate(dst, &overlap);
+        }
+        break;
+    }
+}
+
+static int
+same_region(RegionPtr a, RegionPtr b)
+{
+    int n = RegionNumRects(a);
+
+    if (n != RegionNumRects(b))
+        return 0;
+    if (n && memcmp(RegionExtents(a), RegionExtents(b), sizeof(BoxRec)))
+        return 0;
+    return !n || !memcmp(RegionRects(a), RegionRects(b), n * sizeof(BoxRec));
+}
+
+static double
+replay(Bool general)
+{
+    RegionRec dst;
+    double start;
+    int round, i;
+
+    RegionNull(&dst);
+    start = now();
+    for (round = 0; round < NUM_ROUNDS; round++)
+        for (i = 0; i < nops; i++)
+            run_op(&ops[i], &dst, general);
+    RegionUninit(&dst);
+    return now() - start;
+}
+
+int main(int argc, char **argv)
+{
+    RegionRec fast, general;
+    double fast_time, general_time;
+    int i;
+
+    InitRegions();
+
+    if (argc > 1) {
+        if (!read_trace(argv[1])) {
+            fprintf(stderr, "can't read trace %s\n", argv[1]);
+            return 1;
+        }
+    }
+    else
+        synthesize_trace();
+
+    RegionNull(&fast);
+    RegionNull(&general);
+    for (i = 0; i < nops; i++) {
+        run_op(&ops[i], &fast, FALSE);
+        run_op(&ops[i], &general, TRUE);
+        if (!same_region(&fast, &general)) {
+            fprintf(stderr, "operation %d (%c) differs from pixman's\n",
+                    i, ops[i].op);
+            return 1;
+        }
+    }
+    RegionUninit(&fast);
+    RegionUninit(&general);
+
+    general_time = replay(TRUE);
+    fast_time = replay(FALSE);
+
+    printf("%d region operations replayed %d times: %.1f ns each, "
+           "%.1f ns through pixman's general code\n", nops, NUM_ROUNDS,
+           fast_time * 1e9 / (nops * NUM_ROUNDS),
+           general_time * 1e9 / (nops * NUM_ROUNDS));
+
+    return 0;
+}
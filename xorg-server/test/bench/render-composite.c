@@ -0,0 +1,343 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Times small RENDER Composite requests into a window, the way x11perf's
+ * -comp and -aa tests do and the way cairo and Qt draw: the same few
+ * pictures composited over and over, 10x10 at a time.  Runs plain Over
+ * from an ARGB pixmap, Over through an A8 mask, and Over from a scaled,
+ * bilinear filtered source.  Every source is opaque red and every mask
+ * opaque, so the window must come out red, which is checked; then the
+ * window picture is clipped away and composited to again, which must
+ * leave it red.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <xcb/xcb.h>
+#include <xcb/xcbext.h>
+
+#define NUM_REQUESTS    200000
+#define SIZE            10
+#define WINDOW_SIZE     256
+
+#define RENDER_QUERY_VERSION            0
+#define RENDER_QUERY_PICT_FORMATS       1
+#define RENDER_CREATE_PICTURE           4
+#define RENDER_SET_PICTURE_CLIP_RECTANGLES 6
+#define RENDER_COMPOSITE                8
+#define RENDER_FILL_RECTANGLES          26
+#define RENDER_SET_PICTURE_TRANSFORM    28
+#define RENDER_SET_PICTURE_FILTER       30
+
+#define OP_SRC          1
+#define OP_OVER         3
+
+#define RED             0xff0000
+#define GREEN           0x00ff00
+
+typedef struct {
+    uint32_t id;
+    uint8_t type, depth;
+    uint16_t pad;
+    uint16_t red, red_mask, green, green_mask, blue, blue_mask;
+    uint16_t alpha, alpha_mask;
+    uint32_t colormap;
+} PictFormInfo;
+
+typedef struct {
+    uint8_t major, minor;
+    uint16_t length;
+    uint8_t op, pad[3];
+    uint32_t src, mask, dst;
+    int16_t src_x, src_y, mask_x, mask_y, dst_x, dst_y;
+    uint16_t width, height;
+} CompositeReq;
+
+static xcb_extension_t render_id = { "RENDER", 0 };
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* data holds the request after its 4 byte header */
+static unsigned int
+render_request(xcb_connection_t *c, int opcode, int isvoid, void *data,
+               size_t len)
+{
+    xcb_protocol_request_t req = { 2, &render_id, opcode, isvoid };
+    uint8_t header[4] = { 0 };
+    struct iovec parts[4];
+
+    parts[2].iov_base = header;
+    parts[2].iov_len = sizeof(header);
+    parts[3].iov_base = data;
+    parts[3].iov_len = len;
+    req.count = len ? 2 : 1;
+    return xcb_send_request(c, 0, parts + 2, &req);
+}
+
+static int
+find_formats(xcb_connection_t *c, uint32_t *argb, uint32_t *rgb,
+             uint32_t *a8)
+{
+    uint32_t version[2] = { 0, 11 };
+    xcb_generic_error_t *err = NULL;
+    uint8_t *reply;
+    PictFormInfo *info;
+    uint32_t i, n;
+
+    reply = xcb_wait_for_reply(c, render_request(c, RENDER_QUERY_VERSION, 0,
+                                                 version, sizeof(version)),
+                               &err);
+    if (!reply)
+        return 0;
+    free(reply);
+
+    reply = xcb_wait_for_reply(c, render_request(c, RENDER_QUERY_PICT_FORMATS,
+                                                 0, NULL, 0), &err);
+    if (!reply)
+        return 0;
+    memcpy(&n, reply + 8, sizeof(n));
+    info = (PictFormInfo *) (reply + 32);
+    *argb = *rgb = *a8 = 0;
+    for (i = 0; i < n; i++) {
+        if (info[i].type != 1)  /* direct */
+            continue;
+        if (info[i].depth == 32 && info[i].red == 16 && info[i].alpha == 24 &&
+            info[i].alpha_mask == 0xff)
+            *argb = info[i].id;
+        else if (info[i].depth == 24 && info[i].red == 16 &&
+                 !info[i].alpha_mask)
+            *rgb = info[i].id;
+        else if (info[i].depth == 8 && !info[i].red_mask &&
+                 info[i].alpha_mask == 0xff)
+            *a8 = info[i].id;
+    }
+    free(reply);
+    return *argb && *rgb && *a8;
+}
+
+static uint32_t
+create_picture(xcb_connection_t *c, xcb_drawable_t d, uint32_t format,
+               uint32_t repeat)
+{
+    uint32_t req[5];
+
+    req[0] = xcb_generate_id(c);
+    req[1] = d;
+    req[2] = format;
+    req[3] = 1;                 /* CPRepeat */
+    req[4] = repeat;
+    render_request(c, RENDER_CREATE_PICTURE, 1, req, sizeof(req));
+    return req[0];
+}
+
+static void
+fill(xcb_connection_t *c, uint32_t picture, uint32_t rgb, int size)
+{
+    struct {
+        uint8_t op, pad[3];
+        uint32_t dst;
+        uint16_t red, green, blue, alpha;
+        int16_t x, y;
+        uint16_t width, height;
+    } req = { OP_SRC, { 0 }, picture,
+              (rgb >> 16 & 0xff) * 0x101, (rgb >> 8 & 0xff) * 0x101,
+              (rgb & 0xff) * 0x101, 0xffff, 0, 0, size, size };
+
+    render_request(c, RENDER_FILL_RECTANGLES, 1, &req, sizeof(req));
+}
+
+static uint32_t
+create_source(xcb_connection_t *c, xcb_window_t root, int depth,
+              uint32_t format, uint32_t rgb)
+{
+    xcb_pixmap_t pixmap = xcb_generate_id(c);
+    uint32_t picture;
+
+    xcb_create_pixmap(c, depth, pixmap, root, SIZE, SIZE);
+    picture = create_picture(c, pixmap, format, 1);
+    fill(c, picture, rgb, SIZE);
+    xcb_free_pixmap(c, pixmap);
+    return picture;
+}
+
+static double
+run(xcb_connection_t *c, uint32_t src, uint32_t mask, uint32_t dst)
+{
+    CompositeReq req;
+    xcb_protocol_request_t pr = { 1, &render_id, RENDER_COMPOSITE, 1 };
+    struct iovec parts[3];
+    double start = now();
+    int i;
+
+    memset(&req, 0, sizeof(req));
+    req.op = OP_OVER;
+    req.src = src;
+    req.mask = mask;
+    req.dst = dst;
+    req.width = req.height = SIZE;
+    parts[2].iov_base = &req;
+    parts[2].iov_len = sizeof(req);
+    for (i = 0; i < NUM_REQUESTS; i++) {
+        req.dst_x = i % (WINDOW_SIZE - SIZE);
+        req.dst_y = (i / 7) % (WINDOW_SIZE - SIZE);
+        xcb_send_request(c, 0, parts + 2, &pr);
+    }
+    free(xcb_get_input_focus_reply(c, xcb_get_input_focus(c), NULL));
+    return now() - start;
+}
+
+static int
+check(xcb_connection_t *c, xcb_window_t window, const char *name)
+{
+    xcb_get_image_reply_t *image;
+    uint32_t got;
+
+    image = xcb_get_image_reply(c,
+                                xcb_get_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP,
+                                              window, WINDOW_SIZE / 2,
+                                              WINDOW_SIZE / 2, 1, 1, ~0),
+                                NULL);
+    if (!image || xcb_get_image_data_length(image) < 4) {
+        fprintf(stderr, "%s: GetImage failed\n", name);
+        return 0;
+    }
+    memcpy(&got, xcb_get_image_data(image), 4);
+    free(image);
+    if ((got & 0xffffff) != RED) {
+        fprintf(stderr, "%s: pixel 0x%06x, expected 0x%06x\n", name,
+                got & 0xffffff, RED);
+        return 0;
+    }
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    xcb_connection_t *c = xcb_connect(NULL, NULL);
+    const xcb_query_extension_reply_t *ext;
+    xcb_screen_t *screen;
+    xcb_generic_event_t *ev;
+    xcb_window_t window;
+    uint32_t argb, rgb, a8, dst, red, green, mask, scaled;
+    uint32_t transform[10];
+    uint32_t clip[2];
+    uint32_t back = 0x0000ff;
+    struct {
+        uint32_t picture;
+        uint16_t nbytes, pad;
+        char name[8];
+    } filter = { 0, 8, 0, "bilinear" };
+    double elapsed;
+
+    if (xcb_connection_has_error(c))
+        return 1;
+
+    screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+    if (screen->root_depth != 24) {
+        fprintf(stderr, "needs a depth 24 root window\n");
+        return 1;
+    }
+    ext = xcb_get_extension_data(c, &render_id);
+    if (!ext || !ext->present) {
+        fprintf(stderr, "RENDER not present\n");
+        return 1;
+    }
+    if (!find_formats(c, &argb, &rgb, &a8)) {
+        fprintf(stderr, "no a8r8g8b8, x8r8g8b8 or a8 picture format\n");
+        return 1;
+    }
+
+    window = xcb_generate_id(c);
+    xcb_create_window(c, XCB_COPY_FROM_PARENT, window, screen->root,
+                      0, 0, WINDOW_SIZE, WINDOW_SIZE, 0,
+                      XCB_WINDOW_CLASS_INPUT_OUTPUT, XCB_COPY_FROM_PARENT,
+                      XCB_CW_BACK_PIXEL, &back);
+    xcb_map_window(c, window);
+    dst = create_picture(c, window, rgb, 0);
+
+    red = create_source(c, screen->root, 32, argb, RED);
+    green = create_source(c, screen->root, 32, argb, GREEN);
+    mask = create_source(c, screen->root, 8, a8, 0xffffff);
+
+    /* the same red scaled up by 2, which keeps it red */
+    scaled = create_source(c, screen->root, 32, argb, RED);
+    memset(transform, 0, sizeof(transform));
+    transform[0] = scaled;
+    transform[1] = 0x8000;
+    transform[5] = 0x8000;
+    transform[9] = 0x10000;
+    render_request(c, RENDER_SET_PICTURE_TRANSFORM, 1, transform,
+                   sizeof(transform));
+    filter.picture = scaled;
+    render_request(c, RENDER_SET_PICTURE_FILTER, 1, &filter, sizeof(filter));
+
+    elapsed = run(c, red, 0, dst);
+    printf("%d 10x10 Over from a8r8g8b8 in %.3f s: %.0f/s\n",
+           NUM_REQUESTS, elapsed, NUM_REQUESTS / elapsed);
+    if (!check(c, window, "Over"))
+        return 1;
+
+    elapsed = run(c, red, mask, dst);
+    printf("%d 10x10 Over through an a8 mask in %.3f s: %.0f/s\n",
+           NUM_REQUESTS, elapsed, NUM_REQUESTS / elapsed);
+    if (!check(c, window, "Over with mask"))
+        return 1;
+
+    elapsed = run(c, scaled, 0, dst);
+    printf("%d 10x10 Over from a scaled bilinear source in %.3f s: "
+           "%.0f/s\n", NUM_REQUESTS, elapsed, NUM_REQUESTS / elapsed);
+    if (!check(c, window, "Over scaled"))
+        return 1;
+
+    /* no rectangles at all clips everything away */
+    clip[0] = dst;
+    clip[1] = 0;
+    render_request(c, RENDER_SET_PICTURE_CLIP_RECTANGLES, 1, clip,
+                   sizeof(clip));
+    run(c, green, 0, dst);
+    if (!check(c, window, "clipped"))
+        return 1;
+
+    while ((ev = xcb_poll_for_event(c))) {
+        if (ev->response_type == 0) {
+            xcb_generic_error_t *err = (xcb_generic_error_t *) ev;
+
+            fprintf(stderr, "X error %d on request %d.%d\n",
+                    err->error_code, err->major_code, err->minor_code);
+            return 1;
+        }
+        free(ev);
+    }
+
+    xcb_disconnect(c);
+
+    return 0;
+}
@@ -0,0 +1,412 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Times RENDER text the way a terminal draws it: lines of 80 glyphs from
+ * one glyph set in a fixed cell, with a solid fill source.  Runs an A8
+ * font through an A8 mask, as Xft does, and without one, as cairo does,
+ * with an ASCII sized and a CJK sized glyph set, then an ARGB subpixel
+ * font both ways.  Glyph 0 of every set is an opaque block; it is drawn
+ * in red over the text each time and must come out red.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <xcb/xcb.h>
+#include <xcb/xcbext.h>
+
+#define NUM_LINES       20000
+#define COLUMNS         80
+#define ROWS            25
+#define CELL_WIDTH      8
+#define CELL_HEIGHT     16
+#define ASCENT          12
+#define WINDOW_WIDTH    (COLUMNS * CELL_WIDTH)
+#define WINDOW_HEIGHT   (ROWS * CELL_HEIGHT)
+#define ASCII_GLYPHS    95
+#define CJK_GLYPHS      4000
+#define GLYPHS_PER_ADD  100
+
+#define RENDER_QUERY_VERSION            0
+#define RENDER_QUERY_PICT_FORMATS       1
+#define RENDER_CREATE_PICTURE           4
+#define RENDER_CREATE_GLYPH_SET         17
+#define RENDER_FREE_GLYPH_SET           19
+#define RENDER_ADD_GLYPHS               20
+#define RENDER_COMPOSITE_GLYPHS_16      24
+#define RENDER_CREATE_SOLID_FILL        33
+
+#define OP_OVER         3
+
+#define RED             0xff0000
+
+typedef struct {
+    uint32_t id;
+    uint8_t type, depth;
+    uint16_t pad;
+    uint16_t red, red_mask, green, green_mask, blue, blue_mask;
+    uint16_t alpha, alpha_mask;
+    uint32_t colormap;
+} PictFormInfo;
+
+typedef struct {
+    uint16_t width, height;
+    int16_t x, y, x_off, y_off;
+} GlyphInfo;
+
+/* one line of text in a single glyph item */
+typedef struct {
+    uint8_t op, pad[3];
+    uint32_t src, dst, mask_format, glyphset;
+    int16_t src_x, src_y;
+    uint8_t len, pad2[3];
+    int16_t dx, dy;
+    uint16_t glyphs[COLUMNS];
+} GlyphsReq;
+
+static xcb_extension_t render_id = { "RENDER", 0 };
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint32_t
+random32(void)
+{
+    static uint32_t x = 0x2545f491;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+/* data holds the request after its 4 byte header */
+static unsigned int
+render_request(xcb_connection_t *c, int opcode, int isvoid, void *data,
+               size_t len)
+{
+    xcb_protocol_request_t req = { 2, &render_id, opcode, isvoid };
+    uint8_t header[4] = { 0 };
+    struct iovec parts[4];
+
+    parts[2].iov_base = header;
+    parts[2].iov_len = sizeof(header);
+    parts[3].iov_base = data;
+    parts[3].iov_len = len;
+    req.count = len ? 2 : 1;
+    return xcb_send_request(c, 0, parts + 2, &req);
+}
+
+static int
+find_formats(xcb_connection_t *c, uint32_t *argb, uint32_t *rgb,
+             uint32_t *a8)
+{
+    uint32_t version[2] = { 0, 11 };
+    xcb_generic_error_t *err = NULL;
+    uint8_t *reply;
+    PictFormInfo *info;
+    uint32_t i, n;
+
+    reply = xcb_wait_for_reply(c, render_request(c, RENDER_QUERY_VERSION, 0,
+                                                 version, sizeof(version)),
+                               &err);
+    if (!reply)
+        return 0;
+    free(reply);
+
+    reply = xcb_wait_for_reply(c, render_request(c, RENDER_QUERY_PICT_FORMATS,
+                                                 0, NULL, 0), &err);
+    if (!reply)
+        return 0;
+    memcpy(&n, reply + 8, sizeof(n));
+    info = (PictFormInfo *) (reply + 32);
+    *argb = *rgb = *a8 = 0;
+    for (i = 0; i < n; i++) {
+        if (info[i].type != 1)  /* direct */
+            continue;
+        if (info[i].depth == 32 && info[i].red == 16 && info[i].alpha == 24 &&
+            info[i].alpha_mask == 0xff)
+            *argb = info[i].id;
+        else if (info[i].depth == 24 && info[i].red == 16 &&
+                 !info[i].alpha_mask)
+            *rgb = info[i].id;
+        else if (info[i].depth == 8 && !info[i].red_mask &&
+                 info[i].alpha_mask == 0xff)
+            *a8 = info[i].id;
+    }
+    free(reply);
+    return *argb && *rgb && *a8;
+}
+
+static uint32_t
+create_solid(xcb_connection_t *c, uint32_t rgb)
+{
+    struct {
+        uint32_t picture;
+        uint16_t red, green, blue, alpha;
+    } req = { xcb_generate_id(c),
+              (rgb >> 16 & 0xff) * 0x101, (rgb >> 8 & 0xff) * 0x101,
+              (rgb & 0xff) * 0x101, 0xffff };
+
+    render_request(c, RENDER_CREATE_SOLID_FILL, 1, &req, sizeof(req));
+    return req.picture;
+}
+
+/*
+ * Glyphs the size of the ink in a terminal font's cell, with random
+ * coverage, except for glyph 0 which fills the cell
+ */
+static void
+add_glyphs(xcb_connection_t *c, uint32_t glyphset, int bpp, int first,
+           int n)
+{
+    GlyphInfo info[GLYPHS_PER_ADD];
+    size_t size = 0, header = 8 + n * (4 + sizeof(GlyphInfo));
+    uint8_t *req, *bits;
+    int i, j;
+
+    for (i = 0; i < n; i++) {
+        GlyphInfo *gi = &info[i];
+
+        if (first + i == 0) {
+            gi->width = CELL_WIDTH;
+            gi->height = CELL_HEIGHT;
+            gi->x = 0;
+            gi->y = ASCENT;
+        }
+        else {
+            gi->width = CELL_WIDTH - 2 - random32() % (CELL_WIDTH / 2);
+            gi->height = 1 + random32() % CELL_HEIGHT;
+            gi->x = -1;
+            gi->y = ASCENT - random32() % 3;
+        }
+        gi->x_off = CELL_WIDTH;
+        gi->y_off = 0;
+        size += ((gi->width * bpp / 8 + 3) & ~3) * gi->height;
+    }
+
+    req = calloc(1, header + size);
+    memcpy(req, &glyphset, 4);
+    memcpy(req + 4, &n, 4);
+    for (i = 0; i < n; i++) {
+        uint32_t id = first + i;
+
+        memcpy(req + 8 + i * 4, &id, 4);
+    }
+    memcpy(req + 8 + n * 4, info, n * sizeof(GlyphInfo));
+
+    bits = req + header;
+    for (i = 0; i < n; i++) {
+        int bytes = ((info[i].width * bpp / 8 + 3) & ~3) * info[i].height;
+
+        for (j = 0; j < bytes; j++)
+            bits[j] = first + i == 0 ? 0xff : random32() % 3 ? random32() : 0;
+        bits += bytes;
+    }
+
+    render_request(c, RENDER_ADD_GLYPHS, 1, req, header + size);
+    free(req);
+}
+
+static uint32_t
+create_glyphset(xcb_connection_t *c, uint32_t format, int bpp, int n)
+{
+    uint32_t req[2] = { xcb_generate_id(c), format };
+    int i;
+
+    render_request(c, RENDER_CREATE_GLYPH_SET, 1, req, sizeof(req));
+    for (i = 0; i < n; i += GLYPHS_PER_ADD)
+        add_glyphs(c, req[0], bpp, i,
+                   n - i < GLYPHS_PER_ADD ? n - i : GLYPHS_PER_ADD);
+    return req[0];
+}
+
+static void
+draw_line(xcb_connection_t *c, GlyphsReq *req, int row)
+{
+    req->dx = 0;
+    req->dy = row * CELL_HEIGHT + ASCENT;
+    render_request(c, RENDER_COMPOSITE_GLYPHS_16, 1, req, sizeof(*req));
+}
+
+static double
+run(xcb_connection_t *c, uint32_t src, uint32_t dst, uint32_t mask_format,
+    uint32_t glyphset, int nglyphs)
+{
+    GlyphsReq req;
+    double start = now();
+    int i, j;
+
+    memset(&req, 0, sizeof(req));
+    req.op = OP_OVER;
+    req.src = src;
+    req.dst = dst;
+    req.mask_format = mask_format;
+    req.glyphset = glyphset;
+    req.len = COLUMNS;
+    for (i = 0; i < NUM_LINES; i++) {
+        for (j = 0; j < COLUMNS; j++)
+            req.glyphs[j] = 1 + random32() % (nglyphs - 1);
+        draw_line(c, &req, i % ROWS);
+    }
+    free(xcb_get_input_focus_reply(c, xcb_get_input_focus(c), NULL));
+    return now() - start;
+}
+
+static int
+check(xcb_connection_t *c, xcb_window_t window, uint32_t red, uint32_t dst,
+      uint32_t mask_format, uint32_t glyphset, const char *name)
+{
+    xcb_get_image_reply_t *image;
+    GlyphsReq req;
+    uint32_t got;
+
+    /* a line of blocks */
+    memset(&req, 0, sizeof(req));
+    req.op = OP_OVER;
+    req.src = red;
+    req.dst = dst;
+    req.mask_format = mask_format;
+    req.glyphset = glyphset;
+    req.len = COLUMNS;
+    draw_line(c, &req, ROWS / 2);
+
+    image = xcb_get_image_reply(c,
+                                xcb_get_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP,
+                                              window, WINDOW_WIDTH / 2,
+                                              ROWS / 2 * CELL_HEIGHT + 4,
+                                              1, 1, ~0),
+                                NULL);
+    if (!image || xcb_get_image_data_length(image) < 4) {
+        fprintf(stderr, "%s: GetImage failed\n", name);
+        return 0;
+    }
+    memcpy(&got, xcb_get_image_data(image), 4);
+    free(image);
+    if ((got & 0xffffff) != RED) {
+        fprintf(stderr, "%s: pixel 0x%06x, expected 0x%06x\n", name,
+                got & 0xffffff, RED);
+        return 0;
+    }
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    xcb_connection_t *c = xcb_connect(NULL, NULL);
+    const xcb_query_extension_reply_t *ext;
+    xcb_screen_t *screen;
+    xcb_generic_event_t *ev;
+    xcb_window_t window;
+    uint32_t argb, rgb, a8, dst, white, red;
+    uint32_t back = 0x000000;
+    static const struct {
+        const char *name;
+        int argb, nglyphs, mask;
+    } tests[] = {
+        { "a8 ascii, a8 mask", 0, ASCII_GLYPHS, 1 },
+        { "a8 ascii, no mask", 0, ASCII_GLYPHS, 0 },
+        { "a8 cjk, a8 mask", 0, CJK_GLYPHS, 1 },
+        { "a8 cjk, no mask", 0, CJK_GLYPHS, 0 },
+        { "argb ascii, argb mask", 1, ASCII_GLYPHS, 1 },
+        { "argb ascii, no mask", 1, ASCII_GLYPHS, 0 },
+    };
+    int i;
+
+    if (xcb_connection_has_error(c))
+        return 1;
+
+    screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+    if (screen->root_depth != 24) {
+        fprintf(stderr, "needs a depth 24 root window\n");
+        return 1;
+    }
+    ext = xcb_get_extension_data(c, &render_id);
+    if (!ext || !ext->present) {
+        fprintf(stderr, "RENDER not present\n");
+        return 1;
+    }
+    if (!find_formats(c, &argb, &rgb, &a8)) {
+        fprintf(stderr, "no a8r8g8b8, x8r8g8b8 or a8 picture format\n");
+        return 1;
+    }
+
+    window = xcb_generate_id(c);
+    xcb_create_window(c, XCB_COPY_FROM_PARENT, window, screen->root,
+                      0, 0, WINDOW_WIDTH, WINDOW_HEIGHT, 0,
+                      XCB_WINDOW_CLASS_INPUT_OUTPUT, XCB_COPY_FROM_PARENT,
+                      XCB_CW_BACK_PIXEL, &back);
+    xcb_map_window(c, window);
+    {
+        uint32_t req[3] = { xcb_generate_id(c), window, rgb };
+
+        render_request(c, RENDER_CREATE_PICTURE, 1, req, sizeof(req));
+        dst = req[0];
+    }
+
+    white = create_solid(c, 0xffffff);
+    red = create_solid(c, RED);
+
+    for (i = 0; i < (int) (sizeof(tests) / sizeof(tests[0])); i++) {
+        uint32_t format = tests[i].argb ? argb : a8;
+        uint32_t glyphset = create_glyphset(c, format,
+                                            tests[i].argb ? 32 : 8,
+                                            tests[i].nglyphs);
+        uint32_t mask_format = tests[i].mask ? format : 0;
+        double elapsed;
+
+        /* once to get the glyphs where the server keeps them */
+        run(c, white, dst, mask_format, glyphset, tests[i].nglyphs);
+        elapsed = run(c, white, dst, mask_format, glyphset,
+                      tests[i].nglyphs);
+        printf("%d lines of %d glyphs, %s (%d glyphs) in %.3f s: "
+               "%.0f glyphs/s\n", NUM_LINES, COLUMNS, tests[i].name,
+               tests[i].nglyphs, elapsed, NUM_LINES * COLUMNS / elapsed);
+        if (!check(c, window, red, dst, mask_format, glyphset,
+                   tests[i].name))
+            return 1;
+
+        render_request(c, RENDER_FREE_GLYPH_SET, 1, &glyphset, 4);
+    }
+
+    while ((ev = xcb_poll_for_event(c))) {
+        if (ev->response_type == 0) {
+            xcb_generic_error_t *err = (xcb_generic_error_t *) ev;
+
+            fprintf(stderr, "X error %d on request %d.%d\n",
+                    err->error_code, err->major_code, err->minor_code);
+            return 1;
+        }
+        free(ev);
+    }
+
+    xcb_disconnect(c);
+
+    return 0;
+}
@@ -0,0 +1,326 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Times full 4K RENDER composites into a pixmap: Over from a translucent
+ * ARGB pixmap, Over from a linear gradient and Over from a rotated,
+ * scaled and bilinear filtered source.  Run it against servers started
+ * with different -renderthreads to see how compositing scales with
+ * cores.  Each operation is then done once more in one piece and once in
+ * strips of a few rows, too small to be split across threads, into two
+ * pixmaps, which must come out the same to the bit.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <xcb/xcb.h>
+#include <xcb/xcbext.h>
+
+#define WIDTH           3840
+#define HEIGHT          2160
+#define NUM_REQUESTS    20
+#define STRIP           8
+
+#define RENDER_QUERY_VERSION            0
+#define RENDER_QUERY_PICT_FORMATS       1
+#define RENDER_CREATE_PICTURE           4
+#define RENDER_COMPOSITE                8
+#define RENDER_FILL_RECTANGLES          26
+#define RENDER_SET_PICTURE_TRANSFORM    28
+#define RENDER_SET_PICTURE_FILTER       30
+#define RENDER_CREATE_LINEAR_GRADIENT   34
+
+#define OP_SRC          1
+#define OP_OVER         3
+
+typedef struct {
+    uint32_t id;
+    uint8_t type, depth;
+    uint16_t pad;
+    uint16_t red, red_mask, green, green_mask, blue, blue_mask;
+    uint16_t alpha, alpha_mask;
+    uint32_t colormap;
+} PictFormInfo;
+
+typedef struct {
+    uint8_t op, pad[3];
+    uint32_t src, mask, dst;
+    int16_t src_x, src_y, mask_x, mask_y, dst_x, dst_y;
+    uint16_t width, height;
+} CompositeReq;
+
+static xcb_extension_t render_id = { "RENDER", 0 };
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* data holds the request after its 4 byte header */
+static unsigned int
+render_request(xcb_connection_t *c, int opcode, int isvoid, void *data,
+               size_t len)
+{
+    xcb_protocol_request_t req = { 2, &render_id, opcode, isvoid };
+    uint8_t header[4] = { 0 };
+    struct iovec parts[4];
+
+    parts[2].iov_base = header;
+    parts[2].iov_len = sizeof(header);
+    parts[3].iov_base = data;
+    parts[3].iov_len = len;
+    req.count = len ? 2 : 1;
+    return xcb_send_request(c, 0, parts + 2, &req);
+}
+
+static int
+find_formats(xcb_connection_t *c, uint32_t *argb, uint32_t *rgb)
+{
+    uint32_t version[2] = { 0, 11 };
+    xcb_generic_error_t *err = NULL;
+    uint8_t *reply;
+    PictFormInfo *info;
+    uint32_t i, n;
+
+    reply = xcb_wait_for_reply(c, render_request(c, RENDER_QUERY_VERSION, 0,
+                                                 version, sizeof(version)),
+                               &err);
+    if (!reply)
+        return 0;
+    free(reply);
+
+    reply = xcb_wait_for_reply(c, render_request(c, RENDER_QUERY_PICT_FORMATS,
+                                                 0, NULL, 0), &err);
+    if (!reply)
+        return 0;
+    memcpy(&n, reply + 8, sizeof(n));
+    info = (PictFormInfo *) (reply + 32);
+    *argb = *rgb = 0;
+    for (i = 0; i < n; i++) {
+        if (info[i].type != 1)  /* direct */
+            continue;
+        if (info[i].depth == 32 && info[i].red == 16 && info[i].alpha == 24 &&
+            info[i].alpha_mask == 0xff)
+            *argb = info[i].id;
+        else if (info[i].depth == 24 && info[i].red == 16 &&
+                 !info[i].alpha_mask)
+            *rgb = info[i].id;
+    }
+    free(reply);
+    return *argb && *rgb;
+}
+
+static uint32_t
+create_picture(xcb_connection_t *c, xcb_window_t root, int depth,
+               uint32_t format, xcb_pixmap_t *pixmap)
+{
+    uint32_t req[5];
+
+    *pixmap = xcb_generate_id(c);
+    xcb_create_pixmap(c, depth, *pixmap, root, WIDTH, HEIGHT);
+    req[0] = xcb_generate_id(c);
+    req[1] = *pixmap;
+    req[2] = format;
+    req[3] = 1;                 /* CPRepeat */
+    req[4] = 2;                 /* RepeatPad */
+    render_request(c, RENDER_CREATE_PICTURE, 1, req, sizeof(req));
+    return req[0];
+}
+
+static void
+fill(xcb_connection_t *c, uint32_t picture, uint32_t argb,
+     int x, int y, int width, int height)
+{
+    struct {
+        uint8_t op, pad[3];
+        uint32_t dst;
+        uint16_t red, green, blue, alpha;
+        int16_t x, y;
+        uint16_t width, height;
+    } req = { OP_SRC, { 0 }, picture,
+              (argb >> 16 & 0xff) * 0x101, (argb >> 8 & 0xff) * 0x101,
+              (argb & 0xff) * 0x101, (argb >> 24) * 0x101,
+              x, y, width, height };
+
+    render_request(c, RENDER_FILL_RECTANGLES, 1, &req, sizeof(req));
+}
+
+static void
+composite(xcb_connection_t *c, uint32_t src, uint32_t dst,
+          int x, int y, int width, int height)
+{
+    CompositeReq req = { OP_OVER, { 0 }, src, 0, dst,
+                         x + 3, y + 1, 0, 0, x, y, width, height };
+
+    render_request(c, RENDER_COMPOSITE, 1, &req, sizeof(req));
+}
+
+static uint32_t
+create_gradient(xcb_connection_t *c)
+{
+    struct {
+        uint32_t picture;
+        int32_t p1x, p1y, p2x, p2y;
+        uint32_t nstops;
+        int32_t stops[3];
+        uint16_t colors[3][4];
+    } req = { xcb_generate_id(c), 13 << 16, 7 << 16, 3001 << 16, 1999 << 16,
+              3, { 0, 0x8000, 0x10000 },
+              { { 0xffff, 0, 0, 0x8000 }, { 0, 0xffff, 0, 0xffff },
+                { 0, 0, 0xffff, 0x4000 } } };
+
+    render_request(c, RENDER_CREATE_LINEAR_GRADIENT, 1, &req, sizeof(req));
+    return req.picture;
+}
+
+static xcb_get_image_reply_t *
+get_image(xcb_connection_t *c, xcb_pixmap_t pixmap)
+{
+    return xcb_get_image_reply(c,
+                               xcb_get_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP,
+                                             pixmap, 0, 0, WIDTH, HEIGHT, ~0),
+                               NULL);
+}
+
+static int
+run(xcb_connection_t *c, const char *name, uint32_t src,
+    uint32_t dst, xcb_pixmap_t dst_pixmap,
+    uint32_t ref, xcb_pixmap_t ref_pixmap)
+{
+    xcb_get_image_reply_t *got, *expected;
+    double start;
+    int i, y, same;
+
+    fill(c, dst, 0xff204060, 0, 0, WIDTH, HEIGHT);
+    free(xcb_get_input_focus_reply(c, xcb_get_input_focus(c), NULL));
+    start = now();
+    for (i = 0; i < NUM_REQUESTS; i++)
+        composite(c, src, dst, 0, 0, WIDTH, HEIGHT);
+    free(xcb_get_input_focus_reply(c, xcb_get_input_focus(c), NULL));
+    printf("%s: %.2f ms per %dx%d composite\n", name,
+           (now() - start) * 1000 / NUM_REQUESTS, WIDTH, HEIGHT);
+
+    fill(c, dst, 0xff204060, 0, 0, WIDTH, HEIGHT);
+    fill(c, ref, 0xff204060, 0, 0, WIDTH, HEIGHT);
+    composite(c, src, dst, 0, 0, WIDTH, HEIGHT);
+    for (y = 0; y < HEIGHT; y += STRIP)
+        composite(c, src, ref, 0, y, WIDTH, STRIP);
+
+    got = get_image(c, dst_pixmap);
+    expected = get_image(c, ref_pixmap);
+    same = got && expected &&
+        xcb_get_image_data_length(got) ==
+        xcb_get_image_data_length(expected) &&
+        memcmp(xcb_get_image_data(got), xcb_get_image_data(expected),
+               xcb_get_image_data_length(got)) == 0;
+    if (!same)
+        fprintf(stderr, "%s: result differs from compositing in strips\n",
+                name);
+    free(got);
+    free(expected);
+    return same;
+}
+
+int main(int argc, char **argv)
+{
+    xcb_connection_t *c = xcb_connect(NULL, NULL);
+    const xcb_query_extension_reply_t *ext;
+    xcb_screen_t *screen;
+    xcb_generic_event_t *ev;
+    xcb_pixmap_t src_pixmap, scaled_pixmap, dst_pixmap, ref_pixmap;
+    uint32_t argb, rgb, src, scaled, gradient, dst, ref;
+    /* rotated by 0.14 radians and scaled up by about 1.5 */
+    uint32_t transform[10] = { 0, 0xa74b, -0x1794, 0, 0x1794, 0xa74b, 0,
+                               0, 0, 0x10000 };
+    struct {
+        uint32_t picture;
+        uint16_t nbytes, pad;
+        char name[8];
+    } filter = { 0, 8, 0, "bilinear" };
+    int i;
+
+    if (xcb_connection_has_error(c))
+        return 1;
+
+    screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+    ext = xcb_get_extension_data(c, &render_id);
+    if (!ext || !ext->present) {
+        fprintf(stderr, "RENDER not present\n");
+        return 1;
+    }
+    if (!find_formats(c, &argb, &rgb)) {
+        fprintf(stderr, "no a8r8g8b8 or x8r8g8b8 picture format\n");
+        return 1;
+    }
+
+    dst = create_picture(c, screen->root, 24, rgb, &dst_pixmap);
+    ref = create_picture(c, screen->root, 24, rgb, &ref_pixmap);
+
+    /* overlapping translucent blocks */
+    src = create_picture(c, screen->root, 32, argb, &src_pixmap);
+    fill(c, src, 0x00000000, 0, 0, WIDTH, HEIGHT);
+    for (i = 0; i < 64; i++)
+        fill(c, src, (uint32_t) (0x30 + i * 3) << 24 |
+             (i * 2654435761u & 0xffffff),
+             (i * 397) % WIDTH, (i * 211) % HEIGHT, 200 + i * 13, 150 + i * 7);
+
+    scaled = create_picture(c, screen->root, 32, argb, &scaled_pixmap);
+    fill(c, scaled, 0x00000000, 0, 0, WIDTH, HEIGHT);
+    for (i = 0; i < 64; i++)
+        fill(c, scaled, (uint32_t) (0x80 + i) << 24 |
+             (i * 40503u & 0xffffff),
+             (i * 601) % WIDTH, (i * 307) % HEIGHT, 300, 100 + i * 5);
+    transform[0] = scaled;
+    render_request(c, RENDER_SET_PICTURE_TRANSFORM, 1, transform,
+                   sizeof(transform));
+    filter.picture = scaled;
+    render_request(c, RENDER_SET_PICTURE_FILTER, 1, &filter, sizeof(filter));
+
+    gradient = create_gradient(c);
+
+    if (!run(c, "Over from a8r8g8b8", src, dst, dst_pixmap, ref, ref_pixmap) ||
+        !run(c, "Over from a linear gradient", gradient,
+             dst, dst_pixmap, ref, ref_pixmap) ||
+        !run(c, "Over from a scaled bilinear source", scaled,
+             dst, dst_pixmap, ref, ref_pixmap))
+        return 1;
+
+    while ((ev = xcb_poll_for_event(c))) {
+        if (ev->response_type == 0) {
+            xcb_generic_error_t *err = (xcb_generic_error_t *) ev;
+
+            fprintf(stderr, "X error %d on request %d.%d\n",
+                    err->error_code, err->major_code, err->minor_code);
+            return 1;
+        }
+        free(ev);
+    }
+
+    xcb_disconnect(c);
+
+    return 0;
+}
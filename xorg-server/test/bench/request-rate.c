@@ -0,0 +1,132 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Streams small PolyFillRectangle and PutImage requests at the server,
+ * with an occasional PutImage large enough to need BIG-REQUESTS, and
+ * reports how many requests per second were dispatched.  Any X error
+ * fails the run, so this doubles as a check that requests arriving
+ * back to back in one read are framed correctly.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <xcb/xcb.h>
+
+#define NUM_ROUNDS      200
+#define REQS_PER_ROUND  5000
+#define SIZE            256
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+    xcb_connection_t *c = xcb_connect(NULL, NULL);
+    xcb_screen_t *screen;
+    xcb_pixmap_t pixmap;
+    xcb_gcontext_t gc;
+    xcb_generic_event_t *ev;
+    uint8_t *small_image, *big_image;
+    unsigned long nreqs = 0;
+    double start, elapsed;
+    int round, i;
+
+    if (xcb_connection_has_error(c))
+        return 1;
+
+    screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+
+    /* a full SIZE x SIZE PutImage is over the core request limit, so
+     * this makes it go out as a big request */
+    xcb_prefetch_maximum_request_length(c);
+
+    small_image = calloc(16 * 16, 4);
+    big_image = calloc(SIZE * SIZE, 4);
+    if (!small_image || !big_image)
+        return 1;
+    memset(big_image, 0x5a, SIZE * SIZE * 4);
+
+    pixmap = xcb_generate_id(c);
+    xcb_create_pixmap(c, screen->root_depth, pixmap, screen->root,
+                      SIZE, SIZE);
+    gc = xcb_generate_id(c);
+    xcb_create_gc(c, gc, pixmap, 0, NULL);
+
+    start = now();
+    for (round = 0; round < NUM_ROUNDS; round++) {
+        for (i = 0; i < REQS_PER_ROUND; i++) {
+            xcb_rectangle_t rect = {
+                i % (SIZE - 8), (i / 7) % (SIZE - 8), 8, 8
+            };
+            uint32_t fg = i;
+
+            switch (i % 16) {
+            case 0:
+                xcb_change_gc(c, gc, XCB_GC_FOREGROUND, &fg);
+                break;
+            case 1:
+                xcb_put_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP, pixmap, gc,
+                              16, 16, rect.x, rect.y, 0,
+                              screen->root_depth, 16 * 16 * 4, small_image);
+                break;
+            default:
+                xcb_poly_fill_rectangle(c, pixmap, gc, 1, &rect);
+                break;
+            }
+            nreqs++;
+        }
+        xcb_put_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP, pixmap, gc,
+                      SIZE, SIZE, 0, 0, 0, screen->root_depth,
+                      SIZE * SIZE * 4, big_image);
+        nreqs++;
+    }
+    free(xcb_get_input_focus_reply(c, xcb_get_input_focus(c), NULL));
+    elapsed = now() - start;
+
+    while ((ev = xcb_poll_for_event(c))) {
+        if (ev->response_type == 0) {
+            xcb_generic_error_t *err = (xcb_generic_error_t *) ev;
+
+            fprintf(stderr, "X error %d on request %d\n",
+                    err->error_code, err->major_code);
+            return 1;
+        }
+        free(ev);
+    }
+
+    printf("%lu requests in %.3f s: %.0f requests/s\n",
+           nreqs, elapsed, nreqs / elapsed);
+
+    xcb_free_gc(c, gc);
+    xcb_free_pixmap(c, pixmap);
+    xcb_disconnect(c);
+
+    return 0;
+}
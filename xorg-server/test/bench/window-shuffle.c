@@ -0,0 +1,261 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Maps NUM_WINDOWS overlapping top-level windows, each with a grid of
+ * subwindows, and shuffles them the way a window manager does: raising,
+ * lowering and moving one window at a time, as fast as the server takes
+ * it.  Every window has its own background and border pixel, so after
+ * each round the screen is sampled and checked against what should be on
+ * top at each point, as worked out here.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <xcb/xcb.h>
+
+#define NUM_WINDOWS     300
+#define NUM_COLUMNS     4
+#define NUM_ROWS        3
+#define NUM_ROUNDS      100
+#define OPS_PER_ROUND   50
+#define SAMPLES         32
+
+typedef struct {
+    xcb_window_t id;
+    int x, y, width, height, border;
+    uint32_t background, border_pixel;
+    uint32_t child_pixel[NUM_COLUMNS * NUM_ROWS];
+} TopLevel;
+
+/* top of the stack first */
+static TopLevel stack[NUM_WINDOWS];
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint32_t
+pixel(unsigned n)
+{
+    return (n * 2654435761u) & 0xffffff;
+}
+
+static void
+child_box(const TopLevel *w, int i, int *x, int *y, int *width, int *height)
+{
+    *width = w->width / NUM_COLUMNS - 4;
+    *height = w->height / NUM_ROWS - 4;
+    *x = (i % NUM_COLUMNS) * (w->width / NUM_COLUMNS) + 2;
+    *y = (i / NUM_COLUMNS) * (w->height / NUM_ROWS) + 2;
+}
+
+/* the pixel expected at x,y, or -1 where only the root shows */
+static int64_t
+pixel_at(int x, int y)
+{
+    int i, j;
+
+    for (i = 0; i < NUM_WINDOWS; i++) {
+        TopLevel *w = &stack[i];
+        int ix = x - w->x - w->border, iy = y - w->y - w->border;
+
+        if (x < w->x || x >= w->x + w->width + 2 * w->border ||
+            y < w->y || y >= w->y + w->height + 2 * w->border)
+            continue;
+        if (ix < 0 || ix >= w->width || iy < 0 || iy >= w->height)
+            return w->border_pixel;
+        for (j = 0; j < NUM_COLUMNS * NUM_ROWS; j++) {
+            int cx, cy, cw, ch;
+
+            child_box(w, j, &cx, &cy, &cw, &ch);
+            if (ix >= cx && ix < cx + cw && iy >= cy && iy < cy + ch)
+                return w->child_pixel[j];
+        }
+        return w->background;
+    }
+    return -1;
+}
+
+static void
+restack(xcb_connection_t *c, int i, int top)
+{
+    TopLevel w = stack[i];
+    uint32_t mode = top ? XCB_STACK_MODE_ABOVE : XCB_STACK_MODE_BELOW;
+
+    if (top) {
+        memmove(&stack[1], &stack[0], i * sizeof(TopLevel));
+        stack[0] = w;
+    }
+    else {
+        memmove(&stack[i], &stack[i + 1],
+                (NUM_WINDOWS - i - 1) * sizeof(TopLevel));
+        stack[NUM_WINDOWS - 1] = w;
+    }
+    xcb_configure_window(c, w.id, XCB_CONFIG_WINDOW_STACK_MODE, &mode);
+}
+
+static int
+check_samples(xcb_connection_t *c, xcb_screen_t *screen)
+{
+    int i;
+
+    for (i = 0; i < SAMPLES; i++) {
+        int x = rand() % screen->width_in_pixels;
+        int y = rand() % screen->height_in_pixels;
+        int64_t expected = pixel_at(x, y);
+        xcb_get_image_reply_t *image;
+        uint32_t got;
+
+        if (expected < 0)
+            continue;
+        image = xcb_get_image_reply(c,
+                                    xcb_get_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP,
+                                                  screen->root, x, y, 1, 1,
+                                                  ~0), NULL);
+        if (!image || xcb_get_image_data_length(image) < 4) {
+            fprintf(stderr, "GetImage failed at %d,%d\n", x, y);
+            return 0;
+        }
+        memcpy(&got, xcb_get_image_data(image), 4);
+        free(image);
+        if ((got & 0xffffff) != expected) {
+            fprintf(stderr, "pixel 0x%06x at %d,%d, expected 0x%06x\n",
+                    got & 0xffffff, x, y, (unsigned) expected);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    xcb_connection_t *c = xcb_connect(NULL, NULL);
+    xcb_screen_t *screen;
+    xcb_generic_event_t *ev;
+    unsigned long nops = 0;
+    double start, elapsed = 0;
+    int round, i, j;
+
+    if (xcb_connection_has_error(c))
+        return 1;
+
+    screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+    if (screen->root_depth != 24) {
+        fprintf(stderr, "needs a depth 24 root window\n");
+        return 1;
+    }
+    srand(5);
+
+    /* each new window goes on top */
+    for (i = NUM_WINDOWS - 1; i >= 0; i--) {
+        TopLevel *w = &stack[i];
+        uint32_t values[3];
+
+        w->width = 80 + rand() % 320;
+        w->height = 60 + rand() % 240;
+        w->border = rand() % 3;
+        w->x = rand() % screen->width_in_pixels - w->width / 2;
+        w->y = rand() % screen->height_in_pixels - w->height / 2;
+        w->background = pixel(3 * i + 1);
+        w->border_pixel = pixel(3 * i + 2);
+        w->id = xcb_generate_id(c);
+        values[0] = w->background;
+        values[1] = w->border_pixel;
+        values[2] = 1;
+        xcb_create_window(c, XCB_COPY_FROM_PARENT, w->id, screen->root,
+                          w->x, w->y, w->width, w->height, w->border,
+                          XCB_WINDOW_CLASS_INPUT_OUTPUT,
+                          XCB_COPY_FROM_PARENT,
+                          XCB_CW_BACK_PIXEL | XCB_CW_BORDER_PIXEL |
+                          XCB_CW_OVERRIDE_REDIRECT, values);
+        for (j = 0; j < NUM_COLUMNS * NUM_ROWS; j++) {
+            xcb_window_t child = xcb_generate_id(c);
+            int cx, cy, cw, ch;
+
+            child_box(w, j, &cx, &cy, &cw, &ch);
+            w->child_pixel[j] = pixel(1000 * (i + 1) + j);
+            xcb_create_window(c, XCB_COPY_FROM_PARENT, child, w->id,
+                              cx, cy, cw, ch, 0,
+                              XCB_WINDOW_CLASS_INPUT_OUTPUT,
+                              XCB_COPY_FROM_PARENT, XCB_CW_BACK_PIXEL,
+                              &w->child_pixel[j]);
+        }
+        xcb_map_subwindows(c, w->id);
+        xcb_map_window(c, w->id);
+    }
+
+    for (round = 0; round < NUM_ROUNDS; round++) {
+        start = now();
+        for (i = 0; i < OPS_PER_ROUND; i++) {
+            int n = rand() % NUM_WINDOWS, op = rand() % 20;
+
+            if (op < 10)
+                restack(c, n, 1);
+            else if (op < 13)
+                restack(c, n, 0);
+            else {
+                TopLevel *w = &stack[n];
+                uint32_t values[2];
+
+                w->x += rand() % 101 - 50;
+                w->y += rand() % 101 - 50;
+                values[0] = w->x;
+                values[1] = w->y;
+                xcb_configure_window(c, w->id,
+                                     XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y,
+                                     values);
+            }
+            nops++;
+        }
+        free(xcb_get_input_focus_reply(c, xcb_get_input_focus(c), NULL));
+        elapsed += now() - start;
+
+        if (!check_samples(c, screen))
+            return 1;
+    }
+
+    while ((ev = xcb_poll_for_event(c))) {
+        if (ev->response_type == 0) {
+            xcb_generic_error_t *err = (xcb_generic_error_t *) ev;
+
+            fprintf(stderr, "X error %d on request %d\n",
+                    err->error_code, err->major_code);
+            return 1;
+        }
+        free(ev);
+    }
+
+    printf("%lu restacks and moves of %d windows in %.3f s: %.0f/s\n",
+           nops, NUM_WINDOWS * (1 + NUM_COLUMNS * NUM_ROWS), elapsed,
+           nops / elapsed);
+
+    xcb_disconnect(c);
+
+    return 0;
+}
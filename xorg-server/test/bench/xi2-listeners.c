@@ -0,0 +1,230 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Opens NUM_LISTENERS extra connections that select for XI2 events on
+ * the root window, only a quarter of them for motion, and warps the
+ * pointer so the server has to deliver an XI2 motion event to the root
+ * for each warp.  After each round every listener checks it got exactly
+ * the motion events it asked for, and nothing else.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <xcb/xcb.h>
+#include <xcb/xcbext.h>
+
+#define NUM_LISTENERS   128
+#define NUM_ROUNDS      50
+#define WARPS_PER_ROUND 2000
+
+#define XI_QUERY_VERSION        47
+#define XI_SELECT_EVENTS        46
+#define XI_KEY_PRESS            2
+#define XI_KEY_RELEASE          3
+#define XI_BUTTON_PRESS         4
+#define XI_BUTTON_RELEASE       5
+#define XI_MOTION               6
+#define XI_ALL_MASTER_DEVICES   1
+
+typedef struct {
+    uint8_t major, minor;
+    uint16_t length;
+    uint16_t major_version, minor_version;
+} QueryVersionReq;
+
+typedef struct {
+    uint8_t major, minor;
+    uint16_t length;
+    uint32_t window;
+    uint16_t num_masks, pad;
+    uint16_t deviceid, mask_len;
+    uint32_t mask;
+} SelectEventsReq;
+
+typedef struct {
+    xcb_connection_t *c;
+    int wants_motion;
+    unsigned long motion, other;
+} Listener;
+
+static xcb_extension_t xinput_id = { "XInputExtension", 0 };
+
+static Listener listeners[NUM_LISTENERS];
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int
+select_xi2(xcb_connection_t *c, xcb_window_t root, uint32_t mask)
+{
+    QueryVersionReq qv = { 0, 0, 0, 2, 2 };
+    SelectEventsReq se = { 0, 0, 0, root, 1, 0, XI_ALL_MASTER_DEVICES, 1,
+                           mask };
+    xcb_protocol_request_t req = { 2, &xinput_id, XI_QUERY_VERSION, 0 };
+    struct iovec parts[4];
+    xcb_generic_error_t *err = NULL;
+    void *reply;
+    unsigned int seq;
+
+    parts[2].iov_base = &qv;
+    parts[2].iov_len = sizeof(qv);
+    parts[3].iov_base = NULL;
+    parts[3].iov_len = 0;
+    seq = xcb_send_request(c, XCB_REQUEST_CHECKED, parts + 2, &req);
+    reply = xcb_wait_for_reply(c, seq, &err);
+    if (!reply)
+        return 0;
+    free(reply);
+
+    req.opcode = XI_SELECT_EVENTS;
+    req.isvoid = 1;
+    parts[2].iov_base = &se;
+    parts[2].iov_len = sizeof(se);
+    seq = xcb_send_request(c, XCB_REQUEST_CHECKED, parts + 2, &req);
+    err = xcb_request_check(c, (xcb_void_cookie_t) { seq });
+    if (err) {
+        free(err);
+        return 0;
+    }
+    return 1;
+}
+
+static int
+drain(Listener *l, uint8_t xi_opcode)
+{
+    xcb_generic_event_t *ev;
+
+    /* everything sent before the reply has been read once it's here */
+    free(xcb_get_input_focus_reply(l->c, xcb_get_input_focus(l->c), NULL));
+    while ((ev = xcb_poll_for_event(l->c))) {
+        xcb_ge_generic_event_t *ge = (xcb_ge_generic_event_t *) ev;
+
+        if (ev->response_type == 0) {
+            free(ev);
+            return 0;
+        }
+        if ((ev->response_type & 0x7f) == XCB_GE_GENERIC &&
+            ge->extension == xi_opcode && ge->event_type == XI_MOTION)
+            l->motion++;
+        else
+            l->other++;
+        free(ev);
+    }
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    xcb_connection_t *c = xcb_connect(NULL, NULL);
+    const xcb_query_extension_reply_t *ext;
+    xcb_screen_t *screen;
+    unsigned long nwarps = 0;
+    double start, elapsed = 0;
+    int round, i;
+
+    if (xcb_connection_has_error(c))
+        return 1;
+
+    screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+    ext = xcb_get_extension_data(c, &xinput_id);
+    if (!ext || !ext->present) {
+        fprintf(stderr, "XInputExtension not present\n");
+        return 1;
+    }
+
+    for (i = 0; i < NUM_LISTENERS; i++) {
+        Listener *l = &listeners[i];
+        uint32_t mask;
+
+        l->c = xcb_connect(NULL, NULL);
+        if (xcb_connection_has_error(l->c))
+            return 1;
+        l->wants_motion = (i % 4 == 0);
+        if (l->wants_motion)
+            mask = 1 << XI_MOTION;
+        else
+            mask = (1 << XI_KEY_PRESS) | (1 << XI_KEY_RELEASE) |
+                (1 << XI_BUTTON_PRESS) | (1 << XI_BUTTON_RELEASE);
+        if (!select_xi2(l->c, screen->root, mask)) {
+            fprintf(stderr, "XISelectEvents failed\n");
+            return 1;
+        }
+    }
+
+    /* start away from where the warps go, and forget that motion */
+    xcb_warp_pointer(c, XCB_NONE, screen->root, 0, 0, 0, 0, 100, 100);
+    free(xcb_get_input_focus_reply(c, xcb_get_input_focus(c), NULL));
+    for (i = 0; i < NUM_LISTENERS; i++) {
+        if (!drain(&listeners[i], ext->major_opcode))
+            return 1;
+        listeners[i].motion = 0;
+    }
+
+    for (round = 0; round < NUM_ROUNDS; round++) {
+        start = now();
+        for (i = 0; i < WARPS_PER_ROUND; i++) {
+            /* always somewhere new, so each warp is a motion event */
+            xcb_warp_pointer(c, XCB_NONE, screen->root, 0, 0, 0, 0,
+                             i % 2, round % 2);
+            nwarps++;
+        }
+        free(xcb_get_input_focus_reply(c, xcb_get_input_focus(c), NULL));
+        elapsed += now() - start;
+
+        for (i = 0; i < NUM_LISTENERS; i++) {
+            Listener *l = &listeners[i];
+
+            if (!drain(l, ext->major_opcode)) {
+                fprintf(stderr, "X error on listener %d\n", i);
+                return 1;
+            }
+        }
+    }
+
+    for (i = 0; i < NUM_LISTENERS; i++) {
+        Listener *l = &listeners[i];
+
+        if (l->other || l->motion != (l->wants_motion ? nwarps : 0)) {
+            fprintf(stderr, "listener %d got %lu motion and %lu other "
+                    "events, expected %lu motion\n", i, l->motion, l->other,
+                    l->wants_motion ? nwarps : 0);
+            return 1;
+        }
+        xcb_disconnect(l->c);
+    }
+
+    printf("%lu warps with %d XI2 listeners on the root in %.3f s: "
+           "%.0f warps/s\n", nwarps, NUM_LISTENERS, elapsed,
+           nwarps / elapsed);
+
+    xcb_disconnect(c);
+
+    return 0;
+}
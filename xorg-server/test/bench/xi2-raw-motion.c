@@ -0,0 +1,249 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Opens NUM_LISTENERS extra connections that all select for XI2 raw
+ * motion on the root window, the way games and input-lag meters do, and
+ * moves the pointer through XTEST as fast as the server takes it.  Every
+ * fake motion has to reach every listener as an XI_RawMotion event, so
+ * the server spends its time encoding and writing events rather than
+ * processing requests.  After each round every listener checks it got
+ * exactly one raw motion event per fake motion, and nothing else.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <xcb/xcb.h>
+#include <xcb/xcbext.h>
+
+#define NUM_LISTENERS       32
+#define NUM_ROUNDS          50
+#define MOTIONS_PER_ROUND   1000
+
+#define XTEST_FAKE_INPUT        2
+#define XI_QUERY_VERSION        47
+#define XI_SELECT_EVENTS        46
+#define XI_RAW_MOTION           17
+#define XI_ALL_MASTER_DEVICES   1
+
+typedef struct {
+    uint8_t major, minor;
+    uint16_t length;
+    uint8_t type, detail;
+    uint16_t pad0;
+    uint32_t time;
+    uint32_t root;
+    uint32_t pad1[2];
+    int16_t root_x, root_y;
+    uint8_t pad2[7];
+    uint8_t deviceid;
+} FakeInputReq;
+
+typedef struct {
+    uint8_t major, minor;
+    uint16_t length;
+    uint16_t major_version, minor_version;
+} QueryVersionReq;
+
+typedef struct {
+    uint8_t major, minor;
+    uint16_t length;
+    uint32_t window;
+    uint16_t num_masks, pad;
+    uint16_t deviceid, mask_len;
+    uint32_t mask;
+} SelectEventsReq;
+
+typedef struct {
+    xcb_connection_t *c;
+    unsigned long raw, other;
+} Listener;
+
+static xcb_extension_t xtest_id = { "XTEST", 0 };
+static xcb_extension_t xinput_id = { "XInputExtension", 0 };
+
+static Listener listeners[NUM_LISTENERS];
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+fake_motion(xcb_connection_t *c, xcb_window_t root, int x, int y)
+{
+    FakeInputReq fi;
+    xcb_protocol_request_t req = { 2, &xtest_id, XTEST_FAKE_INPUT, 1 };
+    struct iovec parts[4];
+
+    memset(&fi, 0, sizeof(fi));
+    fi.type = XCB_MOTION_NOTIFY;
+    fi.detail = 0;              /* absolute */
+    fi.root = root;
+    fi.root_x = x;
+    fi.root_y = y;
+    parts[2].iov_base = &fi;
+    parts[2].iov_len = sizeof(fi);
+    parts[3].iov_base = NULL;
+    parts[3].iov_len = 0;
+    xcb_send_request(c, 0, parts + 2, &req);
+}
+
+static int
+select_raw_motion(xcb_connection_t *c, xcb_window_t root)
+{
+    QueryVersionReq qv = { 0, 0, 0, 2, 2 };
+    SelectEventsReq se = { 0, 0, 0, root, 1, 0, XI_ALL_MASTER_DEVICES, 1,
+                           1 << XI_RAW_MOTION };
+    xcb_protocol_request_t req = { 2, &xinput_id, XI_QUERY_VERSION, 0 };
+    struct iovec parts[4];
+    xcb_generic_error_t *err = NULL;
+    void *reply;
+    unsigned int seq;
+
+    parts[2].iov_base = &qv;
+    parts[2].iov_len = sizeof(qv);
+    parts[3].iov_base = NULL;
+    parts[3].iov_len = 0;
+    seq = xcb_send_request(c, XCB_REQUEST_CHECKED, parts + 2, &req);
+    reply = xcb_wait_for_reply(c, seq, &err);
+    if (!reply)
+        return 0;
+    free(reply);
+
+    req.opcode = XI_SELECT_EVENTS;
+    req.isvoid = 1;
+    parts[2].iov_base = &se;
+    parts[2].iov_len = sizeof(se);
+    seq = xcb_send_request(c, XCB_REQUEST_CHECKED, parts + 2, &req);
+    err = xcb_request_check(c, (xcb_void_cookie_t) { seq });
+    if (err) {
+        free(err);
+        return 0;
+    }
+    return 1;
+}
+
+static int
+drain(Listener *l, uint8_t xi_opcode)
+{
+    xcb_generic_event_t *ev;
+
+    /* everything sent before the reply has been read once it's here */
+    free(xcb_get_input_focus_reply(l->c, xcb_get_input_focus(l->c), NULL));
+    while ((ev = xcb_poll_for_event(l->c))) {
+        xcb_ge_generic_event_t *ge = (xcb_ge_generic_event_t *) ev;
+
+        if (ev->response_type == 0) {
+            free(ev);
+            return 0;
+        }
+        if ((ev->response_type & 0x7f) == XCB_GE_GENERIC &&
+            ge->extension == xi_opcode && ge->event_type == XI_RAW_MOTION)
+            l->raw++;
+        else
+            l->other++;
+        free(ev);
+    }
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    xcb_connection_t *c = xcb_connect(NULL, NULL);
+    const xcb_query_extension_reply_t *ext;
+    xcb_screen_t *screen;
+    unsigned long nmotions = 0;
+    double start, elapsed = 0;
+    int round, i;
+
+    if (xcb_connection_has_error(c))
+        return 1;
+
+    screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+    ext = xcb_get_extension_data(c, &xtest_id);
+    if (!ext || !ext->present) {
+        fprintf(stderr, "XTEST not present\n");
+        return 1;
+    }
+    ext = xcb_get_extension_data(c, &xinput_id);
+    if (!ext || !ext->present) {
+        fprintf(stderr, "XInputExtension not present\n");
+        return 1;
+    }
+
+    for (i = 0; i < NUM_LISTENERS; i++) {
+        Listener *l = &listeners[i];
+
+        l->c = xcb_connect(NULL, NULL);
+        if (xcb_connection_has_error(l->c))
+            return 1;
+        if (!select_raw_motion(l->c, screen->root)) {
+            fprintf(stderr, "XISelectEvents failed\n");
+            return 1;
+        }
+    }
+
+    for (round = 0; round < NUM_ROUNDS; round++) {
+        start = now();
+        for (i = 0; i < MOTIONS_PER_ROUND; i++) {
+            /* always somewhere new, so each one is a motion */
+            fake_motion(c, screen->root, 100 + i % 2, 100 + round % 2);
+            nmotions++;
+        }
+        free(xcb_get_input_focus_reply(c, xcb_get_input_focus(c), NULL));
+
+        /* the events only count once the listeners have them */
+        for (i = 0; i < NUM_LISTENERS; i++) {
+            if (!drain(&listeners[i], ext->major_opcode)) {
+                fprintf(stderr, "X error on listener %d\n", i);
+                return 1;
+            }
+        }
+        elapsed += now() - start;
+    }
+
+    for (i = 0; i < NUM_LISTENERS; i++) {
+        Listener *l = &listeners[i];
+
+        if (l->other || l->raw != nmotions) {
+            fprintf(stderr, "listener %d got %lu raw motion and %lu other "
+                    "events, expected %lu raw motion\n", i, l->raw,
+                    l->other, nmotions);
+            return 1;
+        }
+        xcb_disconnect(l->c);
+    }
+
+    printf("%lu raw motion events to %d XI2 listeners in %.3f s: "
+           "%.0f events/s\n", nmotions * NUM_LISTENERS, NUM_LISTENERS,
+           elapsed, nmotions * NUM_LISTENERS / elapsed);
+
+    xcb_disconnect(c);
+
+    return 0;
+}
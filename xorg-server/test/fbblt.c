@@ -0,0 +1,270 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Tests that the vector fbBlt, fbBltOne and glyph mask add kernels write
+ * exactly what the word-at-a-time code does.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fb.h"
+
+#include "tests-common.h"
+
+#define ITERATIONS  2000
+#define MAX_WIDTH   200         /* pixels */
+#define MAX_HEIGHT  8
+#define STRIDE      (MAX_WIDTH * 3)     /* FbBits, room for any x at 32bpp */
+#define BUF_WORDS   (STRIDE * (MAX_HEIGHT * 3))
+
+static FbBits src[BUF_WORDS], ref[BUF_WORDS], out[BUF_WORDS];
+
+static void
+fill_random(FbBits *buf, int n)
+{
+    static CARD32 x = 0x12345678;
+    int i;
+
+    for (i = 0; i < n; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        buf[i] = x;
+    }
+}
+
+static int
+random_bpp(void)
+{
+    static const int bpps[] = { 1, 4, 8, 16, 24, 32 };
+
+    return bpps[rand() % ARRAY_SIZE(bpps)];
+}
+
+static FbBits
+random_pm(int bpp)
+{
+    if (rand() % 2)
+        return FB_ALLONES;
+    return fbReplicatePixel(((FbBits) rand() << 16) ^ (FbBits) rand(), bpp);
+}
+
+static int
+max_level(void)
+{
+    return fbSimdLevel(FB_SIMD_AVX2);
+}
+
+/* separate source and destination, every rop, any alignment */
+static void
+fbblt_random(void)
+{
+    int top = max_level();
+    int i, level;
+
+    for (i = 0; i < ITERATIONS; i++) {
+        int bpp = random_bpp();
+        int alu = rand() % 16;
+        FbBits pm = random_pm(bpp);
+        int width = 1 + rand() % MAX_WIDTH;
+        int height = 1 + rand() % MAX_HEIGHT;
+        int srcX = rand() % MAX_WIDTH;
+        int dstX = rand() % MAX_WIDTH;
+        Bool upsidedown = rand() % 2;
+
+        fill_random(src, BUF_WORDS);
+        fill_random(ref, BUF_WORDS);
+
+        fbSimdLevel(FB_SIMD_NONE);
+        memcpy(out, ref, sizeof(out));
+        fbBlt(src, STRIDE, srcX * bpp, ref, STRIDE, dstX * bpp,
+              width * bpp, height, alu, pm, bpp, FALSE, upsidedown);
+
+        for (level = FB_SIMD_SSE2; level <= top; level++) {
+            FbBits copy[BUF_WORDS];
+
+            memcpy(copy, out, sizeof(copy));
+            fbSimdLevel(level);
+            fbBlt(src, STRIDE, srcX * bpp, copy, STRIDE, dstX * bpp,
+                  width * bpp, height, alu, pm, bpp, FALSE, upsidedown);
+            assert(memcmp(copy, ref, sizeof(copy)) == 0);
+        }
+    }
+}
+
+/*
+ * Scrolls within one buffer, with reverse and upsidedown set the way
+ * fbCopyRegion does.
+ */
+static void
+fbblt_overlap(void)
+{
+    int top = max_level();
+    int i, level;
+
+    for (i = 0; i < ITERATIONS; i++) {
+        int bpp = random_bpp();
+        int alu = rand() % 2 ? GXcopy : rand() % 16;
+        FbBits pm = random_pm(bpp);
+        int width = 1 + rand() % MAX_WIDTH;
+        int height = 1 + rand() % MAX_HEIGHT;
+        int srcX = MAX_WIDTH / 2 + rand() % MAX_WIDTH / 2;
+        int srcY = MAX_HEIGHT / 2 + rand() % (MAX_HEIGHT / 2);
+        int dstX = srcX + rand() % 65 - 32;
+        int dstY = srcY + rand() % (MAX_HEIGHT / 2 + 1) - MAX_HEIGHT / 4;
+        Bool reverse = srcX < dstX;
+        Bool upsidedown = srcY < dstY;
+        FbBits orig[BUF_WORDS];
+
+        fill_random(orig, BUF_WORDS);
+
+        fbSimdLevel(FB_SIMD_NONE);
+        memcpy(ref, orig, sizeof(ref));
+        fbBlt(ref + srcY * STRIDE, STRIDE, srcX * bpp,
+              ref + dstY * STRIDE, STRIDE, dstX * bpp,
+              width * bpp, height, alu, pm, bpp, reverse, upsidedown);
+
+        for (level = FB_SIMD_SSE2; level <= top; level++) {
+            memcpy(out, orig, sizeof(out));
+            fbSimdLevel(level);
+            fbBlt(out + srcY * STRIDE, STRIDE, srcX * bpp,
+                  out + dstY * STRIDE, STRIDE, dstX * bpp,
+                  width * bpp, height, alu, pm, bpp, reverse, upsidedown);
+            assert(memcmp(out, ref, sizeof(out)) == 0);
+        }
+    }
+}
+
+/* bitmap expansion, opaque, transparent and general rrops */
+static void
+fbbltone_random(void)
+{
+    static const int bpps[] = { 8, 16, 32 };
+    int top = max_level();
+    int i, level;
+
+    for (i = 0; i < ITERATIONS; i++) {
+        int bpp = bpps[rand() % ARRAY_SIZE(bpps)];
+        int width = 1 + rand() % MAX_WIDTH;
+        int height = 1 + rand() % MAX_HEIGHT;
+        int srcX = rand() % 64;
+        int dstX = rand() % MAX_WIDTH;
+        FbBits fgand, fgxor, bgand, bgxor;
+        FbBits orig[BUF_WORDS];
+
+        fgxor = fbReplicatePixel(rand(), bpp);
+        bgxor = fbReplicatePixel(rand(), bpp);
+        switch (rand() % 3) {
+        case 0:                /* opaque copy */
+            fgand = bgand = 0;
+            break;
+        case 1:                /* transparent background */
+            fgand = 0;
+            bgand = FB_ALLONES;
+            bgxor = 0;
+            break;
+        default:
+            fgand = fbReplicatePixel(rand(), bpp);
+            bgand = fbReplicatePixel(rand(), bpp);
+            break;
+        }
+
+        fill_random(src, BUF_WORDS);
+        fill_random(orig, BUF_WORDS);
+
+        fbSimdLevel(FB_SIMD_NONE);
+        memcpy(ref, orig, sizeof(ref));
+        fbBltOne(src, STRIDE / 4, srcX, ref, STRIDE, dstX * bpp, bpp,
+                 width * bpp, height, fgand, fgxor, bgand, bgxor);
+
+        for (level = FB_SIMD_SSE2; level <= top; level++) {
+            memcpy(out, orig, sizeof(out));
+            fbSimdLevel(level);
+            fbBltOne(src, STRIDE / 4, srcX, out, STRIDE, dstX * bpp, bpp,
+                     width * bpp, height, fgand, fgxor, bgand, bgxor);
+            assert(memcmp(out, ref, sizeof(out)) == 0);
+        }
+    }
+}
+
+/* saturating byte add of a glyph into a mask, any width and alignment */
+static void
+fbadd_random(void)
+{
+    int top = max_level();
+    int i, level;
+
+    for (i = 0; i < ITERATIONS; i++) {
+        int bytes = 1 + rand() % (MAX_WIDTH * 4);
+        int height = 1 + rand() % MAX_HEIGHT;
+        int srcX = rand() % 16;
+        int dstX = rand() % 16;
+        CARD8 *s = (CARD8 *) src + srcX;
+        CARD8 *r = (CARD8 *) ref + dstX;
+        int stride = STRIDE * sizeof(FbBits);
+        int x, y;
+
+        fill_random(src, BUF_WORDS);
+        fill_random(ref, BUF_WORDS);
+        memcpy(out, ref, sizeof(out));
+
+        for (y = 0; y < height; y++)
+            for (x = 0; x < bytes; x++) {
+                int t = r[y * stride + x] + s[y * stride + x];
+
+                r[y * stride + x] = t > 0xff ? 0xff : t;
+            }
+
+        fbSimdLevel(FB_SIMD_NONE);
+        assert(!fbAddSimd((CARD8 *) out + dstX, stride, s, stride,
+                          bytes, height));
+
+        for (level = FB_SIMD_SSE2; level <= top; level++) {
+            FbBits copy[BUF_WORDS];
+
+            memcpy(copy, out, sizeof(copy));
+            fbSimdLevel(level);
+            assert(fbAddSimd((CARD8 *) copy + dstX, stride, s, stride,
+                             bytes, height));
+            assert(memcmp(copy, ref, sizeof(copy)) == 0);
+        }
+    }
+}
+
+int
+fbblt_test(void)
+{
+    srand(0x5eed);
+
+    fbblt_random();
+    fbblt_overlap();
+    fbbltone_random();
+    fbadd_random();
+
+    fbSimdLevel(FB_SIMD_AVX2);
+    return 0;
+}
@@ -1810,35 +1810,158 @@ static void
 mieq_test(void)
 {
     uint32_t next = 1;
+    unsigned long dropped, coalesced;
 
     mieq_test_event_last_processed = 0;
     mieqInit();
     mieqSetHandler(ET_RawMotion, mieq_test_event_handler);
 
-    /* Enough to fit the buffer but trigger a grow */
+    /* Fits into the slots allocated up front */
     mieq_test_generate_events(180);
-
-    /* We should resize to 512 now */
     mieqProcessInputEvents();
 
-    /* Some should now get dropped */
+    /* Needs more slots allocated */
     mieq_test_generate_events(500);
-
-    /* Tell us how many got dropped, 1024 now */
     mieqProcessInputEvents();
 
-    /* Now make it 2048 */
     mieq_test_generate_events(900);
     mieqProcessInputEvents();
 
-    /* Now make it 4096 (max) */
+    /* Wraps around the end of the ring */
     mieq_test_generate_events(1950);
     mieqProcessInputEvents();
 
-    /* Now overflow one last time with the maximal queue and reach the verbosity limit */
+    /* Raw events without a device ID are never coalesced */
+    mieqGetCounters(&dropped, &coalesced);
+    assert(dropped == 0);
+    assert(coalesced == 0);
+
+    /* Now overflow the queue and reach the verbosity limit */
     mieq_test_generate_events(10000);
     mieqProcessInputEvents();
 
+    mieqGetCounters(&dropped, &coalesced);
+    assert(dropped == 10000 - 4095);
+
+    mieqFini();
+}
+
+/* Motion coalescing: relative raw deltas add up, the last position wins */
+static int mieq_coalesce_raw_events;
+static int mieq_coalesce_motion_events;
+static double mieq_coalesce_raw_sum;
+static double mieq_coalesce_last_x;
+static double mieq_coalesce_last_pressure;
+
+static void
+mieq_coalesce_event_handler(int screenNum, InternalEvent *ie, DeviceIntPtr dev)
+{
+    if (ie->any.type == ET_RawMotion) {
+        assert(BitIsOn(ie->raw_event.valuators.mask, 0));
+        mieq_coalesce_raw_sum += ie->raw_event.valuators.data_raw[0];
+        mieq_coalesce_raw_events++;
+    }
+    else {
+        assert(ie->any.type == ET_Motion);
+        assert(BitIsOn(ie->device_event.valuators.mask, 0));
+        mieq_coalesce_last_x = ie->device_event.valuators.data[0];
+        if (BitIsOn(ie->device_event.valuators.mask, 2))
+            mieq_coalesce_last_pressure = ie->device_event.valuators.data[2];
+        mieq_coalesce_motion_events++;
+    }
+}
+
+static void
+mieq_coalesce_enqueue(DeviceIntPtr dev, int i, Bool with_raw)
+{
+    RawDeviceEvent raw = { 0 };
+    DeviceEvent motion = { 0 };
+
+    raw.header = ET_Internal;
+    raw.type = ET_RawMotion;
+    raw.length = sizeof(raw);
+    raw.deviceid = dev->id;
+    raw.relative = TRUE;
+    SetBit(raw.valuators.mask, 0);
+    raw.valuators.data[0] = 2;
+    raw.valuators.data_raw[0] = 1;
+
+    motion.header = ET_Internal;
+    motion.type = ET_Motion;
+    motion.length = sizeof(motion);
+    motion.deviceid = dev->id;
+    SetBit(motion.valuators.mask, 0);
+    motion.valuators.data[0] = i;
+    /* only some events carry the pressure */
+    if (i % 3 == 0) {
+        SetBit(motion.valuators.mask, 2);
+        motion.valuators.data[2] = i;
+    }
+
+    if (with_raw)
+        mieqEnqueue(dev, (InternalEvent *) &raw);
+    mieqEnqueue(dev, (InternalEvent *) &motion);
+}
+
+static void
+mieq_coalesce_test(void)
+{
+    static DeviceIntRec dev, other;
+    static SpriteInfoRec spriteInfo;
+    static SpriteRec sprite;
+    unsigned long dropped, coalesced;
+    int i;
+
+    memset(&dev, 0, sizeof(dev));
+    memset(&spriteInfo, 0, sizeof(spriteInfo));
+    memset(&sprite, 0, sizeof(sprite));
+    dev.spriteInfo = &spriteInfo;
+    spriteInfo.sprite = &sprite;
+    dev.enabled = 1;
+    dev.id = 2;
+    other = dev;
+    other.id = 3;
+
+    mieqInit();
+    mieqSetHandler(ET_RawMotion, mieq_coalesce_event_handler);
+    mieqSetHandler(ET_Motion, mieq_coalesce_event_handler);
+
+    /* 128 pairs fill the queue up to the threshold, the rest are folded
+     * into the last of those */
+    for (i = 0; i < 5000; i++)
+        mieq_coalesce_enqueue(&dev, i, TRUE);
+
+    mieqGetCounters(&dropped, &coalesced);
+    assert(dropped == 0);
+    assert(coalesced == 2 * (5000 - 128));
+
+    mieqProcessInputEvents();
+    assert(mieq_coalesce_raw_events == 128);
+    assert(mieq_coalesce_motion_events == 128);
+    assert(mieq_coalesce_raw_sum == 5000);
+    assert(mieq_coalesce_last_x == 4999);
+    assert(mieq_coalesce_last_pressure == 4998);
+
+    /* Motion without raw events, interleaved with a second device: only
+     * consecutive events from the same device are merged */
+    mieq_coalesce_motion_events = 0;
+    for (i = 0; i < 256; i++)
+        mieq_coalesce_enqueue(&dev, i, FALSE);
+    for (i = 0; i < 100; i++) {
+        mieq_coalesce_enqueue(&dev, i, FALSE);
+        mieq_coalesce_enqueue(&other, i, FALSE);
+    }
+    for (i = 0; i < 100; i++)
+        mieq_coalesce_enqueue(&dev, i, FALSE);
+
+    mieqGetCounters(&dropped, &coalesced);
+    assert(dropped == 0);
+    assert(coalesced == 2 * (5000 - 128) + 100);
+
+    mieqProcessInputEvents();
+    assert(mieq_coalesce_motion_events == 256 + 199 + 1);
+    assert(mieq_coalesce_last_x == 99);
+
     mieqFini();
 }
 
@@ -1928,6 +2051,7 @@ input_test(void)
     dix_get_master();
     input_option_test();
     mieq_test();
+    mieq_coalesce_test();
 
     return 0;
 }
@@ -220,6 +220,45 @@ bswap_test(void)
     assert(result_64 == expect_64);
 }
 
+static void
+bswap_list_test(void)
+{
+    CARD32 longs[40];
+    short shorts[80];
+    int start, count, i;
+
+    /* every length and offset either side of the unrolled/vector loops */
+    for (start = 0; start < 4; start++) {
+        for (count = 0; count <= 35; count++) {
+            for (i = 0; i < ARRAY_SIZE(longs); i++)
+                longs[i] = 0x01020304u * (i + 1);
+            SwapLongs(longs + start, count);
+            for (i = 0; i < ARRAY_SIZE(longs); i++) {
+                CARD32 expect = 0x01020304u * (i + 1);
+
+                if (i >= start && i < start + count)
+                    expect = bswap_32(expect);
+                assert(longs[i] == expect);
+            }
+        }
+    }
+
+    for (start = 0; start < 8; start++) {
+        for (count = 0; count <= 70; count++) {
+            for (i = 0; i < ARRAY_SIZE(shorts); i++)
+                shorts[i] = 0x0102 * (i + 1);
+            SwapShorts(shorts + start, count);
+            for (i = 0; i < ARRAY_SIZE(shorts); i++) {
+                short expect = 0x0102 * (i + 1);
+
+                if (i >= start && i < start + count)
+                    expect = bswap_16(expect);
+                assert(shorts[i] == expect);
+            }
+        }
+    }
+}
+
 int
 misc_test(void)
 {
@@ -227,6 +266,7 @@ misc_test(void)
     dix_update_desktop_dimensions();
     dix_request_size_checks();
     bswap_test();
+    bswap_list_test();
 
     return 0;
 }
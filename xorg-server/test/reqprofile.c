@@ -0,0 +1,124 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Tests for the -reqprofile counters.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <assert.h>
+#include <X11/X.h>
+#include <X11/Xproto.h>
+#include "misc.h"
+#include "dixstruct.h"
+#include "reqprofile.h"
+
+#include "tests-common.h"
+
+static ClientRec client_a;
+static ClientRec client_b;
+
+struct seen {
+    int num;
+    int major[8], minor[8];
+    RequestProfileEntryRec entry[8];
+};
+
+static void
+collect_cb(int major, int minor, RequestProfileEntryPtr entry, void *closure)
+{
+    struct seen *seen = closure;
+
+    assert(seen->num < ARRAY_SIZE(seen->major));
+    seen->major[seen->num] = major;
+    seen->minor[seen->num] = minor;
+    seen->entry[seen->num] = *entry;
+    seen->num++;
+}
+
+static void
+reqprofile_counts(void)
+{
+    struct seen seen = { 0 };
+
+    InitClient(&client_a, 1, NULL);
+    InitClient(&client_b, 2, NULL);
+
+    assert(RequestProfileForEach(NULL, NULL, NULL) == 0);
+    assert(RequestProfileForEach(&client_a, NULL, NULL) == 0);
+
+    RequestProfileRecord(&client_a, X_PolyFillRectangle, 0, 20, 0);
+    RequestProfileRecord(&client_a, X_PolyFillRectangle, 0, 28, 1);
+    RequestProfileRecord(&client_a, 130, 4, 8, 3);
+    RequestProfileRecord(&client_b, 130, 4, 8, 1000);
+    RequestProfileRecord(&client_b, 130, 7, 12, (CARD64) 1 << 40);
+
+    /* opcodes come out in order, extension minors separately */
+    assert(RequestProfileForEach(NULL, collect_cb, &seen) == 3);
+    assert(seen.num == 3);
+    assert(seen.major[0] == X_PolyFillRectangle && seen.minor[0] == 0);
+    assert(seen.major[1] == 130 && seen.minor[1] == 4);
+    assert(seen.major[2] == 130 && seen.minor[2] == 7);
+
+    assert(seen.entry[0].count == 2);
+    assert(seen.entry[0].bytes == 48);
+    assert(seen.entry[0].time == 1);
+    assert(seen.entry[0].hist[0] == 1);
+    assert(seen.entry[0].hist[1] == 1);
+
+    assert(seen.entry[1].count == 2);
+    assert(seen.entry[1].time == 1003);
+    assert(seen.entry[1].hist[2] == 1);  /* 2-3 us */
+    assert(seen.entry[1].hist[10] == 1); /* 512-1023 us */
+
+    /* anything too long ends up in the last bucket */
+    assert(seen.entry[2].hist[REQ_PROFILE_BUCKETS - 1] == 1);
+    assert(seen.entry[2].time == (CARD64) 1 << 40);
+
+    seen.num = 0;
+    assert(RequestProfileForEach(&client_a, collect_cb, &seen) == 2);
+    assert(seen.entry[1].count == 1 && seen.entry[1].time == 3);
+    seen.num = 0;
+    assert(RequestProfileForEach(&client_b, collect_cb, &seen) == 2);
+    assert(seen.entry[0].count == 1 && seen.entry[0].time == 1000);
+
+    /* resetting a client leaves the server totals alone */
+    RequestProfileReset(&client_a);
+    assert(client_a.req_profile == NULL);
+    assert(RequestProfileForEach(&client_a, NULL, NULL) == 0);
+    assert(RequestProfileForEach(NULL, NULL, NULL) == 3);
+
+    RequestProfileReset(NULL);
+    assert(RequestProfileForEach(NULL, NULL, NULL) == 0);
+    assert(RequestProfileForEach(&client_b, NULL, NULL) == 2);
+    RequestProfileReset(&client_b);
+}
+
+int
+reqprofile_test(void)
+{
+    reqprofile_counts();
+
+    return 0;
+}
@@ -0,0 +1,378 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Tests for the per-client resource tables and per-type lists, plus rough
+ * create/lookup/free churn and type walk benchmarks.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "misc.h"
+#include "resource.h"
+#include "dixstruct.h"
+#include "privates.h"
+
+#include "tests-common.h"
+
+#define NUM_GROW_RESOURCES      100000
+#define NUM_BENCH_RESOURCES     1000000
+
+static ClientRec server_client;
+static ClientRec test_client;
+static RESTYPE type_a, type_b, type_c, type_partner, type_never, type_census;
+
+static int num_freed;
+static uintptr_t freed_order[8];
+
+static int
+delete_cb(void *value, XID id)
+{
+    if (num_freed < ARRAY_SIZE(freed_order))
+        freed_order[num_freed] = (uintptr_t) value;
+    num_freed++;
+    return Success;
+}
+
+/* frees the resource whose ID is stored as its value */
+static int
+delete_partner_cb(void *value, XID id)
+{
+    num_freed++;
+    FreeResource((XID) (uintptr_t) value, RT_NONE);
+    return Success;
+}
+
+static int num_found;
+
+static void
+count_cb(void *value, XID id, void *cdata)
+{
+    num_found++;
+}
+
+/* walks the client while it is being torn down; the value is how many
+ * resources it had to begin with */
+static int
+delete_census_cb(void *value, XID id)
+{
+    num_freed++;
+    num_found = 0;
+    FindClientResourcesByType(&test_client, RT_NONE, count_cb, NULL);
+    assert(num_found == (int) (uintptr_t) value - num_freed);
+    assert(num_found ==
+           CountClientResourcesByType(&test_client, type_a) +
+           CountClientResourcesByType(&test_client, type_b) +
+           CountClientResourcesByType(&test_client, type_partner) +
+           CountClientResourcesByType(&test_client, type_census));
+    return Success;
+}
+
+static XID
+test_id(int n)
+{
+    return test_client.clientAsMask | n;
+}
+
+static void
+resource_init(void)
+{
+    dixResetPrivates();
+    serverClient = &server_client;
+    InitClient(serverClient, 0, (void *) NULL);
+    assert(InitClientResources(serverClient));
+
+    type_a = CreateNewResourceType(delete_cb, "TestA");
+    type_b = CreateNewResourceType(delete_cb, "TestB");
+    type_c = CreateNewResourceType(delete_cb, "TestC");
+    type_partner = CreateNewResourceType(delete_partner_cb, "TestPartner");
+    type_never = CreateNewResourceType(delete_cb, "TestNever") |
+        RC_NEVERRETAIN;
+    type_census = CreateNewResourceType(delete_census_cb, "TestCensus");
+    assert(type_a && type_b && type_c && type_partner && type_never &&
+           type_census);
+
+    InitClient(&test_client, 1, (void *) NULL);
+}
+
+static void
+resource_same_id(void)
+{
+    XID id = test_id(1);
+    void *val;
+    int i;
+
+    assert(InitClientResources(&test_client));
+    num_freed = 0;
+
+    assert(AddResource(id, type_a, (void *) 1));
+    assert(AddResource(id, type_b, (void *) 2));
+
+    /* push the table through a few rehashes between the two halves */
+    for (i = 0; i < NUM_GROW_RESOURCES; i++)
+        assert(AddResource(test_id(100 + i), type_c, (void *) 0));
+    assert(AddResource(id, type_c, (void *) 3));
+
+    assert(dixLookupResourceByType(&val, id, type_a, NullClient,
+                                   DixReadAccess) == Success);
+    assert(val == (void *) 1);
+    assert(dixLookupResourceByType(&val, id, type_b, NullClient,
+                                   DixReadAccess) == Success);
+    assert(val == (void *) 2);
+    assert(dixLookupResourceByClass(&val, id, RC_ANY, NullClient,
+                                    DixReadAccess) == Success);
+    assert(val == (void *) 3);
+
+    /* resources sharing an ID are freed newest first */
+    FreeResource(id, RT_NONE);
+    assert(num_freed == 3);
+    assert(freed_order[0] == 3);
+    assert(freed_order[1] == 2);
+    assert(freed_order[2] == 1);
+    assert(dixLookupResourceByClass(&val, id, RC_ANY, NullClient,
+                                    DixReadAccess) == BadValue);
+
+    for (i = 0; i < NUM_GROW_RESOURCES; i++)
+        assert(dixLookupResourceByType(&val, test_id(100 + i), type_c,
+                                       NullClient, DixReadAccess) == Success);
+
+    num_freed = 0;
+    FreeClientResources(&test_client);
+    assert(num_freed == NUM_GROW_RESOURCES);
+}
+
+static void
+resource_walk(void)
+{
+    int i;
+
+    assert(InitClientResources(&test_client));
+    num_freed = 0;
+
+    for (i = 0; i < 1000; i++)
+        assert(AddResource(test_id(1 + i), i % 2 ? type_a : type_b,
+                           (void *) 0));
+
+    num_found = 0;
+    FindClientResourcesByType(&test_client, type_a, count_cb, NULL);
+    assert(num_found == 500);
+    num_found = 0;
+    FindClientResourcesByType(&test_client, RT_NONE, count_cb, NULL);
+    assert(num_found == 1000);
+
+    /* delete functions that free other resources of the same client */
+    for (i = 0; i < 1000; i++)
+        assert(AddResource(test_id(2000 + i), type_partner,
+                           (void *) (uintptr_t) test_id(1 + i)));
+    for (i = 0; i < 1000; i += 2)
+        FreeResource(test_id(2000 + i), RT_NONE);
+    assert(num_freed == 1000);
+
+    num_found = 0;
+    FindClientResourcesByType(&test_client, RT_NONE, count_cb, NULL);
+    assert(num_found == 1000);
+
+    /* walks from delete functions while the whole client goes */
+    for (i = 0; i < 10; i++)
+        assert(AddResource(test_id(3000 + i), type_census,
+                           (void *) (uintptr_t) 1010));
+    num_freed = 0;
+    FreeClientResources(&test_client);
+    assert(num_freed == 1010);
+}
+
+static int num_partners;
+
+/* frees its partner, and itself every other time */
+static void
+free_partner_cb(void *value, XID id, void *cdata)
+{
+    num_found++;
+    FreeResource((XID) (uintptr_t) value, RT_NONE);
+    if (num_partners++ % 2)
+        FreeResource(id, RT_NONE);
+}
+
+static Bool
+match_cb(void *value, XID id, void *cdata)
+{
+    return id == *(XID *) cdata;
+}
+
+static void
+resource_by_type(void)
+{
+    XID id;
+    void *val;
+    int i;
+
+    assert(InitClientResources(&test_client));
+
+    for (i = 0; i < 1000; i++)
+        assert(AddResource(test_id(1 + i), type_a, (void *) 0));
+    for (i = 0; i < 10; i++)
+        assert(AddResource(test_id(2000 + i), type_b, (void *) 0));
+    for (i = 0; i < 100; i++)
+        assert(AddResource(test_id(3000 + i), type_never, (void *) 0));
+    assert(CountClientResourcesByType(&test_client, type_a) == 1000);
+    assert(CountClientResourcesByType(&test_client, type_b) == 10);
+    assert(CountClientResourcesByType(&test_client, type_c) == 0);
+
+    /* values changed in the table show up in walks */
+    id = test_id(2003);
+    assert(ChangeResourceValue(id, type_b, (void *) 7));
+    assert(LookupClientResourceComplex(&test_client, type_b, match_cb,
+                                       &id) == (void *) 7);
+    id = test_id(5000);
+    assert(!LookupClientResourceComplex(&test_client, type_b, match_cb, &id));
+
+    /* once a walk has listed a type, the list follows adds and frees */
+    assert(AddResource(test_id(2010), type_b, (void *) 9));
+    assert(CountClientResourcesByType(&test_client, type_b) == 11);
+    num_found = 0;
+    FindClientResourcesByType(&test_client, type_b, count_cb, NULL);
+    assert(num_found == 11);
+    FreeResource(test_id(2003), RT_NONE);
+    assert(CountClientResourcesByType(&test_client, type_b) == 10);
+    id = test_id(2010);
+    assert(LookupClientResourceComplex(&test_client, type_b, match_cb,
+                                       &id) == (void *) 9);
+    assert(!ChangeResourceValue(test_id(2003), type_b, (void *) 0));
+
+    /* callbacks freeing both visited and unvisited resources of the
+     * type being walked, including themselves */
+    for (i = 0; i < 1000; i++)
+        assert(AddResource(test_id(4000 + i), type_partner,
+                           (void *) (uintptr_t) test_id(1 + i)));
+    for (i = 0; i < 1000; i++)
+        assert(AddResource(test_id(6000 + i), type_c,
+                           (void *) (uintptr_t) test_id(4000 + i)));
+    num_found = num_partners = num_freed = 0;
+    FindClientResourcesByType(&test_client, type_c, free_partner_cb, NULL);
+    assert(num_found == 1000);
+    assert(num_freed == 1000 * 2 + 500);
+    assert(CountClientResourcesByType(&test_client, type_a) == 0);
+    assert(CountClientResourcesByType(&test_client, type_partner) == 0);
+    assert(CountClientResourcesByType(&test_client, type_c) == 500);
+    num_found = 0;
+    for (i = 0; i < 1000; i++)
+        if (dixLookupResourceByType(&val, test_id(6000 + i), type_c,
+                                    NullClient, DixReadAccess) == Success)
+            num_found++;
+    assert(num_found == 500);
+
+    num_freed = 0;
+    FreeClientNeverRetainResources(&test_client);
+    assert(num_freed == 100);
+    assert(CountClientResourcesByType(&test_client, type_never) == 0);
+    assert(CountClientResourcesByType(&test_client, type_b) == 10);
+
+    num_found = 0;
+    FindClientResourcesByType(&test_client, RT_NONE, count_cb, NULL);
+    assert(num_found == 510);
+
+    num_freed = 0;
+    FreeClientResources(&test_client);
+    assert(num_freed == 510);
+}
+
+static void
+resource_type_walk_bench(void)
+{
+    CARD64 start, walked;
+    int i;
+
+    assert(InitClientResources(&test_client));
+
+    for (i = 0; i < NUM_BENCH_RESOURCES; i++)
+        AddResource(test_id(1 + i), type_a, (void *) 0);
+    for (i = 0; i < 10; i++)
+        AddResource(test_id(NUM_BENCH_RESOURCES + 1 + i), type_b, (void *) 0);
+
+    num_found = 0;
+    start = GetTimeInMicros();
+    for (i = 0; i < 1000; i++)
+        FindClientResourcesByType(&test_client, type_b, count_cb, NULL);
+    walked = GetTimeInMicros();
+    assert(num_found == 10 * 1000);
+
+    printf("1000 walks over 10 of %d resources in %llu us\n",
+           NUM_BENCH_RESOURCES + 10, (unsigned long long) (walked - start));
+
+    FreeClientResources(&test_client);
+}
+
+static void
+resource_churn_bench(void)
+{
+    CARD64 start, created, looked_up, churned, freed;
+    void *val;
+    int i;
+
+    assert(InitClientResources(&test_client));
+    srand(2);
+
+    start = GetTimeInMicros();
+    for (i = 0; i < NUM_BENCH_RESOURCES; i++)
+        AddResource(test_id(1 + i), type_a, (void *) 0);
+    created = GetTimeInMicros();
+    for (i = 0; i < NUM_BENCH_RESOURCES; i++)
+        assert(dixLookupResourceByType(&val, test_id(1 + rand() % NUM_BENCH_RESOURCES),
+                                       type_a, NullClient,
+                                       DixReadAccess) == Success);
+    looked_up = GetTimeInMicros();
+    for (i = 0; i < NUM_BENCH_RESOURCES; i++) {
+        XID id = test_id(1 + rand() % NUM_BENCH_RESOURCES);
+
+        FreeResource(id, RT_NONE);
+        AddResource(id, type_b, (void *) 0);
+    }
+    churned = GetTimeInMicros();
+    FreeClientResources(&test_client);
+    freed = GetTimeInMicros();
+
+    printf("%d resources: created in %llu us, looked up in %llu us, "
+           "churned in %llu us, freed in %llu us\n",
+           NUM_BENCH_RESOURCES,
+           (unsigned long long) (created - start),
+           (unsigned long long) (looked_up - created),
+           (unsigned long long) (churned - looked_up),
+           (unsigned long long) (freed - churned));
+}
+
+int
+resource_test(void)
+{
+    resource_init();
+    resource_same_id();
+    resource_walk();
+    resource_by_type();
+    resource_churn_bench();
+    resource_type_walk_bench();
+
+    return 0;
+}
@@ -0,0 +1,125 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Tests for the slab caches.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include "misc.h"
+#include "slab.h"
+
+#include "tests-common.h"
+
+#define NUM_OBJECTS 1000
+#define OBJECT_SIZE 100
+
+static void
+slab_alloc_free(void)
+{
+    SlabCachePtr cache = SlabCacheCreate("test", OBJECT_SIZE);
+    SlabStatsRec stats;
+    char *objects[NUM_OBJECTS];
+    void *big;
+    int i;
+
+    assert(cache);
+
+    for (i = 0; i < NUM_OBJECTS; i++) {
+        objects[i] = SlabAlloc(cache, OBJECT_SIZE - i % 2);
+        assert(objects[i]);
+        assert(((uintptr_t) objects[i] & (sizeof(void *) - 1)) == 0);
+        memset(objects[i], i, OBJECT_SIZE);
+    }
+    for (i = 0; i < NUM_OBJECTS; i++) {
+        char expect[OBJECT_SIZE];
+
+        memset(expect, i, sizeof(expect));
+        assert(memcmp(objects[i], expect, sizeof(expect)) == 0);
+    }
+
+    SlabCacheGetStats(cache, &stats);
+    assert(stats.perSlab >= 8);
+    assert(stats.allocs == NUM_OBJECTS);
+    assert(stats.inUse == NUM_OBJECTS);
+    assert(stats.slabs == (NUM_OBJECTS + stats.perSlab - 1) / stats.perSlab);
+    assert(stats.hits == NUM_OBJECTS - stats.slabs);
+
+    /* the slot just freed is the next one handed out */
+    SlabFree(objects[500]);
+    assert(SlabAlloc(cache, OBJECT_SIZE) == objects[500]);
+
+    /* too big for the cache, so from malloc and not counted as in use */
+    big = SlabAlloc(cache, OBJECT_SIZE + 1);
+    assert(big);
+    memset(big, 0, OBJECT_SIZE + 1);
+    SlabCacheGetStats(cache, &stats);
+    assert(stats.allocs == NUM_OBJECTS + 2);
+    assert(stats.inUse == NUM_OBJECTS);
+    SlabFree(big);
+
+    /* all but one empty slab go back as soon as they empty */
+    for (i = 0; i < NUM_OBJECTS; i++)
+        SlabFree(objects[i]);
+    SlabCacheGetStats(cache, &stats);
+    assert(stats.inUse == 0);
+    assert(stats.peakInUse == NUM_OBJECTS);
+    assert(stats.slabs == 1);
+
+    /* which serves the next allocation */
+    objects[0] = SlabAlloc(cache, OBJECT_SIZE);
+    SlabCacheGetStats(cache, &stats);
+    assert(stats.slabs == 1);
+    assert(stats.hits == NUM_OBJECTS + 2 - stats.peakSlabs);
+
+    /* objects may outlive their cache */
+    objects[1] = SlabAlloc(cache, OBJECT_SIZE);
+    SlabCacheDestroy(cache);
+    SlabFree(objects[0]);
+    SlabFree(objects[1]);
+}
+
+static void
+slab_no_cache(void)
+{
+    void *object = SlabAlloc(NULL, 64);
+
+    assert(object);
+    memset(object, 0, 64);
+    SlabFree(object);
+    SlabFree(NULL);
+    SlabCacheDestroy(NULL);
+}
+
+int
+slab_test(void)
+{
+    slab_alloc_free();
+    slab_no_cache();
+
+    return 0;
+}
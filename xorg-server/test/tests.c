@@ -9,10 +9,16 @@ main(int argc, char **argv)
     run_test(string_test);
 
 #ifdef XORG_TESTS
+    run_test(atom_test);
+    run_test(fbblt_test);
     run_test(fixes_test);
     run_test(input_test);
     run_test(misc_test);
+    run_test(reqprofile_test);
+    run_test(resource_test);
     run_test(signal_logging_test);
+    run_test(slab_test);
+    run_test(timer_test);
     run_test(touch_test);
     run_test(xfree86_test);
     run_test(xkb_test);
@@ -1,13 +1,19 @@
 #ifndef TESTS_H
 #define TESTS_H
 
+int atom_test(void);
+int fbblt_test(void);
 int fixes_test(void);
 int hashtabletest_test(void);
 int input_test(void);
 int list_test(void);
 int misc_test(void);
+int reqprofile_test(void);
+int resource_test(void);
 int signal_logging_test(void);
+int slab_test(void);
 int string_test(void);
+int timer_test(void);
 int touch_test(void);
 int xfree86_test(void);
 int xkb_test(void);
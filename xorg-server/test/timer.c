@@ -0,0 +1,179 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Tests for the OS timer queue (TimerSet/TimerCancel/TimerForce), plus a
+ * rough arm/cancel benchmark.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "os.h"
+
+#include "tests-common.h"
+
+#define NUM_ORDER_TIMERS        512
+#define NUM_BENCH_TIMERS        100000
+
+static CARD32 last_expired;
+static int num_expired;
+
+static CARD32
+order_cb(OsTimerPtr timer, CARD32 now, void *arg)
+{
+    CARD32 expires = (CARD32) (uintptr_t) arg;
+
+    /* timers must fire in expiry order, and never early */
+    assert((int) (expires - last_expired) >= 0);
+    assert((int) (now - expires) >= 0);
+    last_expired = expires;
+    num_expired++;
+    return 0;
+}
+
+static void
+timer_order(void)
+{
+    OsTimerPtr timers[NUM_ORDER_TIMERS];
+    CARD32 start = GetTimeInMillis();
+    int i;
+
+    TimerInit();
+    srand(0);
+    last_expired = start;
+    num_expired = 0;
+
+    for (i = 0; i < NUM_ORDER_TIMERS; i++) {
+        CARD32 expires = start + 20 + rand() % 40;
+
+        timers[i] = TimerSet(NULL, TimerAbsolute, expires, order_cb,
+                             (void *) (uintptr_t) expires);
+        assert(timers[i]);
+    }
+
+    /* drop every third timer before it gets a chance to run */
+    for (i = 0; i < NUM_ORDER_TIMERS; i += 3)
+        TimerCancel(timers[i]);
+
+    while ((int) (GetTimeInMillis() - (start + 60)) <= 0)
+        TimerCheck();
+    TimerCheck();
+
+    assert(num_expired == NUM_ORDER_TIMERS - (NUM_ORDER_TIMERS + 2) / 3);
+
+    for (i = 0; i < NUM_ORDER_TIMERS; i++)
+        TimerFree(timers[i]);
+}
+
+static int force_count;
+
+static CARD32
+force_cb(OsTimerPtr timer, CARD32 now, void *arg)
+{
+    force_count++;
+    return 0;
+}
+
+static void
+timer_force(void)
+{
+    OsTimerPtr a, b;
+
+    TimerInit();
+    force_count = 0;
+
+    a = TimerSet(NULL, 0, 100000, force_cb, NULL);
+    b = TimerSet(NULL, 0, 50000, force_cb, NULL);
+
+    /* forcing runs a pending timer exactly once */
+    assert(TimerForce(a));
+    assert(force_count == 1);
+    assert(!TimerForce(a));
+    assert(force_count == 1);
+
+    /* re-arming with TimerForceOld fires the old instance first */
+    TimerSet(b, TimerForceOld, 60000, force_cb, NULL);
+    assert(force_count == 2);
+    assert(TimerForce(b));
+    assert(force_count == 3);
+
+    /* cancelled timers don't fire, and cancelling twice is harmless */
+    TimerSet(a, 0, 100000, force_cb, NULL);
+    TimerCancel(a);
+    TimerCancel(a);
+    assert(!TimerForce(a));
+    assert(force_count == 3);
+
+    TimerFree(a);
+    TimerFree(b);
+}
+
+static void
+timer_arm_cancel_bench(void)
+{
+    OsTimerPtr *timers = calloc(NUM_BENCH_TIMERS, sizeof(OsTimerPtr));
+    CARD64 start, armed, cancelled;
+    int i;
+
+    assert(timers);
+    TimerInit();
+    srand(1);
+
+    for (i = 0; i < NUM_BENCH_TIMERS; i++) {
+        timers[i] = TimerSet(NULL, 0, 1, force_cb, NULL);
+        TimerCancel(timers[i]);
+    }
+
+    start = GetTimeInMicros();
+    for (i = 0; i < NUM_BENCH_TIMERS; i++)
+        TimerSet(timers[i], 0, 10000 + rand() % 100000, force_cb, NULL);
+    armed = GetTimeInMicros();
+    for (i = 0; i < NUM_BENCH_TIMERS; i++)
+        TimerCancel(timers[(i * 7919) % NUM_BENCH_TIMERS]);
+    cancelled = GetTimeInMicros();
+
+    printf("armed %d timers in %llu us, cancelled in %llu us\n",
+           NUM_BENCH_TIMERS,
+           (unsigned long long) (armed - start),
+           (unsigned long long) (cancelled - armed));
+
+    for (i = 0; i < NUM_BENCH_TIMERS; i++) {
+        assert(!TimerForce(timers[i]));
+        TimerFree(timers[i]);
+    }
+    free(timers);
+}
+
+int
+timer_test(void)
+{
+    timer_order();
+    timer_force();
+    timer_arm_cancel_bench();
+
+    return 0;
+}